@@ -14,6 +14,10 @@ let package = Package(
             targets: ["lumengine"]
         ),
     ],
+    traits: [
+        // TLS termination for TCP servers, links the system OpenSSL (libssl and libcrypto)
+        .trait(name: "TLS"),
+    ],
     targets: [
         // Header only dependency Asio (Non-Boost)
         // Repository: https://github.com/chriskohlhoff/asio
@@ -29,6 +33,13 @@ let package = Package(
             name: "cxxLumengine",
             dependencies: [
                 "cxxAsio"
+            ],
+            cxxSettings: [
+                .define("LE_ENABLE_TLS", .when(traits: ["TLS"])),
+            ],
+            linkerSettings: [
+                .linkedLibrary("ssl", .when(traits: ["TLS"])),
+                .linkedLibrary("crypto", .when(traits: ["TLS"])),
             ]
         ),
         .target(
@@ -40,9 +51,61 @@ let package = Package(
                 .interoperabilityMode(.Cxx),
             ]
         ),
+        // Shared helpers of the benchmark executables: argument parsing, JSON output, CPU time
+        .target(
+            name: "cxxLumengineBenchmark",
+            dependencies: [
+                "cxxLumengine",
+            ]
+        ),
+        // Benchmarks are meant to be built with: swift run -c release <name>
+        .executableTarget(
+            name: "lumengineTcpBenchmark",
+            dependencies: [
+                "cxxLumengineBenchmark",
+            ]
+        ),
+        .executableTarget(
+            name: "lumengineUdpBenchmark",
+            dependencies: [
+                "cxxLumengineBenchmark",
+            ]
+        ),
+        .executableTarget(
+            name: "lumengineMicroBenchmark",
+            dependencies: [
+                "cxxLumengineBenchmark",
+            ]
+        ),
+        .executableTarget(
+            name: "lumengineProxyBenchmark",
+            dependencies: [
+                "cxxLumengineBenchmark",
+            ]
+        ),
+        // Needs the TLS trait: swift run -c release --traits TLS lumengineTlsBenchmark
+        .executableTarget(
+            name: "lumengineTlsBenchmark",
+            dependencies: [
+                "cxxLumengineBenchmark",
+            ],
+            cxxSettings: [
+                .define("LE_ENABLE_TLS", .when(traits: ["TLS"])),
+            ]
+        ),
+        // Checks of the C++ internals that the tests cannot reach from Swift
+        .target(
+            name: "cxxLumengineTestSupport",
+            dependencies: [
+                "cxxLumengine",
+            ],
+            cxxSettings: [
+                .define("LE_ENABLE_TLS", .when(traits: ["TLS"])),
+            ]
+        ),
         .testTarget(
             name: "lumengineTests",
-            dependencies: ["lumengine"],
+            dependencies: ["lumengine", "cxxLumengineTestSupport"],
             swiftSettings: [
                 .interoperabilityMode(.Cxx),
             ]
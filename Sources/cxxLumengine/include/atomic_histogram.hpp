@@ -0,0 +1,99 @@
+#ifndef LE_ATOMIC_HISTOGRAM_HPP
+#define LE_ATOMIC_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+// Merged histogram, values in nanoseconds. Percentiles are the upper bound of their bucket.
+struct HistogramSnapshot {
+    std::uint64_t count { 0 };
+    std::uint64_t sum_ns { 0 };
+    std::uint64_t p50_ns { 0 };
+    std::uint64_t p90_ns { 0 };
+    std::uint64_t p99_ns { 0 };
+    std::uint64_t p999_ns { 0 };
+    std::uint64_t max_ns { 0 };
+
+    [[nodiscard]] double mean_ns() const {
+        return count ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0;
+    }
+};
+
+// Log-linear histogram with atomic buckets
+// Every power of two is split into 8 buckets, so a bucket is at most 12.5% wide.
+// Values of 2^41 ns (about 36 minutes) and above land in the last bucket.
+class AtomicHistogram final {
+public:
+    static constexpr int sub_bucket_bits = 3;
+    static constexpr int value_bits = 41;
+    static constexpr std::size_t sub_bucket_count = std::size_t { 1 } << sub_bucket_bits;
+    static constexpr std::size_t bucket_count = (value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+    static constexpr std::size_t bucket_of(const std::uint64_t value) noexcept {
+        if (value < sub_bucket_count) {
+            return static_cast<std::size_t>(value);
+        }
+        const auto clamped = std::min(value, (std::uint64_t { 1 } << value_bits) - 1);
+        const auto shift = static_cast<std::size_t>(std::bit_width(clamped)) - 1 - sub_bucket_bits;
+        return (shift + 1) * sub_bucket_count + static_cast<std::size_t>((clamped >> shift) & (sub_bucket_count - 1));
+    }
+
+    static constexpr std::uint64_t upper_bound_of(const std::size_t bucket) noexcept {
+        if (bucket < sub_bucket_count) {
+            return bucket;
+        }
+        const auto shift = bucket / sub_bucket_count - 1;
+        const auto lower = (sub_bucket_count | (bucket % sub_bucket_count)) << shift;
+        return lower + (std::uint64_t { 1 } << shift) - 1;
+    }
+
+    void record(const std::uint64_t value) noexcept {
+        m_buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Adds the buckets into a plain array, used when merging shards
+    void accumulate(std::array<std::uint64_t, bucket_count>& buckets, std::uint64_t& sum) const noexcept {
+        for (std::size_t i = 0; i < bucket_count; ++i) {
+            buckets[i] += m_buckets[i].load(std::memory_order_relaxed);
+        }
+        sum += m_sum.load(std::memory_order_relaxed);
+    }
+
+    static HistogramSnapshot summarise(const std::array<std::uint64_t, bucket_count>& buckets, const std::uint64_t sum) {
+        HistogramSnapshot snapshot;
+        snapshot.sum_ns = sum;
+        for (const auto count : buckets) {
+            snapshot.count += count;
+        }
+        if (snapshot.count == 0) {
+            return snapshot;
+        }
+        const auto percentile = [&](const double fraction) -> std::uint64_t {
+            const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(fraction * static_cast<double>(snapshot.count) + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < bucket_count; ++i) {
+                seen += buckets[i];
+                if (seen >= target) {
+                    return upper_bound_of(i);
+                }
+            }
+            return upper_bound_of(bucket_count - 1);
+        };
+        snapshot.p50_ns = percentile(0.5);
+        snapshot.p90_ns = percentile(0.9);
+        snapshot.p99_ns = percentile(0.99);
+        snapshot.p999_ns = percentile(0.999);
+        snapshot.max_ns = percentile(1.0);
+        return snapshot;
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets {};
+    std::atomic<std::uint64_t> m_sum { 0 };
+};
+
+#endif //LE_ATOMIC_HISTOGRAM_HPP
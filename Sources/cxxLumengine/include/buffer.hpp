@@ -2,36 +2,51 @@
 #define LE_BUFFER_HPP
 
 #include <cstddef>
+#include <memory>
 #include <string>
 
 class Buffer;
 using BufferPtr = std::shared_ptr<Buffer>;
 class Buffer final {
     std::unique_ptr<char[]> m_ptr;
+    // Keeps the bytes of a view alive, see view()
+    std::shared_ptr<const void> m_owner;
+    char* m_data;
     std::size_t m_size;
     std::size_t m_pos { 0 };  // Current position in buffer for read/write operations
 
 public:
     // An empty buffer declaration
-    Buffer() : m_ptr(nullptr), m_size(0) {}
+    Buffer() : m_ptr(nullptr), m_data(nullptr), m_size(0) {}
 
     // Constructor with max size
     explicit Buffer(const std::size_t max_size)
-        : m_ptr(std::make_unique<char[]>(max_size)), m_size(max_size) {}
+        : m_ptr(std::make_unique<char[]>(max_size)), m_data(m_ptr.get()), m_size(max_size) {}
 
     // Constructor that consumes a std::string
     explicit Buffer(std::string&& str)
-        : m_ptr(std::make_unique<char[]>(str.size())), m_size(str.size()) {
+        : m_ptr(std::make_unique<char[]>(str.size())), m_data(m_ptr.get()), m_size(str.size()) {
         std::ranges::move(str, m_ptr.get());
     }
 
+    // Bytes owned by someone else, e.g. a mapped file of a HotFileCache, shared instead of copied.
+    // The owner stays alive as long as the buffer. Views of read-only bytes, like mapped files, must not be written.
+    [[nodiscard]] static Buffer view(std::shared_ptr<const void> owner, const char* data, const std::size_t size) {
+        Buffer buffer;
+        buffer.m_owner = std::move(owner);
+        buffer.m_data = const_cast<char*>(data);
+        buffer.m_size = size;
+        return buffer;
+    }
+
     // Disable copy constructor and copy assignment operator
     Buffer(const Buffer&) = delete;
     Buffer& operator=(const Buffer&) = delete;
 
     // Move constructor
     Buffer(Buffer&& other) noexcept
-        : m_ptr(std::move(other.m_ptr)), m_size(other.m_size) {
+        : m_ptr(std::move(other.m_ptr)), m_owner(std::move(other.m_owner)), m_data(other.m_data), m_size(other.m_size) {
+        other.m_data = nullptr;
         other.m_size = 0;
     }
 
@@ -39,18 +54,21 @@ public:
     Buffer& operator=(Buffer&& other) noexcept {
         if (this != &other) {
             m_ptr = std::move(other.m_ptr);
+            m_owner = std::move(other.m_owner);
+            m_data = other.m_data;
             m_size = other.m_size;
+            other.m_data = nullptr;
             other.m_size = 0;
         }
         return *this;
     }
 
     // Getters
-    [[nodiscard]] char* pointer() const noexcept { return m_ptr.get(); }
+    [[nodiscard]] char* pointer() const noexcept { return m_data; }
     [[nodiscard]] std::size_t size() const noexcept { return m_size; }
     [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
     [[nodiscard]] std::string to_string() const {
-        return m_size ? std::string(m_ptr.get(), m_size) : std::string();
+        return m_size ? std::string(m_data, m_size) : std::string();
     }
 
     // Helper pointer constructors
@@ -80,7 +98,7 @@ public:
         const std::size_t available = remaining();
         const std::size_t to_write = std::min(available, length);
         if (to_write > 0) {
-            std::memcpy(m_ptr.get() + m_pos, data, to_write);
+            std::memcpy(m_data + m_pos, data, to_write);
             m_pos += to_write;
         }
         return to_write;
@@ -91,7 +109,7 @@ public:
         const std::size_t available = remaining();
         const std::size_t to_read = std::min(available, length);
         if (to_read > 0) {
-            std::memcpy(data, m_ptr.get() + m_pos, to_read);
+            std::memcpy(data, m_data + m_pos, to_read);
             m_pos += to_read;
         }
         return to_read;
@@ -102,7 +120,7 @@ public:
         const std::size_t available = remaining();
         const std::size_t to_read = std::min(available, length);
         if (to_read > 0) {
-            std::memcpy(data, m_ptr.get() + m_pos, to_read);
+            std::memcpy(data, m_data + m_pos, to_read);
         }
         return to_read;
     }
@@ -0,0 +1,311 @@
+#ifndef LE_CALLBACK_PROFILER_HPP
+#define LE_CALLBACK_PROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "atomic_histogram.hpp"
+#include "io_worker.hpp"
+#include "swift_function_wrapper.hpp"
+
+enum class HandlerType {
+    TcpOnConnect,
+    TcpOnRceive,
+    TcpOnWrite,
+    TcpOnDisconnect,
+    TcpOnStart,
+    TcpOnStop,
+    UpdOnReceive,
+    UpdOnWrite,
+    UdpOnStart,
+    UdpOnStop,
+    UnixOnConnect,
+    UnixOnReceive,
+    UnixOnWrite,
+    UnixOnDisconnect,
+    UnixOnStart,
+    UnixOnStop,
+    UnixDatagramOnReceive,
+    UnixDatagramOnWrite,
+    UnixDatagramOnStart,
+    UnixDatagramOnStop,
+};
+
+inline constexpr std::size_t handler_type_count = static_cast<std::size_t>(HandlerType::UnixDatagramOnStop) + 1;
+
+inline const char* handler_type_name(const HandlerType type) {
+    switch (type) {
+        case HandlerType::TcpOnConnect: return "tcp on_connect";
+        case HandlerType::TcpOnRceive: return "tcp on_receive";
+        case HandlerType::TcpOnWrite: return "tcp on_write";
+        case HandlerType::TcpOnDisconnect: return "tcp on_disconnect";
+        case HandlerType::TcpOnStart: return "tcp on_start";
+        case HandlerType::TcpOnStop: return "tcp on_stop";
+        case HandlerType::UpdOnReceive: return "udp on_receive";
+        case HandlerType::UpdOnWrite: return "udp on_write";
+        case HandlerType::UdpOnStart: return "udp on_start";
+        case HandlerType::UdpOnStop: return "udp on_stop";
+        case HandlerType::UnixOnConnect: return "unix on_connect";
+        case HandlerType::UnixOnReceive: return "unix on_receive";
+        case HandlerType::UnixOnWrite: return "unix on_write";
+        case HandlerType::UnixOnDisconnect: return "unix on_disconnect";
+        case HandlerType::UnixOnStart: return "unix on_start";
+        case HandlerType::UnixOnStop: return "unix on_stop";
+        case HandlerType::UnixDatagramOnReceive: return "unix datagram on_receive";
+        case HandlerType::UnixDatagramOnWrite: return "unix datagram on_write";
+        case HandlerType::UnixDatagramOnStart: return "unix datagram on_start";
+        case HandlerType::UnixDatagramOnStop: return "unix datagram on_stop";
+    }
+    return "unknown";
+}
+
+// A callback that was still running when the watchdog found it over the threshold
+struct SlowCallbackReport {
+    HandlerType handler_type { HandlerType::TcpOnConnect };
+    // Port of the handler that called it
+    int port { -1 };
+    // The session, or the handler for callbacks without a session. Only meant to correlate reports.
+    const void* session { nullptr };
+    std::size_t worker { 0 };
+    // Time spent in the callback when it was found, it may run for longer
+    std::chrono::nanoseconds elapsed { 0 };
+};
+
+struct CallbackProfileSnapshot {
+    HistogramSnapshot latency {};
+    // Calls that took longer than the slow threshold
+    std::uint64_t slow_calls { 0 };
+};
+
+struct CallbackProfilerConfig {
+    std::chrono::nanoseconds slow_threshold { std::chrono::milliseconds { 10 } };
+    // How often the watchdog looks at the workers, zero for a quarter of the threshold
+    std::chrono::nanoseconds scan_interval { 0 };
+    // Runs on the watchdog thread, not on a pool thread. Slow callbacks are logged to stderr without it.
+    std::optional<SwiftFunctionWrapper<void, SlowCallbackReport>> on_slow_callback { std::nullopt };
+};
+
+// Latency of the handler callbacks, grouped by HandlerType, and a watchdog for callbacks that block a worker
+// A disabled profiler costs one relaxed load per callback. When enabled, each pool thread publishes the callback
+// it is running in its own slot, and the watchdog thread scans the slots, so a stuck callback is reported while
+// it is still blocking every session of its worker.
+class CallbackProfiler final {
+    struct alignas(64) Slot {
+        // Start of the running callback in steady clock nanoseconds, zero while the worker is outside a callback
+        std::atomic<std::int64_t> started { 0 };
+        std::atomic<std::uint64_t> sequence { 0 };
+        std::atomic<HandlerType> type { HandlerType::TcpOnConnect };
+        std::atomic<int> port { -1 };
+        std::atomic<const void*> session { nullptr };
+    };
+
+    struct alignas(64) Shard {
+        std::array<AtomicHistogram, handler_type_count> latency {};
+        std::array<std::atomic<std::uint64_t>, handler_type_count> slow_calls {};
+    };
+
+    std::size_t m_worker_count;
+    // One slot per pool thread, threads outside the pool are profiled but not watched
+    std::unique_ptr<Slot[]> m_slots;
+    // Shard 0 is shared by threads outside the pool
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<bool> m_enabled { false };
+    std::atomic<std::int64_t> m_slow_threshold_ns { 0 };
+
+    // Serialises enable and disable
+    std::mutex m_control_mutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping { false };
+    std::thread m_watchdog;
+
+    static std::int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    [[nodiscard]] std::size_t worker_index() const noexcept {
+        const auto worker = IoWorker::current();
+        return worker ? worker->index() % m_worker_count : m_worker_count;
+    }
+
+    static void log_slow_callback(const SlowCallbackReport& report) {
+        std::fprintf(stderr, "[Warning] Slow %s callback on worker %zu: %.3f ms so far (port %d, session %p)\n",
+            handler_type_name(report.handler_type),
+            report.worker,
+            static_cast<double>(report.elapsed.count()) / 1e6,
+            report.port,
+            report.session);
+    }
+
+    void scan(const CallbackProfilerConfig& config, std::vector<std::uint64_t>& reported) const {
+        const auto threshold = m_slow_threshold_ns.load(std::memory_order_relaxed);
+        const auto now = now_ns();
+        for (std::size_t i = 0; i < m_worker_count; ++i) {
+            const auto& slot = m_slots[i];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto started = slot.started.load(std::memory_order_acquire);
+            if (started == 0 || now - started < threshold || reported[i] == sequence) {
+                continue;
+            }
+            const SlowCallbackReport report {
+                slot.type.load(std::memory_order_relaxed),
+                slot.port.load(std::memory_order_relaxed),
+                slot.session.load(std::memory_order_relaxed),
+                i,
+                std::chrono::nanoseconds { now - started }
+            };
+            // The worker moved on to another callback while the slot was being read
+            if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+                continue;
+            }
+            // Each call is reported once, however long it keeps running
+            reported[i] = sequence;
+            if (config.on_slow_callback) {
+                config.on_slow_callback->call(report);
+            } else {
+                log_slow_callback(report);
+            }
+        }
+    }
+
+    void watch(const CallbackProfilerConfig config) {
+        const auto interval = config.scan_interval.count() > 0
+            ? config.scan_interval
+            : std::max<std::chrono::nanoseconds>(config.slow_threshold / 4, std::chrono::microseconds { 100 });
+        std::vector<std::uint64_t> reported(m_worker_count, 0);
+        std::unique_lock lock { m_mutex };
+        while (!m_wake.wait_for(lock, interval, [this] { return m_stopping; })) {
+            lock.unlock();
+            scan(config, reported);
+            lock.lock();
+        }
+    }
+
+    void stop_watchdog() {
+        std::thread watchdog;
+        {
+            std::lock_guard lock { m_mutex };
+            m_stopping = true;
+            watchdog = std::move(m_watchdog);
+        }
+        m_wake.notify_all();
+        if (watchdog.joinable()) {
+            watchdog.join();
+        }
+        std::lock_guard lock { m_mutex };
+        m_stopping = false;
+    }
+
+public:
+    // State of the calling worker's slot before the callback, restored once it returns
+    struct Entry {
+        Slot* slot { nullptr };
+        std::int64_t previous_started { 0 };
+        HandlerType previous_type { HandlerType::TcpOnConnect };
+        int previous_port { -1 };
+        const void* previous_session { nullptr };
+        bool active { false };
+    };
+
+    explicit CallbackProfiler(const std::size_t worker_count):
+        m_worker_count { std::max(std::size_t { 1 }, worker_count) },
+        m_slots { std::make_unique<Slot[]>(m_worker_count) },
+        m_shards { std::make_unique<Shard[]>(m_worker_count + 1) } {}
+
+    CallbackProfiler(const CallbackProfiler&) = delete;
+    CallbackProfiler& operator=(const CallbackProfiler&) = delete;
+
+    ~CallbackProfiler() {
+        disable();
+    }
+
+    // Starts profiling and the watchdog. Calling it again replaces the config.
+    void enable(CallbackProfilerConfig config) {
+        std::lock_guard control { m_control_mutex };
+        stop_watchdog();
+        m_slow_threshold_ns = std::max<std::int64_t>(1, config.slow_threshold.count());
+        m_enabled = true;
+        std::lock_guard lock { m_mutex };
+        m_watchdog = std::thread { [this, config = std::move(config)] { watch(config); } };
+    }
+
+    // Callbacks that are already running finish their measurement, histograms are kept
+    void disable() {
+        std::lock_guard control { m_control_mutex };
+        m_enabled = false;
+        stop_watchdog();
+    }
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Publishes the callback in the slot of the calling worker. Inactive when the profiler is disabled.
+    [[nodiscard]] Entry enter(const HandlerType type, const int port, const void* session,
+                              const std::chrono::steady_clock::time_point start) noexcept {
+        if (!m_enabled.load(std::memory_order_relaxed)) {
+            return {};
+        }
+        const auto index = worker_index();
+        if (index == m_worker_count) {
+            return { nullptr, 0, type, -1, nullptr, true };
+        }
+        auto& slot = m_slots[index];
+        Entry entry {
+            &slot,
+            slot.started.load(std::memory_order_relaxed),
+            slot.type.load(std::memory_order_relaxed),
+            slot.port.load(std::memory_order_relaxed),
+            slot.session.load(std::memory_order_relaxed),
+            true
+        };
+        slot.sequence.fetch_add(1, std::memory_order_relaxed);
+        slot.type.store(type, std::memory_order_relaxed);
+        slot.port.store(port, std::memory_order_relaxed);
+        slot.session.store(session, std::memory_order_relaxed);
+        slot.started.store(std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count(),
+            std::memory_order_release);
+        return entry;
+    }
+
+    void leave(const Entry& entry, const HandlerType type, const std::chrono::nanoseconds elapsed) noexcept {
+        const auto index = static_cast<std::size_t>(type);
+        auto& shard = m_shards[entry.slot ? 1 + static_cast<std::size_t>(entry.slot - m_slots.get()) : 0];
+        shard.latency[index].record(static_cast<std::uint64_t>(std::max<std::int64_t>(0, elapsed.count())));
+        if (elapsed.count() > m_slow_threshold_ns.load(std::memory_order_relaxed)) {
+            shard.slow_calls[index].fetch_add(1, std::memory_order_relaxed);
+        }
+        if (entry.slot) {
+            entry.slot->type.store(entry.previous_type, std::memory_order_relaxed);
+            entry.slot->port.store(entry.previous_port, std::memory_order_relaxed);
+            entry.slot->session.store(entry.previous_session, std::memory_order_relaxed);
+            entry.slot->started.store(entry.previous_started, std::memory_order_release);
+        }
+    }
+
+    [[nodiscard]] CallbackProfileSnapshot snapshot(const HandlerType type) const {
+        const auto index = static_cast<std::size_t>(type);
+        std::array<std::uint64_t, AtomicHistogram::bucket_count> buckets {};
+        std::uint64_t sum = 0;
+        CallbackProfileSnapshot snapshot;
+        for (std::size_t i = 0; i <= m_worker_count; ++i) {
+            m_shards[i].latency[index].accumulate(buckets, sum);
+            snapshot.slow_calls += m_shards[i].slow_calls[index].load(std::memory_order_relaxed);
+        }
+        snapshot.latency = AtomicHistogram::summarise(buckets, sum);
+        return snapshot;
+    }
+};
+
+#endif //LE_CALLBACK_PROFILER_HPP
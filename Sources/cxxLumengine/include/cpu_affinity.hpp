@@ -0,0 +1,117 @@
+#ifndef LE_CPU_AFFINITY_HPP
+#define LE_CPU_AFFINITY_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// A set of logical CPU indices, as reported by the operating system
+using CpuSet = std::vector<int>;
+
+// Parses the kernel list format used in sysfs, e.g. "0-3,8,10-11"
+inline CpuSet parse_cpu_list(const std::string& list) {
+    CpuSet cpus;
+    std::size_t position = 0;
+    while (position < list.size()) {
+        auto next = list.find(',', position);
+        if (next == std::string::npos) {
+            next = list.size();
+        }
+        const auto item = list.substr(position, next - position);
+        position = next + 1;
+
+        try {
+            if (const auto dash = item.find('-'); dash != std::string::npos) {
+                const auto first = std::stoi(item.substr(0, dash));
+                const auto last = std::stoi(item.substr(dash + 1));
+                for (auto cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            } else if (!item.empty() && item != "\n") {
+                cpus.push_back(std::stoi(item));
+            }
+        } catch (...) {
+            // Malformed entries are skipped
+        }
+    }
+    return cpus;
+}
+
+// CPUs removed from the general scheduler with the isolcpus kernel parameter. Empty when there are none
+// or when the platform does not expose them.
+inline CpuSet isolated_cpus() {
+#if defined(__linux__)
+    std::ifstream file { "/sys/devices/system/cpu/isolated" };
+    std::string list;
+    if (file && std::getline(file, list)) {
+        return parse_cpu_list(list);
+    }
+#endif
+    return {};
+}
+
+// Pins the calling thread to the given CPUs
+inline std::error_code pin_current_thread(const CpuSet& cpus) {
+    if (cpus.empty()) {
+        return {};
+    }
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        CPU_SET(cpu, &set);
+    }
+    if (const auto result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); result != 0) {
+        return { result, std::generic_category() };
+    }
+    return {};
+#else
+    // Darwin only offers affinity hints, threads are left to the scheduler
+    return std::make_error_code(std::errc::operation_not_supported);
+#endif
+}
+
+// The CPU the calling thread is running on, or -1 when unknown
+inline int current_cpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// The NUMA node a CPU belongs to, or -1 when unknown. Machines without NUMA report node 0.
+inline int numa_node_of_cpu(const int cpu) {
+#if defined(__linux__)
+    if (cpu < 0) {
+        return -1;
+    }
+    std::error_code ec;
+    const std::filesystem::path path { "/sys/devices/system/cpu/cpu" + std::to_string(cpu) };
+    for (const auto& entry : std::filesystem::directory_iterator { path, ec }) {
+        const auto name = entry.path().filename().string();
+        if (name.starts_with("node") && name.size() > 4) {
+            try {
+                return std::stoi(name.substr(4));
+            } catch (...) {
+                return -1;
+            }
+        }
+    }
+    return ec ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+#endif //LE_CPU_AFFINITY_HPP
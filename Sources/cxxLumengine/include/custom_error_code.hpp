@@ -10,6 +10,19 @@
 enum class CustomErrorCode {
     Success = 0,
     Disconnected = 1,
+    InvalidGraph,
+    Cancelled,
+    DeadlineExpired,
+    FrameTooLarge,
+    HttpBadRequest,
+    WebSocketProtocolError,
+    WebSocketClosed,
+    // A session timeout of TcpTimeouts expired
+    IdleTimeout,
+    ReadTimeout,
+    WriteTimeout,
+    // A connect of a TcpClient took longer than its connect_timeout
+    ConnectTimeout,
     UnknownError
 };
 
@@ -28,6 +41,28 @@ public:
                 return "Success";
             case CustomErrorCode::Disconnected:
                 return "Disconnected";
+            case CustomErrorCode::InvalidGraph:
+                return "Invalid workload graph";
+            case CustomErrorCode::Cancelled:
+                return "Cancelled";
+            case CustomErrorCode::DeadlineExpired:
+                return "Deadline expired";
+            case CustomErrorCode::FrameTooLarge:
+                return "Frame too large";
+            case CustomErrorCode::HttpBadRequest:
+                return "Malformed HTTP request";
+            case CustomErrorCode::WebSocketProtocolError:
+                return "WebSocket protocol error";
+            case CustomErrorCode::WebSocketClosed:
+                return "WebSocket closed by the peer";
+            case CustomErrorCode::IdleTimeout:
+                return "Idle timeout";
+            case CustomErrorCode::ReadTimeout:
+                return "Read timeout";
+            case CustomErrorCode::WriteTimeout:
+                return "Write timeout";
+            case CustomErrorCode::ConnectTimeout:
+                return "Connect timeout";
             case CustomErrorCode::UnknownError:
                 return "Unknown error";
             default:
@@ -42,6 +77,25 @@ public:
                 return { 0, std::generic_category() };
             case CustomErrorCode::Disconnected:
                 return { EINVAL, std::generic_category() };
+            case CustomErrorCode::InvalidGraph:
+                return { EINVAL, std::generic_category() };
+            case CustomErrorCode::Cancelled:
+                return { ECANCELED, std::generic_category() };
+            case CustomErrorCode::DeadlineExpired:
+                return { ETIMEDOUT, std::generic_category() };
+            case CustomErrorCode::FrameTooLarge:
+                return { EMSGSIZE, std::generic_category() };
+            case CustomErrorCode::HttpBadRequest:
+                return { EBADMSG, std::generic_category() };
+            case CustomErrorCode::WebSocketProtocolError:
+                return { EPROTO, std::generic_category() };
+            case CustomErrorCode::WebSocketClosed:
+                return { ENOTCONN, std::generic_category() };
+            case CustomErrorCode::IdleTimeout:
+            case CustomErrorCode::ReadTimeout:
+            case CustomErrorCode::WriteTimeout:
+            case CustomErrorCode::ConnectTimeout:
+                return { ETIMEDOUT, std::generic_category() };
             case CustomErrorCode::UnknownError:
                 return { EINVAL, std::generic_category() };
             default:
@@ -4,6 +4,7 @@
 #include <cxxAsio.hpp>
 #include "workload.hpp"
 #include "handlers.hpp"
+#include "hot_file_cache.hpp"
 #include "custom_error_code.hpp"
 #include "custom_terminate_handler.hpp"
 #include "swift_function_wrapper.hpp"
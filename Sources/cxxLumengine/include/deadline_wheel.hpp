@@ -0,0 +1,125 @@
+#ifndef LE_DEADLINE_WHEEL_HPP
+#define LE_DEADLINE_WHEEL_HPP
+
+#include <cxxAsio.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The deadlines of every session of one worker, driven by a single timer
+// A hashed timing wheel: each slot holds the entries due within one tick, the slot of a deadline is its tick modulo
+// the slot count. Deadlines further away than a full turn stay in their slot until their turn comes.
+// Entries are never removed. When its slot comes up an entry asks its target for the deadline that is due now,
+// so moving a deadline later, e.g. on every read, only changes the target and costs the wheel nothing. Moving it
+// earlier schedules another entry and the target recognises the superseded one by the deadline it was made for.
+// Targets are held weakly, a destroyed target drops its entry. Only the worker thread may use the wheel.
+class DeadlineWheel final {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Called with the target and the deadline its entry was scheduled for, once that deadline is reached.
+    // Returns the deadline to check next, Clock::time_point::max() drops the entry.
+    using Check = Clock::time_point (*)(void* target, Clock::time_point scheduled_for, Clock::time_point now);
+
+    // Deadlines fire up to one tick late, never early
+    static constexpr Clock::duration tick = std::chrono::milliseconds { 100 };
+
+private:
+    static constexpr std::size_t slot_count = 512;
+
+    struct Entry {
+        std::weak_ptr<void> target;
+        Check check;
+        Clock::time_point deadline;
+    };
+
+    asio::steady_timer m_timer;
+    std::array<std::vector<Entry>, slot_count> m_slots;
+    std::size_t m_entries { 0 };
+    // The first tick that has not been processed yet
+    std::uint64_t m_next_tick { 0 };
+    bool m_running { false };
+
+    // The first tick that starts at or after the deadline
+    static std::uint64_t tick_of(const Clock::time_point deadline) {
+        const auto since_epoch = deadline.time_since_epoch();
+        return static_cast<std::uint64_t>((since_epoch + tick - Clock::duration { 1 }) / tick);
+    }
+
+    // Entries that are already due go into the first tick that is still to be processed
+    void insert(Entry entry, const std::uint64_t first_tick) {
+        const auto slot = std::max(tick_of(entry.deadline), first_tick) % slot_count;
+        m_slots[slot].push_back(std::move(entry));
+    }
+
+    void start() {
+        m_running = true;
+        m_timer.expires_at(Clock::time_point { tick * static_cast<Clock::rep>(m_next_tick) });
+        m_timer.async_wait([this](const std::error_code& ec) {
+            m_running = false;
+            if (ec) {
+                return;
+            }
+            advance(Clock::now());
+            if (m_entries > 0) {
+                start();
+            }
+        });
+    }
+
+    void advance(const Clock::time_point now) {
+        // After a stall every slot is visited at most once
+        const auto last_tick = std::min(tick_of(now + Clock::duration { 1 }) - 1, m_next_tick + slot_count - 1);
+        for (; m_next_tick <= last_tick; ++m_next_tick) {
+            auto due = std::move(m_slots[m_next_tick % slot_count]);
+            m_slots[m_next_tick % slot_count].clear();
+            for (auto& entry : due) {
+                if (entry.deadline > now) {
+                    // Belongs to a later turn of the wheel
+                    m_slots[m_next_tick % slot_count].push_back(std::move(entry));
+                    continue;
+                }
+                const auto target = entry.target.lock();
+                const auto next = target ? entry.check(target.get(), entry.deadline, now) : Clock::time_point::max();
+                if (next == Clock::time_point::max()) {
+                    --m_entries;
+                    continue;
+                }
+                entry.deadline = next;
+                insert(std::move(entry), m_next_tick + 1);
+            }
+        }
+    }
+
+public:
+    explicit DeadlineWheel(asio::io_context& io_context): m_timer { io_context } {}
+
+    DeadlineWheel(const DeadlineWheel&) = delete;
+    DeadlineWheel& operator=(const DeadlineWheel&) = delete;
+
+    void schedule(std::weak_ptr<void> target, const Check check, const Clock::time_point deadline) {
+        if (m_entries == 0) {
+            m_next_tick = tick_of(Clock::now());
+        }
+        ++m_entries;
+        insert({ std::move(target), check, deadline }, m_next_tick);
+        if (!m_running) {
+            start();
+        }
+    }
+
+    // Entries waiting in the wheel, superseded ones included
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_entries;
+    }
+
+    // Processes the ticks up to the given time like the timer does, at most one turn per call. Lets a test run the
+    // wheel through whole turns without waiting for them.
+    void advance_to(const Clock::time_point now) {
+        advance(now);
+    }
+};
+
+#endif //LE_DEADLINE_WHEEL_HPP
@@ -0,0 +1,45 @@
+#ifndef LE_DRAIN_LATCH_HPP
+#define LE_DRAIN_LATCH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Counts outstanding work and wakes every waiter the moment the count drops to zero
+// Adding and finishing work are single atomic operations. The mutex is only taken by waiters and by
+// the transition to zero, which is what prevents a waiter from missing the wake up.
+class DrainLatch final {
+    std::atomic<std::size_t> m_count { 0 };
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+
+public:
+    void add() noexcept {
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void done() {
+        if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard lock { m_mutex };
+            m_idle.notify_all();
+        }
+    }
+
+    [[nodiscard]] std::size_t count() const noexcept {
+        return m_count.load(std::memory_order_acquire);
+    }
+
+    void wait() {
+        std::unique_lock lock { m_mutex };
+        m_idle.wait(lock, [this] { return count() == 0; });
+    }
+
+    // Returns false when the count did not reach zero within the timeout
+    bool wait_for(const std::chrono::nanoseconds timeout) {
+        std::unique_lock lock { m_mutex };
+        return m_idle.wait_for(lock, timeout, [this] { return count() == 0; });
+    }
+};
+
+#endif //LE_DRAIN_LATCH_HPP
@@ -1,8 +1,10 @@
 #ifndef LE_HANDLERS_HPP
 #define LE_HANDLERS_HPP
 
+#include "callback_profiler.hpp"
 #include "tcp_handler.hpp"
 #include "udp_handler.hpp"
+#include "unix_handler.hpp"
 
 extern "C" {
     // TCP
@@ -17,6 +19,18 @@ extern "C" {
     typedef UDPCommandVariant (*udp_on_write_handler)(UdpHandlerPtr, std::error_code, size_t);
     typedef void (*udp_on_start_handler)(UdpHandlerPtr);
     typedef void (*udp_on_stop_handler)(UdpHandlerPtr);
+    // Unix stream
+    typedef UnixStreamCommandVariant (*unix_on_connect_handler)(UnixStreamSessionPtr, std::error_code);
+    typedef UnixStreamCommandVariant (*unix_on_receive_handler)(UnixStreamSessionPtr, std::error_code, size_t);
+    typedef UnixStreamCommandVariant (*unix_on_write_handler)(UnixStreamSessionPtr, std::error_code, size_t);
+    typedef void (*unix_on_disconnect_handler)(UnixStreamSessionPtr, std::error_code);
+    typedef void (*unix_on_start_handler)(UnixStreamHandlerPtr);
+    typedef void (*unix_on_stop_handler)(UnixStreamHandlerPtr);
+    // Unix datagram
+    typedef UnixDatagramCommandVariant (*unix_datagram_on_receive_handler)(UnixDatagramHandlerPtr, std::error_code, size_t, asio::local::datagram_protocol::endpoint);
+    typedef UnixDatagramCommandVariant (*unix_datagram_on_write_handler)(UnixDatagramHandlerPtr, std::error_code, size_t);
+    typedef void (*unix_datagram_on_start_handler)(UnixDatagramHandlerPtr);
+    typedef void (*unix_datagram_on_stop_handler)(UnixDatagramHandlerPtr);
 }
 
 inline TcpSession* get_tcp_session_unsafe(TcpSessionPtr pointer) {
@@ -28,19 +42,12 @@ inline TcpHandler* getTcpHandlerUnsafe(TcpHandlerPtr pointer) {
 inline UdpHandler* getUdpHandlerPointer(UdpHandlerPtr pointer) {
     return pointer.get();
 }
-
-enum class HandlerType {
-    TcpOnConnect,
-    TcpOnRceive,
-    TcpOnWrite,
-    TcpOnDisconnect,
-    TcpOnStart,
-    TcpOnStop,
-    UpdOnReceive,
-    UpdOnWrite,
-    UdpOnStart,
-    UdpOnStop,
-};
+inline UnixStreamSession* get_unix_stream_session_unsafe(UnixStreamSessionPtr pointer) {
+    return pointer.get();
+}
+inline UnixDatagramHandler* get_unix_datagram_handler_unsafe(UnixDatagramHandlerPtr pointer) {
+    return pointer.get();
+}
 
 // Memory management
 typedef void (*MyCallbackType)(int);
@@ -0,0 +1,177 @@
+#ifndef LE_HDR_HISTOGRAM_HPP
+#define LE_HDR_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// High dynamic range histogram
+// Values between lowest and highest are recorded with a fixed number of significant decimal digits,
+// using the bucket layout of HdrHistogram: each power of two range is split into the same number of
+// linear sub buckets. Recording is a couple of bit operations and an increment. Histograms with the
+// same layout can be merged, which is how per-thread histograms are combined.
+class HdrHistogram final {
+    std::int64_t m_lowest;
+    std::int64_t m_highest;
+    int m_significant_digits;
+    int m_unit_magnitude { 0 };
+    int m_sub_bucket_half_count_magnitude { 0 };
+    std::int64_t m_sub_bucket_count { 0 };
+    std::int64_t m_sub_bucket_half_count { 0 };
+    std::int64_t m_sub_bucket_mask { 0 };
+    int m_bucket_count { 0 };
+    std::vector<std::uint64_t> m_counts;
+    std::uint64_t m_total { 0 };
+    std::int64_t m_min { std::numeric_limits<std::int64_t>::max() };
+    std::int64_t m_max { 0 };
+    double m_sum { 0 };
+
+    [[nodiscard]] int bucket_index(const std::int64_t value) const noexcept {
+        const auto pow2_ceiling = 64 - std::countl_zero(static_cast<std::uint64_t>(value | m_sub_bucket_mask));
+        return pow2_ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1);
+    }
+
+    [[nodiscard]] std::int64_t sub_bucket_index(const std::int64_t value, const int bucket) const noexcept {
+        return value >> (bucket + m_unit_magnitude);
+    }
+
+    [[nodiscard]] std::size_t counts_index(const int bucket, const std::int64_t sub_bucket) const noexcept {
+        const auto bucket_base = static_cast<std::int64_t>(bucket + 1) << m_sub_bucket_half_count_magnitude;
+        return static_cast<std::size_t>(bucket_base + sub_bucket - m_sub_bucket_half_count);
+    }
+
+    [[nodiscard]] std::int64_t value_from_index(const int bucket, const std::int64_t sub_bucket) const noexcept {
+        return sub_bucket << (bucket + m_unit_magnitude);
+    }
+
+    [[nodiscard]] std::int64_t value_at_counts_index(const std::size_t index) const noexcept {
+        auto bucket = static_cast<int>(index >> m_sub_bucket_half_count_magnitude) - 1;
+        auto sub_bucket = static_cast<std::int64_t>(index & (m_sub_bucket_half_count - 1)) + m_sub_bucket_half_count;
+        if (bucket < 0) {
+            sub_bucket -= m_sub_bucket_half_count;
+            bucket = 0;
+        }
+        return value_from_index(bucket, sub_bucket);
+    }
+
+    [[nodiscard]] std::int64_t highest_equivalent_value(const std::int64_t value) const noexcept {
+        const auto bucket = bucket_index(value);
+        const auto sub_bucket = sub_bucket_index(value, bucket);
+        const auto lowest = value_from_index(bucket, sub_bucket);
+        const auto adjusted_bucket = sub_bucket >= m_sub_bucket_count ? bucket + 1 : bucket;
+        return lowest + (std::int64_t { 1 } << (m_unit_magnitude + adjusted_bucket)) - 1;
+    }
+
+public:
+    // lowest must be at least 1, significant_digits between 1 and 5
+    explicit HdrHistogram(
+        const std::int64_t lowest = 1,
+        const std::int64_t highest = 3'600'000'000'000,
+        const int significant_digits = 3
+    ):
+        m_lowest { std::max(std::int64_t { 1 }, lowest) },
+        m_highest { std::max(highest, 2 * std::max(std::int64_t { 1 }, lowest)) },
+        m_significant_digits { std::clamp(significant_digits, 1, 5) } {
+        const auto largest_single_unit = 2 * static_cast<std::int64_t>(std::pow(10, m_significant_digits));
+        const auto sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+        m_sub_bucket_half_count_magnitude = std::max(sub_bucket_count_magnitude, 1) - 1;
+        m_unit_magnitude = static_cast<int>(std::floor(std::log2(static_cast<double>(m_lowest))));
+        m_sub_bucket_count = std::int64_t { 1 } << (m_sub_bucket_half_count_magnitude + 1);
+        m_sub_bucket_half_count = m_sub_bucket_count / 2;
+        m_sub_bucket_mask = (m_sub_bucket_count - 1) << m_unit_magnitude;
+
+        auto smallest_untrackable = m_sub_bucket_count << m_unit_magnitude;
+        m_bucket_count = 1;
+        while (smallest_untrackable <= m_highest) {
+            if (smallest_untrackable > std::numeric_limits<std::int64_t>::max() / 2) {
+                ++m_bucket_count;
+                break;
+            }
+            smallest_untrackable <<= 1;
+            ++m_bucket_count;
+        }
+        m_counts.assign(static_cast<std::size_t>((m_bucket_count + 1) * m_sub_bucket_half_count), 0);
+    }
+
+    // Values outside of the trackable range are clamped to it
+    void record(const std::int64_t value, const std::uint64_t count = 1) noexcept {
+        const auto clamped = std::clamp(value, std::int64_t { 0 }, m_highest);
+        const auto bucket = bucket_index(clamped);
+        const auto index = counts_index(bucket, sub_bucket_index(clamped, bucket));
+        m_counts[std::min(index, m_counts.size() - 1)] += count;
+        m_total += count;
+        m_min = std::min(m_min, clamped);
+        m_max = std::max(m_max, clamped);
+        m_sum += static_cast<double>(clamped) * static_cast<double>(count);
+    }
+
+    // Returns false when the layouts differ
+    bool merge(const HdrHistogram& other) noexcept {
+        if (other.m_counts.size() != m_counts.size() || other.m_unit_magnitude != m_unit_magnitude ||
+            other.m_sub_bucket_half_count_magnitude != m_sub_bucket_half_count_magnitude) {
+            return false;
+        }
+        for (std::size_t i = 0; i < m_counts.size(); ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+        m_sum += other.m_sum;
+        return true;
+    }
+
+    void reset() noexcept {
+        std::ranges::fill(m_counts, 0);
+        m_total = 0;
+        m_min = std::numeric_limits<std::int64_t>::max();
+        m_max = 0;
+        m_sum = 0;
+    }
+
+    // percentile is in the range [0, 100]
+    [[nodiscard]] std::int64_t value_at_percentile(const double percentile) const noexcept {
+        if (m_total == 0) {
+            return 0;
+        }
+        const auto fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+        const auto target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(fraction * static_cast<double>(m_total) + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < m_counts.size(); ++i) {
+            seen += m_counts[i];
+            if (seen >= target) {
+                return std::min(highest_equivalent_value(value_at_counts_index(i)), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    [[nodiscard]] std::uint64_t count() const noexcept {
+        return m_total;
+    }
+
+    [[nodiscard]] std::int64_t min() const noexcept {
+        return m_total ? m_min : 0;
+    }
+
+    [[nodiscard]] std::int64_t max() const noexcept {
+        return m_max;
+    }
+
+    [[nodiscard]] double mean() const noexcept {
+        return m_total ? m_sum / static_cast<double>(m_total) : 0;
+    }
+
+    [[nodiscard]] std::int64_t highest_trackable_value() const noexcept {
+        return m_highest;
+    }
+
+    [[nodiscard]] int significant_digits() const noexcept {
+        return m_significant_digits;
+    }
+};
+
+#endif //LE_HDR_HISTOGRAM_HPP
@@ -0,0 +1,248 @@
+#ifndef LE_HOT_FILE_CACHE_HPP
+#define LE_HOT_FILE_CACHE_HPP
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.hpp"
+
+// A whole file mapped read-only, unmapped when the last view of it is gone
+class MappedFile final {
+    const char* m_data { nullptr };
+    std::size_t m_size { 0 };
+
+public:
+    MappedFile(const char* data, const std::size_t size): m_data { data }, m_size { size } {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (m_data) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    // Empty files have no mapping
+    [[nodiscard]] static std::shared_ptr<const MappedFile> map(const int fd, const std::size_t size, std::error_code& ec) {
+        if (size == 0) {
+            return std::make_shared<const MappedFile>(nullptr, 0);
+        }
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            ec = { errno, std::system_category() };
+            return nullptr;
+        }
+#if defined(MADV_WILLNEED)
+        // Hot files are read soon and in full
+        ::madvise(data, size, MADV_WILLNEED);
+#endif
+        return std::make_shared<const MappedFile>(static_cast<const char*>(data), size);
+    }
+
+    [[nodiscard]] const char* data() const noexcept {
+        return m_data;
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_size;
+    }
+};
+
+// Files served over and over, each mapped once and shared by every session that sends it
+// get() returns a Buffer viewing the mapped bytes, which TCPWriteCommand sends without copying them. A view keeps
+// its mapping alive, also after the entry was evicted or the file changed. Entries are checked against the file
+// (inode, size and modification time) at most once per revalidate interval, a changed file is mapped again.
+// Least recently used entries are evicted once the mapped bytes exceed the budget. Files larger than the budget
+// are mapped for the caller without being cached.
+// A file truncated in place under a mapping raises SIGBUS when the missing pages are read, so served files
+// should be replaced by a rename instead of being rewritten.
+class HotFileCache final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        std::uint64_t hits { 0 };
+        std::uint64_t misses { 0 };
+        std::uint64_t evictions { 0 };
+        std::size_t entries { 0 };
+        std::size_t bytes { 0 };
+    };
+
+private:
+    struct Version {
+        dev_t device { 0 };
+        ino_t inode { 0 };
+        off_t size { 0 };
+        std::int64_t modified_ns { 0 };
+
+        bool operator==(const Version&) const = default;
+    };
+
+    struct Entry {
+        std::shared_ptr<const MappedFile> file;
+        Version version;
+        Clock::time_point checked;
+        std::list<std::string>::iterator order;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    // Least recently used first
+    std::list<std::string> m_order;
+    std::size_t m_budget;
+    Clock::duration m_revalidate_interval;
+    std::size_t m_bytes { 0 };
+    std::uint64_t m_hits { 0 };
+    std::uint64_t m_misses { 0 };
+    std::uint64_t m_evictions { 0 };
+
+    static Version version_of(const struct stat& status) {
+#if defined(__APPLE__)
+        const auto& modified = status.st_mtimespec;
+#else
+        const auto& modified = status.st_mtim;
+#endif
+        return { status.st_dev, status.st_ino, status.st_size,
+                 static_cast<std::int64_t>(modified.tv_sec) * 1'000'000'000 + modified.tv_nsec };
+    }
+
+    static Buffer view_of(const std::shared_ptr<const MappedFile>& file) {
+        return Buffer::view(file, file->data(), file->size());
+    }
+
+    void erase(const std::unordered_map<std::string, Entry>::iterator it) {
+        m_bytes -= it->second.file->size();
+        m_order.erase(it->second.order);
+        m_entries.erase(it);
+    }
+
+    void touch(Entry& entry) {
+        m_order.splice(m_order.end(), m_order, entry.order);
+    }
+
+    // A cached entry when it is still fresh or the file did not change, nullptr otherwise
+    std::shared_ptr<const MappedFile> cached(const std::string& path, const Version* version, const Clock::time_point now) {
+        std::lock_guard lock { m_mutex };
+        const auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            return nullptr;
+        }
+        auto& entry = it->second;
+        if (version ? entry.version != *version : now - entry.checked >= m_revalidate_interval) {
+            return nullptr;
+        }
+        if (version) {
+            entry.checked = now;
+        }
+        touch(entry);
+        ++m_hits;
+        return entry.file;
+    }
+
+    void insert(const std::string& path, std::shared_ptr<const MappedFile> file, const Version version, const Clock::time_point now) {
+        std::lock_guard lock { m_mutex };
+        ++m_misses;
+        if (const auto it = m_entries.find(path); it != m_entries.end()) {
+            erase(it);
+        }
+        if (file->size() > m_budget) {
+            return;
+        }
+        while (m_bytes + file->size() > m_budget) {
+            erase(m_entries.find(m_order.front()));
+            ++m_evictions;
+        }
+        m_bytes += file->size();
+        m_order.push_back(path);
+        m_entries.emplace(path, Entry { std::move(file), version, now, std::prev(m_order.end()) });
+    }
+
+public:
+    explicit HotFileCache(const std::size_t byte_budget, const Clock::duration revalidate_interval = std::chrono::seconds { 1 }):
+        m_budget { byte_budget },
+        m_revalidate_interval { revalidate_interval } {}
+
+    HotFileCache(const HotFileCache&) = delete;
+    HotFileCache& operator=(const HotFileCache&) = delete;
+
+    // A view of the whole file, empty with ec set when it cannot be read. Safe from any thread.
+    [[nodiscard]] Buffer get(const std::string& path, std::error_code& ec) {
+        const auto now = Clock::now();
+        if (const auto file = cached(path, nullptr, now)) {
+            return view_of(file);
+        }
+        struct stat status {};
+        if (::stat(path.c_str(), &status) != 0) {
+            ec = { errno, std::system_category() };
+            invalidate(path);
+            return {};
+        }
+        if (!S_ISREG(status.st_mode)) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return {};
+        }
+        auto version = version_of(status);
+        if (const auto file = cached(path, &version, now)) {
+            return view_of(file);
+        }
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ec = { errno, std::system_category() };
+            return {};
+        }
+        // The version of the file that is mapped, it may have been replaced since the stat above
+        if (::fstat(fd, &status) != 0) {
+            ec = { errno, std::system_category() };
+            ::close(fd);
+            return {};
+        }
+        version = version_of(status);
+        auto file = MappedFile::map(fd, static_cast<std::size_t>(status.st_size), ec);
+        ::close(fd);
+        if (!file) {
+            return {};
+        }
+        insert(path, file, version, now);
+        return view_of(file);
+    }
+
+    // Drops the entry of a changed file without waiting for the next check, views handed out stay valid
+    void invalidate(const std::string& path) {
+        std::lock_guard lock { m_mutex };
+        if (const auto it = m_entries.find(path); it != m_entries.end()) {
+            erase(it);
+        }
+    }
+
+    void clear() {
+        std::lock_guard lock { m_mutex };
+        m_entries.clear();
+        m_order.clear();
+        m_bytes = 0;
+    }
+
+    [[nodiscard]] Stats stats() {
+        std::lock_guard lock { m_mutex };
+        return { m_hits, m_misses, m_evictions, m_entries.size(), m_bytes };
+    }
+
+    static std::shared_ptr<HotFileCache> shared(const std::size_t byte_budget, const Clock::duration revalidate_interval = std::chrono::seconds { 1 }) {
+        return std::make_shared<HotFileCache>(byte_budget, revalidate_interval);
+    }
+};
+
+using HotFileCachePtr = std::shared_ptr<HotFileCache>;
+
+#endif //LE_HOT_FILE_CACHE_HPP
@@ -0,0 +1,403 @@
+#ifndef LE_HTTP_PARSER_HPP
+#define LE_HTTP_PARSER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "custom_error_code.hpp"
+#include "simd_scan.hpp"
+
+// A run of bytes inside the read buffer
+struct HttpText {
+    const char* data { nullptr };
+    std::size_t size { 0 };
+
+    [[nodiscard]] std::string_view view() const noexcept {
+        return { data, size };
+    }
+};
+
+struct HttpHeader {
+    HttpText name;
+    HttpText value;
+};
+
+namespace http {
+    [[nodiscard]] inline char lower(const char c) noexcept {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    [[nodiscard]] inline bool equals_ignoring_case(const std::string_view a, const std::string_view b) noexcept {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const char x, const char y) {
+            return lower(x) == lower(y);
+        });
+    }
+
+    // Whether a comma separated header value lists the token, e.g. "close" in "Connection: Upgrade, close"
+    [[nodiscard]] inline bool has_token(std::string_view list, const std::string_view token) noexcept {
+        while (!list.empty()) {
+            const auto comma = list.find(',');
+            auto item = list.substr(0, comma);
+            while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+                item.remove_prefix(1);
+            }
+            while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+                item.remove_suffix(1);
+            }
+            if (equals_ignoring_case(item, token)) {
+                return true;
+            }
+            list = comma == std::string_view::npos ? std::string_view {} : list.substr(comma + 1);
+        }
+        return false;
+    }
+}
+
+// One parsed request. Everything points into the read buffer of the session and is valid until the next read.
+struct HttpRequest {
+    HttpText method;
+    HttpText target;
+    // 0 for HTTP/1.0, 1 for HTTP/1.1
+    uint version_minor { 1 };
+    const HttpHeader* headers { nullptr };
+    std::size_t header_count { 0 };
+    // A chunked body is joined in place, its chunk sizes and trailers are dropped
+    HttpText body;
+    bool chunked { false };
+    // Whether the connection may stay open after the response, from the version and the Connection header
+    bool keep_alive { true };
+
+    // Value of the first header with the name, compared case insensitively. Empty when there is none.
+    [[nodiscard]] HttpText header(const std::string_view name) const noexcept {
+        for (std::size_t i = 0; i < header_count; ++i) {
+            if (http::equals_ignoring_case(headers[i].name.view(), name)) {
+                return headers[i].value;
+            }
+        }
+        return {};
+    }
+};
+
+struct HttpLimits {
+    // Request line and headers. A larger head, or more headers, is reported as FrameTooLarge.
+    std::size_t max_head_size { 16 * 1024 };
+    std::size_t max_headers { 100 };
+};
+
+// Parses HTTP/1.1 requests in place, one at a time from the front of the buffered bytes
+// The end of the head is found with the SIMD byte search for line feeds, resuming where the previous read stopped.
+// The request line and the headers become views into the buffer. Bodies are delimited by Content-Length or
+// chunked transfer coding. Each chunk is moved down to the end of the previous one as soon as it is complete, so
+// the body ends up contiguous after the head without a second pass. A request that is still incomplete keeps
+// these resume points relative to its first byte, so the buffer may move between reads.
+// Requests with both Content-Length and Transfer-Encoding, conflicting lengths, or any other transfer coding
+// are rejected as HttpBadRequest, which rules out request smuggling through ambiguous framing.
+class HttpRequestParser final {
+    HttpLimits m_limits;
+    std::size_t m_max_body_size;
+    // Headers of the requests parsed since clear(), in order
+    std::vector<HttpHeader> m_headers;
+    // Bytes of the incomplete head searched for its end
+    std::size_t m_head_scanned { 0 };
+    // Zero until the head is complete
+    std::size_t m_head_size { 0 };
+    std::uint64_t m_content_length { 0 };
+    bool m_chunked { false };
+    // Chunked bodies: the next chunk size line, zero before the first one, and the body bytes joined so far
+    std::size_t m_chunk_offset { 0 };
+    std::size_t m_chunked_body { 0 };
+
+    static std::error_code bad_request() {
+        return make_error_code(CustomErrorCode::HttpBadRequest);
+    }
+
+    // End of the line starting at the position, after its line feed, or 0 when it is incomplete
+    [[nodiscard]] static std::size_t line_end(const char* data, const std::size_t position, const std::size_t size) noexcept {
+        const auto* feed = find_byte(data + position, data + size, '\n');
+        return feed == data + size ? 0 : static_cast<std::size_t>(feed - data) + 1;
+    }
+
+    // Length of the line without its line ending, CRLF or a bare LF
+    [[nodiscard]] static std::size_t line_length(const char* data, const std::size_t position, const std::size_t end) noexcept {
+        auto length = end - 1 - position;
+        if (length > 0 && data[position + length - 1] == '\r') {
+            --length;
+        }
+        return length;
+    }
+
+    // End of the empty line that ends the head, 0 while it is incomplete
+    [[nodiscard]] std::size_t find_head_end(const char* data, const std::size_t size) noexcept {
+        auto position = m_head_scanned;
+        while (const auto end = line_end(data, position, size)) {
+            const auto feed = end - 1;
+            if ((feed >= 1 && data[feed - 1] == '\n') || (feed >= 2 && data[feed - 1] == '\r' && data[feed - 2] == '\n')) {
+                return end;
+            }
+            position = end;
+        }
+        m_head_scanned = size;
+        return 0;
+    }
+
+    std::error_code parse_request_line(const char* data, const std::size_t end, HttpRequest& request) const {
+        const auto length = line_length(data, 0, end);
+        const auto* line = data;
+        const auto* last = data + length;
+        const auto* space = find_byte(line, last, ' ');
+        if (space == line || space == last) {
+            return bad_request();
+        }
+        request.method = { line, static_cast<std::size_t>(space - line) };
+        const auto* target = space + 1;
+        space = find_byte(target, last, ' ');
+        if (space == target || space == last) {
+            return bad_request();
+        }
+        request.target = { target, static_cast<std::size_t>(space - target) };
+        const std::string_view version { space + 1, static_cast<std::size_t>(last - space - 1) };
+        if (version.size() != 8 || !version.starts_with("HTTP/1.") || (version[7] != '0' && version[7] != '1')) {
+            return bad_request();
+        }
+        request.version_minor = static_cast<uint>(version[7] - '0');
+        request.keep_alive = request.version_minor == 1;
+        return {};
+    }
+
+    // Appends the headers and picks up the ones that frame the message
+    std::error_code parse_headers(const char* data, std::size_t position, HttpRequest& request) {
+        bool has_length = false;
+        bool has_encoding = false;
+        m_content_length = 0;
+        m_chunked = false;
+        for (;;) {
+            const auto end = line_end(data, position, m_head_size);
+            const auto length = line_length(data, position, end);
+            if (length == 0) {
+                break;
+            }
+            const auto* line = data + position;
+            // Obsolete line folding is not accepted, like in most servers
+            if (line[0] == ' ' || line[0] == '\t') {
+                return bad_request();
+            }
+            const auto* colon = find_byte(line, line + length, ':');
+            if (colon == line || colon == line + length) {
+                return bad_request();
+            }
+            const std::string_view name { line, static_cast<std::size_t>(colon - line) };
+            if (std::ranges::any_of(name, [](const char c) { return static_cast<unsigned char>(c) <= ' '; })) {
+                return bad_request();
+            }
+            std::string_view value { colon + 1, static_cast<std::size_t>(line + length - colon - 1) };
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+                value.remove_prefix(1);
+            }
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+                value.remove_suffix(1);
+            }
+            if (++request.header_count > m_limits.max_headers) {
+                return make_error_code(CustomErrorCode::FrameTooLarge);
+            }
+            m_headers.push_back({ { name.data(), name.size() }, { value.data(), value.size() } });
+
+            if (http::equals_ignoring_case(name, "content-length")) {
+                std::uint64_t content_length = 0;
+                if (value.empty() || value.size() > 19 ||
+                    !std::ranges::all_of(value, [](const char c) { return c >= '0' && c <= '9'; })) {
+                    return bad_request();
+                }
+                for (const auto c : value) {
+                    content_length = content_length * 10 + static_cast<std::uint64_t>(c - '0');
+                }
+                if (has_length && content_length != m_content_length) {
+                    return bad_request();
+                }
+                has_length = true;
+                m_content_length = content_length;
+            } else if (http::equals_ignoring_case(name, "transfer-encoding")) {
+                has_encoding = true;
+                // Chunked has to be the final coding, nothing else delimits a request body
+                const auto comma = value.rfind(',');
+                auto last = comma == std::string_view::npos ? value : value.substr(comma + 1);
+                while (!last.empty() && (last.front() == ' ' || last.front() == '\t')) {
+                    last.remove_prefix(1);
+                }
+                m_chunked = http::equals_ignoring_case(last, "chunked");
+            } else if (http::equals_ignoring_case(name, "connection")) {
+                if (http::has_token(value, "close")) {
+                    request.keep_alive = false;
+                } else if (http::has_token(value, "keep-alive")) {
+                    request.keep_alive = true;
+                }
+            }
+            position = end;
+        }
+        if (has_encoding && (has_length || !m_chunked)) {
+            return bad_request();
+        }
+        if (m_content_length > m_max_body_size) {
+            return make_error_code(CustomErrorCode::FrameTooLarge);
+        }
+        request.chunked = m_chunked;
+        return {};
+    }
+
+    std::error_code parse_head(const char* data, HttpRequest& request) {
+        const auto first_line = line_end(data, 0, m_head_size);
+        if (const auto ec = parse_request_line(data, first_line, request)) {
+            return ec;
+        }
+        return parse_headers(data, first_line, request);
+    }
+
+    // Joins the complete chunks. Sets the end of the request once the last chunk and the trailers are in.
+    std::error_code read_chunks(char* data, const std::size_t size, std::size_t& consumed) {
+        auto position = m_chunk_offset ? m_chunk_offset : m_head_size;
+        for (;;) {
+            const auto end = line_end(data, position, size);
+            if (end == 0) {
+                // A chunk size line is short, only extensions could make it long
+                if (size - position > m_limits.max_head_size) {
+                    return make_error_code(CustomErrorCode::FrameTooLarge);
+                }
+                break;
+            }
+            const auto length = line_length(data, position, end);
+            std::uint64_t chunk_size = 0;
+            std::size_t digits = 0;
+            for (; digits < length; ++digits) {
+                const auto c = http::lower(data[position + digits]);
+                const auto digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+                if (digit < 0) {
+                    break;
+                }
+                if (digits == 15) {
+                    return make_error_code(CustomErrorCode::FrameTooLarge);
+                }
+                chunk_size = chunk_size << 4 | static_cast<std::uint64_t>(digit);
+            }
+            if (digits == 0 || (digits < length && data[position + digits] != ';' && data[position + digits] != ' ' &&
+                                data[position + digits] != '\t')) {
+                return bad_request();
+            }
+            if (chunk_size == 0) {
+                // Trailers end with an empty line. They are skipped, the request keeps the headers only.
+                auto trailer = end;
+                while (const auto trailer_end = line_end(data, trailer, size)) {
+                    if (line_length(data, trailer, trailer_end) == 0) {
+                        consumed = trailer_end;
+                        return {};
+                    }
+                    trailer = trailer_end;
+                }
+                if (size - end > m_limits.max_head_size) {
+                    return make_error_code(CustomErrorCode::FrameTooLarge);
+                }
+                break;
+            }
+            if (chunk_size > m_max_body_size - m_chunked_body) {
+                return make_error_code(CustomErrorCode::FrameTooLarge);
+            }
+            const auto chunk = static_cast<std::size_t>(chunk_size);
+            if (size - end < chunk + 1) {
+                break;
+            }
+            auto next = end + chunk;
+            if (data[next] == '\r') {
+                if (size - next < 2) {
+                    break;
+                }
+                ++next;
+            }
+            if (data[next] != '\n') {
+                return bad_request();
+            }
+            std::memmove(data + m_head_size + m_chunked_body, data + end, chunk);
+            m_chunked_body += chunk;
+            position = next + 1;
+            m_chunk_offset = position;
+        }
+        return {};
+    }
+
+public:
+    HttpRequestParser(const HttpLimits& limits, const std::size_t max_body_size):
+        m_limits { limits },
+        m_max_body_size { max_body_size } {}
+
+    // Forgets the request being parsed, e.g. when the session switches its framing
+    void reset() noexcept {
+        m_head_scanned = 0;
+        m_head_size = 0;
+        m_content_length = 0;
+        m_chunked = false;
+        m_chunk_offset = 0;
+        m_chunked_body = 0;
+    }
+
+    // Forgets the headers of the requests handed out, before the next batch is parsed
+    void clear() noexcept {
+        m_headers.clear();
+    }
+
+    // Parses the request at the front of the bytes. consumed is its size once it is complete, 0 before.
+    // The request is only filled in when it is complete. Its headers are attached by bind().
+    std::error_code parse(char* data, const std::size_t size, HttpRequest& request, std::size_t& consumed) {
+        consumed = 0;
+        const auto headers_before = m_headers.size();
+        bool head_parsed = false;
+        if (m_head_size == 0) {
+            m_head_size = find_head_end(data, size);
+            if (m_head_size == 0) {
+                return size > m_limits.max_head_size ? make_error_code(CustomErrorCode::FrameTooLarge) : std::error_code {};
+            }
+            if (m_head_size > m_limits.max_head_size) {
+                return make_error_code(CustomErrorCode::FrameTooLarge);
+            }
+            if (const auto ec = parse_head(data, request)) {
+                return ec;
+            }
+            head_parsed = true;
+        }
+        std::size_t body_size = 0;
+        if (m_chunked) {
+            if (const auto ec = read_chunks(data, size, consumed)) {
+                return ec;
+            }
+            body_size = m_chunked_body;
+        } else if (size - m_head_size >= m_content_length) {
+            body_size = static_cast<std::size_t>(m_content_length);
+            consumed = m_head_size + body_size;
+        }
+        if (consumed == 0) {
+            // The views would not survive the buffer moving, the head is parsed again once the body is in
+            m_headers.resize(headers_before);
+            return {};
+        }
+        if (!head_parsed) {
+            request = {};
+            if (const auto ec = parse_head(data, request)) {
+                return ec;
+            }
+        }
+        request.body = { data + m_head_size, body_size };
+        reset();
+        return {};
+    }
+
+    // Points the requests parsed since clear() at their headers
+    void bind(std::vector<HttpRequest>& requests) const noexcept {
+        std::size_t first = 0;
+        for (auto& request : requests) {
+            request.headers = m_headers.data() + first;
+            first += request.header_count;
+        }
+    }
+};
+
+#endif //LE_HTTP_PARSER_HPP
@@ -0,0 +1,299 @@
+#ifndef LE_IO_WORKER_HPP
+#define LE_IO_WORKER_HPP
+
+#include <cxxAsio.hpp>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+#include "cpu_affinity.hpp"
+#include "deadline_wheel.hpp"
+#include "loop_monitor.hpp"
+
+struct ThreadPoolConfig {
+    std::size_t thread_count { std::thread::hardware_concurrency() };
+    // CPUs for each thread. Threads beyond the list reuse it round robin, an empty list leaves threads unpinned.
+    std::vector<CpuSet> cpu_sets {};
+    // How often each thread probes its event loop lag and queue depth, zero disables the probe
+    std::chrono::nanoseconds loop_probe_interval { std::chrono::milliseconds { 100 } };
+
+    // One thread per CPU, each pinned to its own CPU
+    static ThreadPoolConfig pinned_to(const CpuSet& cpus) {
+        ThreadPoolConfig config { cpus.size() };
+        for (const auto cpu : cpus) {
+            config.cpu_sets.push_back({ cpu });
+        }
+        return config;
+    }
+
+    // One pinned thread per isolated CPU. Falls back to unpinned threads when no CPU is isolated.
+    static ThreadPoolConfig pinned_to_isolated_cpus() {
+        if (const auto cpus = isolated_cpus(); !cpus.empty()) {
+            return pinned_to(cpus);
+        }
+        return {};
+    }
+};
+
+struct IoWorkerInfo {
+    std::size_t index { 0 };
+    bool pinned { false };
+    int cpu { -1 };
+    int numa_node { -1 };
+};
+
+// Pending handlers of one worker can own objects bound to another worker, e.g. a workload strand.
+// The group therefore destroys every pending handler of every worker before any io_context goes away.
+class WorkerIoContext : public asio::io_context {
+public:
+    using asio::io_context::io_context;
+
+    void destroy_pending_handlers() {
+        shutdown();
+    }
+};
+
+// A pool thread with its own io_context
+// Everything that belongs to one worker (sessions, their buffers, timers) is created on the worker thread.
+// Once the thread is pinned, first touch places that memory on the NUMA node of the worker.
+class IoWorker final {
+    std::size_t m_index;
+    CpuSet m_cpus;
+    WorkerIoContext m_io_context { 1 };
+    LoopMonitor m_loop_monitor;
+    // Timeouts of the sessions of this worker
+    DeadlineWheel m_deadlines { m_io_context };
+    asio::executor_work_guard<asio::io_context::executor_type> m_work_guard;
+    std::atomic<bool> m_pinned { false };
+    std::atomic<int> m_cpu { -1 };
+    std::atomic<int> m_numa_node { -1 };
+    std::thread m_thread;
+
+    static IoWorker*& current_slot() {
+        static thread_local IoWorker* current { nullptr };
+        return current;
+    }
+
+    void run() {
+        current_slot() = this;
+        if (!m_cpus.empty()) {
+            if (const auto ec = pin_current_thread(m_cpus)) {
+                log_affinity_error(ec);
+            } else {
+                m_pinned = true;
+            }
+        }
+        const auto cpu = current_cpu();
+        m_cpu = cpu;
+        m_numa_node = numa_node_of_cpu(cpu);
+#if defined(__unix__) || defined(__APPLE__)
+        // Writes to a closed peer must fail with EPIPE instead of killing the process. Asio suppresses the signal
+        // for its own sends, splice() cannot.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+        m_loop_monitor.start(m_io_context);
+        // Handlers are run one at a time, so the monitor can count them
+        while (m_io_context.run_one()) {
+            m_loop_monitor.handler_ran();
+        }
+        current_slot() = nullptr;
+    }
+
+    void log_affinity_error(const std::error_code& ec) const {
+        std::fprintf(stderr, "[Error] Failed to pin worker %zu: %s\n", m_index, ec.message().c_str());
+    }
+
+public:
+    IoWorker(const std::size_t index, CpuSet cpus, const std::chrono::nanoseconds loop_probe_interval):
+        m_index { index },
+        m_cpus { std::move(cpus) },
+        m_loop_monitor { loop_probe_interval },
+        m_work_guard { make_work_guard(m_io_context) } {
+        m_thread = std::thread { [this] { run(); } };
+    }
+
+    IoWorker(const IoWorker&) = delete;
+    IoWorker& operator=(const IoWorker&) = delete;
+
+    ~IoWorker() {
+        stop();
+        join();
+    }
+
+    void stop() {
+        m_work_guard.reset();
+        m_io_context.stop();
+    }
+
+    // Must only be called once the thread has been joined
+    void destroy_pending_handlers() {
+        m_io_context.destroy_pending_handlers();
+    }
+
+    // A worker cannot join itself. Its thread would go on running an io_context that is destroyed with the
+    // worker, so a pool that is destroyed from one of its own threads aborts the process.
+    void join() {
+        if (!m_thread.joinable()) {
+            return;
+        }
+        if (m_thread.get_id() == std::this_thread::get_id()) {
+            std::fprintf(stderr, "[Error] Worker %zu cannot join itself, the pool is destroyed from its own thread\n", m_index);
+            std::abort();
+        }
+        m_thread.join();
+    }
+
+    [[nodiscard]] asio::io_context& io_context() {
+        return m_io_context;
+    }
+
+    [[nodiscard]] std::size_t index() const {
+        return m_index;
+    }
+
+    // Only for use on the worker thread
+    [[nodiscard]] DeadlineWheel& deadlines() {
+        return m_deadlines;
+    }
+
+    [[nodiscard]] bool running_in_this_thread() const {
+        return current_slot() == this;
+    }
+
+    [[nodiscard]] IoWorkerInfo info() const {
+        return { m_index, m_pinned, m_cpu, m_numa_node };
+    }
+
+    [[nodiscard]] IoLoopSnapshot loop_snapshot() const {
+        return m_loop_monitor.snapshot(m_index);
+    }
+
+    // The worker that owns the calling thread, nullptr outside the pool
+    static IoWorker* current() {
+        return current_slot();
+    }
+};
+
+class IoWorkerGroup final {
+    std::vector<std::unique_ptr<IoWorker>> m_workers;
+    std::atomic<std::size_t> m_next { 0 };
+
+public:
+    explicit IoWorkerGroup(const ThreadPoolConfig& config) {
+        const auto count = std::max(std::size_t { 1 }, config.thread_count);
+        m_workers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto cpus = config.cpu_sets.empty() ? CpuSet {} : config.cpu_sets[i % config.cpu_sets.size()];
+            m_workers.push_back(std::make_unique<IoWorker>(i, std::move(cpus), config.loop_probe_interval));
+        }
+    }
+
+    IoWorkerGroup(const IoWorkerGroup&) = delete;
+    IoWorkerGroup& operator=(const IoWorkerGroup&) = delete;
+
+    ~IoWorkerGroup() {
+        stop();
+        for (const auto& worker : m_workers) {
+            worker->destroy_pending_handlers();
+        }
+    }
+
+    // Round robin placement for new sessions and workloads
+    IoWorker& next() {
+        return *m_workers[m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+    }
+
+    IoWorker& at(const std::size_t index) {
+        return *m_workers[index % m_workers.size()];
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return m_workers.size();
+    }
+
+    [[nodiscard]] bool contains_current_thread() const {
+        const auto current = IoWorker::current();
+        return current && current->index() < m_workers.size() && m_workers[current->index()].get() == current;
+    }
+
+    [[nodiscard]] std::vector<IoWorkerInfo> info() const {
+        std::vector<IoWorkerInfo> result;
+        result.reserve(m_workers.size());
+        for (const auto& worker : m_workers) {
+            result.push_back(worker->info());
+        }
+        return result;
+    }
+
+    [[nodiscard]] std::vector<IoLoopSnapshot> loop_snapshots() const {
+        std::vector<IoLoopSnapshot> result;
+        result.reserve(m_workers.size());
+        for (const auto& worker : m_workers) {
+            result.push_back(worker->loop_snapshot());
+        }
+        return result;
+    }
+
+    // One line per worker, for logs and debugging sessions
+    [[nodiscard]] std::string loop_dump() const {
+        std::string dump;
+        char line[256];
+        for (const auto& loop : loop_snapshots()) {
+            std::snprintf(line, sizeof(line),
+                "worker %zu: handlers=%llu lag last=%.3fms p99=%.3fms max=%.3fms queue=%llu max=%llu "
+                "busy=%.1fs idle=%.1fs utilisation=%.0f%%\n",
+                loop.index,
+                static_cast<unsigned long long>(loop.handlers_run),
+                static_cast<double>(loop.last_lag_ns) / 1e6,
+                static_cast<double>(loop.lag.p99_ns) / 1e6,
+                static_cast<double>(loop.lag.max_ns) / 1e6,
+                static_cast<unsigned long long>(loop.queue_depth),
+                static_cast<unsigned long long>(loop.max_queue_depth),
+                static_cast<double>(loop.busy_ns) / 1e9,
+                static_cast<double>(loop.idle_ns) / 1e9,
+                loop.utilisation * 100);
+            dump += line;
+        }
+        return dump;
+    }
+
+    // Stops every worker and waits for the threads to finish. The io_contexts stay valid
+    // until the group is destroyed, so handlers posted across workers during shutdown are safe.
+    void stop() {
+        for (const auto& worker : m_workers) {
+            worker->stop();
+        }
+        for (const auto& worker : m_workers) {
+            worker->join();
+        }
+    }
+};
+
+// Posts the function to the strand, or runs it right away once the io_context of the strand has stopped.
+// The pool stops the servers it is destroyed with after joining its threads, so their handlers still close
+// their sessions and call on_stop, on the destroying thread, instead of posting into a loop that never runs again.
+template<typename Executor, typename Function>
+void post_or_run(const asio::strand<Executor>& strand, Function&& function) {
+    auto& context = asio::query(strand.get_inner_executor(), asio::execution::context);
+    if (static_cast<asio::io_context&>(context).stopped()) {
+        std::forward<Function>(function)();
+        return;
+    }
+    post(strand, std::forward<Function>(function));
+}
+
+#endif //LE_IO_WORKER_HPP
@@ -0,0 +1,152 @@
+#ifndef LE_LOOP_MONITOR_HPP
+#define LE_LOOP_MONITOR_HPP
+
+#include <cxxAsio.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+
+#include "atomic_histogram.hpp"
+
+struct IoLoopSnapshot {
+    std::size_t index { 0 };
+    // Handlers run by the worker since it started
+    std::uint64_t handlers_run { 0 };
+    std::uint64_t probes { 0 };
+    // How late the probe timer ran compared to when it was due
+    HistogramSnapshot lag {};
+    std::uint64_t last_lag_ns { 0 };
+    // Handlers that were already queued when the last probe ran
+    std::uint64_t queue_depth { 0 };
+    std::uint64_t max_queue_depth { 0 };
+    // Thread CPU time and the rest of the wall time since the thread started, as of the last probe
+    std::uint64_t busy_ns { 0 };
+    std::uint64_t idle_ns { 0 };
+    // Busy share of the last probe interval, from 0 to 1
+    double utilisation { 0 };
+};
+
+// Event loop health of one worker, measured by the worker itself
+// A probe timer fires every interval. How late it runs is the event loop lag. The probe then posts a marker
+// and counts the handlers that run before it, which is the run queue depth when the probe ran. Busy time is the
+// CPU time of the worker thread, the rest of the wall time is idle. Every value is written by the worker only,
+// so recording is a relaxed store and a snapshot can be read from any thread.
+class LoopMonitor final {
+    using Clock = std::chrono::steady_clock;
+
+    std::chrono::nanoseconds m_interval;
+    std::optional<asio::steady_timer> m_timer;
+    Clock::time_point m_started_at {};
+    Clock::time_point m_last_probe_at {};
+    std::chrono::nanoseconds m_last_cpu_time { 0 };
+
+    std::atomic<std::uint64_t> m_handlers_run { 0 };
+    std::atomic<std::uint64_t> m_probes { 0 };
+    AtomicHistogram m_lag;
+    std::atomic<std::uint64_t> m_last_lag_ns { 0 };
+    std::atomic<std::uint64_t> m_queue_depth { 0 };
+    std::atomic<std::uint64_t> m_max_queue_depth { 0 };
+    std::atomic<std::uint64_t> m_busy_ns { 0 };
+    std::atomic<std::uint64_t> m_idle_ns { 0 };
+    std::atomic<double> m_utilisation { 0 };
+
+    static std::chrono::nanoseconds thread_cpu_time() noexcept {
+        timespec time {};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return std::chrono::seconds { time.tv_sec } + std::chrono::nanoseconds { time.tv_nsec };
+    }
+
+    static void increment(std::atomic<std::uint64_t>& value) noexcept {
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void arm(const Clock::time_point due) {
+        m_timer->expires_at(due);
+        m_timer->async_wait([this](const std::error_code& ec) {
+            if (!ec) {
+                probe();
+            }
+        });
+    }
+
+    void probe() {
+        const auto now = Clock::now();
+        const auto due = m_timer->expiry();
+        const auto lag = static_cast<std::uint64_t>(std::max(Clock::duration::zero(), now - due).count());
+        m_lag.record(lag);
+        m_last_lag_ns.store(lag, std::memory_order_relaxed);
+        increment(m_probes);
+
+        const auto cpu_time = thread_cpu_time();
+        const auto wall = now - m_last_probe_at;
+        if (wall.count() > 0) {
+            m_utilisation.store(std::min(1.0, static_cast<double>((cpu_time - m_last_cpu_time).count()) /
+                static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count())),
+                std::memory_order_relaxed);
+        }
+        const auto busy = static_cast<std::uint64_t>(cpu_time.count());
+        const auto total = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_started_at).count());
+        m_busy_ns.store(busy, std::memory_order_relaxed);
+        m_idle_ns.store(total > busy ? total - busy : 0, std::memory_order_relaxed);
+        m_last_probe_at = now;
+        m_last_cpu_time = cpu_time;
+
+        // This handler is counted once it returns, so it is not part of the queue ahead of the marker
+        post(m_timer->get_executor(), [this, queued_at = m_handlers_run.load(std::memory_order_relaxed) + 1] {
+            const auto depth = m_handlers_run.load(std::memory_order_relaxed) - queued_at;
+            m_queue_depth.store(depth, std::memory_order_relaxed);
+            if (depth > m_max_queue_depth.load(std::memory_order_relaxed)) {
+                m_max_queue_depth.store(depth, std::memory_order_relaxed);
+            }
+        });
+        // Scheduled from the due time, so a late probe does not shift every probe after it
+        arm(std::max(due + m_interval, now));
+    }
+
+public:
+    // A zero interval disables the probe, handlers are still counted
+    explicit LoopMonitor(const std::chrono::nanoseconds interval): m_interval { interval } {}
+
+    LoopMonitor(const LoopMonitor&) = delete;
+    LoopMonitor& operator=(const LoopMonitor&) = delete;
+
+    // Called on the worker thread before its io_context runs
+    void start(asio::io_context& io_context) {
+        m_started_at = Clock::now();
+        m_last_probe_at = m_started_at;
+        m_last_cpu_time = thread_cpu_time();
+        if (m_interval.count() <= 0) {
+            return;
+        }
+        m_timer.emplace(io_context);
+        arm(m_started_at + m_interval);
+    }
+
+    // Called on the worker thread after every handler
+    void handler_ran() noexcept {
+        increment(m_handlers_run);
+    }
+
+    [[nodiscard]] IoLoopSnapshot snapshot(const std::size_t index) const {
+        std::array<std::uint64_t, AtomicHistogram::bucket_count> buckets {};
+        std::uint64_t sum = 0;
+        m_lag.accumulate(buckets, sum);
+        IoLoopSnapshot snapshot;
+        snapshot.index = index;
+        snapshot.handlers_run = m_handlers_run.load(std::memory_order_relaxed);
+        snapshot.probes = m_probes.load(std::memory_order_relaxed);
+        snapshot.lag = AtomicHistogram::summarise(buckets, sum);
+        snapshot.last_lag_ns = m_last_lag_ns.load(std::memory_order_relaxed);
+        snapshot.queue_depth = m_queue_depth.load(std::memory_order_relaxed);
+        snapshot.max_queue_depth = m_max_queue_depth.load(std::memory_order_relaxed);
+        snapshot.busy_ns = m_busy_ns.load(std::memory_order_relaxed);
+        snapshot.idle_ns = m_idle_ns.load(std::memory_order_relaxed);
+        snapshot.utilisation = m_utilisation.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+};
+
+#endif //LE_LOOP_MONITOR_HPP
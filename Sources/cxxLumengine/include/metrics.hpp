@@ -0,0 +1,321 @@
+#ifndef LE_METRICS_HPP
+#define LE_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "atomic_histogram.hpp"
+#include "callback_profiler.hpp"
+#include "io_worker.hpp"
+#include "trace.hpp"
+
+enum class MetricCounter : std::size_t {
+    // TCP, Unix stream handlers count here as well
+    TcpAccepts,
+    TcpAcceptErrors,
+    TcpSessionsOpened,
+    TcpSessionsClosed,
+    TcpReads,
+    TcpWrites,
+    TcpReadErrors,
+    TcpWriteErrors,
+    TcpBytesIn,
+    TcpBytesOut,
+    // Complete frames delivered by sessions with framing
+    TcpFramesIn,
+    // Both directions of finished splices, these bytes are not part of TcpBytesIn and TcpBytesOut
+    TcpSplicedBytes,
+    // Bytes of TCPSendFileCommand, also part of TcpBytesOut
+    TcpFileBytesOut,
+    // Sessions closed by one of their TcpTimeouts
+    TcpTimeouts,
+    // TLS handshakes of sessions with TLS, resumed ones are counted in both
+    TlsHandshakes,
+    TlsResumedHandshakes,
+    TlsHandshakeErrors,
+    // UDP, Unix datagram handlers count here as well
+    UdpDatagramsIn,
+    UdpDatagramsOut,
+    UdpBytesIn,
+    UdpBytesOut,
+    UdpReceiveErrors,
+    UdpSendErrors,
+    // Workloads
+    WorkloadsSubmitted,
+    WorkloadsStarted,
+    WorkloadsCompleted,
+    Count,
+};
+
+enum class MetricHistogram : std::size_t {
+    // Time spent inside handler callbacks
+    CallbackDuration,
+    // Time between the moment a workload was due and the moment it started
+    WorkloadQueueDelay,
+    // Time from start to completion of a workload, servers excluded
+    WorkloadDuration,
+    // Server side of successful TLS handshakes, from the start of the handshake to its completion
+    TlsHandshakeDuration,
+    Count,
+};
+
+// Plain values only, so the snapshot can be read directly from Swift
+struct MetricsSnapshot {
+    std::uint64_t tcp_accepts { 0 };
+    std::uint64_t tcp_accept_errors { 0 };
+    std::uint64_t tcp_sessions_opened { 0 };
+    std::uint64_t tcp_sessions_closed { 0 };
+    std::uint64_t tcp_active_sessions { 0 };
+    std::uint64_t tcp_reads { 0 };
+    std::uint64_t tcp_writes { 0 };
+    std::uint64_t tcp_read_errors { 0 };
+    std::uint64_t tcp_write_errors { 0 };
+    std::uint64_t tcp_bytes_in { 0 };
+    std::uint64_t tcp_bytes_out { 0 };
+    std::uint64_t tcp_frames_in { 0 };
+    std::uint64_t tcp_spliced_bytes { 0 };
+    std::uint64_t tcp_file_bytes_out { 0 };
+    std::uint64_t tcp_timeouts { 0 };
+
+    std::uint64_t tls_handshakes { 0 };
+    std::uint64_t tls_resumed_handshakes { 0 };
+    std::uint64_t tls_handshake_errors { 0 };
+
+    std::uint64_t udp_datagrams_in { 0 };
+    std::uint64_t udp_datagrams_out { 0 };
+    std::uint64_t udp_bytes_in { 0 };
+    std::uint64_t udp_bytes_out { 0 };
+    std::uint64_t udp_receive_errors { 0 };
+    std::uint64_t udp_send_errors { 0 };
+
+    std::uint64_t workloads_submitted { 0 };
+    std::uint64_t workloads_started { 0 };
+    std::uint64_t workloads_completed { 0 };
+    // Submitted workloads that have not started yet, including those waiting for their timer
+    std::uint64_t workload_queue_depth { 0 };
+
+    HistogramSnapshot callback_duration {};
+    HistogramSnapshot workload_queue_delay {};
+    HistogramSnapshot workload_duration {};
+    HistogramSnapshot tls_handshake_duration {};
+};
+
+// Counters and histograms split into one cache line aligned shard per pool thread
+// Recording is a relaxed fetch_add on the shard of the calling thread: wait-free, and uncontended because
+// no other thread writes that shard. Threads outside the pool share shard 0. Snapshots add up all shards,
+// so they can be taken at any time from any thread without stopping the writers.
+class Metrics final {
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(MetricCounter::Count)> counters {};
+        std::array<AtomicHistogram, static_cast<std::size_t>(MetricHistogram::Count)> histograms {};
+    };
+
+    std::unique_ptr<Shard[]> m_shards;
+    std::size_t m_shard_count;
+    // Port of the handler, -1 for the pool
+    int m_port;
+    CallbackProfiler& m_profiler;
+
+    [[nodiscard]] Shard& shard() noexcept {
+        const auto worker = IoWorker::current();
+        return m_shards[worker ? 1 + worker->index() % (m_shard_count - 1) : 0];
+    }
+
+public:
+    Metrics(const std::size_t worker_count, const int port, CallbackProfiler& profiler):
+        m_shards { std::make_unique<Shard[]>(worker_count + 1) },
+        m_shard_count { worker_count + 1 },
+        m_port { port },
+        m_profiler { profiler } {}
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void add(const MetricCounter counter, const std::uint64_t value = 1) noexcept {
+        shard().counters[static_cast<std::size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void record(const MetricHistogram histogram, const std::chrono::nanoseconds duration) noexcept {
+        shard().histograms[static_cast<std::size_t>(histogram)].record(
+            static_cast<std::uint64_t>(std::max<std::int64_t>(0, duration.count()))
+        );
+    }
+
+    // Runs a handler callback and records how long it took, also per handler type when profiling is enabled
+    template<typename Callable>
+    decltype(auto) time_callback(const HandlerType type, const void* session, Callable&& callable) {
+        struct Timer {
+            Metrics& metrics;
+            HandlerType type;
+            std::chrono::steady_clock::time_point start;
+            CallbackProfiler::Entry entry;
+            const void* session;
+            ~Timer() {
+                trace(TraceEvent::CallbackExit, session, static_cast<std::uint64_t>(type));
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+                metrics.record(MetricHistogram::CallbackDuration, elapsed);
+                if (entry.active) {
+                    metrics.m_profiler.leave(entry, type, elapsed);
+                }
+            }
+        };
+        trace(TraceEvent::CallbackEnter, session, static_cast<std::uint64_t>(type));
+        const auto start = std::chrono::steady_clock::now();
+        Timer timer { *this, type, start, m_profiler.enter(type, m_port, session, start), session };
+        return std::forward<Callable>(callable)();
+    }
+
+    [[nodiscard]] std::uint64_t counter(const MetricCounter counter) const noexcept {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            total += m_shards[i].counters[static_cast<std::size_t>(counter)].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    void accumulate(const MetricHistogram histogram,
+                    std::array<std::uint64_t, AtomicHistogram::bucket_count>& buckets,
+                    std::uint64_t& sum) const noexcept {
+        for (std::size_t i = 0; i < m_shard_count; ++i) {
+            m_shards[i].histograms[static_cast<std::size_t>(histogram)].accumulate(buckets, sum);
+        }
+    }
+};
+
+using MetricsPtr = std::shared_ptr<Metrics>;
+
+// Owns the metrics of the pool and of every handler, keyed by port
+// The mutex is only taken when a handler is created and when a snapshot is taken, never while recording.
+// Handler metrics are kept after the handler stops, so totals never go backwards.
+class MetricsRegistry final {
+    std::size_t m_worker_count;
+    CallbackProfiler m_profiler;
+    MetricsPtr m_pool;
+    // Shared by every outbound client
+    MetricsPtr m_clients;
+    mutable std::mutex m_mutex;
+    std::map<int, MetricsPtr> m_handlers;
+
+    static std::uint64_t difference(const std::uint64_t total, const std::uint64_t done) {
+        return total > done ? total - done : 0;
+    }
+
+    static MetricsSnapshot snapshot_of(const std::vector<const Metrics*>& sources) {
+        MetricsSnapshot snapshot;
+        const auto sum = [&sources](const MetricCounter counter) {
+            std::uint64_t total = 0;
+            for (const auto* metrics : sources) {
+                total += metrics->counter(counter);
+            }
+            return total;
+        };
+        const auto merge = [&sources](const MetricHistogram histogram) {
+            std::array<std::uint64_t, AtomicHistogram::bucket_count> buckets {};
+            std::uint64_t total = 0;
+            for (const auto* metrics : sources) {
+                metrics->accumulate(histogram, buckets, total);
+            }
+            return AtomicHistogram::summarise(buckets, total);
+        };
+
+        snapshot.tcp_accepts = sum(MetricCounter::TcpAccepts);
+        snapshot.tcp_accept_errors = sum(MetricCounter::TcpAcceptErrors);
+        snapshot.tcp_sessions_opened = sum(MetricCounter::TcpSessionsOpened);
+        snapshot.tcp_sessions_closed = sum(MetricCounter::TcpSessionsClosed);
+        snapshot.tcp_active_sessions = difference(snapshot.tcp_sessions_opened, snapshot.tcp_sessions_closed);
+        snapshot.tcp_reads = sum(MetricCounter::TcpReads);
+        snapshot.tcp_writes = sum(MetricCounter::TcpWrites);
+        snapshot.tcp_read_errors = sum(MetricCounter::TcpReadErrors);
+        snapshot.tcp_write_errors = sum(MetricCounter::TcpWriteErrors);
+        snapshot.tcp_bytes_in = sum(MetricCounter::TcpBytesIn);
+        snapshot.tcp_bytes_out = sum(MetricCounter::TcpBytesOut);
+        snapshot.tcp_frames_in = sum(MetricCounter::TcpFramesIn);
+        snapshot.tcp_spliced_bytes = sum(MetricCounter::TcpSplicedBytes);
+        snapshot.tcp_file_bytes_out = sum(MetricCounter::TcpFileBytesOut);
+        snapshot.tcp_timeouts = sum(MetricCounter::TcpTimeouts);
+
+        snapshot.tls_handshakes = sum(MetricCounter::TlsHandshakes);
+        snapshot.tls_resumed_handshakes = sum(MetricCounter::TlsResumedHandshakes);
+        snapshot.tls_handshake_errors = sum(MetricCounter::TlsHandshakeErrors);
+
+        snapshot.udp_datagrams_in = sum(MetricCounter::UdpDatagramsIn);
+        snapshot.udp_datagrams_out = sum(MetricCounter::UdpDatagramsOut);
+        snapshot.udp_bytes_in = sum(MetricCounter::UdpBytesIn);
+        snapshot.udp_bytes_out = sum(MetricCounter::UdpBytesOut);
+        snapshot.udp_receive_errors = sum(MetricCounter::UdpReceiveErrors);
+        snapshot.udp_send_errors = sum(MetricCounter::UdpSendErrors);
+
+        snapshot.workloads_submitted = sum(MetricCounter::WorkloadsSubmitted);
+        snapshot.workloads_started = sum(MetricCounter::WorkloadsStarted);
+        snapshot.workloads_completed = sum(MetricCounter::WorkloadsCompleted);
+        snapshot.workload_queue_depth = difference(snapshot.workloads_submitted, snapshot.workloads_started);
+
+        snapshot.callback_duration = merge(MetricHistogram::CallbackDuration);
+        snapshot.workload_queue_delay = merge(MetricHistogram::WorkloadQueueDelay);
+        snapshot.workload_duration = merge(MetricHistogram::WorkloadDuration);
+        snapshot.tls_handshake_duration = merge(MetricHistogram::TlsHandshakeDuration);
+        return snapshot;
+    }
+
+public:
+    explicit MetricsRegistry(const std::size_t worker_count):
+        m_worker_count { worker_count },
+        m_profiler { worker_count },
+        m_pool { std::make_shared<Metrics>(worker_count, -1, m_profiler) },
+        m_clients { std::make_shared<Metrics>(worker_count, -1, m_profiler) } {}
+
+    [[nodiscard]] Metrics& pool() const {
+        return *m_pool;
+    }
+
+    [[nodiscard]] MetricsPtr clients() const {
+        return m_clients;
+    }
+
+    [[nodiscard]] CallbackProfiler& profiler() {
+        return m_profiler;
+    }
+
+    [[nodiscard]] const CallbackProfiler& profiler() const {
+        return m_profiler;
+    }
+
+    // The metrics of the handler on the port. A handler that restarts on the same port continues its counters.
+    [[nodiscard]] MetricsPtr handler(const int port) {
+        std::lock_guard lock { m_mutex };
+        auto& metrics = m_handlers[port];
+        if (!metrics) {
+            metrics = std::make_shared<Metrics>(m_worker_count, port, m_profiler);
+        }
+        return metrics;
+    }
+
+    // Pool, clients and all handlers
+    [[nodiscard]] MetricsSnapshot snapshot() const {
+        std::lock_guard lock { m_mutex };
+        std::vector<const Metrics*> sources { m_pool.get(), m_clients.get() };
+        for (const auto& [port, metrics] : m_handlers) {
+            sources.push_back(metrics.get());
+        }
+        return snapshot_of(sources);
+    }
+
+    // A single handler, empty when nothing ever listened on the port
+    [[nodiscard]] MetricsSnapshot snapshot(const int port) const {
+        std::lock_guard lock { m_mutex };
+        const auto it = m_handlers.find(port);
+        if (it == m_handlers.end()) {
+            return {};
+        }
+        return snapshot_of({ it->second.get() });
+    }
+};
+
+#endif //LE_METRICS_HPP
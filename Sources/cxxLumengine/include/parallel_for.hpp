@@ -0,0 +1,163 @@
+#ifndef LE_PARALLEL_FOR_HPP
+#define LE_PARALLEL_FOR_HPP
+
+#include <cxxAsio.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "io_worker.hpp"
+#include "workload.hpp"
+
+// Executes a ParallelForWorkload across the pool threads
+// The range is cut into one contiguous slot per participating thread. Each thread consumes its own slot
+// from the front in grain sized chunks. Once a slot is exhausted, its thread steals the upper half of the
+// largest remaining slot, so uneven chunk costs are balanced without any central queue.
+// The completion action runs exactly once, on the thread that finishes the last chunk.
+class ParallelForJob final : public std::enable_shared_from_this<ParallelForJob> {
+    struct alignas(64) Slot {
+        std::mutex mutex;
+        std::size_t begin { 0 };
+        std::size_t end { 0 };
+    };
+
+    const ParallelForWorkload& m_workload;
+    std::size_t m_grain;
+    std::size_t m_slot_count;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<std::size_t> m_remaining;
+    std::function<void()> m_on_complete;
+    WorkloadStopCondition m_stop;
+
+    bool take_local(const std::size_t index, std::size_t& begin, std::size_t& end) {
+        auto& slot = m_slots[index];
+        std::lock_guard lock { slot.mutex };
+        if (slot.begin >= slot.end) {
+            return false;
+        }
+        begin = slot.begin;
+        end = slot.begin + std::min(m_grain, slot.end - slot.begin);
+        slot.begin = end;
+        return true;
+    }
+
+    // Moves the upper half of the largest other slot into the slot at index
+    bool steal(const std::size_t index) {
+        std::size_t victim = m_slot_count;
+        std::size_t victim_size = 0;
+        for (std::size_t offset = 1; offset < m_slot_count; ++offset) {
+            const auto candidate = (index + offset) % m_slot_count;
+            std::lock_guard lock { m_slots[candidate].mutex };
+            const auto size = m_slots[candidate].end - std::min(m_slots[candidate].begin, m_slots[candidate].end);
+            if (size > victim_size) {
+                victim = candidate;
+                victim_size = size;
+            }
+        }
+        if (victim == m_slot_count) {
+            return false;
+        }
+
+        std::size_t begin;
+        std::size_t end;
+        {
+            auto& slot = m_slots[victim];
+            std::lock_guard lock { slot.mutex };
+            if (slot.begin >= slot.end) {
+                // The victim drained its slot in the meantime, the caller will rescan
+                return true;
+            }
+            const auto size = slot.end - slot.begin;
+            // Small remainders are taken whole, larger ones are split in half
+            const auto stolen = size > m_grain ? size / 2 : size;
+            begin = slot.end - stolen;
+            end = slot.end;
+            slot.end = begin;
+        }
+
+        auto& own = m_slots[index];
+        std::lock_guard lock { own.mutex };
+        own.begin = begin;
+        own.end = end;
+        return true;
+    }
+
+    void run_slot(const std::size_t index) {
+        std::size_t begin;
+        std::size_t end;
+        while (true) {
+            if (take_local(index, begin, end)) {
+                // Chunks are still accounted for after a stop request so that completion fires once
+                if (!m_stop.stop_requested()) {
+                    m_workload.body.call(begin, end);
+                }
+                if (m_remaining.fetch_sub(end - begin, std::memory_order_acq_rel) == end - begin) {
+                    m_on_complete();
+                    return;
+                }
+            } else if (!steal(index)) {
+                return;
+            }
+        }
+    }
+
+public:
+    ParallelForJob(
+        const ParallelForWorkload& workload,
+        const std::size_t concurrency,
+        std::function<void()> on_complete,
+        WorkloadStopCondition stop = {}
+    ):
+        m_workload { workload },
+        m_grain { workload.grain },
+        m_slot_count { 0 },
+        m_remaining { workload.end > workload.begin ? workload.end - workload.begin : 0 },
+        m_on_complete { std::move(on_complete) },
+        m_stop { stop } {
+        const auto size = m_remaining.load(std::memory_order_relaxed);
+        const auto threads = std::max(std::size_t { 1 }, concurrency);
+        if (m_grain == 0) {
+            // Aim for roughly eight chunks per thread when no grain is provided
+            m_grain = std::max(std::size_t { 1 }, size / (threads * 8));
+        }
+        // A grain over the range is one chunk of it. Chunk ends stay within the range, so a range near the end of
+        // size_t does not wrap around.
+        m_grain = std::min(m_grain, std::max(std::size_t { 1 }, size));
+
+        m_slot_count = std::min(threads, size / m_grain + (size % m_grain != 0 ? 1 : 0));
+        m_slots = std::make_unique<Slot[]>(std::max(std::size_t { 1 }, m_slot_count));
+        std::size_t position = workload.begin;
+        for (std::size_t i = 0; i < m_slot_count; ++i) {
+            const auto length = size / m_slot_count + (i < size % m_slot_count ? 1 : 0);
+            m_slots[i].begin = position;
+            m_slots[i].end = position + length;
+            position += length;
+        }
+    }
+
+    // Posts one runner per slot, each to a different worker.
+    // An empty range completes immediately on the calling thread.
+    void start(IoWorkerGroup& workers) {
+        if (m_slot_count == 0) {
+            m_on_complete();
+            return;
+        }
+        const auto first = workers.next().index();
+        for (std::size_t i = 0; i < m_slot_count; ++i) {
+            post(workers.at(first + i).io_context(), [self = shared_from_this(), i] {
+                self->run_slot(i);
+            });
+        }
+    }
+
+    static std::shared_ptr<ParallelForJob> shared(
+        const ParallelForWorkload& workload,
+        const std::size_t concurrency,
+        std::function<void()> on_complete,
+        WorkloadStopCondition stop = {}
+    ) {
+        return std::make_shared<ParallelForJob>(workload, concurrency, std::move(on_complete), stop);
+    }
+};
+
+#endif //LE_PARALLEL_FOR_HPP
@@ -0,0 +1,187 @@
+#ifndef LE_READ_BUFFER_POOL_HPP
+#define LE_READ_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "buffer.hpp"
+
+// Lets every session size its read buffer after its own traffic instead of using read_buffer_size for all of them
+// read_buffer_size is the size a session starts with. Sizes are powers of two between the minimum and the maximum.
+struct TcpReadBufferSizing {
+    bool adaptive { false };
+    uint min_size { 1024 };
+    uint max_size { 256 * 1024 };
+};
+
+// Read buffers in power of two size classes, recycled by the thread that releases them
+// Resizing sessions trade buffers back and forth, the pool saves the allocation and the zeroing of every new
+// buffer. Each thread keeps a few megabytes per class at most, larger buffers than the largest class are not pooled.
+class ReadBufferPool final {
+    static constexpr std::size_t min_class_shift = 9;
+    static constexpr std::size_t class_count = 16;
+    static constexpr std::size_t max_free_bytes_per_class = 4 * 1024 * 1024;
+    static constexpr std::size_t max_free_control_blocks = 1024;
+
+    struct FreeLists {
+        std::array<std::vector<char*>, class_count> blocks;
+        // Control blocks of the shared_ptr of a buffer, all of the same type and size
+        std::vector<void*> control_blocks;
+
+        // Reserved, so releasing a control block never allocates
+        FreeLists() {
+            control_blocks.reserve(max_free_control_blocks);
+        }
+
+        ~FreeLists() {
+            closed() = true;
+            for (const auto& list : blocks) {
+                for (auto* block : list) {
+                    delete[] block;
+                }
+            }
+            for (auto* control_block : control_blocks) {
+                ::operator delete(control_block);
+            }
+        }
+    };
+
+    // Allocates the shared_ptr control blocks from the free list of the thread, so acquiring a pooled buffer does
+    // not allocate at all
+    template<typename T>
+    struct ControlBlockAllocator {
+        using value_type = T;
+
+        ControlBlockAllocator() = default;
+
+        template<typename U>
+        ControlBlockAllocator(const ControlBlockAllocator<U>&) noexcept {}
+
+        [[nodiscard]] T* allocate(const std::size_t n) {
+            if (n == 1 && !closed()) {
+                if (auto& list = free_lists().control_blocks; !list.empty()) {
+                    auto* control_block = list.back();
+                    list.pop_back();
+                    return static_cast<T*>(control_block);
+                }
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* control_block, const std::size_t n) noexcept {
+            if (n == 1 && !closed()) {
+                if (auto& list = free_lists().control_blocks; list.size() < max_free_control_blocks) {
+                    list.push_back(control_block);
+                    return;
+                }
+            }
+            ::operator delete(control_block);
+        }
+
+        template<typename U>
+        bool operator==(const ControlBlockAllocator<U>&) const noexcept {
+            return true;
+        }
+    };
+
+    static FreeLists& free_lists() {
+        static thread_local FreeLists lists;
+        return lists;
+    }
+
+    // Blocks released while the thread exits, after its lists are gone, are freed right away
+    static bool& closed() {
+        static thread_local bool closed = false;
+        return closed;
+    }
+
+    static void release(const std::size_t index, char* block) {
+        if (!closed()) {
+            auto& list = free_lists().blocks[index];
+            if (list.size() < std::max<std::size_t>(1, max_free_bytes_per_class >> (index + min_class_shift))) {
+                list.push_back(block);
+                return;
+            }
+        }
+        delete[] block;
+    }
+
+public:
+    static constexpr std::size_t min_class_size = std::size_t { 1 } << min_class_shift;
+    static constexpr std::size_t max_class_size = min_class_size << (class_count - 1);
+
+    // The size of the buffer acquire(size) hands out
+    [[nodiscard]] static constexpr std::size_t class_size(const std::size_t size) {
+        return std::bit_ceil(std::max(size, min_class_size));
+    }
+
+    // A buffer of class_size(size) bytes, uninitialised. It goes back to the pool when the buffer is destroyed.
+    [[nodiscard]] static Buffer acquire(const std::size_t size) {
+        const auto capacity = class_size(size);
+        if (capacity > max_class_size) {
+            return Buffer { size };
+        }
+        const auto index = static_cast<std::size_t>(std::countr_zero(capacity)) - min_class_shift;
+        auto& list = free_lists().blocks[index];
+        char* block;
+        if (list.empty()) {
+            block = new char[capacity];
+        } else {
+            block = list.back();
+            list.pop_back();
+        }
+        return Buffer::view(std::shared_ptr<char>(block, [index](char* released) { release(index, released); },
+                                                  ControlBlockAllocator<char> {}), block, capacity);
+    }
+};
+
+// Sizes the read buffer of one session after how full its recent reads were
+// Reads that fill the whole buffer twice in a row double it, so bulk transfers need fewer reads. A long run of
+// reads that fill less than a quarter halves it, so idle and chatty connections hold little memory.
+class ReadBufferSizer final {
+    static constexpr std::uint32_t grow_after = 2;
+    static constexpr std::uint32_t shrink_after = 16;
+
+    std::size_t m_min;
+    std::size_t m_max;
+    std::size_t m_size;
+    std::uint32_t m_full_reads { 0 };
+    std::uint32_t m_sparse_reads { 0 };
+
+public:
+    ReadBufferSizer(const TcpReadBufferSizing& sizing, const std::size_t initial_size):
+        m_min { ReadBufferPool::class_size(sizing.min_size) },
+        m_max { std::max(m_min, ReadBufferPool::class_size(sizing.max_size)) },
+        m_size { std::clamp(ReadBufferPool::class_size(initial_size), m_min, m_max) } {}
+
+    // The size for the next read
+    [[nodiscard]] std::size_t size() const noexcept {
+        return m_size;
+    }
+
+    void record(const std::size_t bytes_read) noexcept {
+        if (bytes_read >= m_size) {
+            m_sparse_reads = 0;
+            if (++m_full_reads >= grow_after && m_size < m_max) {
+                m_size *= 2;
+                m_full_reads = 0;
+            }
+        } else if (bytes_read < m_size / 4) {
+            m_full_reads = 0;
+            if (++m_sparse_reads >= shrink_after && m_size > m_min) {
+                m_size /= 2;
+                m_sparse_reads = 0;
+            }
+        } else {
+            m_full_reads = 0;
+            m_sparse_reads = 0;
+        }
+    }
+};
+
+#endif //LE_READ_BUFFER_POOL_HPP
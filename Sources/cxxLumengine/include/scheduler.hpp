@@ -15,6 +15,10 @@ public:
        ThreadPool::create_thread_pool(std::thread::hardware_concurrency())) {
    }
 
+    explicit LeScheduler(const ThreadPoolConfig& config): m_pool(
+        ThreadPool::create_thread_pool(config)) {
+    }
+
     // Delete copy operations
     LeScheduler(const LeScheduler &) = delete;
 
@@ -25,16 +29,76 @@ public:
 
     LeScheduler &operator=(LeScheduler &&) noexcept = default;
 
-    void run_immediately(Workload workload) const {
-        m_pool->run_immediately(std::move(workload));
+    WorkloadHandle run_immediately(Workload workload) const {
+        return m_pool->run_immediately(std::move(workload));
+    }
+
+    WorkloadHandle run_at(Workload workload, const PointInTime time) const {
+        return m_pool->run_at(std::move(workload), time);
+    }
+
+    WorkloadHandle run_after(Workload workload, const std::chrono::nanoseconds delay) const {
+        return m_pool->run_after(std::move(workload), delay);
+    }
+
+    void cancel_group(const WorkloadGroup group) const {
+        m_pool->cancel_group(group);
+    }
+
+    bool wait_for_completion() const {
+        return m_pool->wait_for_completion();
+    }
+
+    bool wait_for_completion(const std::chrono::nanoseconds timeout) const {
+        return m_pool->wait_for_completion(timeout);
+    }
+
+    [[nodiscard]] TcpClientPtr create_tcp_client(TcpClientConfigPtr config) const {
+        return m_pool->create_tcp_client(std::move(config));
+    }
+
+    [[nodiscard]] std::vector<IoWorkerInfo> workers_info() const {
+        return m_pool->workers_info();
+    }
+
+    void start_tracing(const std::size_t events_per_thread = std::size_t { 1 } << 16) const {
+        m_pool->start_tracing(events_per_thread);
+    }
+
+    void stop_tracing() const {
+        m_pool->stop_tracing();
+    }
+
+    [[nodiscard]] bool write_trace(const std::string& path) const {
+        return m_pool->write_trace(path);
+    }
+
+    [[nodiscard]] std::vector<IoLoopSnapshot> loop_snapshots() const {
+        return m_pool->loop_snapshots();
+    }
+
+    [[nodiscard]] std::string loop_dump() const {
+        return m_pool->loop_dump();
+    }
+
+    [[nodiscard]] MetricsSnapshot metrics_snapshot() const {
+        return m_pool->metrics_snapshot();
+    }
+
+    [[nodiscard]] MetricsSnapshot metrics_snapshot(const int port) const {
+        return m_pool->metrics_snapshot(port);
+    }
+
+    void enable_callback_profiler(CallbackProfilerConfig config) const {
+        m_pool->enable_callback_profiler(std::move(config));
     }
 
-    void run_at(Workload workload, const PointInTime time) const {
-        m_pool->run_at(std::move(workload), time);
+    void disable_callback_profiler() const {
+        m_pool->disable_callback_profiler();
     }
 
-    void run_after(Workload workload, const std::chrono::nanoseconds delay) const {
-        m_pool->run_after(std::move(workload), delay);
+    [[nodiscard]] CallbackProfileSnapshot callback_profile(const HandlerType type) const {
+        return m_pool->callback_profile(type);
     }
 };
 
@@ -2,12 +2,66 @@
 #define LE_SERVER_HPP
 
 #include <cxxAsio.hpp>
+#include "io_worker.hpp"
+#include "metrics.hpp"
 #include "tcp_handler.hpp"
 #include "udp_handler.hpp"
+#include "unix_handler.hpp"
 
-using ProtocolHandler = std::variant<TcpHandlerPtr, UdpHandlerPtr>;
+// Handler with a C++ config, started and stopped by its server like the Swift driven ones
+// Only starting and stopping go through std::function, the callbacks are resolved at compile time.
+struct NativeHandlerConfig {
+    using StopFunction = std::function<void()>;
+    std::function<StopFunction(IoWorkerGroup&, asio::io_context&, MetricsPtr, int, bool)> start;
+
+    template<TcpCallbacks Config>
+    static NativeHandlerConfig tcp(std::shared_ptr<const Config> config) {
+        return { [config = std::move(config)](IoWorkerGroup& workers, asio::io_context& io_context,
+                                              MetricsPtr metrics, const int port, const bool v6) {
+            auto handler = std::make_shared<BasicTcpHandler<Config>>(workers, io_context, config, std::move(metrics), port, v6);
+            handler->start();
+            return StopFunction { [handler] { handler->stop(); } };
+        } };
+    }
+
+    template<UdpCallbacks Config>
+    static NativeHandlerConfig udp(std::shared_ptr<const Config> config) {
+        return { [config = std::move(config)](IoWorkerGroup&, asio::io_context& io_context,
+                                              MetricsPtr metrics, const int port, const bool v6) {
+            auto handler = std::make_shared<BasicUdpHandler<Config>>(io_context, config, std::move(metrics), port, v6);
+            handler->start();
+            return StopFunction { [handler] { handler->stop(); } };
+        } };
+    }
+
+    template<UnixStreamCallbacks Config>
+    static NativeHandlerConfig unix_stream(std::shared_ptr<const Config> config) {
+        return { [config = std::move(config)](IoWorkerGroup& workers, asio::io_context& io_context,
+                                              MetricsPtr metrics, const int port, bool) {
+            auto handler = std::make_shared<BasicUnixStreamHandler<Config>>(workers, io_context, config, std::move(metrics), port);
+            handler->start();
+            return StopFunction { [handler] { handler->stop(); } };
+        } };
+    }
+
+    template<UnixDatagramCallbacks Config>
+    static NativeHandlerConfig unix_datagram(std::shared_ptr<const Config> config) {
+        return { [config = std::move(config)](IoWorkerGroup&, asio::io_context& io_context,
+                                              MetricsPtr metrics, const int port, bool) {
+            auto handler = std::make_shared<BasicUnixDatagramHandler<Config>>(io_context, config, std::move(metrics), port);
+            handler->start();
+            return StopFunction { [handler] { handler->stop(); } };
+        } };
+    }
+};
+struct NativeHandler {
+    NativeHandlerConfig::StopFunction stop;
+};
+
+using ProtocolHandler = std::variant<TcpHandlerPtr, UdpHandlerPtr, UnixStreamHandlerPtr, UnixDatagramHandlerPtr, NativeHandler>;
 using ProtocolHandlerVariant = VariantWrapper<ProtocolHandler>;
-using ProtocolHandlerConfig = std::variant<TcpConfig, UdpConfig>;
+// Unix handlers bind the path of their config, the port of the server config only names them
+using ProtocolHandlerConfig = std::variant<TcpConfig, UdpConfig, UnixStreamConfig, UnixDatagramConfig, NativeHandlerConfig>;
 using ProtocolHandlerConfigVariant = VariantWrapper<ProtocolHandlerConfig>;
 class ServerConfig final {
     int m_port;
@@ -21,56 +75,98 @@ public:
 
     [[nodiscard]] int port() const { return m_port; }
     [[nodiscard]] bool v6() const { return m_v6; }
-    [[nodiscard]] ProtocolHandlerConfigVariant protocol_handler() const { return m_protocol_handler; }
+    // Handlers share ownership of their config with the server, so it is never handed out as a copy
+    [[nodiscard]] const ProtocolHandlerConfigVariant& protocol_handler() const { return m_protocol_handler; }
 };
 class Server;
 using ServerConfigPtr = std::shared_ptr<ServerConfig>;
+using ServerPtr = std::shared_ptr<Server>;
 
 class Server final {
     const ServerConfigPtr m_config;
+    IoWorkerGroup& m_workers;
     asio::io_context& m_io_context;
     asio::strand<asio::any_io_executor>& m_accept_strand;
+    MetricsRegistry& m_metrics;
     ProtocolHandlerVariant m_handler;
     std::function<void()> m_cleanup_action;
+    bool m_stopped { false };
     
     void start() {
         m_config->protocol_handler().visit_all_cases(
             [this](const TcpConfig& config) {
-                auto handler = std::make_shared<TcpHandler>(m_io_context, config, m_config->port(), m_config->v6());
+                auto handler = std::make_shared<TcpHandler>(m_workers, m_io_context, TcpConfigPtr { m_config, &config }, m_metrics.handler(m_config->port()), m_config->port(), m_config->v6());
                 m_handler = VariantWrapper<ProtocolHandler> { handler };
                 handler->start();
             },
             [this](const UdpConfig& config) {
-                auto handler = std::make_shared<UdpHandler>(m_io_context, config, m_config->port(), m_config->v6());
+                auto handler = std::make_shared<UdpHandler>(m_io_context, UdpConfigPtr { m_config, &config }, m_metrics.handler(m_config->port()), m_config->port(), m_config->v6());
                 m_handler = VariantWrapper<ProtocolHandler> { handler };
                 handler->start();
+            },
+            [this](const UnixStreamConfig& config) {
+                auto handler = std::make_shared<UnixStreamHandler>(m_workers, m_io_context, UnixStreamConfigPtr { m_config, &config }, m_metrics.handler(m_config->port()), m_config->port());
+                m_handler = VariantWrapper<ProtocolHandler> { handler };
+                handler->start();
+            },
+            [this](const UnixDatagramConfig& config) {
+                auto handler = std::make_shared<UnixDatagramHandler>(m_io_context, UnixDatagramConfigPtr { m_config, &config }, m_metrics.handler(m_config->port()), m_config->port());
+                m_handler = VariantWrapper<ProtocolHandler> { handler };
+                handler->start();
+            },
+            [this](const NativeHandlerConfig& config) {
+                m_handler = VariantWrapper<ProtocolHandler> { NativeHandler {
+                    config.start(m_workers, m_io_context, m_metrics.handler(m_config->port()), m_config->port(), m_config->v6())
+                } };
             }
         );
     }
 
 public:
-    explicit Server(asio::io_context& io_context, 
+    // The listening socket lives on io_context, accepted sessions are spread over the workers
+    explicit Server(IoWorkerGroup& workers,
+                   asio::io_context& io_context,
                    asio::strand<asio::any_io_executor>& accept_strand,
+                   MetricsRegistry& metrics,
                    ServerConfigPtr config,
                    const std::function<void()>& cleanup_action):
         m_config { std::move(config) },
+        m_workers { workers },
         m_io_context { io_context },
         m_accept_strand { accept_strand },
+        m_metrics { metrics },
         m_cleanup_action { cleanup_action } {
         start();
     }
-    
+
+    // A server owns its listening handler and stops it when destroyed, so it is never copied
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
     ~Server() {
         stop();
     }
 
-    void stop() const {
+    void stop() {
+        if (m_stopped) {
+            return;
+        }
+        m_stopped = true;
         m_handler.visit_all_cases(
             [](const TcpHandlerPtr &handler) {
                 handler->stop();
             },
             [](const UdpHandlerPtr &handler) {
                 handler->stop();
+            },
+            [](const UnixStreamHandlerPtr &handler) {
+                handler->stop();
+            },
+            [](const UnixDatagramHandlerPtr &handler) {
+                handler->stop();
+            },
+            [](const NativeHandler &handler) {
+                handler.stop();
             }
         );
         if (m_cleanup_action) {
@@ -81,6 +177,15 @@ public:
     [[nodiscard]] int port() const {
         return m_config->port();
     }
+
+    static ServerPtr shared(IoWorkerGroup& workers,
+                            asio::io_context& io_context,
+                            asio::strand<asio::any_io_executor>& accept_strand,
+                            MetricsRegistry& metrics,
+                            ServerConfigPtr config,
+                            const std::function<void()>& cleanup_action) {
+        return std::make_shared<Server>(workers, io_context, accept_strand, metrics, std::move(config), cleanup_action);
+    }
 };
 
 #endif //LE_SERVER_HPP
@@ -0,0 +1,201 @@
+#ifndef LE_SIMD_SCAN_HPP
+#define LE_SIMD_SCAN_HPP
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define LE_SIMD_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define LE_SIMD_NEON 1
+#endif
+
+// Byte search and masking kernels for the protocol stages
+// x86-64 always has SSE2, AVX2 is picked at run time when the CPU supports it, ARM64 always has NEON. The scalar
+// kernel handles the tails and every other platform.
+enum class SimdLevel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+};
+
+namespace simd_scan {
+    inline const char* find_byte_scalar(const char* begin, const char* const end, const char needle) noexcept {
+        for (; begin != end; ++begin) {
+            if (*begin == needle) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+#if defined(LE_SIMD_X86)
+    inline const char* find_byte_sse2(const char* begin, const char* const end, const char needle) noexcept {
+        const auto pattern = _mm_set1_epi8(needle);
+        for (; end - begin >= 16; begin += 16) {
+            const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)))) {
+                return begin + std::countr_zero(mask);
+            }
+        }
+        return find_byte_scalar(begin, end, needle);
+    }
+
+    __attribute__((target("avx2")))
+    inline const char* find_byte_avx2(const char* begin, const char* const end, const char needle) noexcept {
+        const auto pattern = _mm256_set1_epi8(needle);
+        for (; end - begin >= 32; begin += 32) {
+            const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern)))) {
+                return begin + std::countr_zero(mask);
+            }
+        }
+        return find_byte_sse2(begin, end, needle);
+    }
+#endif
+
+#if defined(LE_SIMD_NEON)
+    inline const char* find_byte_neon(const char* begin, const char* const end, const char needle) noexcept {
+        const auto pattern = vdupq_n_u8(static_cast<std::uint8_t>(needle));
+        for (; end - begin >= 16; begin += 16) {
+            const auto equal = vceqq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t*>(begin)), pattern);
+            // Narrowing by 4 bits leaves one nibble per byte, so the mask fits into 64 bits
+            const auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal), 4)), 0);
+            if (mask) {
+                return begin + (std::countr_zero(mask) >> 2);
+            }
+        }
+        return find_byte_scalar(begin, end, needle);
+    }
+#endif
+
+    // XORs every byte with the key byte at the same position modulo 4. The output may be the input or start
+    // before it, as every block is loaded before it is stored.
+    inline void xor_mask_scalar(char* out, const char* in, std::size_t size, const std::uint32_t key) noexcept {
+        const auto wide = static_cast<std::uint64_t>(key) << 32 | key;
+        for (; size >= 8; size -= 8, in += 8, out += 8) {
+            std::uint64_t block;
+            std::memcpy(&block, in, 8);
+            block ^= wide;
+            std::memcpy(out, &block, 8);
+        }
+        const auto* bytes = reinterpret_cast<const char*>(&key);
+        for (std::size_t i = 0; i < size; ++i) {
+            out[i] = static_cast<char>(in[i] ^ bytes[i % 4]);
+        }
+    }
+
+#if defined(LE_SIMD_X86)
+    inline void xor_mask_sse2(char* out, const char* in, std::size_t size, const std::uint32_t key) noexcept {
+        const auto pattern = _mm_set1_epi32(static_cast<int>(key));
+        for (; size >= 16; size -= 16, in += 16, out += 16) {
+            const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_xor_si128(block, pattern));
+        }
+        xor_mask_scalar(out, in, size, key);
+    }
+
+    __attribute__((target("avx2")))
+    inline void xor_mask_avx2(char* out, const char* in, std::size_t size, const std::uint32_t key) noexcept {
+        const auto pattern = _mm256_set1_epi32(static_cast<int>(key));
+        for (; size >= 32; size -= 32, in += 32, out += 32) {
+            const auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_xor_si256(block, pattern));
+        }
+        xor_mask_sse2(out, in, size, key);
+    }
+#endif
+
+#if defined(LE_SIMD_NEON)
+    inline void xor_mask_neon(char* out, const char* in, std::size_t size, const std::uint32_t key) noexcept {
+        const auto pattern = vreinterpretq_u8_u32(vdupq_n_u32(key));
+        for (; size >= 16; size -= 16, in += 16, out += 16) {
+            const auto block = vld1q_u8(reinterpret_cast<const std::uint8_t*>(in));
+            vst1q_u8(reinterpret_cast<std::uint8_t*>(out), veorq_u8(block, pattern));
+        }
+        xor_mask_scalar(out, in, size, key);
+    }
+#endif
+
+    using FindByte = const char* (*)(const char*, const char*, char) noexcept;
+    using XorMask = void (*)(char*, const char*, std::size_t, std::uint32_t) noexcept;
+
+    inline FindByte find_byte_kernel(const SimdLevel level) noexcept {
+        switch (level) {
+#if defined(LE_SIMD_X86)
+            case SimdLevel::Sse2: return &find_byte_sse2;
+            case SimdLevel::Avx2: return &find_byte_avx2;
+#endif
+#if defined(LE_SIMD_NEON)
+            case SimdLevel::Neon: return &find_byte_neon;
+#endif
+            default: return &find_byte_scalar;
+        }
+    }
+
+    inline XorMask xor_mask_kernel(const SimdLevel level) noexcept {
+        switch (level) {
+#if defined(LE_SIMD_X86)
+            case SimdLevel::Sse2: return &xor_mask_sse2;
+            case SimdLevel::Avx2: return &xor_mask_avx2;
+#endif
+#if defined(LE_SIMD_NEON)
+            case SimdLevel::Neon: return &xor_mask_neon;
+#endif
+            default: return &xor_mask_scalar;
+        }
+    }
+}
+
+// Best level of the CPU, detected once
+inline SimdLevel simd_level() noexcept {
+    static const SimdLevel level = [] {
+#if defined(LE_SIMD_X86)
+#if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::Avx2;
+        }
+#endif
+        return SimdLevel::Sse2;
+#elif defined(LE_SIMD_NEON)
+        return SimdLevel::Neon;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }();
+    return level;
+}
+
+// The given level, or the best level of the CPU when the CPU lacks it
+inline SimdLevel supported_simd_level(const SimdLevel level) noexcept {
+    return level <= simd_level() ? level : simd_level();
+}
+
+// First byte equal to the needle in [begin, end), end when there is none. Levels the CPU lacks fall back to the
+// best one it has.
+inline const char* find_byte(const char* begin, const char* end, const char needle, const SimdLevel level) noexcept {
+    return simd_scan::find_byte_kernel(supported_simd_level(level))(begin, end, needle);
+}
+
+inline const char* find_byte(const char* begin, const char* end, const char needle) noexcept {
+    static const auto kernel = simd_scan::find_byte_kernel(simd_level());
+    return kernel(begin, end, needle);
+}
+
+// Masks or unmasks bytes with a 4 byte key, e.g. WebSocket payloads. The key holds the key bytes in memory order,
+// as copied from a frame header.
+// The output may be the input itself or start before it.
+inline void xor_mask(char* out, const char* in, const std::size_t size, const std::uint32_t key, const SimdLevel level) noexcept {
+    simd_scan::xor_mask_kernel(supported_simd_level(level))(out, in, size, key);
+}
+
+inline void xor_mask(char* out, const char* in, const std::size_t size, const std::uint32_t key) noexcept {
+    static const auto kernel = simd_scan::xor_mask_kernel(simd_level());
+    kernel(out, in, size, key);
+}
+
+#endif //LE_SIMD_SCAN_HPP
@@ -2,6 +2,7 @@
 #define LE_SWIFT_FUNCTION_WRAPPER_HPP
 
 #include <functional>
+#include <memory>
 #include <string>
 
 // Forward declarations for Swift interop
@@ -13,16 +14,25 @@ inline void log_error(const std::string &message) noexcept {
     std::fprintf(stderr, "[Error] %s\n", message.c_str());
 }
 
+// Shared ownership of a Swift closure context
+// Wrappers are copied together with the configs and workloads that hold them, so the closure is
+// released exactly once, when the last copy goes away.
+using SwiftClosureContext = std::shared_ptr<void>;
+
+inline SwiftClosureContext retain_swift_closure(void *swift_function) noexcept {
+    return { swift_function, [](void *context) { release_swift_closure(context); } };
+}
+
 // Generic Swift function wrapper
 // This struct wraps a Swift function to be callable from C++ with the specified Inputs and Output types.
 // It takes a Swift function pointer, wraps it in a C++ std::function, and handles calling and releasing the Swift closure.
 template<typename Output, typename... Inputs>
 struct SwiftFunctionWrapper {
     std::function<Output(Inputs...)> m_function;
-    void *m_swift_closure;
+    SwiftClosureContext m_swift_closure;
 
     explicit SwiftFunctionWrapper(void *swift_function) noexcept
-        : m_swift_closure(swift_function) {
+        : m_swift_closure(retain_swift_closure(swift_function)) {
         // Wrap the Swift function to match the C++ function signature
         m_function = [swift_function](Inputs... inputs) -> Output {
             try {
@@ -35,9 +45,14 @@ struct SwiftFunctionWrapper {
         };
     }
 
-    ~SwiftFunctionWrapper() noexcept {
-        // Release the Swift closure when the wrapper is destroyed
-        release_swift_closure(m_swift_closure);
+    // Wraps a C++ callable instead of a Swift closure, e.g. in tests. There is no Swift context to release.
+    explicit SwiftFunctionWrapper(std::function<Output(Inputs...)> function) noexcept
+        : m_function(std::move(function)) {}
+
+    // Lets the wrapper stand in for any callable, e.g. in a config that satisfies TcpCallbacks
+    template<typename... Args>
+    Output operator()(Args &&... args) const noexcept {
+        return call(std::forward<Args>(args)...);
     }
 
     template<typename... Args>
@@ -62,10 +77,10 @@ struct SwiftFunctionWrapper {
 template<typename Output>
 struct SwiftFunctionWrapper<Output> {
     std::function<Output()> m_function;
-    void *m_swift_closure;
+    SwiftClosureContext m_swift_closure;
 
     explicit SwiftFunctionWrapper(void *swift_function) noexcept
-        : m_swift_closure(swift_function) {
+        : m_swift_closure(retain_swift_closure(swift_function)) {
         m_function = [swift_function]() -> Output {
             try {
                 auto swift_call = reinterpret_cast<Output(*)(void *)>(swift_function);
@@ -76,6 +91,13 @@ struct SwiftFunctionWrapper<Output> {
         };
     }
 
+    explicit SwiftFunctionWrapper(std::function<Output()> function) noexcept
+        : m_function(std::move(function)) {}
+
+    Output operator()() const noexcept {
+        return call();
+    }
+
     Output call() const noexcept {
         try {
             if (!m_function) {
@@ -97,10 +119,10 @@ struct SwiftFunctionWrapper<Output> {
 template<>
 struct SwiftFunctionWrapper<void, void> {
     std::function<void()> m_function;
-    void *m_swift_closure;
+    SwiftClosureContext m_swift_closure;
 
     explicit SwiftFunctionWrapper(void *swift_function) noexcept
-        : m_swift_closure(swift_function) {
+        : m_swift_closure(retain_swift_closure(swift_function)) {
         m_function = [swift_function] {
             try {
                 reinterpret_cast<void(*)(void *)>(swift_function)(nullptr);
@@ -110,6 +132,13 @@ struct SwiftFunctionWrapper<void, void> {
         };
     }
 
+    explicit SwiftFunctionWrapper(std::function<void()> function) noexcept
+        : m_function(std::move(function)) {}
+
+    void operator()() const noexcept {
+        call();
+    }
+
     void call() const noexcept {
         try {
             if (!m_function) {
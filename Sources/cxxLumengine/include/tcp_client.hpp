@@ -0,0 +1,378 @@
+#ifndef LE_TCP_CLIENT_HPP
+#define LE_TCP_CLIENT_HPP
+
+#include <cxxAsio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#endif
+
+#include "io_worker.hpp"
+#include "metrics.hpp"
+#include "tcp_handler.hpp"
+
+struct TcpClientConfig;
+class TcpClient;
+// Outbound connections are sessions like the accepted ones, driven by the same commands
+using TcpClientSession = BasicTcpSession<TcpClientConfig>;
+using TcpClientSessionPtr = std::shared_ptr<TcpClientSession>;
+using TcpClientPtr = std::shared_ptr<TcpClient>;
+
+struct TcpClientConfig {
+    uint read_buffer_size { 16 * 1024 };
+    // Connections to one endpoint, in use or idle. Connects beyond the limit wait for a connection to be
+    // released or closed.
+    uint max_connections_per_endpoint { 64 };
+    // Released connections kept open for reuse, per endpoint. Releases beyond the limit close the connection.
+    uint max_idle_per_endpoint { 16 };
+    // Idle connections are closed after this long, by the worker of the connection
+    std::chrono::nanoseconds idle_timeout { std::chrono::seconds { 30 } };
+    // Connects that take longer are reported to on_connect as ConnectTimeout, so a peer that never answers does
+    // not hold a connection of the limit. Zero waits for the operating system to give up.
+    std::chrono::nanoseconds connect_timeout { std::chrono::seconds { 10 } };
+    // Timeouts of connections in use, like those of accepted sessions. Pooled connections have only idle_timeout.
+    TcpTimeouts timeouts {};
+    // Called for new and for reused connections. A failed connect reports the error with a closed session.
+    SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code> on_connect;
+    SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> on_receive;
+    SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> on_write;
+    SwiftFunctionWrapper<void, TcpClientSessionPtr, std::error_code> on_disconnect;
+};
+using TcpClientConfigPtr = std::shared_ptr<const TcpClientConfig>;
+
+struct TcpClientPoolInfo {
+    std::size_t open { 0 };
+    std::size_t idle { 0 };
+    std::size_t waiting { 0 };
+};
+
+// Outbound TCP connections on the pool threads, with a keep-alive pool per endpoint
+// connect() hands a connection to on_connect, warm from the pool when there is a healthy one, otherwise
+// a new one. Whether an idle connection is still healthy is checked on its strand before it is handed over.
+// Connects from a pool thread, e.g. from a callback of a downstream session, prefer connections on that worker
+// and open new ones there, so the two sessions can be spliced. Other connects use the next worker.
+// Returning TCPReleaseCommand from a callback puts the connection back into the pool of its endpoint,
+// TCPCloseCommand closes it as usual. The client must not outlive its thread pool.
+class TcpClient final : public std::enable_shared_from_this<TcpClient> {
+    using Clock = std::chrono::steady_clock;
+
+    // The idle timeout of a pooled connection in the deadline wheel of its worker. Owned by the pool entry,
+    // so the wheel drops it once the connection is taken or closed.
+    struct IdleExpiry {
+        std::weak_ptr<TcpClient> client;
+        asio::ip::tcp::endpoint endpoint;
+        std::weak_ptr<TcpClientSession> session;
+    };
+
+    struct IdleSession {
+        TcpClientSessionPtr session;
+        Clock::time_point since;
+        std::shared_ptr<IdleExpiry> expiry;
+    };
+
+    // A connect in flight. The deadline wheel of its worker closes the socket once connect_timeout has passed.
+    struct PendingConnect {
+        asio::ip::tcp::socket socket;
+        bool timed_out { false };
+    };
+
+    struct WaitingConnect {
+        std::shared_ptr<void> context;
+        // The worker the connect came from, nullptr when it came from outside the pool
+        asio::io_context* worker;
+    };
+
+    struct EndpointPool {
+        std::size_t open { 0 };
+        // Connects waiting for a connection, oldest first
+        std::deque<WaitingConnect> waiting;
+        // Most recently released last, so reuse picks the warmest connection
+        std::vector<IdleSession> idle;
+    };
+
+    TcpClientConfigPtr m_config;
+    IoWorkerGroup& m_workers;
+    MetricsPtr m_metrics;
+    std::mutex m_mutex;
+    std::map<asio::ip::tcp::endpoint, EndpointPool> m_pools;
+    bool m_stopped { false };
+
+    // An idle connection must have nothing to read: data or end of file means it cannot be reused.
+    // The peek does not block and is done on the session strand, while no operation is pending on the socket.
+    static bool healthy(asio::ip::tcp::socket& socket) {
+        if (!socket.is_open()) {
+            return false;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        char byte;
+        const auto received = ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#else
+        std::error_code ec;
+        return socket.available(ec) == 0 && !ec;
+#endif
+    }
+
+    static bool on_worker(const TcpClientSessionPtr& session, const asio::io_context* worker) {
+        return &session->socket().get_executor().context() == worker;
+    }
+
+    // Takes an idle connection out of the pool, the ones past the idle timeout are moved to the list to close.
+    // Connections on the given worker are taken first, the warmest of them.
+    static TcpClientSessionPtr take_idle(EndpointPool& pool, const std::chrono::nanoseconds idle_timeout,
+                                         const asio::io_context* worker, std::vector<TcpClientSessionPtr>& stale) {
+        const auto now = Clock::now();
+        while (!pool.idle.empty()) {
+            auto it = std::prev(pool.idle.end());
+            if (worker) {
+                const auto local = std::find_if(pool.idle.rbegin(), pool.idle.rend(), [worker](const IdleSession& idle) {
+                    return on_worker(idle.session, worker);
+                });
+                if (local != pool.idle.rend()) {
+                    it = std::prev(local.base());
+                }
+            }
+            auto idle = std::move(*it);
+            pool.idle.erase(it);
+            if (now - idle.since <= idle_timeout) {
+                return std::move(idle.session);
+            }
+            stale.push_back(std::move(idle.session));
+        }
+        return nullptr;
+    }
+
+    // Closing runs the clean up of the session, which updates the pool, so it is done without the lock
+    static void close_all(const std::vector<TcpClientSessionPtr>& sessions) {
+        for (const auto& session : sessions) {
+            session->close();
+        }
+    }
+
+    static DeadlineWheel::Clock::time_point expire_idle(void* target, DeadlineWheel::Clock::time_point,
+                                                        DeadlineWheel::Clock::time_point) {
+        const auto& expiry = *static_cast<IdleExpiry*>(target);
+        const auto self = expiry.client.lock();
+        const auto session = expiry.session.lock();
+        if (self && session) {
+            self->expire(expiry.endpoint, session);
+        }
+        return DeadlineWheel::Clock::time_point::max();
+    }
+
+    static DeadlineWheel::Clock::time_point expire_connect(void* target, DeadlineWheel::Clock::time_point,
+                                                           DeadlineWheel::Clock::time_point) {
+        auto& pending = *static_cast<PendingConnect*>(target);
+        pending.timed_out = true;
+        std::error_code ec;
+        ec = pending.socket.close(ec);
+        return DeadlineWheel::Clock::time_point::max();
+    }
+
+    // Runs on the worker of an idle connection once its idle timeout is reached
+    void expire(const asio::ip::tcp::endpoint& endpoint, const TcpClientSessionPtr& session) {
+        bool expired = false;
+        {
+            std::lock_guard lock { m_mutex };
+            auto& pool = m_pools[endpoint];
+            expired = std::erase_if(pool.idle, [&session](const IdleSession& idle) { return idle.session == session; }) > 0;
+        }
+        if (expired) {
+            session->close();
+        }
+    }
+
+    // A connection the server closed while it was idle is closed on its strand, the connect is then served again
+    void hand_over(const asio::ip::tcp::endpoint& endpoint, const TcpClientSessionPtr& session,
+                   std::shared_ptr<void> context) {
+        session->reuse([client = weak_from_this(), endpoint, context = std::move(context)](const TcpClientSessionPtr& reused) mutable {
+            if (healthy(reused->socket())) {
+                reused->set_context(std::move(context));
+                return true;
+            }
+            reused->disconnect();
+            if (const auto self = client.lock()) {
+                self->connect(endpoint, std::move(context));
+            }
+            return false;
+        });
+    }
+
+    // The worker of the calling thread when it belongs to the pool
+    [[nodiscard]] asio::io_context* current_worker_context() const {
+        return m_workers.contains_current_thread() ? &IoWorker::current()->io_context() : nullptr;
+    }
+
+    void open_connection(const asio::ip::tcp::endpoint& endpoint, std::shared_ptr<void> context,
+                         asio::io_context* preferred) {
+        auto& io_context = preferred ? *preferred : m_workers.next().io_context();
+        auto pending = std::make_shared<PendingConnect>(PendingConnect { asio::ip::tcp::socket { io_context } });
+        // Started on the worker, only its thread may use its deadline wheel
+        post(io_context, [self = shared_from_this(), pending, endpoint, context = std::move(context)]() mutable {
+            if (auto* const worker = IoWorker::current(); worker && self->m_config->connect_timeout.count() > 0) {
+                worker->deadlines().schedule(pending, &expire_connect, DeadlineWheel::Clock::now() + self->m_config->connect_timeout);
+            }
+            pending->socket.async_connect(endpoint, [self, pending, endpoint, context = std::move(context)](std::error_code ec) mutable {
+                if (pending->timed_out) {
+                    ec = make_error_code(CustomErrorCode::ConnectTimeout);
+                }
+                if (!ec) {
+                    ec = pending->socket.set_option(asio::ip::tcp::no_delay { true }, ec);
+                }
+                // A connection that failed is reported with a closed socket, so it is not counted as a session
+                if (ec) {
+                    std::error_code close_ec;
+                    close_ec = pending->socket.close(close_ec);
+                }
+                auto session = TcpClientSession::shared(std::move(pending->socket), self->m_config, self->m_metrics);
+                session->set_context(std::move(context));
+                session->set_release([client = self->weak_from_this(), endpoint](const TcpClientSessionPtr& released) {
+                    const auto self = client.lock();
+                    return self && self->release(endpoint, released);
+                });
+                session->connect(ec, [client = self->weak_from_this(), endpoint, weak = std::weak_ptr(session)] {
+                    if (const auto self = client.lock()) {
+                        self->closed(endpoint, weak.lock());
+                    }
+                });
+            });
+        });
+    }
+
+    // Runs on the strand of the released session
+    bool release(const asio::ip::tcp::endpoint& endpoint, const TcpClientSessionPtr& session) {
+        std::unique_lock lock { m_mutex };
+        auto& pool = m_pools[endpoint];
+        if (m_stopped) {
+            return false;
+        }
+        if (!pool.waiting.empty()) {
+            auto waiting = std::move(pool.waiting.front());
+            pool.waiting.pop_front();
+            lock.unlock();
+            hand_over(endpoint, session, std::move(waiting.context));
+            return true;
+        }
+        if (pool.idle.size() >= m_config->max_idle_per_endpoint) {
+            return false;
+        }
+        const auto now = Clock::now();
+        auto expiry = std::make_shared<IdleExpiry>(IdleExpiry { weak_from_this(), endpoint, session });
+        pool.idle.push_back({ session, now, expiry });
+        lock.unlock();
+        if (auto* const worker = IoWorker::current()) {
+            worker->deadlines().schedule(expiry, &expire_idle, now + m_config->idle_timeout);
+        }
+        return true;
+    }
+
+    // Runs once for every connection, after it has been disconnected
+    void closed(const asio::ip::tcp::endpoint& endpoint, const TcpClientSessionPtr& session) {
+        std::vector<TcpClientSessionPtr> stale;
+        TcpClientSessionPtr reused;
+        WaitingConnect waiting {};
+        bool open_new = false;
+        {
+            std::lock_guard lock { m_mutex };
+            auto& pool = m_pools[endpoint];
+            --pool.open;
+            std::erase_if(pool.idle, [&session](const IdleSession& idle) { return idle.session == session; });
+            if (!pool.waiting.empty() && !m_stopped) {
+                reused = take_idle(pool, m_config->idle_timeout, pool.waiting.front().worker, stale);
+                if (reused || pool.open < m_config->max_connections_per_endpoint) {
+                    waiting = std::move(pool.waiting.front());
+                    pool.waiting.pop_front();
+                    open_new = !reused;
+                    pool.open += open_new ? 1 : 0;
+                }
+            }
+        }
+        close_all(stale);
+        if (reused) {
+            hand_over(endpoint, reused, std::move(waiting.context));
+        } else if (open_new) {
+            open_connection(endpoint, std::move(waiting.context), waiting.worker);
+        }
+    }
+
+public:
+    TcpClient(IoWorkerGroup& workers, TcpClientConfigPtr config, MetricsPtr metrics):
+        m_config { std::move(config) },
+        m_workers { workers },
+        m_metrics { std::move(metrics) } {}
+
+    TcpClient(const TcpClient&) = delete;
+    TcpClient& operator=(const TcpClient&) = delete;
+
+    // Returns false once the client is stopped. The outcome is reported to on_connect, with the context
+    // attached to the session, e.g. the downstream session the connection is for. A connection reused from
+    // another worker, or handed over from one when all connections were in use, cannot be spliced.
+    bool connect(const asio::ip::tcp::endpoint& endpoint, std::shared_ptr<void> context = nullptr) {
+        std::vector<TcpClientSessionPtr> stale;
+        TcpClientSessionPtr reused;
+        bool open_new = false;
+        auto* const worker = current_worker_context();
+        {
+            std::lock_guard lock { m_mutex };
+            if (m_stopped) {
+                return false;
+            }
+            auto& pool = m_pools[endpoint];
+            reused = take_idle(pool, m_config->idle_timeout, worker, stale);
+            if (!reused) {
+                open_new = pool.open < m_config->max_connections_per_endpoint;
+                if (open_new) {
+                    ++pool.open;
+                } else {
+                    pool.waiting.push_back({ std::move(context), worker });
+                }
+            }
+        }
+        close_all(stale);
+        if (reused) {
+            hand_over(endpoint, reused, std::move(context));
+        } else if (open_new) {
+            open_connection(endpoint, std::move(context), worker);
+        }
+        return true;
+    }
+
+    // Closes the idle connections and drops waiting connects. Connections in use close when their user is done.
+    void stop() {
+        std::vector<TcpClientSessionPtr> idle;
+        {
+            std::lock_guard lock { m_mutex };
+            m_stopped = true;
+            for (auto& [endpoint, pool] : m_pools) {
+                pool.waiting.clear();
+                for (auto& entry : pool.idle) {
+                    idle.push_back(std::move(entry.session));
+                }
+                pool.idle.clear();
+            }
+        }
+        close_all(idle);
+    }
+
+    [[nodiscard]] TcpClientPoolInfo pool_info(const asio::ip::tcp::endpoint& endpoint) {
+        std::lock_guard lock { m_mutex };
+        const auto it = m_pools.find(endpoint);
+        if (it == m_pools.end()) {
+            return {};
+        }
+        return { it->second.open, it->second.idle.size(), it->second.waiting.size() };
+    }
+
+    static TcpClientPtr shared(IoWorkerGroup& workers, TcpClientConfigPtr config, MetricsPtr metrics) {
+        return std::make_shared<TcpClient>(workers, std::move(config), std::move(metrics));
+    }
+};
+
+#endif //LE_TCP_CLIENT_HPP
@@ -0,0 +1,325 @@
+#ifndef LE_TCP_FRAMING_HPP
+#define LE_TCP_FRAMING_HPP
+
+#include <cxxAsio.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "buffer.hpp"
+#include "custom_error_code.hpp"
+#include "http_parser.hpp"
+#include "simd_scan.hpp"
+#include "websocket.hpp"
+
+enum class TcpFramingMode {
+    // on_receive gets the bytes of every read. A session switched to it from another mode gets them as one frame.
+    None,
+    // Every frame starts with its payload length
+    LengthPrefix,
+    // Every frame ends with the delimiter, e.g. lines
+    Delimiter,
+    // Every frame is an HTTP/1.1 request, parsed into TcpSession::requests()
+    Http,
+    // Every frame is the payload of a WebSocket message, see TcpSession::messages()
+    WebSocket,
+};
+
+struct TcpFraming {
+    TcpFramingMode mode { TcpFramingMode::None };
+    // Width of the length prefix in bytes, from 1 to 8. The length counts the payload only.
+    uint header_size { 4 };
+    bool big_endian { true };
+    // A longer frame is reported to on_receive as FrameTooLarge, its bytes stay unread. Limits the body in Http mode
+    // and the joined message in WebSocket mode.
+    std::size_t max_frame_size { 1024 * 1024 };
+    // Frames handed to one on_receive call, zero for all the complete frames that are buffered
+    uint max_frames_per_callback { 0 };
+    // Ends every frame in Delimiter mode and is not part of it, e.g. "\r\n". Empty means "\n".
+    std::string delimiter { "\n" };
+    HttpLimits http {};
+    WebSocketOptions websocket {};
+};
+
+// One complete frame, without its header or delimiter. A whole request in Http mode, a message payload in WebSocket mode.
+struct TcpFrame {
+    const char* data { nullptr };
+    std::size_t size { 0 };
+};
+
+// Cuts the byte stream of a session into frames
+// Reads go into the free space after the buffered bytes. Complete frames are handed out as views into the buffer,
+// valid until the next prepare(). Before a read, a partial frame is moved to the front of the buffer, and the
+// buffer grows when the frame is larger than the buffer. It shrinks back once the large frame is consumed.
+// Delimiters are found with the SIMD byte search for their last byte. Scanning resumes where the previous read
+// stopped, so a delimiter split across reads is found without scanning any byte twice.
+// In Http and WebSocket mode the parsers cut the frames, many pipelined requests or messages may be handed out at
+// once. Frames the WebSocket parser answers on its own, pongs and close replies, are queued as replies.
+class FrameAssembler final {
+    TcpFraming m_framing;
+    std::size_t m_default_capacity;
+    Buffer m_buffer;
+    std::size_t m_begin { 0 };
+    std::size_t m_end { 0 };
+    // Delimiter mode: buffered bytes before this position hold no delimiter
+    std::size_t m_scanned { 0 };
+    std::vector<TcpFrame> m_frames;
+    std::size_t m_frame_bytes { 0 };
+    HttpRequestParser m_http;
+    std::vector<HttpRequest> m_requests;
+    WebSocketParser m_websocket;
+    std::vector<WebSocketMessage> m_messages;
+
+    [[nodiscard]] std::uint64_t length_at(const std::size_t position) const noexcept {
+        const auto* header = reinterpret_cast<const unsigned char*>(m_buffer.pointer() + position);
+        std::uint64_t length = 0;
+        for (uint i = 0; i < m_framing.header_size; ++i) {
+            const auto byte = m_framing.big_endian ? header[i] : header[m_framing.header_size - 1 - i];
+            length = length << 8 | byte;
+        }
+        return length;
+    }
+
+    // Bytes of the first buffered frame, header included, or of its header while that is incomplete
+    [[nodiscard]] std::size_t first_frame_size() const noexcept {
+        if (m_end - m_begin < m_framing.header_size) {
+            return m_framing.header_size;
+        }
+        return m_framing.header_size + static_cast<std::size_t>(length_at(m_begin));
+    }
+
+    // Moves the buffered bytes to the front of a buffer of the given size
+    void move_to_front(const std::size_t capacity) {
+        if (capacity != m_buffer.size()) {
+            Buffer resized { capacity };
+            std::memcpy(resized.pointer(), m_buffer.pointer() + m_begin, m_end - m_begin);
+            m_buffer = std::move(resized);
+        } else {
+            std::memmove(m_buffer.pointer(), m_buffer.pointer() + m_begin, m_end - m_begin);
+        }
+        m_end -= m_begin;
+        m_scanned -= std::min(m_scanned, m_begin);
+        m_begin = 0;
+    }
+
+    std::error_code collect_length_prefixed() {
+        while (m_framing.max_frames_per_callback == 0 || m_frames.size() < m_framing.max_frames_per_callback) {
+            const auto available = m_end - m_begin;
+            if (available < m_framing.header_size) {
+                break;
+            }
+            const auto length = length_at(m_begin);
+            if (length > m_framing.max_frame_size) {
+                return make_error_code(CustomErrorCode::FrameTooLarge);
+            }
+            if (available - m_framing.header_size < length) {
+                break;
+            }
+            const auto size = static_cast<std::size_t>(length);
+            m_frames.push_back({ m_buffer.pointer() + m_begin + m_framing.header_size, size });
+            m_frame_bytes += size;
+            m_begin += m_framing.header_size + size;
+        }
+        return {};
+    }
+
+    std::error_code collect_delimited() {
+        const auto& delimiter = m_framing.delimiter;
+        const auto tail = delimiter.size() - 1;
+        const auto* data = m_buffer.pointer();
+        while (m_framing.max_frames_per_callback == 0 || m_frames.size() < m_framing.max_frames_per_callback) {
+            auto position = std::max(m_scanned, m_begin + tail);
+            std::size_t end = m_end;
+            while (position < m_end) {
+                const auto index = static_cast<std::size_t>(find_byte(data + position, data + m_end, delimiter.back()) - data);
+                if (index == m_end || std::memcmp(data + index - tail, delimiter.data(), tail) == 0) {
+                    end = index;
+                    break;
+                }
+                position = index + 1;
+            }
+            if (end == m_end) {
+                // No byte so far ends a delimiter, the next read is scanned from its first byte on. A delimiter
+                // split across the reads is matched by its last byte, the bytes before it are still buffered.
+                m_scanned = m_end;
+                if (m_end - m_begin > m_framing.max_frame_size + tail) {
+                    return make_error_code(CustomErrorCode::FrameTooLarge);
+                }
+                break;
+            }
+            const auto size = end - tail - m_begin;
+            if (size > m_framing.max_frame_size) {
+                return make_error_code(CustomErrorCode::FrameTooLarge);
+            }
+            m_frames.push_back({ data + m_begin, size });
+            m_frame_bytes += size;
+            m_begin = end + 1;
+            m_scanned = m_begin;
+        }
+        return {};
+    }
+
+    std::error_code collect_requests() {
+        m_http.clear();
+        auto* data = m_buffer.pointer();
+        std::error_code ec;
+        while (m_framing.max_frames_per_callback == 0 || m_frames.size() < m_framing.max_frames_per_callback) {
+            // Empty lines before a request line are ignored, as RFC 9112 asks for
+            while (m_begin < m_end && (data[m_begin] == '\r' || data[m_begin] == '\n')) {
+                ++m_begin;
+            }
+            HttpRequest request;
+            std::size_t consumed = 0;
+            ec = m_http.parse(data + m_begin, m_end - m_begin, request, consumed);
+            if (ec || consumed == 0) {
+                break;
+            }
+            m_frames.push_back({ data + m_begin, consumed });
+            m_frame_bytes += consumed;
+            m_requests.push_back(request);
+            m_begin += consumed;
+        }
+        m_http.bind(m_requests);
+        return ec;
+    }
+
+    std::error_code collect_messages() {
+        auto* data = m_buffer.pointer();
+        while (m_framing.max_frames_per_callback == 0 || m_frames.size() < m_framing.max_frames_per_callback) {
+            auto event = WebSocketEvent::None;
+            WebSocketMessage message;
+            std::size_t consumed = 0;
+            if (const auto ec = m_websocket.parse(data + m_begin, m_end - m_begin, event, message, consumed)) {
+                return ec;
+            }
+            if (event == WebSocketEvent::None) {
+                break;
+            }
+            if (event == WebSocketEvent::Close) {
+                // The messages before the close are handed out first
+                if (!m_frames.empty()) {
+                    break;
+                }
+                m_begin += consumed;
+                m_websocket.close_consumed();
+                m_messages.push_back(message);
+                return make_error_code(CustomErrorCode::WebSocketClosed);
+            }
+            m_begin += consumed;
+            if (event == WebSocketEvent::Message) {
+                m_frames.push_back({ message.data, message.size });
+                m_frame_bytes += message.size;
+                m_messages.push_back(message);
+            }
+        }
+        return {};
+    }
+
+    // Everything buffered is one frame
+    void collect_raw() {
+        if (m_end > m_begin) {
+            m_frames.push_back({ m_buffer.pointer() + m_begin, m_end - m_begin });
+            m_frame_bytes = m_end - m_begin;
+            m_begin = m_end;
+        }
+    }
+
+public:
+    FrameAssembler(const TcpFraming& framing, const std::size_t buffer_size):
+        m_framing { framing },
+        m_default_capacity { std::max<std::size_t>(buffer_size, 16) },
+        m_buffer { m_default_capacity },
+        m_http { framing.http, framing.max_frame_size },
+        m_websocket { framing.websocket, framing.max_frame_size } {
+        m_framing.header_size = std::clamp<uint>(m_framing.header_size, 1, 8);
+        if (m_framing.delimiter.empty()) {
+            m_framing.delimiter = "\n";
+        }
+    }
+
+    // Free space for the next read. Invalidates the frames handed out.
+    asio::mutable_buffer prepare() {
+        if (m_begin == m_end) {
+            m_begin = 0;
+            m_end = 0;
+            m_scanned = 0;
+            if (m_buffer.size() > m_default_capacity) {
+                m_buffer = Buffer { m_default_capacity };
+            }
+        }
+        if (m_framing.mode != TcpFramingMode::LengthPrefix) {
+            // The end of a frame is unknown, so a full buffer doubles. Compacting early keeps reads large.
+            if (m_end == m_buffer.size() && m_begin == 0) {
+                move_to_front(m_buffer.size() * 2);
+            } else if (m_begin > 0 && m_buffer.size() - m_end < m_buffer.size() / 4) {
+                move_to_front(m_buffer.size());
+            }
+        } else if (const auto needed = first_frame_size(); m_begin + needed > m_buffer.size()) {
+            move_to_front(std::max(needed, m_buffer.size()));
+        }
+        return asio::buffer(m_buffer.pointer() + m_end, m_buffer.size() - m_end);
+    }
+
+    void commit(const std::size_t bytes) noexcept {
+        m_end += bytes;
+    }
+
+    // Replaces frames() with the next complete frames, which may be none
+    // A frame over the size limit stops the collection with FrameTooLarge.
+    std::error_code collect() {
+        m_frames.clear();
+        m_frame_bytes = 0;
+        m_requests.clear();
+        m_messages.clear();
+        switch (m_framing.mode) {
+            case TcpFramingMode::LengthPrefix: return collect_length_prefixed();
+            case TcpFramingMode::Delimiter: return collect_delimited();
+            case TcpFramingMode::Http: return collect_requests();
+            case TcpFramingMode::WebSocket: return collect_messages();
+            default:
+                collect_raw();
+                return {};
+        }
+    }
+
+    // Cuts the bytes after the frames handed out with the new mode, e.g. WebSocket once the upgrade is answered
+    void set_mode(const TcpFramingMode mode) noexcept {
+        m_framing.mode = mode;
+        m_scanned = m_begin;
+        m_http.reset();
+        m_websocket.reset();
+    }
+
+    [[nodiscard]] const std::vector<TcpFrame>& frames() const noexcept {
+        return m_frames;
+    }
+
+    // The requests of frames() in Http mode
+    [[nodiscard]] const std::vector<HttpRequest>& requests() const noexcept {
+        return m_requests;
+    }
+
+    // The messages of frames() in WebSocket mode, plus the Close message when collect() reports WebSocketClosed
+    [[nodiscard]] const std::vector<WebSocketMessage>& messages() const noexcept {
+        return m_messages;
+    }
+
+    // Frames to send before anything else, e.g. pongs
+    [[nodiscard]] bool has_replies() const noexcept {
+        return m_websocket.has_replies();
+    }
+
+    [[nodiscard]] std::string take_replies() noexcept {
+        return m_websocket.take_replies();
+    }
+
+    // Payload bytes of frames()
+    [[nodiscard]] std::size_t frame_bytes() const noexcept {
+        return m_frame_bytes;
+    }
+};
+
+#endif //LE_TCP_FRAMING_HPP
@@ -3,27 +3,90 @@
 
 #include <cxxAsio.hpp>
 #include <swift/bridging>
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <optional>
 
 #include "custom_error_code.hpp"
+#include "io_worker.hpp"
+#include "callback_profiler.hpp"
+#include "metrics.hpp"
 #include "swift_function_wrapper.hpp"
+#include "trace.hpp"
+#include "tcp_framing.hpp"
+#include "tcp_splice.hpp"
+#include "tcp_send_file.hpp"
+#include "read_buffer_pool.hpp"
+#include "deadline_wheel.hpp"
+#include "tls.hpp"
 #include "sparse_vector.hpp"
 
 #include "variant_wrapper.hpp"
 #include "buffer.hpp"
 
-class TcpSession;
-class TcpHandler;
+template<typename Config>
+class BasicTcpSession;
+template<typename Config>
+class BasicTcpHandler;
+struct TcpConfig;
+// Handlers driven by Swift closures. C++ code can instantiate the templates with its own config, see TcpCallbacks.
+using TcpSession = BasicTcpSession<TcpConfig>;
+using TcpHandler = BasicTcpHandler<TcpConfig>;
 
 struct TCPReadCommand {};
 struct TCPWriteCommand {
     Buffer buffer;
 };
 struct TCPCloseCommand {};
-using TCPCommand = std::variant<TCPReadCommand, TCPWriteCommand, TCPCloseCommand>;
+// Hands a pooled client connection back to its pool for the next user. Other sessions are closed.
+struct TCPReleaseCommand {};
+// Leaves the session without a pending operation, e.g. while the upstream of a proxy connects.
+// It stays open until resume() hands it a command, a splice takes it over or it is closed.
+struct TCPHoldCommand {};
+// Pipes the session and a held peer into each other, see TcpSplice. Build it with splice_with(peer).
+// The end is reported to on_receive with the bytes sent to the peer. The peer is closed with it, unless
+// stop_splice() ended the splice, which is reported as operation_aborted. Both sessions must run on the same
+// worker, e.g. a TcpClient connection opened from a callback of the session, otherwise on_receive gets
+// operation_not_supported. The timeouts of both sessions are suspended while the splice runs.
+struct TCPSpliceCommand {
+    std::shared_ptr<void> peer;
+    asio::ip::tcp::socket* peer_socket { nullptr };
+    std::function<void()> close_peer;
+    std::function<void(bool)> suspend_peer_timeouts;
+};
+// Sends a range of a file, see FileSource. The file is an open descriptor, which the caller keeps, or a path
+// when fd is negative. A length of 0 sends the rest of the file. on_write is called once with the bytes sent,
+// a file that shrank underneath ends the send with eof.
+struct TCPSendFileCommand {
+    int fd { -1 };
+    std::string path;
+    std::uint64_t offset { 0 };
+    std::uint64_t length { 0 };
+};
+using TCPCommand = std::variant<TCPReadCommand, TCPWriteCommand, TCPCloseCommand, TCPReleaseCommand,
+    TCPHoldCommand, TCPSpliceCommand, TCPSendFileCommand>;
 using TCPCommandVariant = VariantWrapper<TCPCommand>;
 using TcpSessionPtr = std::shared_ptr<TcpSession>;
 using TcpHandlerPtr = std::shared_ptr<TcpHandler>;
 
+// Closes sessions that stall, reported to on_disconnect as IdleTimeout, ReadTimeout or WriteTimeout. Zero is off.
+// Deadlines are kept by the DeadlineWheel of the worker, so they fire up to DeadlineWheel::tick late. Sessions
+// outside the worker pool have no timeouts.
+struct TcpTimeouts {
+    // No bytes read or written for this long, held sessions included. Paused while the session is spliced.
+    std::chrono::milliseconds idle { 0 };
+    // From a TCPReadCommand, or the start of the TLS handshake, until on_receive. With framing that is until a
+    // whole frame arrived, so a peer that trickles a request in cannot hold the session.
+    std::chrono::milliseconds read { 0 };
+    // From a TCPWriteCommand or TCPSendFileCommand until on_write
+    std::chrono::milliseconds write { 0 };
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return idle.count() > 0 || read.count() > 0 || write.count() > 0;
+    }
+};
+
 struct TcpConfig {
     uint read_buffer_size { 16 * 1024 };
     uint pre_allocated_session_count { 128 };
@@ -33,80 +96,764 @@ struct TcpConfig {
     SwiftFunctionWrapper<void, TcpSessionPtr, std::error_code> on_disconnect;
     SwiftFunctionWrapper<void, TcpHandlerPtr> on_start;
     SwiftFunctionWrapper<void, TcpHandlerPtr> on_stop;
+    // With framing, on_receive gets complete frames through TcpSession::frames() instead of the raw reads
+    TcpFraming framing {};
+    // With TLS, sessions complete the handshake before on_connect and read and write plain text
+    TcpTls tls {};
+    // Without framing, sessions can grow and shrink their read buffer, read_buffer_size is where they start
+    TcpReadBufferSizing read_buffer_sizing {};
+    TcpTimeouts timeouts {};
 };
-class TcpSession final : public std::enable_shared_from_this<TcpSession> {
-    const TcpConfig& m_config;
+// Sessions can outlive the server that created them, e.g. while a close is still queued, so they share the config
+using TcpConfigPtr = std::shared_ptr<const TcpConfig>;
+
+// A config drives its sessions through callbacks named like the TcpConfig fields. They are called as
+// config.on_receive(session, ec, bytes), so a config can hold callable objects, as TcpConfig does, or
+// implement them as const member functions that are inlined into the completion handlers.
+// A config may also have a TcpFraming member named framing, a TcpTls member named tls, a TcpReadBufferSizing
+// member named read_buffer_sizing and a TcpTimeouts member named timeouts. Callbacks run concurrently on every worker.
+template<typename Config>
+concept TcpSessionCallbacks = requires(
+    const Config& config,
+    const std::shared_ptr<BasicTcpSession<Config>>& session,
+    const std::error_code& ec,
+    const std::size_t bytes
+) {
+    { config.read_buffer_size } -> std::convertible_to<std::size_t>;
+    { config.on_connect(session, ec) } -> std::convertible_to<TCPCommandVariant>;
+    { config.on_receive(session, ec, bytes) } -> std::convertible_to<TCPCommandVariant>;
+    { config.on_write(session, ec, bytes) } -> std::convertible_to<TCPCommandVariant>;
+    config.on_disconnect(session, ec);
+};
+
+// Session callbacks plus the ones of the listening handler
+template<typename Config>
+concept TcpCallbacks = TcpSessionCallbacks<Config> && requires(
+    const Config& config,
+    const std::shared_ptr<BasicTcpHandler<Config>>& handler
+) {
+    { config.pre_allocated_session_count } -> std::convertible_to<std::size_t>;
+    config.on_start(handler);
+    config.on_stop(handler);
+};
+
+template<typename Config>
+class BasicTcpSession final : public std::enable_shared_from_this<BasicTcpSession<Config>> {
+    using SessionPtr = std::shared_ptr<BasicTcpSession>;
+    using ConfigPtr = std::shared_ptr<const Config>;
+    using DeadlineClock = DeadlineWheel::Clock;
+    static constexpr auto no_deadline = DeadlineClock::time_point::max();
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
     asio::ip::tcp::socket m_socket;
-    asio::strand<asio::any_io_executor>& m_strand;
+    asio::strand<asio::any_io_executor> m_strand;
+    // Replaces the read buffer when the config enables framing
+    std::optional<FrameAssembler> m_frames;
+    // Set when the read buffer adapts to the traffic, its buffers come from the ReadBufferPool
+    std::optional<ReadBufferSizer> m_read_sizer;
     Buffer m_read_buffer;
+    // Owns the data of the write in flight, the command that carried it is gone once the callback returns
+    Buffer m_write_buffer;
     std::function<void()> m_clean_up;
+    // Set by a connection pool. Returns false when the pool does not take the session back.
+    std::function<bool(const SessionPtr&)> m_release;
+    // Whatever the user attached to the session, e.g. the downstream session of a proxy connection
+    std::shared_ptr<void> m_context;
+    // The splice owns itself through its pending operations
+    std::weak_ptr<TcpSplice> m_splice;
+    // The file of a TCPSendFileCommand in flight and the bytes of it sent so far
+    std::unique_ptr<FileSource> m_file;
+    std::uint64_t m_file_sent { 0 };
+    // Set when the config has timeouts, the deadlines are no_deadline while they are not armed
+    TcpTimeouts m_timeouts;
+    DeadlineWheel* m_deadline_wheel { nullptr };
+    DeadlineClock::time_point m_idle_deadline { no_deadline };
+    DeadlineClock::time_point m_read_deadline { no_deadline };
+    DeadlineClock::time_point m_write_deadline { no_deadline };
+    // The deadline of the newest wheel entry of the session, no_deadline when it has none
+    DeadlineClock::time_point m_scheduled_deadline { no_deadline };
+    // Set while a splice drives the socket, no deadline is armed then
+    bool m_timeouts_suspended { false };
+    // Set by disconnect(). Completions that arrive afterwards, e.g. the aborted read of a session that timed out,
+    // are dropped, the session has been reported as disconnected.
+    bool m_closed { false };
+#if defined(LE_ENABLE_TLS)
+    // Keeps the callbacks of the SSL context alive as long as the stream
+    TlsServerContextPtr m_tls_context;
+    std::optional<TlsStream> m_tls;
+#endif
 
-    void handle_command(const TCPCommandVariant &command) {
+    void handle_command(TCPCommandVariant command) {
         command.visit_all_cases(
-            [this](const TCPReadCommand&) { read(); },
-            [this](const TCPWriteCommand& cmd) { write(cmd.buffer); },
-            [this](const TCPCloseCommand&) { disconnect(); }
+            [this](const TCPReadCommand&) {
+                arm(m_read_deadline, m_timeouts.read);
+                read();
+            },
+            [this](TCPWriteCommand& cmd) {
+                writing();
+                write(std::move(cmd.buffer));
+            },
+            [this](const TCPCloseCommand&) { disconnect(); },
+            [this](const TCPReleaseCommand&) { release(); },
+            [](const TCPHoldCommand&) {},
+            [this](TCPSpliceCommand& cmd) { splice(std::move(cmd)); },
+            [this](const TCPSendFileCommand& cmd) {
+                writing();
+                send_file(cmd);
+            }
         );
     }
 
+    void release() {
+        // A pooled session must not keep its previous user alive
+        m_context.reset();
+        if (m_release && m_socket.is_open() && m_release(this->shared_from_this())) {
+            // The pool has a timeout of its own, the timeouts of the session resume once it is reused
+            suspend_timeouts(true);
+            return;
+        }
+        disconnect();
+    }
+
+    static std::optional<FrameAssembler> frame_assembler(const Config& config) {
+        if constexpr (requires { { config.framing } -> std::convertible_to<TcpFraming>; }) {
+            if (config.framing.mode != TcpFramingMode::None) {
+                return FrameAssembler { config.framing, config.read_buffer_size };
+            }
+        }
+        return std::nullopt;
+    }
+
+    static std::optional<ReadBufferSizer> read_sizer(const Config& config, const bool framing) {
+        if constexpr (requires { { config.read_buffer_sizing } -> std::convertible_to<TcpReadBufferSizing>; }) {
+            if (config.read_buffer_sizing.adaptive && !framing) {
+                return ReadBufferSizer { config.read_buffer_sizing, config.read_buffer_size };
+            }
+        }
+        return std::nullopt;
+    }
+    static TcpTimeouts timeouts_of(const Config& config) {
+        if constexpr (requires { { config.timeouts } -> std::convertible_to<TcpTimeouts>; }) {
+            return config.timeouts;
+        } else {
+            return {};
+        }
+    }
+
+    // The wheel of the worker that runs the socket, so the deadlines are only touched by the session thread
+    static DeadlineWheel* deadline_wheel_of(const TcpTimeouts& timeouts, asio::ip::tcp::socket& socket) {
+        const auto worker = IoWorker::current();
+        if (!timeouts.enabled() || !worker ||
+            static_cast<asio::execution_context*>(&worker->io_context()) != &socket.get_executor().context()) {
+            return nullptr;
+        }
+        return &worker->deadlines();
+    }
+
+    void arm(DeadlineClock::time_point& deadline, const std::chrono::milliseconds timeout) {
+        if (!m_deadline_wheel || timeout.count() <= 0 || m_timeouts_suspended) {
+            return;
+        }
+        deadline = DeadlineClock::now() + timeout;
+        // A later deadline is found when the scheduled one comes up
+        if (deadline < m_scheduled_deadline) {
+            schedule_deadline(deadline);
+        }
+    }
+
+    // A session has no read or write of its own in flight while it is spliced, so only the idle deadline
+    // starts over when the timeouts resume
+    void suspend_timeouts(const bool suspended) {
+        m_timeouts_suspended = suspended;
+        if (suspended) {
+            m_idle_deadline = no_deadline;
+            m_read_deadline = no_deadline;
+            m_write_deadline = no_deadline;
+        } else {
+            active();
+        }
+    }
+
+    // Bytes moved, the idle deadline starts over
+    void active() {
+        arm(m_idle_deadline, m_timeouts.idle);
+    }
+
+    // A write may take longer than the idle timeout while its bytes trickle out, the write timeout covers it
+    void writing() {
+        m_idle_deadline = no_deadline;
+        arm(m_write_deadline, m_timeouts.write);
+    }
+
+    void written() {
+        m_write_deadline = no_deadline;
+        active();
+    }
+
+    void schedule_deadline(const DeadlineClock::time_point deadline) {
+        m_scheduled_deadline = deadline;
+        m_deadline_wheel->schedule(this->weak_from_this(), &check_deadlines, deadline);
+    }
+
+    [[nodiscard]] DeadlineClock::time_point next_deadline() const {
+        return std::min({ m_idle_deadline, m_read_deadline, m_write_deadline });
+    }
+
+    // Runs on the worker thread when a wheel entry of the session comes up
+    static DeadlineClock::time_point check_deadlines(void* target, const DeadlineClock::time_point scheduled_for,
+                                                     const DeadlineClock::time_point now) {
+        auto& session = *static_cast<BasicTcpSession*>(target);
+        // An earlier deadline replaced the entry
+        if (scheduled_for != session.m_scheduled_deadline) {
+            return no_deadline;
+        }
+        const auto next = session.next_deadline();
+        if (next <= now) {
+            session.m_scheduled_deadline = no_deadline;
+            // A completion that beats the deadline may still be queued, the strand sorts it out
+            post(session.m_strand, [self = session.shared_from_this()] {
+                self->deadline_reached();
+            });
+            return no_deadline;
+        }
+        session.m_scheduled_deadline = next;
+        return next;
+    }
+
+    void deadline_reached() {
+        const auto now = DeadlineClock::now();
+        CustomErrorCode reason;
+        if (m_write_deadline <= now) {
+            reason = CustomErrorCode::WriteTimeout;
+        } else if (m_read_deadline <= now) {
+            reason = CustomErrorCode::ReadTimeout;
+        } else if (m_idle_deadline <= now) {
+            reason = CustomErrorCode::IdleTimeout;
+        } else {
+            if (const auto next = next_deadline(); next != no_deadline && next < m_scheduled_deadline) {
+                schedule_deadline(next);
+            }
+            return;
+        }
+        m_metrics->add(MetricCounter::TcpTimeouts);
+        disconnect(make_error_code(reason));
+    }
+
+    static TcpFraming framing_of(const Config& config) {
+        if constexpr (requires { { config.framing } -> std::convertible_to<TcpFraming>; }) {
+            return config.framing;
+        } else {
+            return {};
+        }
+    }
+
+    // Runs the operation on the TLS stream of the session, or on its socket without TLS
+    template<typename Operation>
+    void with_stream(Operation&& operation) {
+#if defined(LE_ENABLE_TLS)
+        if (m_tls) {
+            operation(*m_tls);
+            return;
+        }
+#endif
+        operation(m_socket);
+    }
+
     void read() {
-        async_read(m_socket, asio::buffer(m_read_buffer.pointer(), m_read_buffer.size()),
-            asio::transfer_at_least(1),
-            bind_executor(m_strand, [this](std::error_code ec, const size_t bytes_transferred) {
-                const auto command = m_config.on_receive.call(
-                    shared_from_this(),
-                    ec,
-                    bytes_transferred
-                );
-                handle_command(command);
-            })
-        );
+        if (m_frames) {
+            read_frames();
+            return;
+        }
+        // The last read is handed out until here, so this is where the buffer can change its size
+        if (m_read_sizer && m_read_sizer->size() != m_read_buffer.size()) {
+            m_read_buffer = ReadBufferPool::acquire(m_read_sizer->size());
+        }
+        trace(TraceEvent::ReadIssued, this);
+        with_stream([this](auto& stream) {
+            async_read(stream, asio::buffer(m_read_buffer.pointer(), m_read_buffer.size()),
+                asio::transfer_at_least(1),
+                bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec, const size_t bytes_transferred) {
+                    trace(TraceEvent::ReadCompleted, this, bytes_transferred);
+                    if (m_closed) {
+                        return;
+                    }
+                    if (!ec) {
+                        m_metrics->add(MetricCounter::TcpReads);
+                        m_metrics->add(MetricCounter::TcpBytesIn, bytes_transferred);
+                        if (m_read_sizer) {
+                            m_read_sizer->record(bytes_transferred);
+                        }
+                        active();
+                    } else if (ec != asio::error::eof && ec != asio::error::operation_aborted) {
+                        m_metrics->add(MetricCounter::TcpReadErrors);
+                    }
+                    m_read_deadline = no_deadline;
+                    handle_command(m_metrics->time_callback(HandlerType::TcpOnRceive, this, [&] {
+                        return m_config->on_receive(self, ec, bytes_transferred);
+                    }));
+                })
+            );
+        });
+    }
+
+    // Reads until at least one frame is complete, partial frames never reach the callbacks
+    void read_frames() {
+        // Frames that came with an earlier read are delivered first, posted so a long run of them does not recurse
+        if (const auto ec = m_frames->collect(); ec || !m_frames->frames().empty() || m_frames->has_replies()) {
+            post(m_strand, [this, self = this->shared_from_this(), ec] {
+                frames_collected(self, ec);
+            });
+            return;
+        }
+        trace(TraceEvent::ReadIssued, this);
+        with_stream([this](auto& stream) {
+            stream.async_read_some(m_frames->prepare(),
+                bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec, const size_t bytes_transferred) {
+                    trace(TraceEvent::ReadCompleted, this, bytes_transferred);
+                    if (m_closed) {
+                        return;
+                    }
+                    if (!ec) {
+                        m_metrics->add(MetricCounter::TcpReads);
+                        m_metrics->add(MetricCounter::TcpBytesIn, bytes_transferred);
+                        m_frames->commit(bytes_transferred);
+                        active();
+                        ec = m_frames->collect();
+                    } else if (ec != asio::error::eof && ec != asio::error::operation_aborted) {
+                        m_metrics->add(MetricCounter::TcpReadErrors);
+                    }
+                    frames_collected(self, ec);
+                })
+            );
+        });
+    }
+
+    // Replies of the framing, e.g. WebSocket pongs, go out before the frames reach the callbacks
+    void frames_collected(const SessionPtr& self, const std::error_code& ec) {
+        if (m_closed) {
+            return;
+        }
+        if (m_frames->has_replies()) {
+            write_replies(ec);
+        } else if (!ec && m_frames->frames().empty()) {
+            read_frames();
+        } else {
+            deliver_frames(self, ec);
+        }
+    }
+
+    // No write is in flight while the session reads, so the replies can use the write buffer
+    void write_replies(const std::error_code& read_ec) {
+        m_write_buffer = Buffer { m_frames->take_replies() };
+        trace(TraceEvent::WriteIssued, this, m_write_buffer.size());
+        with_stream([this, read_ec](auto& stream) {
+            async_write(stream, asio::buffer(m_write_buffer.pointer(), m_write_buffer.size()),
+                bind_executor(m_strand, [this, self = this->shared_from_this(), read_ec](const std::error_code ec, size_t bytes_transferred) {
+                    trace(TraceEvent::WriteCompleted, this, bytes_transferred);
+                    if (!ec) {
+                        m_metrics->add(MetricCounter::TcpWrites);
+                        m_metrics->add(MetricCounter::TcpBytesOut, bytes_transferred);
+                        active();
+                    } else if (ec != asio::error::operation_aborted) {
+                        m_metrics->add(MetricCounter::TcpWriteErrors);
+                    }
+                    frames_collected(self, read_ec ? read_ec : ec);
+                })
+            );
+        });
+    }
+
+    void deliver_frames(const SessionPtr& self, const std::error_code& ec) {
+        m_read_deadline = no_deadline;
+        m_metrics->add(MetricCounter::TcpFramesIn, m_frames->frames().size());
+        handle_command(m_metrics->time_callback(HandlerType::TcpOnRceive, this, [&] {
+            return m_config->on_receive(self, ec, m_frames->frame_bytes());
+        }));
+    }
+
+    // The splice drives the peer socket from this strand, which is only safe when one thread runs both sessions
+    [[nodiscard]] bool same_worker(asio::ip::tcp::socket& peer_socket) {
+        return &peer_socket.get_executor().context() == &m_socket.get_executor().context();
+    }
+
+    void splice(TCPSpliceCommand command) {
+        // A splice moves raw bytes between the sockets, which would bypass the TLS stream
+        if (!command.peer_socket || tls() || !same_worker(*command.peer_socket)) {
+            const auto self = this->shared_from_this();
+            const auto ec = command.peer_socket ? asio::error::operation_not_supported : asio::error::invalid_argument;
+            handle_command(m_metrics->time_callback(HandlerType::TcpOnRceive, this, [&] {
+                return m_config->on_receive(self, ec, 0);
+            }));
+            return;
+        }
+        // The peer goes quiet as well, its deadlines would otherwise close the socket the splice drives
+        auto suspend_peer = std::move(command.suspend_peer_timeouts);
+        if (suspend_peer) {
+            suspend_peer(true);
+        }
+        auto splice = TcpSplice::shared(m_strand, this->shared_from_this(), m_socket,
+            std::move(command.peer), *command.peer_socket,
+            [this, close_peer = std::move(command.close_peer), suspend_peer = std::move(suspend_peer)](const std::error_code ec, const std::uint64_t sent, const std::uint64_t received) {
+                // The splice keeps the session alive until this returns
+                const auto self = this->shared_from_this();
+                m_metrics->add(MetricCounter::TcpSplicedBytes, sent + received);
+                // A session closed underneath the splice takes the peer with it
+                if (m_closed) {
+                    if (close_peer) {
+                        close_peer();
+                    }
+                    return;
+                }
+                suspend_timeouts(false);
+                if (ec != asio::error::operation_aborted && close_peer) {
+                    close_peer();
+                } else if (suspend_peer) {
+                    suspend_peer(false);
+                }
+                handle_command(m_metrics->time_callback(HandlerType::TcpOnRceive, this, [&] {
+                    return m_config->on_receive(self, ec, static_cast<std::size_t>(sent));
+                }));
+            });
+        m_splice = splice;
+        suspend_timeouts(true);
+        splice->start();
+    }
+
+    void write(Buffer data) {
+        m_write_buffer = std::move(data);
+        trace(TraceEvent::WriteIssued, this, m_write_buffer.size());
+        with_stream([this](auto& stream) {
+            async_write(stream, asio::buffer(m_write_buffer.pointer(), m_write_buffer.size()),
+                bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec, size_t bytes_transferred) {
+                    trace(TraceEvent::WriteCompleted, this, bytes_transferred);
+                    if (m_closed) {
+                        return;
+                    }
+                    if (!ec) {
+                        m_metrics->add(MetricCounter::TcpWrites);
+                        m_metrics->add(MetricCounter::TcpBytesOut, bytes_transferred);
+                    } else if (ec != asio::error::operation_aborted) {
+                        m_metrics->add(MetricCounter::TcpWriteErrors);
+                    }
+                    written();
+                    handle_command(m_metrics->time_callback(HandlerType::TcpOnWrite, this, [&] {
+                        return m_config->on_write(self, ec, bytes_transferred);
+                    }));
+                })
+            );
+        });
+    }
+
+    // Chunks sent in one go before the session yields the worker to other handlers
+    static constexpr int file_chunks_per_turn = 16;
+
+    void send_file(const TCPSendFileCommand& command) {
+        m_file = std::make_unique<FileSource>();
+        m_file_sent = 0;
+        trace(TraceEvent::WriteIssued, this, 0);
+        if (const auto ec = m_file->open(command.fd, command.path, command.offset, command.length)) {
+            file_sent(ec);
+            return;
+        }
+        if (tls()) {
+            copy_file();
+            return;
+        }
+        // sendfile() must not block the worker. The socket stays non-blocking, which Asio handles like its own mode.
+        std::error_code ec;
+        ec = m_socket.native_non_blocking(true, ec);
+        if (ec) {
+            file_sent(ec);
+            return;
+        }
+        send_file_chunks();
     }
 
-    void write(const Buffer& data) {
-        async_write(m_socket, asio::buffer(data.pointer(), data.size()),
-            bind_executor(m_strand, [this](const std::error_code ec, size_t bytes_transferred) {
-                const auto command = m_config.on_write.call(
-                    shared_from_this(),
-                    ec,
-                    bytes_transferred
+    void send_file_chunks() {
+        for (int turn = 0; turn < file_chunks_per_turn && m_file->remaining() > 0; ++turn) {
+            const auto sent = m_file->send(m_socket.native_handle());
+            if (sent > 0) {
+                m_file_sent += static_cast<std::uint64_t>(sent);
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                m_socket.async_wait(asio::socket_base::wait_write,
+                    bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec) {
+                        if (ec) {
+                            file_sent(ec);
+                        } else {
+                            send_file_chunks();
+                        }
+                    })
                 );
-                handle_command(command);
+                return;
+            }
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            file_sent(sent == 0 ? asio::error::eof : std::error_code { errno, std::system_category() });
+            return;
+        }
+        if (m_file->remaining() > 0) {
+            post(m_strand, [this, self = this->shared_from_this()] {
+                send_file_chunks();
+            });
+            return;
+        }
+        file_sent({});
+    }
+
+    // TLS encrypts in user space, so the file is copied through the write buffer chunk by chunk
+    void copy_file() {
+        if (m_file->remaining() == 0) {
+            file_sent({});
+            return;
+        }
+        if (m_write_buffer.size() != FileSource::chunk_size) {
+            m_write_buffer = Buffer { FileSource::chunk_size };
+        }
+        const auto filled = m_file->read(m_write_buffer.pointer(), m_write_buffer.size());
+        if (filled <= 0) {
+            file_sent(filled == 0 ? asio::error::eof : std::error_code { errno, std::system_category() });
+            return;
+        }
+        with_stream([this, filled](auto& stream) {
+            async_write(stream, asio::buffer(m_write_buffer.pointer(), static_cast<std::size_t>(filled)),
+                bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec, const size_t bytes_transferred) {
+                    m_file_sent += bytes_transferred;
+                    if (ec) {
+                        file_sent(ec);
+                    } else {
+                        copy_file();
+                    }
+                })
+            );
+        });
+    }
+
+    void file_sent(const std::error_code& ec) {
+        m_file.reset();
+        if (m_closed) {
+            return;
+        }
+        trace(TraceEvent::WriteCompleted, this, m_file_sent);
+        if (!ec) {
+            m_metrics->add(MetricCounter::TcpWrites);
+        } else if (ec != asio::error::operation_aborted) {
+            m_metrics->add(MetricCounter::TcpWriteErrors);
+        }
+        m_metrics->add(MetricCounter::TcpBytesOut, m_file_sent);
+        m_metrics->add(MetricCounter::TcpFileBytesOut, m_file_sent);
+        written();
+        const auto self = this->shared_from_this();
+        handle_command(m_metrics->time_callback(HandlerType::TcpOnWrite, this, [&] {
+            return m_config->on_write(self, ec, static_cast<std::size_t>(m_file_sent));
+        }));
+    }
+
+#if defined(LE_ENABLE_TLS)
+    void handshake() {
+        const auto started = std::chrono::steady_clock::now();
+        m_tls->async_handshake(asio::ssl::stream_base::server,
+            bind_executor(m_strand, [this, self = this->shared_from_this(), started](const std::error_code ec) {
+                if (m_closed) {
+                    return;
+                }
+                m_read_deadline = no_deadline;
+                if (ec) {
+                    m_metrics->add(MetricCounter::TlsHandshakeErrors);
+                } else {
+                    m_metrics->record(MetricHistogram::TlsHandshakeDuration, std::chrono::steady_clock::now() - started);
+                    m_metrics->add(MetricCounter::TlsHandshakes);
+                    if (SSL_session_reused(m_tls->native_handle())) {
+                        m_metrics->add(MetricCounter::TlsResumedHandshakes);
+                    }
+                }
+                connected(ec);
             })
         );
     }
+#endif
+
+    void connected(const std::error_code& ec) {
+        if (!ec) {
+            active();
+        }
+        handle_command(m_metrics->time_callback(HandlerType::TcpOnConnect, this, [&] {
+            return m_config->on_connect(this->shared_from_this(), ec);
+        }));
+    }
 
 public:
-    TcpSession(asio::strand<asio::any_io_executor>& strand, const TcpConfig& config):
-        m_config { config },
-        m_socket { strand.get_inner_executor() },
-        m_strand { strand },
-        m_read_buffer { config.read_buffer_size } {}
+    // The socket decides which worker runs the session. Sessions are constructed on that worker,
+    // so the session state and its read buffer are first touched by the thread that uses them.
+    BasicTcpSession(asio::ip::tcp::socket socket, ConfigPtr config, MetricsPtr metrics):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
+        m_socket { std::move(socket) },
+        m_strand { make_strand(m_socket.get_executor()) },
+        m_frames { frame_assembler(*m_config) },
+        m_read_sizer { read_sizer(*m_config, m_frames.has_value()) },
+        m_read_buffer { m_read_sizer ? ReadBufferPool::acquire(m_read_sizer->size()) : Buffer { m_frames ? 0 : m_config->read_buffer_size } },
+        m_timeouts { timeouts_of(*m_config) },
+        m_deadline_wheel { deadline_wheel_of(m_timeouts, m_socket) } {}
 
-    ~TcpSession() {
-        disconnect();
+    // Callbacks need a live shared pointer, so a session that is destroyed without
+    // being disconnected only releases its socket
+    ~BasicTcpSession() {
+        std::error_code ec;
+        ec = m_socket.close(ec);
     }
 
     void connect(std::error_code ec, std::function<void()> clean_up) {
         m_clean_up = std::move(clean_up);
-        const auto command = m_config.on_connect.call(shared_from_this(), ec);
-        handle_command(command);
+        trace(TraceEvent::Connect, this, static_cast<std::uint64_t>(ec.value()));
+        if (m_socket.is_open()) {
+            m_metrics->add(MetricCounter::TcpSessionsOpened);
+        }
+#if defined(LE_ENABLE_TLS)
+        // A failed handshake reaches on_connect as its error
+        if (m_tls && !ec) {
+            arm(m_read_deadline, m_timeouts.read);
+            handshake();
+            return;
+        }
+#endif
+        connected(ec);
     }
 
-    void disconnect() {
+    // A reason, e.g. a timeout, is reported to on_disconnect instead of the result of closing the socket
+    void disconnect(const std::error_code& reason = {}) {
+        if (m_closed) {
+            return;
+        }
+        m_closed = true;
+        m_idle_deadline = no_deadline;
+        m_read_deadline = no_deadline;
+        m_write_deadline = no_deadline;
+#if defined(LE_ENABLE_TLS)
+        // Closes without a close_notify, yet as a clean shutdown. OpenSSL drops the TLS session of a connection
+        // that ends otherwise, so it could not be resumed.
+        if (m_tls && m_socket.is_open()) {
+            SSL_set_quiet_shutdown(m_tls->native_handle(), 1);
+            SSL_shutdown(m_tls->native_handle());
+        }
+#endif
         if (m_socket.is_open()) {
             std::error_code shutdown_ec;
             std::error_code close_ec;
             shutdown_ec = m_socket.shutdown(asio::ip::tcp::socket::shutdown_both, shutdown_ec);
-            if (!shutdown_ec) {
-                close_ec = m_socket.close(close_ec);
+            // A failed shutdown (e.g. the peer is already gone) must not keep the socket open
+            close_ec = m_socket.close(close_ec);
+            m_metrics->add(MetricCounter::TcpSessionsClosed);
+            m_metrics->time_callback(HandlerType::TcpOnDisconnect, this, [&] {
+                m_config->on_disconnect(this->shared_from_this(), reason ? reason : shutdown_ec ? shutdown_ec : close_ec);
+            });
+        } else {
+            m_metrics->time_callback(HandlerType::TcpOnDisconnect, this, [&] {
+                m_config->on_disconnect(this->shared_from_this(), make_error_code(CustomErrorCode::Disconnected));
+            });
+        }
+        // The clean up action runs once and releases the session from its handler
+        if (m_clean_up) {
+            const auto clean_up = std::move(m_clean_up);
+            m_clean_up = nullptr;
+            clean_up();
+        }
+    }
+
+    // Gives a pooled session to its next user, on_connect is called again on the session strand
+    // The pool's check runs on the strand first, e.g. to look at the idle socket. A session it rejects is left to it.
+    void reuse(std::function<bool(const SessionPtr&)> usable = nullptr) {
+        post(m_strand, [self = this->shared_from_this(), usable = std::move(usable)] {
+            if (usable && !usable(self)) {
+                return;
             }
-            m_config.on_disconnect.call(shared_from_this(), shutdown_ec ? shutdown_ec : close_ec);
-            if (!shutdown_ec && !close_ec && m_clean_up) {
-                m_clean_up();
+            self->suspend_timeouts(false);
+            self->handle_command(self->m_metrics->time_callback(HandlerType::TcpOnConnect, self.get(), [&self] {
+                return self->m_config->on_connect(self, make_error_code(CustomErrorCode::Success));
+            }));
+        });
+    }
+
+    void set_release(std::function<bool(const SessionPtr&)> release) {
+        m_release = std::move(release);
+    }
+
+    // Hands a held session its next command from any thread, the command runs on the session strand
+    void resume(TCPCommandVariant command) {
+        post(m_strand, [self = this->shared_from_this(), command = std::move(command)]() mutable {
+            self->handle_command(std::move(command));
+        });
+    }
+
+    // Suspends or resumes the timeouts from any thread, the peer of a splice is suspended while it runs
+    void set_timeouts_suspended(const bool suspended) {
+        post(m_strand, [self = this->shared_from_this(), suspended] {
+            self->suspend_timeouts(suspended);
+        });
+    }
+
+    // Ends a splice of this session from any thread, see TCPSpliceCommand
+    void stop_splice() {
+        post(m_strand, [self = this->shared_from_this()] {
+            if (const auto splice = self->m_splice.lock()) {
+                splice->stop();
             }
-        } else {
-            m_config.on_disconnect.call(shared_from_this(), make_error_code(CustomErrorCode::Disconnected));
+        });
+    }
+
+    [[nodiscard]] const std::shared_ptr<void>& context() const {
+        return m_context;
+    }
+
+    void set_context(std::shared_ptr<void> context) {
+        m_context = std::move(context);
+    }
+
+    // Disconnects from any thread, the disconnect itself runs on the session strand
+    void close() {
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            self->disconnect();
+        });
+    }
+
+    // Holds the bytes of the last completed read, valid until the next read is issued. Empty with framing.
+    [[nodiscard]] const Buffer& read_buffer() const {
+        return m_read_buffer;
+    }
+
+    // The frames of the last on_receive when the config enables framing, valid until the next read is issued
+    [[nodiscard]] const std::vector<TcpFrame>& frames() const {
+        static const std::vector<TcpFrame> none;
+        return m_frames ? m_frames->frames() : none;
+    }
+
+    // The parsed requests of the last on_receive when the config frames HTTP, in the order of frames()
+    [[nodiscard]] const std::vector<HttpRequest>& requests() const {
+        static const std::vector<HttpRequest> none;
+        return m_frames ? m_frames->requests() : none;
+    }
+
+    // The messages of the last on_receive in WebSocket mode, in the order of frames(). After a WebSocketClosed
+    // error it holds the Close message, the close reply has been sent by then. Pings are answered on their own.
+    [[nodiscard]] const std::vector<WebSocketMessage>& messages() const {
+        static const std::vector<WebSocketMessage> none;
+        return m_frames ? m_frames->messages() : none;
+    }
+
+    // Switches the framing from the next read on, e.g. to WebSocket from on_receive of the upgrade request or
+    // from on_write of its response. Bytes that are buffered and not handed out yet are kept.
+    void set_framing_mode(const TcpFramingMode mode) {
+        if (m_frames) {
+            m_frames->set_mode(mode);
+        } else if (mode != TcpFramingMode::None) {
+            auto framing = framing_of(*m_config);
+            framing.mode = mode;
+            m_frames.emplace(framing, m_config->read_buffer_size);
+            m_read_sizer.reset();
+            m_read_buffer = Buffer {};
         }
     }
 
@@ -114,37 +861,133 @@ public:
         return m_socket;
     }
 
-    TcpSessionPtr static shared(asio::strand<asio::any_io_executor>& strand, const TcpConfig& config) {
-        return std::make_shared<TcpSession>(strand, config);
+    // Whether reads and writes go through TLS
+    [[nodiscard]] bool tls() const noexcept {
+#if defined(LE_ENABLE_TLS)
+        return m_tls.has_value();
+#else
+        return false;
+#endif
+    }
+
+#if defined(LE_ENABLE_TLS)
+    // Terminates TLS with the context of the calling worker, the handshake runs when the session connects
+    void set_tls(TlsServerContextPtr context) {
+        m_tls_context = std::move(context);
+        m_tls.emplace(m_socket, m_tls_context->context());
+        // Handshake flights and short records would otherwise wait for the delayed ACK of the peer
+        std::error_code ec;
+        ec = m_socket.set_option(asio::ip::tcp::no_delay { true }, ec);
+    }
+
+    // The OpenSSL connection of the session, e.g. for the negotiated ALPN protocol. Null without TLS.
+    [[nodiscard]] SSL* tls_handle() {
+        return m_tls ? m_tls->native_handle() : nullptr;
+    }
+#endif
+
+    static SessionPtr shared(asio::ip::tcp::socket socket, ConfigPtr config, MetricsPtr metrics) {
+        static_assert(TcpSessionCallbacks<Config>, "The config does not provide the TCP session callbacks");
+        return std::make_shared<BasicTcpSession>(std::move(socket), std::move(config), std::move(metrics));
     }
 };
 
-class TcpHandler final : public std::enable_shared_from_this<TcpHandler> {
-    const TcpConfig& m_config;
+// The other side of a TCPSpliceCommand, any kind of TCP session
+template<typename Session>
+TCPSpliceCommand splice_with(const std::shared_ptr<Session>& peer) {
+    // Both run on the strand of the peer
+    return { peer, &peer->socket(), [peer] { peer->close(); },
+             [peer](const bool suspended) { peer->set_timeouts_suspended(suspended); } };
+}
+
+template<typename Config>
+class BasicTcpHandler final : public std::enable_shared_from_this<BasicTcpHandler<Config>> {
+    using Session = BasicTcpSession<Config>;
+    using SessionPtr = std::shared_ptr<Session>;
+    using ConfigPtr = std::shared_ptr<const Config>;
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
+    IoWorkerGroup& m_workers;
     asio::strand<asio::any_io_executor> m_strand;
     asio::ip::tcp::acceptor m_acceptor;
-    SparseVector<TcpSessionPtr> m_sessions;
+    // Only accessed from m_strand
+    SparseVector<SessionPtr> m_sessions;
+    bool m_stopped { false };
     int m_port;
+#if defined(LE_ENABLE_TLS)
+    TlsServerContextPtr m_tls;
+#endif
+    // Reported to on_connect of every session when TLS is enabled but cannot be set up
+    std::error_code m_tls_error;
 
-    void accept() {
-        auto session = m_sessions.add(TcpSession::shared(m_strand, m_config));
+    static TcpTls tls_of(const Config& config) {
+        if constexpr (requires { { config.tls } -> std::convertible_to<TcpTls>; }) {
+            return config.tls;
+        } else {
+            return {};
+        }
+    }
 
+    void accept() {
+        auto& worker = m_workers.next();
         m_acceptor.async_accept(
-            session->socket(),
-            [this, session](const std::error_code ec) {
-                session->connect(ec, [this, session] {
-                    m_sessions.remove(session);
-                });
-                if (m_acceptor.is_open()) {
-                    accept();
+            worker.io_context(),
+            bind_executor(m_strand, [self = this->shared_from_this(), &worker](const std::error_code ec, asio::ip::tcp::socket socket) {
+                trace(TraceEvent::Accept, self.get(), static_cast<std::uint64_t>(ec.value()));
+                // An aborted accept means the handler is stopping, there is no session to report
+                if (ec != asio::error::operation_aborted) {
+                    self->m_metrics->add(ec ? MetricCounter::TcpAcceptErrors : MetricCounter::TcpAccepts);
+                    post(worker.io_context(), [self, ec, socket = std::move(socket)]() mutable {
+                        self->connect_session(std::move(socket), ec);
+                    });
                 }
-            }
+                if (self->m_acceptor.is_open()) {
+                    self->accept();
+                }
+            })
         );
     }
 
+    // Runs on the worker that owns the accepted socket
+    void connect_session(asio::ip::tcp::socket socket, std::error_code ec) {
+        auto session = Session::shared(std::move(socket), m_config, m_metrics);
+        if (!ec) {
+            ec = m_tls_error;
+        }
+#if defined(LE_ENABLE_TLS)
+        if (m_tls && !ec) {
+            session->set_tls(m_tls);
+        }
+#endif
+        // An accept that completed before a stop connects its session after it, the session is closed instead
+        post(m_strand, [self = this->shared_from_this(), session] {
+            if (self->m_stopped) {
+                session->close();
+                return;
+            }
+            self->m_sessions.add(session);
+        });
+        // The handler owns its sessions, so a session only refers back to the handler weakly
+        session->connect(ec, [handler = this->weak_from_this(), weak = std::weak_ptr(session)] {
+            const auto self = handler.lock();
+            if (!self) {
+                return;
+            }
+            post(self->m_strand, [self, weak] {
+                if (const auto session = weak.lock()) {
+                    self->m_sessions.remove(session);
+                }
+            });
+        });
+    }
+
 public:
-    TcpHandler(asio::io_context& io_context, const TcpConfig& config, int const port, const bool v6 = false):
-        m_config { config },
+    BasicTcpHandler(IoWorkerGroup& workers, asio::io_context& io_context, ConfigPtr config, MetricsPtr metrics,
+                    int const port, const bool v6 = false):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
+        m_workers { workers },
         m_strand { make_strand(io_context) },
         m_acceptor {
             io_context, asio::ip::tcp::endpoint(
@@ -152,11 +995,21 @@ public:
                 port
             )
         },
-        m_sessions { config.pre_allocated_session_count },
-        m_port { port } {}
+        m_sessions { m_config->pre_allocated_session_count },
+        m_port { port } {
+        if (const auto tls = tls_of(*m_config); tls.enabled) {
+#if defined(LE_ENABLE_TLS)
+            m_tls = TlsServerContext::shared(tls, m_workers.size());
+            m_tls_error = m_tls->error();
+#else
+            m_tls_error = std::make_error_code(std::errc::operation_not_supported);
+#endif
+        }
+    }
 
-    ~TcpHandler() {
-        stop();
+    ~BasicTcpHandler() {
+        std::error_code ec;
+        ec = m_acceptor.close(ec);
     }
 
     [[nodiscard]] int port() const {
@@ -164,16 +1017,30 @@ public:
     }
 
     void start() {
-        m_config.on_start.call(shared_from_this());
-        accept();
+        static_assert(TcpCallbacks<Config>, "The config does not provide the TCP handler callbacks");
+        m_metrics->time_callback(HandlerType::TcpOnStart, this, [this] {
+            m_config->on_start(this->shared_from_this());
+        });
+        post(m_strand, [self = this->shared_from_this()] {
+            self->accept();
+        });
     }
 
     void stop() {
-        m_acceptor.close();
-        for (const auto& session : m_sessions) {
-            session->disconnect();
-        }
-        m_config.on_stop.call(shared_from_this());
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            if (self->m_stopped) {
+                return;
+            }
+            self->m_stopped = true;
+            std::error_code ec;
+            ec = self->m_acceptor.close(ec);
+            for (const auto& session : self->m_sessions) {
+                session->close();
+            }
+            self->m_metrics->time_callback(HandlerType::TcpOnStop, self.get(), [&self] {
+                self->m_config->on_stop(self);
+            });
+        });
     }
 };
 
@@ -0,0 +1,128 @@
+#ifndef LE_TCP_SEND_FILE_HPP
+#define LE_TCP_SEND_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#else
+#include <sys/socket.h>
+#endif
+
+// A range of a file on its way into a socket
+// On Linux it is sent with sendfile(), so the bytes go from the page cache to the socket without a copy
+// through user space. Elsewhere each chunk is read with pread() and sent with send().
+// The source sends from its own descriptor, a duplicate of a given one or the opened path, and closes it.
+class FileSource final {
+    int m_fd { -1 };
+    std::uint64_t m_offset { 0 };
+    std::uint64_t m_remaining { 0 };
+#if !defined(__linux__)
+    std::vector<char> m_buffer;
+    std::size_t m_buffered { 0 };
+    std::size_t m_buffer_offset { 0 };
+#endif
+
+public:
+    // Upper bound of a single send
+    static constexpr std::size_t chunk_size = 256 * 1024;
+
+    FileSource() = default;
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    ~FileSource() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    // Opens the range, a length of 0 is the rest of the file. A range past the end of the file is invalid.
+    [[nodiscard]] std::error_code open(const int fd, const std::string& path, const std::uint64_t offset, const std::uint64_t length) {
+        m_fd = fd >= 0 ? ::fcntl(fd, F_DUPFD_CLOEXEC, 0) : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fd < 0) {
+            return { errno, std::system_category() };
+        }
+        struct stat status {};
+        if (::fstat(m_fd, &status) != 0) {
+            return { errno, std::system_category() };
+        }
+        if (!S_ISREG(status.st_mode)) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        const auto size = static_cast<std::uint64_t>(status.st_size);
+        if (offset > size || (length != 0 && length > size - offset)) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        m_offset = offset;
+        m_remaining = length != 0 ? length : size - offset;
+#if !defined(__linux__)
+        m_buffer.resize(static_cast<std::size_t>(std::min<std::uint64_t>(m_remaining, chunk_size)));
+#endif
+        return {};
+    }
+
+    [[nodiscard]] std::uint64_t remaining() const noexcept {
+        return m_remaining;
+    }
+
+    // Bytes handed to the non-blocking socket, 0 when the file was truncated, -1 with errno set
+    ssize_t send(const int socket) {
+#if defined(__linux__)
+        auto offset = static_cast<off_t>(m_offset);
+        const auto sent = ::sendfile(socket, m_fd, &offset, static_cast<std::size_t>(std::min<std::uint64_t>(m_remaining, chunk_size)));
+        if (sent > 0) {
+            m_offset += static_cast<std::uint64_t>(sent);
+            m_remaining -= static_cast<std::uint64_t>(sent);
+        }
+        return sent;
+#else
+        if (m_buffer_offset == m_buffered) {
+            const auto filled = read(m_buffer.data(), m_buffer.size());
+            if (filled <= 0) {
+                return filled;
+            }
+            m_buffered = static_cast<std::size_t>(filled);
+            m_buffer_offset = 0;
+            // Counted as sent once the socket took them
+            m_remaining += m_buffered;
+        }
+#if defined(MSG_NOSIGNAL)
+        const auto sent = ::send(socket, m_buffer.data() + m_buffer_offset, m_buffered - m_buffer_offset, MSG_NOSIGNAL);
+#else
+        const auto sent = ::send(socket, m_buffer.data() + m_buffer_offset, m_buffered - m_buffer_offset, 0);
+#endif
+        if (sent > 0) {
+            m_buffer_offset += static_cast<std::size_t>(sent);
+            m_remaining -= static_cast<std::uint64_t>(sent);
+        }
+        return sent;
+#endif
+    }
+
+    // Copies the next chunk for streams that cannot take the file directly, e.g. TLS.
+    // Bytes read, 0 when the file was truncated, -1 with errno set.
+    ssize_t read(char* data, const std::size_t size) {
+        const auto wanted = static_cast<std::size_t>(std::min<std::uint64_t>(m_remaining, size));
+        ssize_t filled;
+        do {
+            filled = ::pread(m_fd, data, wanted, static_cast<off_t>(m_offset));
+        } while (filled < 0 && errno == EINTR);
+        if (filled > 0) {
+            m_offset += static_cast<std::uint64_t>(filled);
+            m_remaining -= static_cast<std::uint64_t>(filled);
+        }
+        return filled;
+    }
+};
+
+#endif //LE_TCP_SEND_FILE_HPP
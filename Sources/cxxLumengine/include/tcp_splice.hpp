@@ -0,0 +1,287 @@
+#ifndef LE_TCP_SPLICE_HPP
+#define LE_TCP_SPLICE_HPP
+
+#include <cxxAsio.hpp>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#endif
+
+// Holds the bytes taken from one socket until the other socket accepts them
+// On Linux this is a kernel pipe filled and drained with splice(), so the bytes never reach user space.
+// Elsewhere it is a user space buffer filled with recv() and drained with send().
+class SplicePipe final {
+#if defined(__linux__)
+    int m_read_fd { -1 };
+    int m_write_fd { -1 };
+#else
+    std::vector<char> m_buffer;
+    std::size_t m_offset { 0 };
+#endif
+
+public:
+    // Upper bound of a single fill, the default capacity of a Linux pipe
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    SplicePipe() = default;
+    SplicePipe(const SplicePipe&) = delete;
+    SplicePipe& operator=(const SplicePipe&) = delete;
+
+    ~SplicePipe() {
+#if defined(__linux__)
+        if (m_read_fd >= 0) {
+            ::close(m_read_fd);
+            ::close(m_write_fd);
+        }
+#endif
+    }
+
+    [[nodiscard]] std::error_code open() {
+#if defined(__linux__)
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+            return { errno, std::system_category() };
+        }
+        m_read_fd = fds[0];
+        m_write_fd = fds[1];
+#else
+        m_buffer.resize(chunk_size);
+#endif
+        return {};
+    }
+
+    // Bytes taken from the socket, 0 at end of file, -1 with errno set. Only called while the pipe is empty.
+    ssize_t fill(const int socket) {
+#if defined(__linux__)
+        return ::splice(socket, nullptr, m_write_fd, nullptr, chunk_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+        m_offset = 0;
+        return ::recv(socket, m_buffer.data(), m_buffer.size(), 0);
+#endif
+    }
+
+    // Bytes handed to the socket, -1 with errno set
+    ssize_t drain(const int socket, const std::size_t pending) {
+#if defined(__linux__)
+        return ::splice(m_read_fd, nullptr, socket, nullptr, pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+#if defined(MSG_NOSIGNAL)
+        const auto sent = ::send(socket, m_buffer.data() + m_offset, pending, MSG_NOSIGNAL);
+#else
+        const auto sent = ::send(socket, m_buffer.data() + m_offset, pending, 0);
+#endif
+        if (sent > 0) {
+            m_offset += static_cast<std::size_t>(sent);
+        }
+        return sent;
+#endif
+    }
+};
+
+// Pipes two connected sockets into each other in both directions
+// Each direction fills its pipe from one socket and drains it into the other, waiting for readiness with
+// async_wait in between. End of file on one side shuts down sending on the other, once everything before it
+// was delivered, and the splice completes when both directions reached end of file. An error on either side
+// cancels both. stop() ends it early: nothing more is taken from the sockets, the bytes already in the pipes
+// are still delivered. Everything runs on one strand, the sockets must have no other operation pending.
+// Both sockets must belong to the same worker: the strand is the one of the first socket, and the other socket
+// is only safe to use from it because the worker runs every handler of its io_context on one thread.
+// The splice is owned by its pending operations and keeps both sides alive until it completes.
+class TcpSplice final : public std::enable_shared_from_this<TcpSplice> {
+public:
+    // Error (end of file, operation_aborted when stopped), bytes from the first socket to the second and back
+    using Completion = std::function<void(std::error_code, std::uint64_t, std::uint64_t)>;
+
+private:
+    struct Direction {
+        asio::ip::tcp::socket& from;
+        asio::ip::tcp::socket& to;
+        SplicePipe pipe {};
+        std::size_t pending { 0 };
+        std::uint64_t moved { 0 };
+        bool eof { false };
+        bool done { false };
+    };
+
+    // Chunks moved in one go before the direction yields the worker to other handlers
+    static constexpr int chunks_per_turn = 16;
+
+    asio::strand<asio::any_io_executor> m_strand;
+    std::shared_ptr<void> m_owner;
+    std::shared_ptr<void> m_peer;
+    Direction m_outbound;
+    Direction m_inbound;
+    Completion m_on_complete;
+    std::error_code m_error;
+    // Waits and yields in flight, the splice completes once none is left
+    std::size_t m_pending_operations { 0 };
+    bool m_stopping { false };
+    bool m_completed { false };
+
+    static bool would_block() {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    void fail(const std::error_code& ec) {
+        if (m_error) {
+            return;
+        }
+        m_error = ec;
+        cancel();
+    }
+
+    void cancel() {
+        std::error_code ec;
+        ec = m_outbound.from.cancel(ec);
+        ec = m_outbound.to.cancel(ec);
+    }
+
+    void wait(Direction& direction, asio::ip::tcp::socket& socket, const asio::socket_base::wait_type type) {
+        ++m_pending_operations;
+        socket.async_wait(type, bind_executor(m_strand, [self = shared_from_this(), &direction](const std::error_code& ec) {
+            --self->m_pending_operations;
+            // Aborted waits are the ones cancelled by stop() or by an error, pump() sorts them out
+            if (ec && ec != asio::error::operation_aborted) {
+                self->fail(ec);
+            }
+            self->pump(direction);
+        }));
+    }
+
+    void yield(Direction& direction) {
+        ++m_pending_operations;
+        post(m_strand, [self = shared_from_this(), &direction] {
+            --self->m_pending_operations;
+            self->pump(direction);
+        });
+    }
+
+    void pump(Direction& direction) {
+        for (int turn = 0; !direction.done; ++turn) {
+            if (m_error) {
+                direction.done = true;
+                break;
+            }
+            if (turn == chunks_per_turn) {
+                yield(direction);
+                return;
+            }
+            if (direction.pending > 0) {
+                const auto sent = direction.pipe.drain(direction.to.native_handle(), direction.pending);
+                if (sent > 0) {
+                    direction.pending -= static_cast<std::size_t>(sent);
+                    direction.moved += static_cast<std::uint64_t>(sent);
+                    continue;
+                }
+                if (sent < 0 && would_block()) {
+                    wait(direction, direction.to, asio::socket_base::wait_write);
+                    return;
+                }
+                fail(sent < 0 ? std::error_code { errno, std::system_category() } : asio::error::broken_pipe);
+                continue;
+            }
+            if (direction.eof || m_stopping) {
+                if (direction.eof) {
+                    std::error_code ec;
+                    ec = direction.to.shutdown(asio::ip::tcp::socket::shutdown_send, ec);
+                }
+                direction.done = true;
+                break;
+            }
+            const auto received = direction.pipe.fill(direction.from.native_handle());
+            if (received > 0) {
+                direction.pending += static_cast<std::size_t>(received);
+            } else if (received == 0) {
+                direction.eof = true;
+            } else if (would_block()) {
+                wait(direction, direction.from, asio::socket_base::wait_read);
+                return;
+            } else {
+                fail({ errno, std::system_category() });
+            }
+        }
+        complete();
+    }
+
+    void complete() {
+        if (m_completed || !m_outbound.done || !m_inbound.done || m_pending_operations > 0) {
+            return;
+        }
+        m_completed = true;
+        // The sockets stay non-blocking, the asynchronous reads and writes of the sessions work either way
+        const auto on_complete = std::move(m_on_complete);
+        on_complete(
+            m_error ? m_error : m_stopping ? std::error_code { asio::error::operation_aborted } : std::error_code { asio::error::eof },
+            m_outbound.moved,
+            m_inbound.moved
+        );
+    }
+
+public:
+    TcpSplice(asio::strand<asio::any_io_executor> strand,
+              std::shared_ptr<void> owner, asio::ip::tcp::socket& socket,
+              std::shared_ptr<void> peer, asio::ip::tcp::socket& peer_socket,
+              Completion on_complete):
+        m_strand { std::move(strand) },
+        m_owner { std::move(owner) },
+        m_peer { std::move(peer) },
+        m_outbound { socket, peer_socket },
+        m_inbound { peer_socket, socket },
+        m_on_complete { std::move(on_complete) } {}
+
+    TcpSplice(const TcpSplice&) = delete;
+    TcpSplice& operator=(const TcpSplice&) = delete;
+
+    // Runs on the strand
+    void start() {
+        std::error_code ec;
+        if (!m_outbound.from.is_open() || !m_outbound.to.is_open()) {
+            ec = asio::error::bad_descriptor;
+        }
+        if (!ec) {
+            ec = m_outbound.pipe.open();
+        }
+        if (!ec) {
+            ec = m_inbound.pipe.open();
+        }
+        if (!ec) {
+            ec = m_outbound.from.native_non_blocking(true, ec);
+        }
+        if (!ec) {
+            ec = m_outbound.to.native_non_blocking(true, ec);
+        }
+        if (ec) {
+            m_error = ec;
+        }
+        pump(m_outbound);
+        pump(m_inbound);
+    }
+
+    // Runs on the strand
+    void stop() {
+        if (m_completed || m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        cancel();
+    }
+
+    static std::shared_ptr<TcpSplice> shared(asio::strand<asio::any_io_executor> strand,
+                                             std::shared_ptr<void> owner, asio::ip::tcp::socket& socket,
+                                             std::shared_ptr<void> peer, asio::ip::tcp::socket& peer_socket,
+                                             Completion on_complete) {
+        return std::make_shared<TcpSplice>(std::move(strand), std::move(owner), socket, std::move(peer), peer_socket,
+            std::move(on_complete));
+    }
+};
+
+#endif //LE_TCP_SPLICE_HPP
@@ -2,106 +2,189 @@
 #define LE_THREAD_POOL_HPP
 
 #include <cxxAsio.hpp>
+#include <atomic>
 #include <vector>
 #include <thread>
 
+#include "drain_latch.hpp"
+#include "io_worker.hpp"
+#include "metrics.hpp"
+#include "tcp_client.hpp"
+#include "trace.hpp"
+#include "parallel_for.hpp"
 #include "sparse_vector.hpp"
 #include "workload.hpp"
+#include "workload_graph.hpp"
 
-class ScheduledWorkload final {
+class ScheduledWorkload;
+using ScheduledWorkloadPtr = std::shared_ptr<ScheduledWorkload>;
+using ScheduledWorkloadCleanup = std::function<void(const ScheduledWorkloadPtr&)>;
+
+class ScheduledWorkload final : public std::enable_shared_from_this<ScheduledWorkload> {
+    IoWorkerGroup& m_workers;
     asio::io_context& m_io_context;
     asio::strand<asio::any_io_executor> m_strand;
     Workload m_workload;
     PointInTime m_scheduled_at_time { std::chrono::steady_clock::now() };
+    // When the schedule says the workload should run, the queue delay is measured from here
+    PointInTime m_due_time { m_scheduled_at_time };
+    PointInTime m_started_at_time {};
     std::optional<asio::steady_timer> m_timer { std::nullopt };
-    std::function<void()> m_cleanup_action;
-    SparseVector<Server>& m_server_storage;
-    bool m_started { false };
-    bool m_finished { false };
+    ScheduledWorkloadCleanup m_cleanup_action;
+    SparseVector<ServerPtr>& m_server_storage;
+    MetricsRegistry& m_metrics;
+    std::atomic<bool> m_started { false };
+    std::atomic<bool> m_finished { false };
+    std::atomic<bool> m_cancelled { false };
+
+    [[nodiscard]] WorkloadStopCondition stop_condition() const {
+        return { &m_cancelled, m_workload.deadline };
+    }
 
     void run_workload(const std::error_code& error) {
-        auto do_immediate_cleanup = true;
-        if (!error) {
-            m_started = true;
-            m_workload.workload.visit_all_cases(
-                [] (const FunctionWorkload& wl) {
-                    wl.call();
-                },
-                [this, &do_immediate_cleanup] (const StartServerWorkload& wl) {
-                    if (!m_server_storage.contains([&wl](const Server& s) {
-                        return s.port() == wl.config->port();
-                    })) {
-                        m_server_storage.add(Server(m_io_context, m_strand, wl.config, [this]{
-                            m_finished = true;
-                            m_cleanup_action();
-                        }));
-                        do_immediate_cleanup = false;
-                    }
-                },
-                [this] (const StopServerWorkload& wl) {
-                    const auto server = m_server_storage.first_where([&wl](const Server& s) {
-                        return s.port() == wl.port;
-                    });
-
-                    if (server) {
-                        server->stop();
-                    }
+        trace(TraceEvent::WorkloadRun, this, static_cast<std::uint64_t>(error.value()));
+        // A cancelled timer also completes with an error, cancellation takes precedence
+        if (m_cancelled) {
+            complete(make_error_code(CustomErrorCode::Cancelled));
+            return;
+        }
+        if (error) {
+            complete(error);
+            return;
+        }
+        if (stop_condition().deadline_expired()) {
+            complete(make_error_code(CustomErrorCode::DeadlineExpired));
+            return;
+        }
+
+        m_started_at_time = std::chrono::steady_clock::now();
+        m_metrics.pool().record(MetricHistogram::WorkloadQueueDelay, m_started_at_time - m_due_time);
+        m_metrics.pool().add(MetricCounter::WorkloadsStarted);
+        m_started = true;
+        m_workload.workload.visit_all_cases(
+            [this] (const FunctionWorkload& wl) {
+                wl.call();
+                complete(make_error_code(CustomErrorCode::Success));
+            },
+            [this] (const StartServerWorkload& wl) {
+                if (!m_server_storage.contains([&wl](const ServerPtr& s) {
+                    return s->port() == wl.config->port();
+                })) {
+                    // The workload stays alive until the server stops
+                    m_server_storage.add(Server::shared(m_workers, m_io_context, m_strand, m_metrics, wl.config, [self = shared_from_this()] {
+                        self->m_metrics.pool().add(MetricCounter::WorkloadsCompleted);
+                        self->m_finished = true;
+                        self->m_cleanup_action(self);
+                    }));
+                    notify(make_error_code(CustomErrorCode::Success));
+                } else {
+                    complete(make_error_code(CustomErrorCode::Success));
                 }
-            );
+            },
+            [this] (const StopServerWorkload& wl) {
+                // Releasing the server stops it
+                m_server_storage.remove_if([&wl](const ServerPtr& s) {
+                    return s->port() == wl.port;
+                });
+                complete(make_error_code(CustomErrorCode::Success));
+            },
+            [this] (const ParallelForWorkload& wl) {
+                // The callback is delayed until the last chunk has been processed
+                ParallelForJob::shared(wl, m_workers.size(), [self = shared_from_this()] {
+                    self->complete(self->stop_error());
+                }, stop_condition())->start(m_workers);
+            },
+            [this] (const GraphWorkload& wl) {
+                if (!wl.graph || !wl.graph->is_acyclic()) {
+                    complete(make_error_code(CustomErrorCode::InvalidGraph));
+                    return;
+                }
+                // The callback is delayed until the last node has finished
+                GraphJob::shared(wl.graph, m_workers, [self = shared_from_this()] {
+                    self->complete(self->stop_error());
+                }, stop_condition())->start();
+            }
+        );
+    }
+
+    // Result of a chunked workload that may have been stopped part way through
+    [[nodiscard]] std::error_code stop_error() const {
+        const auto stop = stop_condition();
+        if (stop.cancel_requested()) {
+            return make_error_code(CustomErrorCode::Cancelled);
+        }
+        if (stop.deadline_expired()) {
+            return make_error_code(CustomErrorCode::DeadlineExpired);
         }
+        return make_error_code(CustomErrorCode::Success);
+    }
 
+    void notify(const std::error_code& error) const {
         if (m_workload.callback) {
-            if (error) {
-                m_workload.callback->call(error);
-            } else {
-                m_workload.callback->call(make_error_code(CustomErrorCode::Success));
-            }
+            m_workload.callback->call(error);
         }
+    }
 
-        if (do_immediate_cleanup) {
-            m_finished = true;
-            m_cleanup_action();
+    void complete(const std::error_code& error) {
+        if (m_started) {
+            m_metrics.pool().record(MetricHistogram::WorkloadDuration, std::chrono::steady_clock::now() - m_started_at_time);
         }
+        m_metrics.pool().add(MetricCounter::WorkloadsCompleted);
+        notify(error);
+        m_finished = true;
+        m_cleanup_action(shared_from_this());
     }
+
 public:
+    // The workload is armed on the given io_context, parallel parts are spread over all workers
     ScheduledWorkload(
+        IoWorkerGroup& workers,
         asio::io_context& io,
         Workload workload,
-        const VariantWrapper<ExecuteSchedule> schedule,
-        SparseVector<Server>& server_storage,
-        std::function<void()> cleanup_action = []{}
-    ) : m_io_context(io),
+        SparseVector<ServerPtr>& server_storage,
+        MetricsRegistry& metrics,
+        ScheduledWorkloadCleanup cleanup_action = [](const ScheduledWorkloadPtr&) {}
+    ) : m_workers(workers),
+        m_io_context(io),
         m_strand { make_strand(io) },
         m_workload { std::move(workload) },
         m_cleanup_action { std::move(cleanup_action) },
-        m_server_storage { server_storage } {
+        m_server_storage { server_storage },
+        m_metrics { metrics } {}
+
+    // Arms the workload according to its schedule. Pending handlers keep the workload alive.
+    void start(const VariantWrapper<ExecuteSchedule>& schedule) {
         schedule.visit_all_cases(
             [this](ExecuteNow) {
                 // Immediately execute the workload
                 post(
                     m_strand,
-                    [this] {
-                        run_workload(make_error_code(CustomErrorCode::Success));
+                    [self = shared_from_this()] {
+                        self->run_workload(make_error_code(CustomErrorCode::Success));
                     }
                 );
             },
-            [this, &io](const ExecuteAt at) {
+            [this](const ExecuteAt at) {
                 // Schedule the workload to be executed at a specific time
-                m_timer.emplace(asio::steady_timer(io, at.start_time));
+                m_due_time = at.start_time;
+                m_timer.emplace(m_io_context, at.start_time);
                 m_timer->async_wait(bind_executor(
                     m_strand,
-                    [this](const std::error_code& error) {
-                        run_workload(error);
+                    [self = shared_from_this()](const std::error_code& error) {
+                        trace(TraceEvent::TimerFired, self.get(), static_cast<std::uint64_t>(error.value()));
+                        self->run_workload(error);
                     }
                 ));
             },
-            [this, &io](const ExecuteAfter after) {
+            [this](const ExecuteAfter after) {
                 // Schedule the workload to be executed after a specific delay
-                m_timer.emplace(io, std::chrono::steady_clock::now() + after.delay);
+                m_due_time = std::chrono::steady_clock::now() + after.delay;
+                m_timer.emplace(m_io_context, m_due_time);
                 m_timer->async_wait(bind_executor(
                     m_strand,
-                    [this](const std::error_code& error) {
-                        run_workload(error);
+                    [self = shared_from_this()](const std::error_code& error) {
+                        trace(TraceEvent::TimerFired, self.get(), static_cast<std::uint64_t>(error.value()));
+                        self->run_workload(error);
                     }
                 ));
             }
@@ -110,149 +193,278 @@ public:
 
     // Cancel the scheduled workload. This method is thread safe as it uses a strand
     // to ensure that the timer is accessed in a thread-safe manner.
+    // Work that has not started yet is dropped, parallel for and graph workloads stop before their next chunk or node.
+    // Either way the callback receives CustomErrorCode::Cancelled. Started servers are not affected.
     void cancel() {
-        post(m_strand, [this] {
-            if (m_timer) {
-                m_timer->cancel();
+        if (m_finished) {
+            return;
+        }
+        m_cancelled = true;
+        post(m_strand, [self = shared_from_this()] {
+            if (self->m_timer) {
+                self->m_timer->cancel();
             }
         });
     }
 
     [[nodiscard]] bool started() const {
-        std::promise<bool> promise;
-        auto future = promise.get_future();
-        post(m_strand, [this, &promise] {
-            promise.set_value(m_started);
-        });
-        return future.get();
+        return m_started;
     }
 
     [[nodiscard]] bool finished() const {
-        std::promise<bool> promise;
-        auto future = promise.get_future();
-        post(m_strand, [this, &promise] {
-            promise.set_value(m_finished);
-        });
-        return future.get();
+        return m_finished;
+    }
+
+    [[nodiscard]] bool cancelled() const {
+        return m_cancelled;
+    }
+
+    [[nodiscard]] WorkloadGroup group() const {
+        return m_workload.group;
     }
 
     [[nodiscard]] PointInTime scheduled_at_time() const {
         return m_scheduled_at_time;
     }
+
+    static ScheduledWorkloadPtr shared(
+        IoWorkerGroup& workers,
+        asio::io_context& io,
+        Workload workload,
+        SparseVector<ServerPtr>& server_storage,
+        MetricsRegistry& metrics,
+        ScheduledWorkloadCleanup cleanup_action = [](const ScheduledWorkloadPtr&) {}
+    ) {
+        return std::make_shared<ScheduledWorkload>(
+            workers, io, std::move(workload), server_storage, metrics, std::move(cleanup_action));
+    }
+};
+
+// Returned for every submitted workload
+// The handle does not keep the workload alive. Once the workload has completed and been released
+// by the pool, cancel() does nothing and finished() reports true.
+class WorkloadHandle final {
+    std::weak_ptr<ScheduledWorkload> m_workload;
+
+public:
+    WorkloadHandle() = default;
+
+    explicit WorkloadHandle(const ScheduledWorkloadPtr& workload): m_workload { workload } {}
+
+    // Returns false when the workload is already gone
+    bool cancel() const {
+        if (const auto workload = m_workload.lock()) {
+            workload->cancel();
+            return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] bool started() const {
+        const auto workload = m_workload.lock();
+        return !workload || workload->started();
+    }
+
+    [[nodiscard]] bool finished() const {
+        const auto workload = m_workload.lock();
+        return !workload || workload->finished();
+    }
 };
 
 class ThreadPool final {
-    std::size_t m_num_threads;
-    asio::io_context m_io_context;
-    asio::executor_work_guard<asio::io_context::executor_type> m_work_guard;
+    // Handlers and workloads record into the registry until the last pending handler is destroyed
+    MetricsRegistry m_metrics;
+    // Declared before everything else that posts to them, so that the io_contexts outlive it
+    IoWorkerGroup m_workers;
     asio::strand<asio::any_io_executor> m_cleanup_strand;
-    std::vector<std::thread> m_threads;
-    SparseVector<ScheduledWorkload> m_workloads;
-    SparseVector<Server> m_running_servers;
+    // Workloads that have been submitted but not completed. Server workloads complete when the server stops.
+    // Declared before the storages, servers that are destroyed with the pool still count down on it.
+    DrainLatch m_outstanding;
+    SparseVector<ScheduledWorkloadPtr> m_workloads;
+    SparseVector<ServerPtr> m_running_servers;
+
+    // Server workloads share the first worker, which serialises access to the server storage.
+    // Every other workload is placed round robin.
+    asio::io_context& io_context_for(const Workload& workload) {
+        const auto manages_servers = workload.workload.visit_all_cases(
+            [](const StartServerWorkload&) { return true; },
+            [](const StopServerWorkload&) { return true; },
+            [](const auto&) { return false; }
+        );
+        return manages_servers ? m_workers.at(0).io_context() : m_workers.next().io_context();
+    }
 
-    void schedule_workload(Workload workload, const VariantWrapper<ExecuteSchedule> schedule) {
-        m_workloads.add(ScheduledWorkload {
-            m_io_context,
+    // The workload registry is only touched from the cleanup strand.
+    // Registration is posted before the workload is armed, so it always precedes the removal.
+    WorkloadHandle schedule_workload(Workload workload, const VariantWrapper<ExecuteSchedule>& schedule) {
+        auto& io_context = io_context_for(workload);
+        m_outstanding.add();
+        m_metrics.pool().add(MetricCounter::WorkloadsSubmitted);
+        auto scheduled = ScheduledWorkload::shared(
+            m_workers,
+            io_context,
             std::move(workload),
-            schedule,
             m_running_servers,
-            [this] {
-                post(m_cleanup_strand, [this] {
-                    remove_completed_workloads();
+            m_metrics,
+            [this](const ScheduledWorkloadPtr& completed) {
+                m_outstanding.done();
+                post(m_cleanup_strand, [this, completed] {
+                    m_workloads.remove(completed);
                 });
             }
+        );
+        trace(TraceEvent::WorkloadScheduled, scheduled.get());
+        post(m_cleanup_strand, [this, scheduled] {
+            m_workloads.add(scheduled);
         });
-    }
-
-    void remove_completed_workloads() {
-        auto it = m_workloads.begin();
-        while (it != m_workloads.end()) {
-            if (it->finished()) {
-                const size_t pos = it.position();
-                ++it;
-                m_workloads.remove(pos);
-            } else {
-                ++it;
-            }
-        }
+        scheduled->start(schedule);
+        return WorkloadHandle { scheduled };
     }
 public:
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
 
     explicit ThreadPool(const std::size_t num_threads)
-        : m_num_threads { std::max(std::size_t { 1 }, num_threads) },
-          m_work_guard { make_work_guard(m_io_context) },
-          m_cleanup_strand { make_strand(m_io_context) },
-          m_workloads { m_num_threads*32 },
-          m_running_servers { m_num_threads } {
-        for (std::size_t i = 0; i < m_num_threads; ++i) {
-            m_threads.emplace_back([this] { m_io_context.run(); });
-        }
-    }
+        : ThreadPool(ThreadPoolConfig { num_threads }) {}
 
+    explicit ThreadPool(const ThreadPoolConfig& config)
+        : m_metrics { std::max(std::size_t { 1 }, config.thread_count) },
+          m_workers { config },
+          m_cleanup_strand { make_strand(m_workers.at(0).io_context()) },
+          m_workloads { m_workers.size()*32 },
+          m_running_servers { m_workers.size() } {}
+
+    // Must not run on a pool thread, e.g. by releasing the last reference to the pool in a callback
     ~ThreadPool() {
-        m_work_guard.reset();
-        m_io_context.stop();
-        for (auto& thread : m_threads) {
-            if (thread.joinable()) {
-                thread.join();
-            }
-        }
+        m_workers.stop();
+        // With the threads joined the servers stop on this thread, see post_or_run
+        m_running_servers.remove_if([](const ServerPtr&) { return true; });
+    }
+
+    [[nodiscard]] std::size_t thread_count() const {
+        return m_workers.size();
+    }
+
+    // Placement of every pool thread. Threads report their CPU and NUMA node once they have started.
+    [[nodiscard]] std::vector<IoWorkerInfo> workers_info() const {
+        return m_workers.info();
+    }
+
+    // Outbound connections on the pool threads. The client must not outlive the pool.
+    [[nodiscard]] TcpClientPtr create_tcp_client(TcpClientConfigPtr config) {
+        return TcpClient::shared(m_workers, std::move(config), m_metrics.clients());
+    }
+
+    // Event loop lag, queue depth and busy time of every pool thread
+    [[nodiscard]] std::vector<IoLoopSnapshot> loop_snapshots() const {
+        return m_workers.loop_snapshots();
+    }
+
+    [[nodiscard]] std::string loop_dump() const {
+        return m_workers.loop_dump();
     }
 
-    void run_immediately(Workload workload) {
-        schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteNow{} } );
+    WorkloadHandle run_immediately(Workload workload) {
+        return schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteNow{} } );
     }
 
-    void run_at(Workload workload, const PointInTime time) {
-        schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteAt { time } });
+    WorkloadHandle run_at(Workload workload, const PointInTime time) {
+        return schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteAt { time } });
     }
 
-    void run_after(Workload workload, const std::chrono::nanoseconds delay) {
-        schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteAfter { delay }});
+    WorkloadHandle run_after(Workload workload, const std::chrono::nanoseconds delay) {
+        return schedule_workload(std::move(workload), VariantWrapper<ExecuteSchedule> { ExecuteAfter { delay }});
+    }
+
+    // Cancels every pending or running workload of the group.
+    // Workloads submitted to the group after this call are not affected.
+    void cancel_group(const WorkloadGroup group) {
+        if (group == DefaultWorkloadGroup) {
+            return;
+        }
+        post(m_cleanup_strand, [this, group] {
+            for (const auto& workload : m_workloads) {
+                if (workload->group() == group) {
+                    workload->cancel();
+                }
+            }
+        });
     }
 
     static std::shared_ptr<ThreadPool> create_thread_pool(std::size_t num_threads) {
         return std::make_shared<ThreadPool>(num_threads);
     }
 
+    static std::shared_ptr<ThreadPool> create_thread_pool(const ThreadPoolConfig& config) {
+        return std::make_shared<ThreadPool>(config);
+    }
+
+    // Counters and histograms of the pool and every handler, merged at the time of the call
+    [[nodiscard]] MetricsSnapshot metrics_snapshot() const {
+        return m_metrics.snapshot();
+    }
+
+    // Counters and histograms of the handler listening on the port
+    [[nodiscard]] MetricsSnapshot metrics_snapshot(const int port) const {
+        return m_metrics.snapshot(port);
+    }
+
+    // Times every handler callback per HandlerType and starts the slow callback watchdog
+    void enable_callback_profiler(CallbackProfilerConfig config) {
+        m_metrics.profiler().enable(std::move(config));
+    }
+
+    void disable_callback_profiler() {
+        m_metrics.profiler().disable();
+    }
+
+    [[nodiscard]] CallbackProfileSnapshot callback_profile(const HandlerType type) const {
+        return m_metrics.profiler().snapshot(type);
+    }
+
+    // Starts recording trace events on every thread, see Tracer
+    // Each worker attaches a ring of its own before it runs anything queued after this call.
+    void start_tracing(const std::size_t events_per_thread) {
+        Tracer::instance().start(events_per_thread);
+        for (std::size_t i = 0; i < m_workers.size(); ++i) {
+            auto& worker = m_workers.at(i);
+            post(worker.io_context(), [&worker] {
+                Tracer::instance().attach_current_thread("worker " + std::to_string(worker.index()));
+            });
+        }
+    }
+
+    void stop_tracing() {
+        Tracer::instance().stop();
+    }
+
+    // Writes the recorded events as a Chrome trace, returns false when the file cannot be written
+    [[nodiscard]] bool write_trace(const std::string& path) const {
+        return Tracer::instance().write_chrome_trace(path);
+    }
+
     // Check if there are any active workloads or servers
     [[nodiscard]] bool has_active_tasks() const {
-        return !m_workloads.empty() || !m_running_servers.empty();
-    }
-
-    // // Wait for all current workloads to complete
-    // void wait_for_completion() {
-    //     std::promise<void> completion_promise;
-    //     const auto completion_future = completion_promise.get_future();
-
-    //     // Create a timer that we'll reuse
-    //     auto timer = std::make_shared<asio::steady_timer>(m_io_context);
-
-    //     // Create the check function
-    //     std::function<void()> check_completion;
-    //     check_completion = [this, timer, &check_completion, completion_promise = std::move(completion_promise)]() mutable {
-    //         post(m_cleanup_strand, [this, timer, &check_completion, completion_promise = std::move(completion_promise)]() mutable {
-    //             remove_completed_workloads();
-    //             if (!has_active_tasks()) {
-    //                 completion_promise.set_value();
-    //             } else {
-    //                 timer->expires_after(std::chrono::milliseconds(100));
-    //                 timer->async_wait([this, timer, &check_completion, completion_promise = std::move(completion_promise)]
-    //                     (const std::error_code&) mutable {
-    //                         check_completion();
-    //                 });
-    //             }
-    //         });
-    //     };
-
-    //     // Start the first check
-    //     check_completion();
-
-    //     // Wait for completion
-    //     completion_future.wait();
-    // }
+        return m_outstanding.count() > 0;
+    }
+
+    // Blocks until every submitted workload has completed and every server has stopped.
+    // Waiting on a pool thread would deadlock the pool, so it returns false immediately there.
+    bool wait_for_completion() {
+        if (m_workers.contains_current_thread()) {
+            return false;
+        }
+        m_outstanding.wait();
+        return true;
+    }
+
+    // Returns false when the pool did not become idle within the timeout
+    bool wait_for_completion(const std::chrono::nanoseconds timeout) {
+        if (m_workers.contains_current_thread()) {
+            return false;
+        }
+        return m_outstanding.wait_for(timeout);
+    }
 };
 
 using ThreadPoolPtr = std::shared_ptr<ThreadPool>;
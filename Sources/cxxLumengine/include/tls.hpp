@@ -0,0 +1,228 @@
+#ifndef LE_TLS_HPP
+#define LE_TLS_HPP
+
+#include <chrono>
+#include <string>
+#include <system_error>
+
+// TLS termination of a TcpHandler
+// Only available in builds with LE_ENABLE_TLS, the TLS trait of the package, which links OpenSSL. Without it an
+// enabled config reports operation_not_supported to on_connect of every session.
+struct TcpTls {
+    bool enabled { false };
+    // PEM files
+    std::string certificate_chain_file;
+    std::string private_key_file;
+    // Sessions kept for resumption by session id, and by stateful tickets when tickets are off. Shared by all workers.
+    std::size_t session_cache_size { 20 * 1024 };
+    std::chrono::seconds session_lifetime { 300 };
+    // Stateless resumption, the ticket keys are shared by all workers and live as long as the handler
+    bool tickets { true };
+};
+
+#if defined(LE_ENABLE_TLS)
+
+#include <cxxAsio.hpp>
+#include <asio/ssl.hpp>
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+#include "io_worker.hpp"
+
+using TlsStream = asio::ssl::stream<asio::ip::tcp::socket&>;
+
+// Serialised sessions by session id, the oldest is evicted once the cache is full
+class TlsSessionCache final {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string session;
+        Clock::time_point expires;
+        std::list<std::string>::iterator order;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    // Oldest first
+    std::list<std::string> m_order;
+    std::size_t m_capacity;
+
+    void erase(const std::unordered_map<std::string, Entry>::iterator it) {
+        m_order.erase(it->second.order);
+        m_entries.erase(it);
+    }
+
+public:
+    explicit TlsSessionCache(const std::size_t capacity): m_capacity { capacity } {}
+
+    void store(std::string id, std::string session, const std::chrono::seconds lifetime) {
+        std::lock_guard lock { m_mutex };
+        if (m_capacity == 0) {
+            return;
+        }
+        if (const auto it = m_entries.find(id); it != m_entries.end()) {
+            erase(it);
+        }
+        while (m_entries.size() >= m_capacity) {
+            erase(m_entries.find(m_order.front()));
+        }
+        m_order.push_back(id);
+        m_entries.emplace(std::move(id), Entry { std::move(session), Clock::now() + lifetime, std::prev(m_order.end()) });
+    }
+
+    // Empty when the session is unknown or expired
+    [[nodiscard]] std::string find(const std::string& id) {
+        std::lock_guard lock { m_mutex };
+        const auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            return {};
+        }
+        if (it->second.expires < Clock::now()) {
+            erase(it);
+            return {};
+        }
+        return it->second.session;
+    }
+
+    void remove(const std::string& id) {
+        std::lock_guard lock { m_mutex };
+        if (const auto it = m_entries.find(id); it != m_entries.end()) {
+            erase(it);
+        }
+    }
+};
+
+// The SSL contexts of one handler, one per worker thread
+// An SSL_CTX is shared state that every handshake touches, so each worker gets its own, all created up front.
+// Threads outside the pool share the first one.
+// Resumption works across threads anyway: every context uses the same ticket keys and stores sessions in the
+// same external cache instead of its internal one.
+class TlsServerContext final {
+    TcpTls m_config;
+    std::array<unsigned char, 80> m_ticket_keys {};
+    TlsSessionCache m_cache;
+    std::error_code m_error;
+    std::vector<std::unique_ptr<asio::ssl::context>> m_contexts;
+
+    // The app data of an SSL_CTX belongs to asio, which keeps its verify callback there
+    static int ex_data_index() {
+        static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    static TlsServerContext& of(SSL_CTX* context) {
+        return *static_cast<TlsServerContext*>(SSL_CTX_get_ex_data(context, ex_data_index()));
+    }
+
+    static std::string id_of(const SSL_SESSION* session) {
+        unsigned int length = 0;
+        const auto* id = SSL_SESSION_get_id(session, &length);
+        return { reinterpret_cast<const char*>(id), length };
+    }
+
+    static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+        const auto size = i2d_SSL_SESSION(session, nullptr);
+        if (size <= 0) {
+            return 0;
+        }
+        std::string encoded(static_cast<std::size_t>(size), '\0');
+        auto* out = reinterpret_cast<unsigned char*>(encoded.data());
+        i2d_SSL_SESSION(session, &out);
+        auto& self = of(SSL_get_SSL_CTX(ssl));
+        self.m_cache.store(id_of(session), std::move(encoded), self.m_config.session_lifetime);
+        // The cache keeps its own copy, OpenSSL may free the session
+        return 0;
+    }
+
+    static SSL_SESSION* on_get_session(SSL* ssl, const unsigned char* id, const int length, int* copy) {
+        *copy = 0;
+        const auto encoded = of(SSL_get_SSL_CTX(ssl)).m_cache.find({ reinterpret_cast<const char*>(id), static_cast<std::size_t>(length) });
+        if (encoded.empty()) {
+            return nullptr;
+        }
+        const auto* in = reinterpret_cast<const unsigned char*>(encoded.data());
+        return d2i_SSL_SESSION(nullptr, &in, static_cast<long>(encoded.size()));
+    }
+
+    static void on_remove_session(SSL_CTX* context, SSL_SESSION* session) {
+        of(context).m_cache.remove(id_of(session));
+    }
+
+    std::error_code configure(asio::ssl::context& context) {
+        std::error_code ec;
+        ec = context.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 |
+                                 asio::ssl::context::no_sslv3 | asio::ssl::context::no_tlsv1 |
+                                 asio::ssl::context::no_tlsv1_1, ec);
+        if (!ec) {
+            ec = context.use_certificate_chain_file(m_config.certificate_chain_file, ec);
+        }
+        if (!ec) {
+            ec = context.use_private_key_file(m_config.private_key_file, asio::ssl::context::pem, ec);
+        }
+        if (ec) {
+            return ec;
+        }
+        auto* native = context.native_handle();
+        SSL_CTX_set_ex_data(native, ex_data_index(), this);
+        static constexpr unsigned char id_context[] = "lumengine";
+        SSL_CTX_set_session_id_context(native, id_context, sizeof(id_context) - 1);
+        SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_set_timeout(native, static_cast<long>(m_config.session_lifetime.count()));
+        SSL_CTX_sess_set_new_cb(native, &on_new_session);
+        SSL_CTX_sess_set_get_cb(native, &on_get_session);
+        SSL_CTX_sess_set_remove_cb(native, &on_remove_session);
+        if (m_config.tickets) {
+            SSL_CTX_set_tlsext_ticket_keys(native, m_ticket_keys.data(), static_cast<long>(m_ticket_keys.size()));
+        } else {
+            SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+        }
+        return {};
+    }
+
+public:
+    TlsServerContext(const TcpTls& config, const std::size_t worker_count):
+        m_config { config },
+        m_cache { config.session_cache_size } {
+        if (RAND_bytes(m_ticket_keys.data(), static_cast<int>(m_ticket_keys.size())) != 1) {
+            m_error = std::make_error_code(std::errc::io_error);
+            return;
+        }
+        // A broken certificate or key is found here, before the first handshake
+        m_contexts.reserve(worker_count + 1);
+        for (std::size_t i = 0; i < worker_count + 1 && !m_error; ++i) {
+            m_contexts.push_back(std::make_unique<asio::ssl::context>(asio::ssl::context::tls_server));
+            m_error = configure(*m_contexts.back());
+        }
+    }
+
+    TlsServerContext(const TlsServerContext&) = delete;
+    TlsServerContext& operator=(const TlsServerContext&) = delete;
+
+    // Why the certificate, the key or the ticket keys could not be set up
+    [[nodiscard]] std::error_code error() const noexcept {
+        return m_error;
+    }
+
+    // The context of the calling worker. Only valid without an error.
+    [[nodiscard]] asio::ssl::context& context() const noexcept {
+        const auto worker = IoWorker::current();
+        return *m_contexts[worker ? 1 + worker->index() % (m_contexts.size() - 1) : 0];
+    }
+
+    static std::shared_ptr<TlsServerContext> shared(const TcpTls& config, const std::size_t worker_count) {
+        return std::make_shared<TlsServerContext>(config, worker_count);
+    }
+};
+
+using TlsServerContextPtr = std::shared_ptr<TlsServerContext>;
+
+#endif
+
+#endif //LE_TLS_HPP
@@ -0,0 +1,306 @@
+#ifndef LE_TRACE_HPP
+#define LE_TRACE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "callback_profiler.hpp"
+
+enum class TraceEvent : std::uint8_t {
+    Accept,
+    Connect,
+    ReadIssued,
+    ReadCompleted,
+    WriteIssued,
+    WriteCompleted,
+    // The value is the HandlerType
+    CallbackEnter,
+    CallbackExit,
+    WorkloadScheduled,
+    WorkloadRun,
+    TimerFired,
+};
+
+inline const char* trace_event_name(const TraceEvent event) {
+    switch (event) {
+        case TraceEvent::Accept: return "accept";
+        case TraceEvent::Connect: return "connect";
+        case TraceEvent::ReadIssued:
+        case TraceEvent::ReadCompleted: return "read";
+        case TraceEvent::WriteIssued:
+        case TraceEvent::WriteCompleted: return "write";
+        case TraceEvent::CallbackEnter:
+        case TraceEvent::CallbackExit: return "callback";
+        case TraceEvent::WorkloadScheduled: return "workload scheduled";
+        case TraceEvent::WorkloadRun: return "workload run";
+        case TraceEvent::TimerFired: return "timer fired";
+    }
+    return "unknown";
+}
+
+// Raw timestamp counter: TSC on x86, the virtual counter on ARM64, steady clock nanoseconds elsewhere
+inline std::uint64_t trace_clock() noexcept {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+#endif
+}
+
+struct TraceRecord {
+    std::uint64_t timestamp;
+    // Session, handler or workload the event belongs to
+    const void* object;
+    // Bytes for completions, error value for accepts, HandlerType for callbacks
+    std::uint64_t value;
+    TraceEvent event;
+};
+
+// Process wide event tracer with ring buffers of events
+// A thread records into its own ring once it is attached. Pool workers attach when the pool starts tracing, other
+// threads can attach themselves. Events of threads without a ring go to one ring they share, which is created
+// by the first start. Recording never allocates: it is a timestamp read and relaxed stores into a slot, guarded
+// by a sequence number so that an export running at the same time skips slots that are being written. When a
+// ring is full the oldest events are overwritten. Rings of threads that exited are kept for the export until the
+// next start. A disabled tracer costs one relaxed load and a branch per event.
+class Tracer final {
+    struct Slot {
+        // The index of the event plus one once the slot is written, zero while it is being written
+        std::atomic<std::uint64_t> sequence { 0 };
+        std::atomic<std::uint64_t> timestamp { 0 };
+        std::atomic<const void*> object { nullptr };
+        std::atomic<std::uint64_t> value { 0 };
+        std::atomic<TraceEvent> event { TraceEvent::Accept };
+    };
+
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        std::size_t mask;
+        std::atomic<std::uint64_t> head { 0 };
+        std::string name;
+        int id;
+        // Written by every thread without a ring of its own
+        bool shared;
+        // Set once no thread writes the ring any more
+        std::atomic<bool> retired { false };
+
+        Ring(const std::size_t capacity, std::string thread_name, const int thread_id, const bool shared_ring):
+            slots { std::make_unique<Slot[]>(capacity) },
+            mask { capacity - 1 },
+            name { std::move(thread_name) },
+            id { thread_id },
+            shared { shared_ring } {}
+    };
+
+    // The ring of the calling thread, retired when the thread exits
+    struct ThreadRing {
+        std::shared_ptr<Ring> ring;
+
+        ~ThreadRing() {
+            if (ring) {
+                ring->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    std::atomic<bool> m_enabled { false };
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<Ring>> m_rings;
+    std::atomic<Ring*> m_shared_ring { nullptr };
+    int m_next_id { 0 };
+    std::size_t m_capacity { std::size_t { 1 } << 16 };
+    // Pairs of counter ticks and steady clock time, used to convert ticks to time on export
+    std::uint64_t m_start_ticks { 0 };
+    std::chrono::steady_clock::time_point m_start_time {};
+
+    static ThreadRing& thread_ring() noexcept {
+        static thread_local ThreadRing ring;
+        return ring;
+    }
+
+    // Copies the event at the index, false when it was overwritten or is being written
+    static bool read(const Ring& ring, const std::uint64_t index, TraceRecord& record) {
+        const auto& slot = ring.slots[index & ring.mask];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != index + 1) {
+            return false;
+        }
+        record = {
+            slot.timestamp.load(std::memory_order_relaxed),
+            slot.object.load(std::memory_order_relaxed),
+            slot.value.load(std::memory_order_relaxed),
+            slot.event.load(std::memory_order_relaxed),
+        };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    static void append_event(std::string& json, const char* name, const char* phase, const int tid,
+                             const double ts, const TraceRecord& record, const char* category) {
+        char line[320];
+        std::snprintf(line, sizeof(line),
+            "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+            "\"id\":\"%p\",\"args\":{\"object\":\"%p\",\"value\":%llu}%s}",
+            json.back() == '[' ? "" : ",\n",
+            name, category, phase, tid, ts, record.object, record.object,
+            static_cast<unsigned long long>(record.value),
+            phase[0] == 'i' ? ",\"s\":\"t\"" : "");
+        json += line;
+    }
+
+public:
+    static Tracer& instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Starts recording, events recorded before are left out of the export. The capacity is rounded up to a power
+    // of two and applies to rings created from now on. Rings of threads that exited are dropped.
+    void start(const std::size_t events_per_thread = std::size_t { 1 } << 16) {
+        std::lock_guard lock { m_mutex };
+        m_capacity = std::bit_ceil(std::max<std::size_t>(events_per_thread, 2));
+        std::erase_if(m_rings, [](const auto& ring) { return ring->retired.load(std::memory_order_acquire); });
+        if (!m_shared_ring.load(std::memory_order_relaxed)) {
+            m_rings.push_back(std::make_shared<Ring>(m_capacity, "other threads", m_next_id++, true));
+            m_shared_ring.store(m_rings.back().get(), std::memory_order_release);
+        }
+        m_start_ticks = trace_clock();
+        m_start_time = std::chrono::steady_clock::now();
+        m_enabled.store(true, std::memory_order_release);
+    }
+
+    void stop() {
+        m_enabled.store(false, std::memory_order_release);
+    }
+
+    // Gives the calling thread a ring of its own, allocated here so that recording does not allocate. The ring is
+    // first touched by the thread, which places it on the thread's NUMA node. A ring of an earlier capacity is
+    // replaced.
+    void attach_current_thread(std::string name) {
+        auto& current = thread_ring();
+        std::lock_guard lock { m_mutex };
+        if (current.ring && current.ring->mask + 1 == m_capacity) {
+            return;
+        }
+        if (current.ring) {
+            current.ring->retired.store(true, std::memory_order_release);
+        }
+        current.ring = std::make_shared<Ring>(m_capacity, std::move(name), m_next_id++, false);
+        m_rings.push_back(current.ring);
+    }
+
+    // Events of threads without a ring are dropped until the first start
+    void record(const TraceEvent event, const void* object, const std::uint64_t value) noexcept {
+        auto* ring = thread_ring().ring.get();
+        if (!ring) {
+            ring = m_shared_ring.load(std::memory_order_acquire);
+            if (!ring) {
+                return;
+            }
+        }
+        const auto index = ring->shared ? ring->head.fetch_add(1, std::memory_order_relaxed)
+                                         : ring->head.load(std::memory_order_relaxed);
+        auto& slot = ring->slots[index & ring->mask];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.timestamp.store(trace_clock(), std::memory_order_relaxed);
+        slot.object.store(object, std::memory_order_relaxed);
+        slot.value.store(value, std::memory_order_relaxed);
+        slot.event.store(event, std::memory_order_relaxed);
+        slot.sequence.store(index + 1, std::memory_order_release);
+        if (!ring->shared) {
+            ring->head.store(index + 1, std::memory_order_release);
+        }
+    }
+
+    // Chrome trace event format, loads in chrome://tracing and Perfetto
+    // Safe while tracing, events that are overwritten or written during the export are left out.
+    [[nodiscard]] std::string chrome_trace_json() const {
+        std::lock_guard lock { m_mutex };
+        const auto end_ticks = trace_clock();
+        const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start_time).count();
+        const auto ticks = static_cast<double>(end_ticks - m_start_ticks);
+        const auto us_per_tick = ticks > 0 ? elapsed / ticks : 0.0;
+
+        std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        char line[160];
+        for (const auto& ring : m_rings) {
+            std::snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                json.back() == '[' ? "" : ",\n", ring->id, ring->name.c_str());
+            json += line;
+            const auto head = ring->head.load(std::memory_order_acquire);
+            const auto count = std::min<std::uint64_t>(head, ring->mask + 1);
+            for (auto i = head - count; i < head; ++i) {
+                TraceRecord record;
+                if (!read(*ring, i, record) || record.timestamp < m_start_ticks) {
+                    continue;
+                }
+                const auto ts = static_cast<double>(record.timestamp - m_start_ticks) * us_per_tick;
+                switch (record.event) {
+                    case TraceEvent::ReadIssued:
+                    case TraceEvent::WriteIssued:
+                        append_event(json, trace_event_name(record.event), "b", ring->id, ts, record, "io");
+                        break;
+                    case TraceEvent::ReadCompleted:
+                    case TraceEvent::WriteCompleted:
+                        append_event(json, trace_event_name(record.event), "e", ring->id, ts, record, "io");
+                        break;
+                    case TraceEvent::CallbackEnter:
+                        append_event(json, handler_type_name(static_cast<HandlerType>(record.value)), "B", ring->id, ts, record, "callback");
+                        break;
+                    case TraceEvent::CallbackExit:
+                        append_event(json, handler_type_name(static_cast<HandlerType>(record.value)), "E", ring->id, ts, record, "callback");
+                        break;
+                    default:
+                        append_event(json, trace_event_name(record.event), "i", ring->id, ts, record, "event");
+                }
+            }
+        }
+        json += "]}\n";
+        return json;
+    }
+
+    bool write_chrome_trace(const std::string& path) const {
+        std::ofstream file { path };
+        if (!file) {
+            return false;
+        }
+        file << chrome_trace_json();
+        return static_cast<bool>(file);
+    }
+};
+
+// Records an event on the calling thread when tracing is on
+// Building with LE_DISABLE_TRACING removes every trace point.
+inline void trace(const TraceEvent event, const void* object, const std::uint64_t value = 0) noexcept {
+#if !defined(LE_DISABLE_TRACING)
+    if (auto& tracer = Tracer::instance(); tracer.enabled()) [[unlikely]] {
+        tracer.record(event, object, value);
+    }
+#endif
+}
+
+#endif //LE_TRACE_HPP
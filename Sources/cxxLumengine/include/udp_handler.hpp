@@ -2,11 +2,20 @@
 #define LE_UDP_HANDLER_HPP
 
 #include <cxxAsio.hpp>
+#include <concepts>
 #include "buffer.hpp"
+#include "callback_profiler.hpp"
+#include "io_worker.hpp"
+#include "metrics.hpp"
 #include "swift_function_wrapper.hpp"
+#include "trace.hpp"
 #include "variant_wrapper.hpp"
 
-class UdpHandler;
+template<typename Config>
+class BasicUdpHandler;
+struct UdpConfig;
+// Handler driven by Swift closures. C++ code can instantiate the template with its own config, see UdpCallbacks.
+using UdpHandler = BasicUdpHandler<UdpConfig>;
 using UdpHandlerPtr = std::shared_ptr<UdpHandler>;
 
 struct UDPReadCommand {};
@@ -24,56 +33,97 @@ struct UdpConfig {
     SwiftFunctionWrapper<void, UdpHandlerPtr> on_start;
     SwiftFunctionWrapper<void, UdpHandlerPtr> on_stop;
 };
+// Completions of a stopped handler still run after its server is gone, so the handler shares the config
+using UdpConfigPtr = std::shared_ptr<const UdpConfig>;
 
-class UdpHandler final : public std::enable_shared_from_this<UdpHandler> {
-    const UdpConfig& m_config;
+// Same contract as TcpCallbacks, for datagram handlers
+template<typename Config>
+concept UdpCallbacks = requires(
+    const Config& config,
+    const std::shared_ptr<BasicUdpHandler<Config>>& handler,
+    const std::error_code& ec,
+    const std::size_t bytes,
+    const asio::ip::udp::endpoint& endpoint
+) {
+    { config.read_buffer_size } -> std::convertible_to<std::size_t>;
+    { config.on_receive(handler, ec, bytes, endpoint) } -> std::convertible_to<UDPCommandVariant>;
+    { config.on_write(handler, ec, bytes) } -> std::convertible_to<UDPCommandVariant>;
+    config.on_start(handler);
+    config.on_stop(handler);
+};
+
+template<typename Config>
+class BasicUdpHandler final : public std::enable_shared_from_this<BasicUdpHandler<Config>> {
+    using ConfigPtr = std::shared_ptr<const Config>;
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
     asio::strand<asio::any_io_executor> m_strand;
     asio::ip::udp::socket m_socket;
     Buffer m_read_buffer;
+    // Owns the datagram in flight, the command that carried it is gone once the callback returns
+    Buffer m_write_buffer;
     asio::ip::udp::endpoint m_sender_endpoint;
     int m_port;
 
-    void handle_command(const UDPCommandVariant &command) {
+    void handle_command(UDPCommandVariant command) {
         command.visit_all_cases(
-            [this](const UDPReadCommand&) { read(); },
-            [this](const UDPWriteCommand& cmd) { write(cmd.buffer, cmd.endpoint); }
+            [this](const UDPReadCommand&) {
+                // A stopped handler reports the aborted receive, reading again would fail forever
+                if (m_socket.is_open()) {
+                    read();
+                }
+            },
+            [this](UDPWriteCommand& cmd) { write(std::move(cmd.buffer), cmd.endpoint); }
         );
     }
 
     void read() {
+        trace(TraceEvent::ReadIssued, this);
         m_socket.async_receive_from(
             asio::buffer(m_read_buffer.pointer(), m_read_buffer.size()),
             m_sender_endpoint,
-            bind_executor(m_strand, [this](std::error_code ec, size_t bytes_transferred) {
-                const auto command = m_config.on_receive.call(
-                    shared_from_this(),
-                    ec,
-                    bytes_transferred,
-                    m_sender_endpoint
-                );
-                handle_command(command);
+            bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec, size_t bytes_transferred) {
+                trace(TraceEvent::ReadCompleted, this, bytes_transferred);
+                if (!ec) {
+                    m_metrics->add(MetricCounter::UdpDatagramsIn);
+                    m_metrics->add(MetricCounter::UdpBytesIn, bytes_transferred);
+                } else if (ec != asio::error::operation_aborted) {
+                    m_metrics->add(MetricCounter::UdpReceiveErrors);
+                }
+                handle_command(m_metrics->time_callback(HandlerType::UpdOnReceive, this, [&] {
+                    return m_config->on_receive(self, ec, bytes_transferred, m_sender_endpoint);
+                }));
             })
         );
     }
 
-    void write(const Buffer& data, const asio::ip::udp::endpoint& endpoint) {
+    void write(Buffer data, const asio::ip::udp::endpoint& endpoint) {
+        m_write_buffer = std::move(data);
+        trace(TraceEvent::WriteIssued, this, m_write_buffer.size());
         m_socket.async_send_to(
-            asio::buffer(data.pointer(), data.size()),
+            asio::buffer(m_write_buffer.pointer(), m_write_buffer.size()),
             endpoint,
-            bind_executor(m_strand, [this](std::error_code ec, size_t bytes_transferred) {
-                const auto command = m_config.on_write.call(
-                    shared_from_this(),
-                    ec,
-                    bytes_transferred
-                );
-                handle_command(command);
+            bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec, size_t bytes_transferred) {
+                trace(TraceEvent::WriteCompleted, this, bytes_transferred);
+                if (!ec) {
+                    m_metrics->add(MetricCounter::UdpDatagramsOut);
+                    m_metrics->add(MetricCounter::UdpBytesOut, bytes_transferred);
+                } else if (ec != asio::error::operation_aborted) {
+                    m_metrics->add(MetricCounter::UdpSendErrors);
+                }
+                handle_command(m_metrics->time_callback(HandlerType::UpdOnWrite, this, [&] {
+                    return m_config->on_write(self, ec, bytes_transferred);
+                }));
             })
         );
     }
 
 public:
-    UdpHandler(asio::io_context& io_context, const UdpConfig& config, int const port, const bool v6 = false):
-        m_config { config },
+    BasicUdpHandler(asio::io_context& io_context, ConfigPtr config, MetricsPtr metrics,
+                    int const port, const bool v6 = false):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
         m_strand { asio::make_strand(io_context) },
         m_socket {
             io_context,
@@ -82,7 +132,7 @@ public:
                 port
             )
         },
-        m_read_buffer { config.read_buffer_size },
+        m_read_buffer { m_config->read_buffer_size },
         m_port { port } {}
 
     [[nodiscard]] int port() const {
@@ -90,13 +140,31 @@ public:
     }
 
     void start() {
-        m_config.on_start.call(shared_from_this());
+        static_assert(UdpCallbacks<Config>, "The config does not provide the UDP callbacks");
+        m_metrics->time_callback(HandlerType::UdpOnStart, this, [this] {
+            m_config->on_start(this->shared_from_this());
+        });
         read();
     }
 
+    // Holds the last received datagram, valid until the next read is issued
+    [[nodiscard]] const Buffer& read_buffer() const {
+        return m_read_buffer;
+    }
+
+    // The socket is closed on the handler strand, so it never races a completion
+    // Runs on the handler strand, or right away when the pool is destroyed with the server, see post_or_run
     void stop() {
-        m_socket.close();
-        m_config.on_stop.call(shared_from_this());
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            if (!self->m_socket.is_open()) {
+                return;
+            }
+            std::error_code ec;
+            ec = self->m_socket.close(ec);
+            self->m_metrics->time_callback(HandlerType::UdpOnStop, self.get(), [&self] {
+                self->m_config->on_stop(self);
+            });
+        });
     }
 };
 
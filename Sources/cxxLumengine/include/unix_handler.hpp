@@ -0,0 +1,832 @@
+#ifndef LE_UNIX_HANDLER_HPP
+#define LE_UNIX_HANDLER_HPP
+
+#include <cxxAsio.hpp>
+#include <cerrno>
+#include <concepts>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "buffer.hpp"
+#include "callback_profiler.hpp"
+#include "custom_error_code.hpp"
+#include "io_worker.hpp"
+#include "metrics.hpp"
+#include "sparse_vector.hpp"
+#include "swift_function_wrapper.hpp"
+#include "trace.hpp"
+#include "variant_wrapper.hpp"
+
+// Unix domain sockets, for IPC with local processes without the TCP/IP stack
+// Stream handlers accept sessions like TcpHandler, datagram handlers receive like UdpHandler. Both can pass file
+// descriptors (SCM_RIGHTS) along with the bytes. Their counters are the TCP and UDP ones of the handler metrics.
+// A server of either kind still has a port, it only names the server, e.g. to stop it or to read its metrics.
+
+template<typename Config>
+class BasicUnixStreamSession;
+template<typename Config>
+class BasicUnixStreamHandler;
+template<typename Config>
+class BasicUnixDatagramHandler;
+struct UnixStreamConfig;
+struct UnixDatagramConfig;
+// Handlers driven by Swift closures. C++ code can instantiate the templates with its own config, see
+// UnixStreamCallbacks and UnixDatagramCallbacks.
+using UnixStreamSession = BasicUnixStreamSession<UnixStreamConfig>;
+using UnixStreamHandler = BasicUnixStreamHandler<UnixStreamConfig>;
+using UnixDatagramHandler = BasicUnixDatagramHandler<UnixDatagramConfig>;
+using UnixStreamSessionPtr = std::shared_ptr<UnixStreamSession>;
+using UnixStreamHandlerPtr = std::shared_ptr<UnixStreamHandler>;
+using UnixDatagramHandlerPtr = std::shared_ptr<UnixDatagramHandler>;
+
+struct UnixReadCommand {};
+// The session owns the descriptors and closes them once they are sent, the peer receives duplicates.
+// They go out with the first byte of the buffer, which must not be empty.
+struct UnixWriteCommand {
+    Buffer buffer;
+    std::vector<int> fds;
+};
+struct UnixCloseCommand {};
+// Leaves the session without a pending operation until resume() hands it a command or it is closed
+struct UnixHoldCommand {};
+using UnixStreamCommand = std::variant<UnixReadCommand, UnixWriteCommand, UnixCloseCommand, UnixHoldCommand>;
+using UnixStreamCommandVariant = VariantWrapper<UnixStreamCommand>;
+
+struct UnixDatagramReadCommand {};
+// Descriptors are owned and closed like those of UnixWriteCommand
+struct UnixDatagramWriteCommand {
+    Buffer buffer;
+    asio::local::datagram_protocol::endpoint endpoint;
+    std::vector<int> fds;
+};
+using UnixDatagramCommand = std::variant<UnixDatagramReadCommand, UnixDatagramWriteCommand>;
+using UnixDatagramCommandVariant = VariantWrapper<UnixDatagramCommand>;
+
+struct UnixStreamConfig {
+    uint read_buffer_size { 16 * 1024 };
+    uint pre_allocated_session_count { 128 };
+    SwiftFunctionWrapper<UnixStreamCommandVariant, UnixStreamSessionPtr, std::error_code> on_connect;
+    SwiftFunctionWrapper<UnixStreamCommandVariant, UnixStreamSessionPtr, std::error_code, size_t> on_receive;
+    SwiftFunctionWrapper<UnixStreamCommandVariant, UnixStreamSessionPtr, std::error_code, size_t> on_write;
+    SwiftFunctionWrapper<void, UnixStreamSessionPtr, std::error_code> on_disconnect;
+    SwiftFunctionWrapper<void, UnixStreamHandlerPtr> on_start;
+    SwiftFunctionWrapper<void, UnixStreamHandlerPtr> on_stop;
+    // A filesystem path, or a name in the abstract namespace (Linux only), which has no file
+    std::string path;
+    bool abstract_namespace { false };
+    // Descriptors accepted with one read, see UnixStreamSession::received_fds(). Zero reads bytes only, the
+    // kernel closes descriptors sent along. A read that brought more is reported to on_receive as message_size.
+    uint max_received_fds { 0 };
+};
+using UnixStreamConfigPtr = std::shared_ptr<const UnixStreamConfig>;
+
+struct UnixDatagramConfig {
+    uint read_buffer_size { 16 * 1024 };
+    SwiftFunctionWrapper<UnixDatagramCommandVariant, UnixDatagramHandlerPtr, std::error_code, size_t, asio::local::datagram_protocol::endpoint> on_receive;
+    SwiftFunctionWrapper<UnixDatagramCommandVariant, UnixDatagramHandlerPtr, std::error_code, size_t> on_write;
+    SwiftFunctionWrapper<void, UnixDatagramHandlerPtr> on_start;
+    SwiftFunctionWrapper<void, UnixDatagramHandlerPtr> on_stop;
+    std::string path;
+    bool abstract_namespace { false };
+    uint max_received_fds { 0 };
+};
+using UnixDatagramConfigPtr = std::shared_ptr<const UnixDatagramConfig>;
+
+// Same contract as TcpSessionCallbacks, plus the address of the listening socket
+template<typename Config>
+concept UnixStreamSessionCallbacks = requires(
+    const Config& config,
+    const std::shared_ptr<BasicUnixStreamSession<Config>>& session,
+    const std::error_code& ec,
+    const std::size_t bytes
+) {
+    { config.read_buffer_size } -> std::convertible_to<std::size_t>;
+    { config.max_received_fds } -> std::convertible_to<std::size_t>;
+    { config.on_connect(session, ec) } -> std::convertible_to<UnixStreamCommandVariant>;
+    { config.on_receive(session, ec, bytes) } -> std::convertible_to<UnixStreamCommandVariant>;
+    { config.on_write(session, ec, bytes) } -> std::convertible_to<UnixStreamCommandVariant>;
+    config.on_disconnect(session, ec);
+};
+
+template<typename Config>
+concept UnixStreamCallbacks = UnixStreamSessionCallbacks<Config> && requires(
+    const Config& config,
+    const std::shared_ptr<BasicUnixStreamHandler<Config>>& handler
+) {
+    { config.pre_allocated_session_count } -> std::convertible_to<std::size_t>;
+    { config.path } -> std::convertible_to<std::string>;
+    { config.abstract_namespace } -> std::convertible_to<bool>;
+    config.on_start(handler);
+    config.on_stop(handler);
+};
+
+// Same contract as UdpCallbacks
+template<typename Config>
+concept UnixDatagramCallbacks = requires(
+    const Config& config,
+    const std::shared_ptr<BasicUnixDatagramHandler<Config>>& handler,
+    const std::error_code& ec,
+    const std::size_t bytes,
+    const asio::local::datagram_protocol::endpoint& endpoint
+) {
+    { config.read_buffer_size } -> std::convertible_to<std::size_t>;
+    { config.max_received_fds } -> std::convertible_to<std::size_t>;
+    { config.path } -> std::convertible_to<std::string>;
+    { config.abstract_namespace } -> std::convertible_to<bool>;
+    { config.on_receive(handler, ec, bytes, endpoint) } -> std::convertible_to<UnixDatagramCommandVariant>;
+    { config.on_write(handler, ec, bytes) } -> std::convertible_to<UnixDatagramCommandVariant>;
+    config.on_start(handler);
+    config.on_stop(handler);
+};
+
+namespace unix_socket {
+    template<typename Protocol>
+    typename Protocol::endpoint endpoint(const std::string& path, const bool abstract_namespace) {
+        if (!abstract_namespace) {
+            return typename Protocol::endpoint { path };
+        }
+#if defined(__linux__)
+        // A leading NUL byte puts the name into the abstract namespace
+        std::string name(1, '\0');
+        name += path;
+        return typename Protocol::endpoint { name };
+#else
+        throw std::system_error(std::make_error_code(std::errc::operation_not_supported), "abstract Unix socket");
+#endif
+    }
+
+    // The file a socket was bound to. A server only removes its own file, not one that replaced it.
+    struct SocketFile {
+        dev_t device { 0 };
+        ino_t inode { 0 };
+    };
+
+    inline SocketFile socket_file(const std::string& path, const bool abstract_namespace) noexcept {
+        struct stat status {};
+        if (abstract_namespace || ::lstat(path.c_str(), &status) != 0 || !S_ISSOCK(status.st_mode)) {
+            return {};
+        }
+        return { status.st_dev, status.st_ino };
+    }
+
+    // Removes a socket file left by an earlier run, which refuses connections. The file of a live server and
+    // other files are kept, so bind reports them. The probe does not block, a full backlog counts as live.
+    inline void remove_stale(const std::string& path, const bool abstract_namespace, const int type) noexcept {
+        sockaddr_un address {};
+        if (socket_file(path, abstract_namespace).inode == 0 || path.size() >= sizeof(address.sun_path)) {
+            return;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.data(), path.size());
+        const int probe = ::socket(AF_UNIX, type, 0);
+        if (probe < 0) {
+            return;
+        }
+        ::fcntl(probe, F_SETFL, ::fcntl(probe, F_GETFL) | O_NONBLOCK);
+        const bool refused = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 &&
+                             errno == ECONNREFUSED;
+        ::close(probe);
+        if (refused) {
+            ::unlink(path.c_str());
+        }
+    }
+
+    // Removes the file the socket was bound to, unless another server has bound the path since
+    inline void remove_bound(const std::string& path, const bool abstract_namespace, const SocketFile& bound) noexcept {
+        const auto current = socket_file(path, abstract_namespace);
+        if (bound.inode != 0 && current.inode == bound.inode && current.device == bound.device) {
+            ::unlink(path.c_str());
+        }
+    }
+
+    inline void close_all(std::vector<int>& fds) noexcept {
+        for (const auto fd : fds) {
+            ::close(fd);
+        }
+        fds.clear();
+    }
+
+    // Control buffer for up to max_fds descriptors
+    inline std::vector<char> control_buffer(const std::size_t max_fds) {
+        return std::vector<char>(max_fds == 0 ? 0 : CMSG_SPACE(max_fds * sizeof(int)));
+    }
+
+    // Non-blocking recvmsg. Appends the descriptors that came with the bytes, would_block when nothing is ready.
+    // More descriptors than the control buffer holds are closed by the kernel, which is reported as message_size
+    // with the bytes and the descriptors that did arrive.
+    inline std::size_t receive(const int socket, void* data, const std::size_t size, std::vector<char>& control,
+                               std::vector<int>& fds, sockaddr* sender, socklen_t* sender_size, std::error_code& ec) {
+        iovec vector { data, size };
+        msghdr message {};
+        message.msg_name = sender;
+        message.msg_namelen = sender_size ? *sender_size : 0;
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+        int flags = MSG_DONTWAIT;
+#if defined(MSG_CMSG_CLOEXEC)
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        const auto received = ::recvmsg(socket, &message, flags);
+        if (received < 0) {
+            ec = errno == EAGAIN || errno == EWOULDBLOCK
+                ? make_error_code(asio::error::would_block)
+                : std::error_code { errno, std::system_category() };
+            return 0;
+        }
+        if (sender_size) {
+            *sender_size = message.msg_namelen;
+        }
+        for (auto* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            const auto count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const auto* received_fds = reinterpret_cast<const unsigned char*>(CMSG_DATA(header));
+            for (std::size_t i = 0; i < count; ++i) {
+                int fd;
+                std::memcpy(&fd, received_fds + i * sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+        ec = message.msg_flags & MSG_CTRUNC ? make_error_code(asio::error::message_size) : std::error_code {};
+        return static_cast<std::size_t>(received);
+    }
+
+    // Non-blocking sendmsg with the descriptors attached, would_block when the socket is full
+    inline std::size_t send(const int socket, const void* data, const std::size_t size, const std::vector<int>& fds,
+                            const sockaddr* target, const socklen_t target_size, std::error_code& ec) {
+        iovec vector { const_cast<void*>(data), size };
+        msghdr message {};
+        message.msg_name = const_cast<sockaddr*>(target);
+        message.msg_namelen = target_size;
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        std::vector<char> control(CMSG_SPACE(fds.size() * sizeof(int)));
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+        auto* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+        std::memcpy(CMSG_DATA(header), fds.data(), fds.size() * sizeof(int));
+        int flags = MSG_DONTWAIT;
+#if defined(MSG_NOSIGNAL)
+        flags |= MSG_NOSIGNAL;
+#endif
+        const auto sent = ::sendmsg(socket, &message, flags);
+        if (sent < 0) {
+            ec = errno == EAGAIN || errno == EWOULDBLOCK
+                ? make_error_code(asio::error::would_block)
+                : std::error_code { errno, std::system_category() };
+            return 0;
+        }
+        ec = {};
+        return static_cast<std::size_t>(sent);
+    }
+}
+
+template<typename Config>
+class BasicUnixStreamSession final : public std::enable_shared_from_this<BasicUnixStreamSession<Config>> {
+    using SessionPtr = std::shared_ptr<BasicUnixStreamSession>;
+    using ConfigPtr = std::shared_ptr<const Config>;
+    using Socket = asio::local::stream_protocol::socket;
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
+    Socket m_socket;
+    asio::strand<asio::any_io_executor> m_strand;
+    Buffer m_read_buffer;
+    Buffer m_write_buffer;
+    std::vector<char> m_control;
+    // Owned by the session until taken, closed when the next read is issued
+    std::vector<int> m_received_fds;
+    // Owned until sent
+    std::vector<int> m_write_fds;
+    std::function<void()> m_clean_up;
+    std::shared_ptr<void> m_context;
+
+    void handle_command(UnixStreamCommandVariant command) {
+        command.visit_all_cases(
+            [this](const UnixReadCommand&) { read(); },
+            [this](UnixWriteCommand& cmd) { write(std::move(cmd.buffer), std::move(cmd.fds)); },
+            [this](const UnixCloseCommand&) { disconnect(); },
+            [](const UnixHoldCommand&) {}
+        );
+    }
+
+    void read() {
+        unix_socket::close_all(m_received_fds);
+        trace(TraceEvent::ReadIssued, this);
+        if (m_control.empty()) {
+            m_socket.async_read_some(asio::buffer(m_read_buffer.pointer(), m_read_buffer.size()),
+                bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec, const size_t bytes_transferred) {
+                    received(self, ec, bytes_transferred);
+                })
+            );
+            return;
+        }
+        // Descriptors only arrive through recvmsg, so the reactor only reports readiness
+        m_socket.async_wait(Socket::wait_read,
+            bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec) {
+                std::size_t bytes_transferred = 0;
+                if (!ec) {
+                    bytes_transferred = unix_socket::receive(m_socket.native_handle(), m_read_buffer.pointer(),
+                        m_read_buffer.size(), m_control, m_received_fds, nullptr, nullptr, ec);
+                    if (ec == asio::error::would_block) {
+                        read();
+                        return;
+                    }
+                    if (!ec && bytes_transferred == 0) {
+                        ec = asio::error::eof;
+                    }
+                }
+                received(self, ec, bytes_transferred);
+            })
+        );
+    }
+
+    void received(const SessionPtr& self, const std::error_code& ec, const std::size_t bytes_transferred) {
+        trace(TraceEvent::ReadCompleted, this, bytes_transferred);
+        if (!ec) {
+            m_metrics->add(MetricCounter::TcpReads);
+            m_metrics->add(MetricCounter::TcpBytesIn, bytes_transferred);
+        } else if (ec != asio::error::eof && ec != asio::error::operation_aborted) {
+            m_metrics->add(MetricCounter::TcpReadErrors);
+        }
+        handle_command(m_metrics->time_callback(HandlerType::UnixOnReceive, this, [&] {
+            return m_config->on_receive(self, ec, bytes_transferred);
+        }));
+    }
+
+    void write(Buffer data, std::vector<int> fds) {
+        m_write_buffer = std::move(data);
+        m_write_fds = std::move(fds);
+        trace(TraceEvent::WriteIssued, this, m_write_buffer.size());
+        if (m_write_fds.empty()) {
+            write_remaining(0);
+        } else if (m_write_buffer.size() == 0) {
+            // Descriptors need at least one byte to travel with
+            unix_socket::close_all(m_write_fds);
+            post(m_strand, [this, self = this->shared_from_this()] {
+                written(self, asio::error::invalid_argument, 0);
+            });
+        } else {
+            write_fds();
+        }
+    }
+
+    void write_fds() {
+        m_socket.async_wait(Socket::wait_write,
+            bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec) {
+                std::size_t sent = 0;
+                if (!ec) {
+                    sent = unix_socket::send(m_socket.native_handle(), m_write_buffer.pointer(), m_write_buffer.size(),
+                        m_write_fds, nullptr, 0, ec);
+                    if (ec == asio::error::would_block) {
+                        write_fds();
+                        return;
+                    }
+                }
+                unix_socket::close_all(m_write_fds);
+                if (ec || sent == m_write_buffer.size()) {
+                    written(self, ec, sent);
+                    return;
+                }
+                write_remaining(sent);
+            })
+        );
+    }
+
+    void write_remaining(const std::size_t offset) {
+        async_write(m_socket, asio::buffer(m_write_buffer.pointer() + offset, m_write_buffer.size() - offset),
+            bind_executor(m_strand, [this, self = this->shared_from_this(), offset](const std::error_code ec, const size_t bytes_transferred) {
+                written(self, ec, offset + bytes_transferred);
+            })
+        );
+    }
+
+    void written(const SessionPtr& self, const std::error_code& ec, const std::size_t bytes_transferred) {
+        trace(TraceEvent::WriteCompleted, this, bytes_transferred);
+        if (!ec) {
+            m_metrics->add(MetricCounter::TcpWrites);
+            m_metrics->add(MetricCounter::TcpBytesOut, bytes_transferred);
+        } else if (ec != asio::error::operation_aborted) {
+            m_metrics->add(MetricCounter::TcpWriteErrors);
+        }
+        handle_command(m_metrics->time_callback(HandlerType::UnixOnWrite, this, [&] {
+            return m_config->on_write(self, ec, bytes_transferred);
+        }));
+    }
+
+public:
+    BasicUnixStreamSession(Socket socket, ConfigPtr config, MetricsPtr metrics):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
+        m_socket { std::move(socket) },
+        m_strand { make_strand(m_socket.get_executor()) },
+        m_read_buffer { m_config->read_buffer_size },
+        m_control { unix_socket::control_buffer(m_config->max_received_fds) } {}
+
+    ~BasicUnixStreamSession() {
+        unix_socket::close_all(m_received_fds);
+        unix_socket::close_all(m_write_fds);
+        std::error_code ec;
+        ec = m_socket.close(ec);
+    }
+
+    void connect(const std::error_code& ec, std::function<void()> clean_up) {
+        m_clean_up = std::move(clean_up);
+        trace(TraceEvent::Connect, this, static_cast<std::uint64_t>(ec.value()));
+        if (m_socket.is_open()) {
+            m_metrics->add(MetricCounter::TcpSessionsOpened);
+        }
+        handle_command(m_metrics->time_callback(HandlerType::UnixOnConnect, this, [&] {
+            return m_config->on_connect(this->shared_from_this(), ec);
+        }));
+    }
+
+    void disconnect() {
+        if (m_socket.is_open()) {
+            std::error_code shutdown_ec;
+            std::error_code close_ec;
+            shutdown_ec = m_socket.shutdown(Socket::shutdown_both, shutdown_ec);
+            close_ec = m_socket.close(close_ec);
+            m_metrics->add(MetricCounter::TcpSessionsClosed);
+            m_metrics->time_callback(HandlerType::UnixOnDisconnect, this, [&] {
+                m_config->on_disconnect(this->shared_from_this(), shutdown_ec ? shutdown_ec : close_ec);
+            });
+        } else {
+            m_metrics->time_callback(HandlerType::UnixOnDisconnect, this, [&] {
+                m_config->on_disconnect(this->shared_from_this(), make_error_code(CustomErrorCode::Disconnected));
+            });
+        }
+        if (m_clean_up) {
+            const auto clean_up = std::move(m_clean_up);
+            m_clean_up = nullptr;
+            clean_up();
+        }
+    }
+
+    // Hands a held session its next command from any thread, the command runs on the session strand
+    void resume(UnixStreamCommandVariant command) {
+        post(m_strand, [self = this->shared_from_this(), command = std::move(command)]() mutable {
+            self->handle_command(std::move(command));
+        });
+    }
+
+    // Disconnects from any thread, the disconnect itself runs on the session strand
+    void close() {
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            self->disconnect();
+        });
+    }
+
+    [[nodiscard]] const std::shared_ptr<void>& context() const {
+        return m_context;
+    }
+
+    void set_context(std::shared_ptr<void> context) {
+        m_context = std::move(context);
+    }
+
+    // Holds the bytes of the last completed read, valid until the next read is issued
+    [[nodiscard]] const Buffer& read_buffer() const {
+        return m_read_buffer;
+    }
+
+    // Descriptors that came with the last read, in the order they were sent. The session closes them when the
+    // next read is issued, unless they are taken.
+    [[nodiscard]] const std::vector<int>& received_fds() const {
+        return m_received_fds;
+    }
+
+    // The caller owns the descriptors from now on
+    [[nodiscard]] std::vector<int> take_received_fds() {
+        return std::exchange(m_received_fds, {});
+    }
+
+    [[nodiscard]] Socket& socket() {
+        return m_socket;
+    }
+
+    static SessionPtr shared(Socket socket, ConfigPtr config, MetricsPtr metrics) {
+        static_assert(UnixStreamSessionCallbacks<Config>, "The config does not provide the Unix stream session callbacks");
+        return std::make_shared<BasicUnixStreamSession>(std::move(socket), std::move(config), std::move(metrics));
+    }
+};
+
+template<typename Config>
+class BasicUnixStreamHandler final : public std::enable_shared_from_this<BasicUnixStreamHandler<Config>> {
+    using Session = BasicUnixStreamSession<Config>;
+    using SessionPtr = std::shared_ptr<Session>;
+    using ConfigPtr = std::shared_ptr<const Config>;
+    using Acceptor = asio::local::stream_protocol::acceptor;
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
+    IoWorkerGroup& m_workers;
+    asio::strand<asio::any_io_executor> m_strand;
+    Acceptor m_acceptor;
+    // Only accessed from m_strand
+    SparseVector<SessionPtr> m_sessions;
+    bool m_stopped { false };
+    unix_socket::SocketFile m_bound;
+    int m_port;
+
+    static Acceptor bound_acceptor(asio::io_context& io_context, const Config& config) {
+        unix_socket::remove_stale(config.path, config.abstract_namespace, SOCK_STREAM);
+        return Acceptor { io_context, unix_socket::endpoint<asio::local::stream_protocol>(config.path, config.abstract_namespace) };
+    }
+
+    void accept() {
+        auto& worker = m_workers.next();
+        m_acceptor.async_accept(
+            worker.io_context(),
+            bind_executor(m_strand, [self = this->shared_from_this(), &worker](const std::error_code ec, asio::local::stream_protocol::socket socket) {
+                trace(TraceEvent::Accept, self.get(), static_cast<std::uint64_t>(ec.value()));
+                if (ec != asio::error::operation_aborted) {
+                    self->m_metrics->add(ec ? MetricCounter::TcpAcceptErrors : MetricCounter::TcpAccepts);
+                    post(worker.io_context(), [self, ec, socket = std::move(socket)]() mutable {
+                        self->connect_session(std::move(socket), ec);
+                    });
+                }
+                if (self->m_acceptor.is_open()) {
+                    self->accept();
+                }
+            })
+        );
+    }
+
+    // Runs on the worker that owns the accepted socket
+    void connect_session(asio::local::stream_protocol::socket socket, const std::error_code ec) {
+        auto session = Session::shared(std::move(socket), m_config, m_metrics);
+        // Like TcpHandler, a session accepted before a stop that connects after it is closed
+        post(m_strand, [self = this->shared_from_this(), session] {
+            if (self->m_stopped) {
+                session->close();
+                return;
+            }
+            self->m_sessions.add(session);
+        });
+        session->connect(ec, [handler = this->weak_from_this(), weak = std::weak_ptr(session)] {
+            const auto self = handler.lock();
+            if (!self) {
+                return;
+            }
+            post(self->m_strand, [self, weak] {
+                if (const auto session = weak.lock()) {
+                    self->m_sessions.remove(session);
+                }
+            });
+        });
+    }
+
+public:
+    // Binds the path of the config, a stale socket file is replaced. Throws like TcpHandler when binding fails,
+    // e.g. when another server listens on the path.
+    BasicUnixStreamHandler(IoWorkerGroup& workers, asio::io_context& io_context, ConfigPtr config, MetricsPtr metrics,
+                           const int port):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
+        m_workers { workers },
+        m_strand { make_strand(io_context) },
+        m_acceptor { bound_acceptor(io_context, *m_config) },
+        m_sessions { m_config->pre_allocated_session_count },
+        m_bound { unix_socket::socket_file(m_config->path, m_config->abstract_namespace) },
+        m_port { port } {}
+
+    ~BasicUnixStreamHandler() {
+        std::error_code ec;
+        ec = m_acceptor.close(ec);
+    }
+
+    [[nodiscard]] int port() const {
+        return m_port;
+    }
+
+    void start() {
+        static_assert(UnixStreamCallbacks<Config>, "The config does not provide the Unix stream handler callbacks");
+        m_metrics->time_callback(HandlerType::UnixOnStart, this, [this] {
+            m_config->on_start(this->shared_from_this());
+        });
+        post(m_strand, [self = this->shared_from_this()] {
+            self->accept();
+        });
+    }
+
+    // Closes the sessions and removes the socket file, also when the pool is destroyed with the server
+    void stop() {
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            if (self->m_stopped) {
+                return;
+            }
+            self->m_stopped = true;
+            std::error_code ec;
+            ec = self->m_acceptor.close(ec);
+            unix_socket::remove_bound(self->m_config->path, self->m_config->abstract_namespace, self->m_bound);
+            for (const auto& session : self->m_sessions) {
+                session->close();
+            }
+            self->m_metrics->time_callback(HandlerType::UnixOnStop, self.get(), [&self] {
+                self->m_config->on_stop(self);
+            });
+        });
+    }
+};
+
+template<typename Config>
+class BasicUnixDatagramHandler final : public std::enable_shared_from_this<BasicUnixDatagramHandler<Config>> {
+    using ConfigPtr = std::shared_ptr<const Config>;
+    using Socket = asio::local::datagram_protocol::socket;
+    using Endpoint = asio::local::datagram_protocol::endpoint;
+
+    ConfigPtr m_config;
+    MetricsPtr m_metrics;
+    asio::strand<asio::any_io_executor> m_strand;
+    Socket m_socket;
+    Buffer m_read_buffer;
+    Buffer m_write_buffer;
+    std::vector<char> m_control;
+    std::vector<int> m_received_fds;
+    std::vector<int> m_write_fds;
+    Endpoint m_sender_endpoint;
+    unix_socket::SocketFile m_bound;
+    int m_port;
+
+    static Socket bound_socket(asio::io_context& io_context, const Config& config) {
+        unix_socket::remove_stale(config.path, config.abstract_namespace, SOCK_DGRAM);
+        return Socket { io_context, unix_socket::endpoint<asio::local::datagram_protocol>(config.path, config.abstract_namespace) };
+    }
+
+    void handle_command(UnixDatagramCommandVariant command) {
+        command.visit_all_cases(
+            [this](const UnixDatagramReadCommand&) {
+                // A stopped handler reports the aborted receive, reading again would fail forever
+                if (m_socket.is_open()) {
+                    read();
+                }
+            },
+            [this](UnixDatagramWriteCommand& cmd) { write(std::move(cmd.buffer), cmd.endpoint, std::move(cmd.fds)); }
+        );
+    }
+
+    void read() {
+        unix_socket::close_all(m_received_fds);
+        trace(TraceEvent::ReadIssued, this);
+        if (m_control.empty()) {
+            m_socket.async_receive_from(asio::buffer(m_read_buffer.pointer(), m_read_buffer.size()), m_sender_endpoint,
+                bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec, const size_t bytes_transferred) {
+                    received(self, ec, bytes_transferred);
+                })
+            );
+            return;
+        }
+        m_socket.async_wait(Socket::wait_read,
+            bind_executor(m_strand, [this, self = this->shared_from_this()](std::error_code ec) {
+                std::size_t bytes_transferred = 0;
+                if (!ec) {
+                    auto sender_size = static_cast<socklen_t>(m_sender_endpoint.capacity());
+                    bytes_transferred = unix_socket::receive(m_socket.native_handle(), m_read_buffer.pointer(),
+                        m_read_buffer.size(), m_control, m_received_fds, m_sender_endpoint.data(), &sender_size, ec);
+                    if (ec == asio::error::would_block) {
+                        read();
+                        return;
+                    }
+                    if (!ec) {
+                        m_sender_endpoint.resize(sender_size);
+                    }
+                }
+                received(self, ec, bytes_transferred);
+            })
+        );
+    }
+
+    void received(const std::shared_ptr<BasicUnixDatagramHandler>& self, const std::error_code& ec, const std::size_t bytes_transferred) {
+        trace(TraceEvent::ReadCompleted, this, bytes_transferred);
+        if (!ec) {
+            m_metrics->add(MetricCounter::UdpDatagramsIn);
+            m_metrics->add(MetricCounter::UdpBytesIn, bytes_transferred);
+        } else if (ec != asio::error::operation_aborted) {
+            m_metrics->add(MetricCounter::UdpReceiveErrors);
+        }
+        handle_command(m_metrics->time_callback(HandlerType::UnixDatagramOnReceive, this, [&] {
+            return m_config->on_receive(self, ec, bytes_transferred, m_sender_endpoint);
+        }));
+    }
+
+    void write(Buffer data, const Endpoint& endpoint, std::vector<int> fds) {
+        m_write_buffer = std::move(data);
+        m_write_fds = std::move(fds);
+        trace(TraceEvent::WriteIssued, this, m_write_buffer.size());
+        if (m_write_fds.empty()) {
+            m_socket.async_send_to(asio::buffer(m_write_buffer.pointer(), m_write_buffer.size()), endpoint,
+                bind_executor(m_strand, [this, self = this->shared_from_this()](const std::error_code ec, const size_t bytes_transferred) {
+                    written(self, ec, bytes_transferred);
+                })
+            );
+            return;
+        }
+        write_fds(endpoint);
+    }
+
+    void write_fds(const Endpoint& endpoint) {
+        m_socket.async_wait(Socket::wait_write,
+            bind_executor(m_strand, [this, self = this->shared_from_this(), endpoint](std::error_code ec) {
+                std::size_t sent = 0;
+                if (!ec) {
+                    sent = unix_socket::send(m_socket.native_handle(), m_write_buffer.pointer(), m_write_buffer.size(),
+                        m_write_fds, endpoint.data(), static_cast<socklen_t>(endpoint.size()), ec);
+                    if (ec == asio::error::would_block) {
+                        write_fds(endpoint);
+                        return;
+                    }
+                }
+                unix_socket::close_all(m_write_fds);
+                written(self, ec, sent);
+            })
+        );
+    }
+
+    void written(const std::shared_ptr<BasicUnixDatagramHandler>& self, const std::error_code& ec, const std::size_t bytes_transferred) {
+        trace(TraceEvent::WriteCompleted, this, bytes_transferred);
+        if (!ec) {
+            m_metrics->add(MetricCounter::UdpDatagramsOut);
+            m_metrics->add(MetricCounter::UdpBytesOut, bytes_transferred);
+        } else if (ec != asio::error::operation_aborted) {
+            m_metrics->add(MetricCounter::UdpSendErrors);
+        }
+        handle_command(m_metrics->time_callback(HandlerType::UnixDatagramOnWrite, this, [&] {
+            return m_config->on_write(self, ec, bytes_transferred);
+        }));
+    }
+
+public:
+    BasicUnixDatagramHandler(asio::io_context& io_context, ConfigPtr config, MetricsPtr metrics, const int port):
+        m_config { std::move(config) },
+        m_metrics { std::move(metrics) },
+        m_strand { asio::make_strand(io_context) },
+        m_socket { bound_socket(io_context, *m_config) },
+        m_read_buffer { m_config->read_buffer_size },
+        m_control { unix_socket::control_buffer(m_config->max_received_fds) },
+        m_bound { unix_socket::socket_file(m_config->path, m_config->abstract_namespace) },
+        m_port { port } {}
+
+    ~BasicUnixDatagramHandler() {
+        unix_socket::close_all(m_received_fds);
+        unix_socket::close_all(m_write_fds);
+    }
+
+    [[nodiscard]] int port() const {
+        return m_port;
+    }
+
+    void start() {
+        static_assert(UnixDatagramCallbacks<Config>, "The config does not provide the Unix datagram callbacks");
+        m_metrics->time_callback(HandlerType::UnixDatagramOnStart, this, [this] {
+            m_config->on_start(this->shared_from_this());
+        });
+        read();
+    }
+
+    // Holds the last received datagram, valid until the next read is issued
+    [[nodiscard]] const Buffer& read_buffer() const {
+        return m_read_buffer;
+    }
+
+    // Descriptors that came with the last datagram, see UnixStreamSession::received_fds()
+    [[nodiscard]] const std::vector<int>& received_fds() const {
+        return m_received_fds;
+    }
+
+    [[nodiscard]] std::vector<int> take_received_fds() {
+        return std::exchange(m_received_fds, {});
+    }
+
+    // The socket is closed on the handler strand, so it never races a completion
+    void stop() {
+        post_or_run(m_strand, [self = this->shared_from_this()] {
+            if (!self->m_socket.is_open()) {
+                return;
+            }
+            std::error_code ec;
+            ec = self->m_socket.close(ec);
+            unix_socket::remove_bound(self->m_config->path, self->m_config->abstract_namespace, self->m_bound);
+            self->m_metrics->time_callback(HandlerType::UnixDatagramOnStop, self.get(), [&self] {
+                self->m_config->on_stop(self);
+            });
+        });
+    }
+};
+
+#endif //LE_UNIX_HANDLER_HPP
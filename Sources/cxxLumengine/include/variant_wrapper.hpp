@@ -34,6 +34,14 @@ public:
         }
     }
 
+    // Lets handlers take their case by reference, e.g. to move a buffer out of a command.
+    // A handler that throws terminates the process, as it does through the const overload.
+    auto visit_all_cases(auto &&... handlers) noexcept {
+        return std::visit(overload<std::decay_t<decltype(handlers)>...>{
+                          std::forward<decltype(handlers)>(handlers)...
+                      }, m_variant);
+    }
+
     template<typename T>
     std::optional<T> get_if() const noexcept {
         try {
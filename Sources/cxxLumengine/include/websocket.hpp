@@ -0,0 +1,427 @@
+#ifndef LE_WEBSOCKET_HPP
+#define LE_WEBSOCKET_HPP
+
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__APPLE__)
+#include <stdlib.h>
+#elif defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#include "buffer.hpp"
+#include "custom_error_code.hpp"
+#include "simd_scan.hpp"
+
+enum class WebSocketOpcode : std::uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+struct WebSocketOptions {
+    // Client sessions expect unmasked frames and mask their own, servers the other way round
+    bool client { false };
+};
+
+// One complete message, fragments joined. Points into the read buffer and is valid until the next read.
+// A Close message carries the reason as its data.
+struct WebSocketMessage {
+    WebSocketOpcode opcode { WebSocketOpcode::Text };
+    const char* data { nullptr };
+    std::size_t size { 0 };
+    // Status code of a Close message, 1005 when the peer sent none
+    std::uint16_t close_code { 0 };
+};
+
+namespace websocket {
+    // Close status codes of RFC 6455
+    constexpr std::uint16_t normal_closure = 1000;
+    constexpr std::uint16_t protocol_error = 1002;
+    constexpr std::uint16_t no_status = 1005;
+    constexpr std::uint16_t message_too_big = 1009;
+
+    inline std::array<std::uint8_t, 20> sha1(const std::string_view input) {
+        std::uint32_t h[5] { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+        std::string message { input };
+        message.push_back(static_cast<char>(0x80));
+        while (message.size() % 64 != 56) {
+            message.push_back(0);
+        }
+        const auto bits = static_cast<std::uint64_t>(input.size()) * 8;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            message.push_back(static_cast<char>(bits >> shift));
+        }
+        for (std::size_t block = 0; block < message.size(); block += 64) {
+            std::uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                const auto* b = reinterpret_cast<const std::uint8_t*>(message.data() + block + i * 4);
+                w[i] = static_cast<std::uint32_t>(b[0]) << 24 | static_cast<std::uint32_t>(b[1]) << 16 |
+                       static_cast<std::uint32_t>(b[2]) << 8 | b[3];
+            }
+            for (int i = 16; i < 80; ++i) {
+                w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+            auto [a, b, c, d, e] = h;
+            for (int i = 0; i < 80; ++i) {
+                const auto f = i < 20 ? (b & c) | (~b & d) : i < 40 ? b ^ c ^ d : i < 60 ? (b & c) | (b & d) | (c & d) : b ^ c ^ d;
+                const std::uint32_t k = i < 20 ? 0x5A827999 : i < 40 ? 0x6ED9EBA1 : i < 60 ? 0x8F1BBCDC : 0xCA62C1D6;
+                const auto t = std::rotl(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = std::rotl(b, 30);
+                b = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        std::array<std::uint8_t, 20> digest {};
+        for (int i = 0; i < 20; ++i) {
+            digest[i] = static_cast<std::uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        return digest;
+    }
+
+    inline std::string base64(const std::uint8_t* data, const std::size_t size) {
+        static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string encoded;
+        encoded.reserve((size + 2) / 3 * 4);
+        for (std::size_t i = 0; i < size; i += 3) {
+            const auto rest = size - i;
+            const std::uint32_t group = static_cast<std::uint32_t>(data[i]) << 16 |
+                                        (rest > 1 ? static_cast<std::uint32_t>(data[i + 1]) << 8 : 0) |
+                                        (rest > 2 ? data[i + 2] : 0);
+            encoded.push_back(alphabet[group >> 18 & 63]);
+            encoded.push_back(alphabet[group >> 12 & 63]);
+            encoded.push_back(rest > 1 ? alphabet[group >> 6 & 63] : '=');
+            encoded.push_back(rest > 2 ? alphabet[group & 63] : '=');
+        }
+        return encoded;
+    }
+
+    // Fills the bytes from the random source of the system
+    inline void fill_random(void* data, const std::size_t size) {
+        auto* bytes = static_cast<unsigned char*>(data);
+        std::size_t filled = 0;
+#if defined(__APPLE__)
+        arc4random_buf(bytes, size);
+        filled = size;
+#elif defined(__linux__)
+        while (filled < size) {
+            const auto got = ::getrandom(bytes + filled, size - filled, 0);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(got);
+        }
+#endif
+        // Kernels without getrandom(), random_device reads the same source through the device
+        if (filled < size) {
+            std::random_device device;
+            for (; filled < size; ++filled) {
+                bytes[filled] = static_cast<unsigned char>(device());
+            }
+        }
+    }
+
+    // Clients need masking keys the peer cannot predict (RFC 6455 section 5.3). Each thread fetches them in
+    // batches, so most keys cost no system call.
+    inline std::uint32_t masking_key() {
+        struct Batch {
+            std::array<std::uint32_t, 64> keys {};
+            std::size_t next { 64 };
+        };
+        thread_local Batch batch;
+        if (batch.next == batch.keys.size()) {
+            fill_random(batch.keys.data(), sizeof(batch.keys));
+            batch.next = 0;
+        }
+        return batch.keys[batch.next++];
+    }
+
+    inline std::size_t header_size(const std::size_t size, const bool masked) noexcept {
+        return (size < 126 ? 2 : size <= 0xFFFF ? 4 : 10) + (masked ? 4 : 0);
+    }
+
+    // Writes the header of a frame and returns its size
+    inline std::size_t write_header(char* out, const WebSocketOpcode opcode, const std::size_t size, const bool fin,
+                                    const bool masked, const std::uint32_t key) noexcept {
+        std::size_t header = 2;
+        out[0] = static_cast<char>((fin ? 0x80 : 0) | static_cast<std::uint8_t>(opcode));
+        const char mask_bit = masked ? static_cast<char>(0x80) : 0;
+        if (size < 126) {
+            out[1] = static_cast<char>(mask_bit | static_cast<char>(size));
+        } else if (size <= 0xFFFF) {
+            out[1] = static_cast<char>(mask_bit | 126);
+            out[2] = static_cast<char>(size >> 8);
+            out[3] = static_cast<char>(size);
+            header = 4;
+        } else {
+            out[1] = static_cast<char>(mask_bit | 127);
+            for (int i = 0; i < 8; ++i) {
+                out[2 + i] = static_cast<char>(static_cast<std::uint64_t>(size) >> (56 - 8 * i));
+            }
+            header = 10;
+        }
+        if (masked) {
+            std::memcpy(out + header, &key, 4);
+            header += 4;
+        }
+        return header;
+    }
+}
+
+// The Sec-WebSocket-Accept value of the upgrade response for the Sec-WebSocket-Key of the request
+inline std::string websocket_accept(const std::string_view key) {
+    std::string input { key };
+    input += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    const auto digest = websocket::sha1(input);
+    return websocket::base64(digest.data(), digest.size());
+}
+
+// A complete frame for TCPWriteCommand. Messages can be framed once and the buffer written to every session.
+// Frames from clients must be masked, frames from servers must not.
+inline Buffer websocket_frame(const WebSocketOpcode opcode, const char* data, const std::size_t size,
+                              const bool masked = false, const bool fin = true) {
+    const auto key = masked ? websocket::masking_key() : 0;
+    Buffer frame { websocket::header_size(size, masked) + size };
+    const auto header = websocket::write_header(frame.pointer(), opcode, size, fin, masked, key);
+    if (masked) {
+        xor_mask(frame.pointer() + header, data, size, key);
+    } else if (size > 0) {
+        std::memcpy(frame.pointer() + header, data, size);
+    }
+    return frame;
+}
+
+enum class WebSocketEvent {
+    // The next frame is incomplete
+    None,
+    Message,
+    // A ping or pong was handled
+    Control,
+    Close,
+};
+
+// Parses WebSocket frames in place, one message at a time from the front of the buffered bytes
+// Payloads are unmasked with the SIMD kernel. A single frame message stays where it is, the fragments of a
+// longer message are joined at the front of the bytes as they arrive, over the headers already parsed, so a
+// message that is still incomplete only keeps offsets relative to its first byte and the buffer may move.
+// Pings are answered with pongs, interleaved control frames included. A close is reported, the close reply is
+// only queued once the caller consumed it. Protocol violations queue a close with the matching status code.
+// Text is not validated as UTF-8, the receiver does that when it converts the payload.
+class WebSocketParser final {
+    WebSocketOptions m_options;
+    std::size_t m_max_message_size;
+    // The message being joined, Continuation while there is none, with its payload bytes at the front
+    WebSocketOpcode m_opcode { WebSocketOpcode::Continuation };
+    std::size_t m_message_size { 0 };
+    // The next frame header of the message being joined
+    std::size_t m_frame_offset { 0 };
+    std::uint16_t m_close_code { 0 };
+    bool m_close_queued { false };
+    // Frames the parser answers with on its own
+    std::string m_replies;
+
+    void queue(const WebSocketOpcode opcode, const char* data, const std::size_t size) {
+        const auto key = m_options.client ? websocket::masking_key() : 0;
+        const auto start = m_replies.size();
+        m_replies.resize(start + websocket::header_size(size, m_options.client) + size);
+        const auto header = websocket::write_header(m_replies.data() + start, opcode, size, true, m_options.client, key);
+        if (m_options.client) {
+            xor_mask(m_replies.data() + start + header, data, size, key);
+        } else if (size > 0) {
+            std::memcpy(m_replies.data() + start + header, data, size);
+        }
+    }
+
+    void queue_close(const std::uint16_t code) {
+        if (m_close_queued) {
+            return;
+        }
+        m_close_queued = true;
+        const char payload[2] { static_cast<char>(code >> 8), static_cast<char>(code) };
+        queue(WebSocketOpcode::Close, payload, code == websocket::no_status ? 0 : 2);
+    }
+
+    std::error_code fail(const CustomErrorCode error) {
+        queue_close(error == CustomErrorCode::FrameTooLarge ? websocket::message_too_big : websocket::protocol_error);
+        return make_error_code(error);
+    }
+
+public:
+    WebSocketParser(const WebSocketOptions& options, const std::size_t max_message_size):
+        m_options { options },
+        m_max_message_size { max_message_size } {}
+
+    // Forgets the message being joined, e.g. when the session switches its framing
+    void reset() noexcept {
+        m_opcode = WebSocketOpcode::Continuation;
+        m_message_size = 0;
+        m_frame_offset = 0;
+    }
+
+    // Parses from the front of the bytes until a message is complete, a control frame was handled outside of a
+    // message or the next frame is incomplete. consumed is the size of what the event covers, 0 for None.
+    std::error_code parse(char* data, const std::size_t size, WebSocketEvent& event, WebSocketMessage& message,
+                          std::size_t& consumed) {
+        event = WebSocketEvent::None;
+        consumed = 0;
+        auto position = m_frame_offset;
+        for (;;) {
+            if (size - position < 2) {
+                return {};
+            }
+            const auto first = static_cast<std::uint8_t>(data[position]);
+            const auto second = static_cast<std::uint8_t>(data[position + 1]);
+            const bool fin = first & 0x80;
+            const auto opcode = static_cast<WebSocketOpcode>(first & 0x0F);
+            const bool masked = second & 0x80;
+            // No extension is negotiated, so the reserved bits must be clear
+            if ((first & 0x70) || masked == m_options.client) {
+                return fail(CustomErrorCode::WebSocketProtocolError);
+            }
+            std::size_t header = 2;
+            std::uint64_t length = second & 0x7F;
+            if (length >= 126) {
+                const std::size_t width = length == 126 ? 2 : 8;
+                if (size - position < 2 + width) {
+                    return {};
+                }
+                length = 0;
+                for (std::size_t i = 0; i < width; ++i) {
+                    length = length << 8 | static_cast<std::uint8_t>(data[position + 2 + i]);
+                }
+                if (length >> 63) {
+                    return fail(CustomErrorCode::WebSocketProtocolError);
+                }
+                header += width;
+            }
+            std::uint32_t key = 0;
+            if (masked) {
+                if (size - position < header + 4) {
+                    return {};
+                }
+                std::memcpy(&key, data + position + header, 4);
+                header += 4;
+            }
+
+            const bool control = static_cast<std::uint8_t>(opcode) & 0x08;
+            if (control) {
+                if (!fin || length > 125 || (opcode != WebSocketOpcode::Close && opcode != WebSocketOpcode::Ping &&
+                                             opcode != WebSocketOpcode::Pong)) {
+                    return fail(CustomErrorCode::WebSocketProtocolError);
+                }
+            } else if (opcode != WebSocketOpcode::Continuation && opcode != WebSocketOpcode::Text &&
+                       opcode != WebSocketOpcode::Binary) {
+                return fail(CustomErrorCode::WebSocketProtocolError);
+            } else if ((opcode == WebSocketOpcode::Continuation) != (m_opcode != WebSocketOpcode::Continuation)) {
+                // A continuation without a message, or a new message before the last one ended
+                return fail(CustomErrorCode::WebSocketProtocolError);
+            } else if (length > m_max_message_size - m_message_size) {
+                return fail(CustomErrorCode::FrameTooLarge);
+            }
+            if (size - position - header < length) {
+                return {};
+            }
+            auto* payload = data + position + header;
+            const auto payload_size = static_cast<std::size_t>(length);
+            const auto end = position + header + payload_size;
+
+            if (control) {
+                if (masked) {
+                    xor_mask(payload, payload, payload_size, key);
+                }
+                if (opcode == WebSocketOpcode::Close) {
+                    // A close behind messages is parsed again once they are handed out, a zero key unmasks nothing
+                    if (masked) {
+                        std::memset(payload - 4, 0, 4);
+                    }
+                    if (payload_size == 1) {
+                        return fail(CustomErrorCode::WebSocketProtocolError);
+                    }
+                    const auto reason = payload_size >= 2 ? std::size_t { 2 } : std::size_t { 0 };
+                    m_close_code = reason ? static_cast<std::uint16_t>(static_cast<std::uint8_t>(payload[0]) << 8 |
+                                                                      static_cast<std::uint8_t>(payload[1]))
+                                          : websocket::no_status;
+                    message = { WebSocketOpcode::Close, payload + reason, payload_size - reason, m_close_code };
+                    event = WebSocketEvent::Close;
+                    consumed = end;
+                    return {};
+                }
+                if (opcode == WebSocketOpcode::Ping && !m_close_queued) {
+                    queue(WebSocketOpcode::Pong, payload, payload_size);
+                }
+                if (m_opcode == WebSocketOpcode::Continuation) {
+                    event = WebSocketEvent::Control;
+                    consumed = end;
+                    return {};
+                }
+                position = end;
+                m_frame_offset = position;
+                continue;
+            }
+
+            if (fin && m_opcode == WebSocketOpcode::Continuation) {
+                // A message in a single frame is unmasked where it is
+                if (masked) {
+                    xor_mask(payload, payload, payload_size, key);
+                }
+                message = { opcode, payload, payload_size };
+            } else {
+                if (masked) {
+                    xor_mask(data + m_message_size, payload, payload_size, key);
+                } else {
+                    std::memmove(data + m_message_size, payload, payload_size);
+                }
+                if (opcode != WebSocketOpcode::Continuation) {
+                    m_opcode = opcode;
+                }
+                m_message_size += payload_size;
+                message = { m_opcode, data, m_message_size };
+            }
+            if (fin) {
+                event = WebSocketEvent::Message;
+                consumed = end;
+                reset();
+                return {};
+            }
+            position = end;
+            m_frame_offset = position;
+        }
+    }
+
+    // Answers a close the caller consumed, after which no more frames are answered
+    void close_consumed() {
+        queue_close(m_close_code);
+    }
+
+    [[nodiscard]] bool has_replies() const noexcept {
+        return !m_replies.empty();
+    }
+
+    [[nodiscard]] std::string take_replies() noexcept {
+        return std::exchange(m_replies, {});
+    }
+};
+
+#endif //LE_WEBSOCKET_HPP
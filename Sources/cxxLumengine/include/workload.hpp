@@ -3,6 +3,8 @@
 
 #include "swift_function_wrapper.hpp"
 #include "variant_wrapper.hpp"
+#include <atomic>
+#include <cstdint>
 #include <optional>
 
 #include "server.hpp"
@@ -27,13 +29,53 @@ struct StartServerWorkload {
 struct StopServerWorkload {
     int port { 8080 };
 };
+// Runs the body over [begin, end) in chunks of at least grain indices spread over the pool threads.
+// A grain of 0 lets the pool pick one. The workload callback is called once after the last chunk.
+struct ParallelForWorkload {
+    std::size_t begin { 0 };
+    std::size_t end { 0 };
+    std::size_t grain { 0 };
+    SwiftFunctionWrapper<void, std::size_t, std::size_t> body;
+};
+
+class WorkloadGraph;
+using WorkloadGraphPtr = std::shared_ptr<WorkloadGraph>;
+// Runs every node of the graph once its dependencies have completed. The graph must not be modified
+// after it has been submitted. The workload callback is called once after the last node.
+struct GraphWorkload {
+    WorkloadGraphPtr graph;
+};
 
-using WorkloadType = std::variant<FunctionWorkload, StartServerWorkload, StopServerWorkload>;
+using WorkloadType = std::variant<FunctionWorkload, StartServerWorkload, StopServerWorkload, ParallelForWorkload, GraphWorkload>;
 using WorkloadTypeVariant = VariantWrapper<WorkloadType>;
 
+using WorkloadGroup = std::uint64_t;
+// Workloads in the default group can only be cancelled through their handles
+constexpr WorkloadGroup DefaultWorkloadGroup = 0;
+
 struct Workload {
     WorkloadTypeVariant workload;
     std::optional<SwiftFunctionWrapper<void, std::error_code>> callback { std::nullopt };
+    // Checked when the workload is due to start, a workload that starts late is not run. Parallel for and graph
+    // workloads also check it before every chunk and node, so they can stop part way through. Either way the
+    // callback receives DeadlineExpired. Nothing fires at the deadline itself, work that has started runs on.
+    std::optional<PointInTime> deadline { std::nullopt };
+    WorkloadGroup group { DefaultWorkloadGroup };
+
+    Workload& with_deadline(const PointInTime time) {
+        deadline = time;
+        return *this;
+    }
+
+    Workload& with_deadline_after(const std::chrono::nanoseconds timeout) {
+        deadline = std::chrono::steady_clock::now() + timeout;
+        return *this;
+    }
+
+    Workload& in_group(const WorkloadGroup value) {
+        group = value;
+        return *this;
+    }
 
     // Correct swift closures must be provided. Their types are not verified at compile time.
     // Incorrect function signatures will result in a runtime failure and terminate the library.
@@ -60,10 +102,56 @@ struct Workload {
             w.callback = SwiftFunctionWrapper<void, std::error_code>(callback);
         }
 
+        return w;
+    }
+    // The swift function is called concurrently from several threads with (chunk_begin, chunk_end)
+    static Workload create_parallel_for(
+        const std::size_t begin,
+        const std::size_t end,
+        const std::size_t grain,
+        void* swift_function,
+        void* callback = nullptr
+    ) {
+        Workload w { WorkloadTypeVariant(ParallelForWorkload {
+            begin,
+            end,
+            grain,
+            SwiftFunctionWrapper<void, std::size_t, std::size_t>(swift_function)
+        }) };
+        if (callback) {
+            w.callback = SwiftFunctionWrapper<void, std::error_code>(callback);
+        }
+
+        return w;
+    }
+    static Workload create_graph(WorkloadGraphPtr graph, void* callback = nullptr) {
+        Workload w { WorkloadTypeVariant(GraphWorkload { std::move(graph) }) };
+        if (callback) {
+            w.callback = SwiftFunctionWrapper<void, std::error_code>(callback);
+        }
+
         return w;
     }
 };
 
 using WorkloadPtr = std::shared_ptr<Workload>;
 
+// Lets long running workloads observe cancellation and deadlines between their chunks and nodes
+struct WorkloadStopCondition {
+    const std::atomic<bool>* cancelled { nullptr };
+    std::optional<PointInTime> deadline { std::nullopt };
+
+    [[nodiscard]] bool cancel_requested() const noexcept {
+        return cancelled && cancelled->load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool deadline_expired() const noexcept {
+        return deadline && std::chrono::steady_clock::now() > *deadline;
+    }
+
+    [[nodiscard]] bool stop_requested() const noexcept {
+        return cancel_requested() || deadline_expired();
+    }
+};
+
 #endif //LE_WORKLOAD_HPP
@@ -0,0 +1,226 @@
+#ifndef LE_WORKLOAD_GRAPH_HPP
+#define LE_WORKLOAD_GRAPH_HPP
+
+#include <cxxAsio.hpp>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "parallel_for.hpp"
+#include "workload.hpp"
+
+using GraphNodeWorkload = std::variant<FunctionWorkload, ParallelForWorkload>;
+using GraphNodeWorkloadVariant = VariantWrapper<GraphNodeWorkload>;
+
+// A set of workloads with explicit dependencies between them
+// Nodes are identified by the index returned when they are added. A node runs once every node
+// it depends on has finished, independent nodes run in parallel.
+class WorkloadGraph final {
+    struct Node {
+        GraphNodeWorkloadVariant workload;
+        std::vector<std::size_t> successors {};
+        std::size_t dependency_count { 0 };
+    };
+
+    std::vector<Node> m_nodes;
+
+public:
+    // Correct swift closures must be provided. Their types are not verified at compile time.
+    std::size_t add_function(void* swift_function) {
+        return add_function(FunctionWorkload(swift_function));
+    }
+
+    std::size_t add_function(FunctionWorkload function) {
+        m_nodes.push_back(Node { GraphNodeWorkloadVariant(std::move(function)) });
+        return m_nodes.size() - 1;
+    }
+
+    std::size_t add_parallel_for(
+        const std::size_t begin,
+        const std::size_t end,
+        const std::size_t grain,
+        void* swift_function
+    ) {
+        return add_parallel_for(begin, end, grain, SwiftFunctionWrapper<void, std::size_t, std::size_t>(swift_function));
+    }
+
+    std::size_t add_parallel_for(
+        const std::size_t begin,
+        const std::size_t end,
+        const std::size_t grain,
+        SwiftFunctionWrapper<void, std::size_t, std::size_t> body
+    ) {
+        m_nodes.push_back(Node { GraphNodeWorkloadVariant(ParallelForWorkload { begin, end, grain, std::move(body) }) });
+        return m_nodes.size() - 1;
+    }
+
+    // The after node will not start before the before node has finished.
+    // Returns false when either node does not exist or both are the same node.
+    bool add_dependency(const std::size_t before, const std::size_t after) {
+        if (before >= m_nodes.size() || after >= m_nodes.size() || before == after) {
+            return false;
+        }
+        m_nodes[before].successors.push_back(after);
+        ++m_nodes[after].dependency_count;
+        return true;
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return m_nodes.empty();
+    }
+
+    [[nodiscard]] const GraphNodeWorkloadVariant& workload(const std::size_t node) const {
+        return m_nodes[node].workload;
+    }
+
+    [[nodiscard]] const std::vector<std::size_t>& successors(const std::size_t node) const {
+        return m_nodes[node].successors;
+    }
+
+    [[nodiscard]] std::size_t dependency_count(const std::size_t node) const {
+        return m_nodes[node].dependency_count;
+    }
+
+    // Kahn's algorithm, a graph with a cycle can never complete
+    [[nodiscard]] bool is_acyclic() const {
+        std::vector<std::size_t> pending(m_nodes.size());
+        std::vector<std::size_t> ready;
+        for (std::size_t i = 0; i < m_nodes.size(); ++i) {
+            pending[i] = m_nodes[i].dependency_count;
+            if (pending[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+
+        std::size_t visited = 0;
+        while (!ready.empty()) {
+            const auto node = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (const auto successor : m_nodes[node].successors) {
+                if (--pending[successor] == 0) {
+                    ready.push_back(successor);
+                }
+            }
+        }
+        return visited == m_nodes.size();
+    }
+
+    static WorkloadGraphPtr shared() {
+        return std::make_shared<WorkloadGraph>();
+    }
+};
+
+// Executes one submission of a WorkloadGraph on the pool
+// Every node has an atomic count of unfinished dependencies. The thread that finishes a node continues
+// with the first successor that becomes ready and posts the others, so a chain of nodes runs without
+// bouncing through the executor queue.
+class GraphJob final : public std::enable_shared_from_this<GraphJob> {
+    WorkloadGraphPtr m_graph;
+    IoWorkerGroup& m_workers;
+    std::unique_ptr<std::atomic<std::size_t>[]> m_pending;
+    std::atomic<std::size_t> m_remaining;
+    std::function<void()> m_on_complete;
+    WorkloadStopCondition m_stop;
+
+    void run_node(std::size_t node) {
+        while (true) {
+            // Nodes are still released after a stop request so that completion fires once
+            if (m_stop.stop_requested()) {
+                const auto next = node_done(node);
+                if (!next) {
+                    return;
+                }
+                node = *next;
+                continue;
+            }
+            const auto next = m_graph->workload(node).visit_all_cases(
+                [this, node](const FunctionWorkload& wl) -> std::optional<std::size_t> {
+                    wl.call();
+                    return node_done(node);
+                },
+                [this, node](const ParallelForWorkload& wl) -> std::optional<std::size_t> {
+                    ParallelForJob::shared(wl, m_workers.size(), [self = shared_from_this(), node] {
+                        if (const auto next_node = self->node_done(node)) {
+                            self->run_node(*next_node);
+                        }
+                    }, m_stop)->start(m_workers);
+                    return std::nullopt;
+                }
+            );
+            if (!next) {
+                return;
+            }
+            node = *next;
+        }
+    }
+
+    // Releases the successors of a finished node and returns the one the caller should run next
+    std::optional<std::size_t> node_done(const std::size_t node) {
+        std::optional<std::size_t> next { std::nullopt };
+        for (const auto successor : m_graph->successors(node)) {
+            if (m_pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (!next) {
+                    next = successor;
+                } else {
+                    post(m_workers.next().io_context(), [self = shared_from_this(), successor] {
+                        self->run_node(successor);
+                    });
+                }
+            }
+        }
+
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            m_on_complete();
+        }
+        return next;
+    }
+
+public:
+    GraphJob(
+        WorkloadGraphPtr graph,
+        IoWorkerGroup& workers,
+        std::function<void()> on_complete,
+        WorkloadStopCondition stop = {}
+    ):
+        m_graph { std::move(graph) },
+        m_workers { workers },
+        m_pending { std::make_unique<std::atomic<std::size_t>[]>(m_graph->size()) },
+        m_remaining { m_graph->size() },
+        m_on_complete { std::move(on_complete) },
+        m_stop { stop } {
+        for (std::size_t i = 0; i < m_graph->size(); ++i) {
+            m_pending[i].store(m_graph->dependency_count(i), std::memory_order_relaxed);
+        }
+    }
+
+    // Posts every node without dependencies. An empty graph completes immediately on the calling thread.
+    void start() {
+        if (m_graph->empty()) {
+            m_on_complete();
+            return;
+        }
+        for (std::size_t i = 0; i < m_graph->size(); ++i) {
+            if (m_graph->dependency_count(i) == 0) {
+                post(m_workers.next().io_context(), [self = shared_from_this(), i] {
+                    self->run_node(i);
+                });
+            }
+        }
+    }
+
+    static std::shared_ptr<GraphJob> shared(
+        WorkloadGraphPtr graph,
+        IoWorkerGroup& workers,
+        std::function<void()> on_complete,
+        WorkloadStopCondition stop = {}
+    ) {
+        return std::make_shared<GraphJob>(std::move(graph), workers, std::move(on_complete), stop);
+    }
+};
+
+#endif //LE_WORKLOAD_GRAPH_HPP
@@ -0,0 +1,5 @@
+#include "benchmark_support.hpp"
+
+// Benchmarks hand plain C++ functions to the engine in place of Swift closures, so there is no
+// Swift context to release
+extern "C" void release_swift_closure(void *) {}
@@ -0,0 +1,346 @@
+#ifndef LE_BENCHMARK_SUPPORT_HPP
+#define LE_BENCHMARK_SUPPORT_HPP
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cxxLumengine.hpp>
+#include "hdr_histogram.hpp"
+
+// Command line of the form --name value --flag
+// Lists are comma separated, e.g. --payload 64,1024,16384
+class BenchmarkArguments final {
+    std::map<std::string, std::string> m_values;
+
+public:
+    BenchmarkArguments(const int argc, char** argv) {
+        for (int i = 1; i < argc; ++i) {
+            std::string name { argv[i] };
+            if (!name.starts_with("--")) {
+                continue;
+            }
+            name = name.substr(2);
+            if (i + 1 < argc && !std::string_view { argv[i + 1] }.starts_with("--")) {
+                m_values[name] = argv[++i];
+            } else {
+                m_values[name] = "true";
+            }
+        }
+    }
+
+    [[nodiscard]] bool has(const std::string& name) const {
+        return m_values.contains(name);
+    }
+
+    [[nodiscard]] std::string string(const std::string& name, const std::string& fallback) const {
+        const auto it = m_values.find(name);
+        return it == m_values.end() ? fallback : it->second;
+    }
+
+    [[nodiscard]] std::size_t size(const std::string& name, const std::size_t fallback) const {
+        const auto it = m_values.find(name);
+        return it == m_values.end() ? fallback : std::stoull(it->second);
+    }
+
+    [[nodiscard]] double number(const std::string& name, const double fallback) const {
+        const auto it = m_values.find(name);
+        return it == m_values.end() ? fallback : std::stod(it->second);
+    }
+
+    [[nodiscard]] std::vector<std::size_t> sizes(const std::string& name, std::vector<std::size_t> fallback) const {
+        const auto it = m_values.find(name);
+        if (it == m_values.end()) {
+            return fallback;
+        }
+        std::vector<std::size_t> result;
+        std::stringstream stream { it->second };
+        for (std::string item; std::getline(stream, item, ',');) {
+            if (!item.empty()) {
+                result.push_back(std::stoull(item));
+            }
+        }
+        return result;
+    }
+
+    [[nodiscard]] std::vector<std::string> strings(const std::string& name, std::vector<std::string> fallback) const {
+        const auto it = m_values.find(name);
+        if (it == m_values.end()) {
+            return fallback;
+        }
+        std::vector<std::string> result;
+        std::stringstream stream { it->second };
+        for (std::string item; std::getline(stream, item, ',');) {
+            if (!item.empty()) {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+// Streaming JSON writer, enough for flat result files
+// Commas are inserted automatically, nesting is tracked with a stack of "first element" flags.
+class JsonWriter final {
+    std::string m_output;
+    std::vector<bool> m_first;
+    bool m_after_key { false };
+
+    void separator() {
+        if (m_after_key) {
+            m_after_key = false;
+            return;
+        }
+        if (!m_first.empty()) {
+            if (!m_first.back()) {
+                m_output += ',';
+            }
+            m_first.back() = false;
+        }
+    }
+
+    void quoted(const std::string_view text) {
+        m_output += '"';
+        for (const auto c : text) {
+            switch (c) {
+                case '"': m_output += "\\\""; break;
+                case '\\': m_output += "\\\\"; break;
+                case '\n': m_output += "\\n"; break;
+                case '\t': m_output += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        m_output += escaped;
+                    } else {
+                        m_output += c;
+                    }
+            }
+        }
+        m_output += '"';
+    }
+
+public:
+    JsonWriter& begin_object() {
+        separator();
+        m_output += '{';
+        m_first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& end_object() {
+        m_first.pop_back();
+        m_output += '}';
+        return *this;
+    }
+
+    JsonWriter& begin_array() {
+        separator();
+        m_output += '[';
+        m_first.push_back(true);
+        return *this;
+    }
+
+    JsonWriter& end_array() {
+        m_first.pop_back();
+        m_output += ']';
+        return *this;
+    }
+
+    JsonWriter& key(const std::string_view name) {
+        separator();
+        quoted(name);
+        m_output += ':';
+        m_after_key = true;
+        return *this;
+    }
+
+    JsonWriter& value(const std::string_view text) {
+        separator();
+        quoted(text);
+        return *this;
+    }
+
+    JsonWriter& value(const char* text) {
+        return value(std::string_view { text });
+    }
+
+    JsonWriter& value(const bool flag) {
+        separator();
+        m_output += flag ? "true" : "false";
+        return *this;
+    }
+
+    JsonWriter& value(const double number) {
+        separator();
+        char formatted[64];
+        std::snprintf(formatted, sizeof(formatted), "%.6g", number);
+        m_output += formatted;
+        return *this;
+    }
+
+    template<std::integral T>
+    JsonWriter& value(const T number) {
+        separator();
+        m_output += std::to_string(number);
+        return *this;
+    }
+
+    template<typename T>
+    JsonWriter& field(const std::string_view name, const T& field_value) {
+        key(name);
+        return value(field_value);
+    }
+
+    [[nodiscard]] const std::string& str() const {
+        return m_output;
+    }
+};
+
+// CPU time consumed by the whole process, user and system
+inline std::chrono::nanoseconds process_cpu_time() {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto to_ns = [](const timeval& time) {
+        return std::chrono::seconds { time.tv_sec } + std::chrono::microseconds { time.tv_usec };
+    };
+    return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+}
+
+// CPU time consumed by the calling thread
+inline std::chrono::nanoseconds thread_cpu_time() {
+    timespec time {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds { time.tv_sec } + std::chrono::nanoseconds { time.tv_nsec };
+}
+
+// Latency percentiles in microseconds
+inline void write_latency(JsonWriter& json, const std::string_view name, const HdrHistogram& histogram) {
+    const auto us = [](const std::int64_t ns) { return static_cast<double>(ns) / 1000.0; };
+    json.key(name).begin_object()
+        .field("count", histogram.count())
+        .field("min_us", us(histogram.min()))
+        .field("mean_us", histogram.mean() / 1000.0)
+        .field("p50_us", us(histogram.value_at_percentile(50)))
+        .field("p90_us", us(histogram.value_at_percentile(90)))
+        .field("p99_us", us(histogram.value_at_percentile(99)))
+        .field("p99_9_us", us(histogram.value_at_percentile(99.9)))
+        .field("max_us", us(histogram.max()))
+        .end_object();
+}
+
+// The workload callback is a plain function, so the pending start is handed over through a slot
+inline std::promise<std::error_code>*& pending_server_start() {
+    static std::promise<std::error_code>* pending { nullptr };
+    return pending;
+}
+
+inline std::mutex& pending_server_start_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline void on_benchmark_server_started(void* arguments) {
+    const auto& [ec] = *static_cast<std::tuple<std::error_code>*>(arguments);
+    std::lock_guard lock { pending_server_start_mutex() };
+    if (auto*& pending = pending_server_start()) {
+        pending->set_value(ec);
+        pending = nullptr;
+    }
+}
+
+// Starts a server and waits until its socket is bound. Returns timed_out when the callback never came.
+inline std::error_code start_server_and_wait(
+    const LeScheduler& scheduler,
+    ServerConfigPtr config,
+    const std::chrono::nanoseconds timeout = std::chrono::seconds { 5 }
+) {
+    std::promise<std::error_code> started;
+    auto result = started.get_future();
+    {
+        std::lock_guard lock { pending_server_start_mutex() };
+        pending_server_start() = &started;
+    }
+    scheduler.run_immediately(Workload::create_start_server(
+        std::move(config),
+        reinterpret_cast<void*>(&on_benchmark_server_started)
+    ));
+    if (result.wait_for(timeout) != std::future_status::ready) {
+        std::lock_guard lock { pending_server_start_mutex() };
+        if (pending_server_start() == &started) {
+            pending_server_start() = nullptr;
+            return std::make_error_code(std::errc::timed_out);
+        }
+    }
+    return result.get();
+}
+
+// Stops the server on the port and waits for the pool to drain
+inline bool stop_server_and_wait(
+    const LeScheduler& scheduler,
+    const int port,
+    const std::chrono::nanoseconds timeout = std::chrono::seconds { 5 }
+) {
+    scheduler.run_immediately(Workload::create_stop_server(port));
+    return scheduler.wait_for_completion(timeout);
+}
+
+// Describes the machine and build, so runs from different releases can be told apart
+inline void write_environment(JsonWriter& json, const std::string_view benchmark, const std::string& label) {
+    char host[256] {};
+    gethostname(host, sizeof(host) - 1);
+    const auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    char timestamp[32] {};
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    json.key("environment").begin_object()
+        .field("benchmark", benchmark)
+        .field("label", label)
+        .field("timestamp", timestamp)
+        .field("host", host)
+        .field("hardware_concurrency", std::thread::hardware_concurrency())
+#if defined(__clang__)
+        .field("compiler", "clang " __clang_version__)
+#elif defined(__GNUC__)
+        .field("compiler", "gcc " __VERSION__)
+#else
+        .field("compiler", "unknown")
+#endif
+#if defined(NDEBUG)
+        .field("optimised", true)
+#else
+        .field("optimised", false)
+#endif
+        .end_object();
+}
+
+// Writes the document to the path, or to stdout when the path is "-"
+inline bool write_json_output(const std::string& path, const JsonWriter& json) {
+    if (path == "-") {
+        std::printf("%s\n", json.str().c_str());
+        return true;
+    }
+    std::ofstream file { path };
+    if (!file) {
+        std::fprintf(stderr, "[Error] Failed to open %s\n", path.c_str());
+        return false;
+    }
+    file << json.str() << '\n';
+    return static_cast<bool>(file);
+}
+
+#endif //LE_BENCHMARK_SUPPORT_HPP
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int handler_port = 7;
+
+    class SlowCallbackRecorder final {
+        mutable std::mutex m_mutex;
+        std::vector<SlowCallbackReport> m_reports;
+
+    public:
+        [[nodiscard]] SwiftFunctionWrapper<void, SlowCallbackReport> callback() {
+            return SwiftFunctionWrapper<void, SlowCallbackReport> { [this](const SlowCallbackReport report) {
+                std::lock_guard lock { m_mutex };
+                m_reports.push_back(report);
+            } };
+        }
+
+        [[nodiscard]] std::vector<SlowCallbackReport> reports() const {
+            std::lock_guard lock { m_mutex };
+            return m_reports;
+        }
+    };
+}
+
+// Callbacks are timed on a pool thread against a registry of the same size, the way handlers time theirs
+std::string engine_checks::callback_profiler() {
+    CheckReport report;
+    int session = 0;
+    SlowCallbackRecorder slow;
+    CallbackRecorder completions;
+    MetricsRegistry registry { 2 };
+    {
+        ThreadPool pool { 2 };
+        const auto metrics = registry.handler(handler_port);
+        const auto run = [&](std::function<void()> body) {
+            const auto before = completions.results().size();
+            pool.run_immediately(function_workload(std::move(body), completions));
+            return completions.wait_for(before + 1);
+        };
+
+        report.expect(run([&] { metrics->time_callback(HandlerType::TcpOnConnect, &session, [] {}); }), "a callback runs");
+        report.expect(registry.profiler().snapshot(HandlerType::TcpOnConnect).latency.count == 0,
+                      "a disabled profiler records nothing");
+
+        registry.profiler().enable(CallbackProfilerConfig {
+            .slow_threshold = std::chrono::milliseconds { 20 },
+            .scan_interval = std::chrono::milliseconds { 2 },
+            .on_slow_callback = slow.callback(),
+        });
+        report.expect(run([&] {
+            metrics->time_callback(HandlerType::TcpOnRceive, &session, [] {
+                std::this_thread::sleep_for(std::chrono::milliseconds { 80 });
+            });
+            for (int i = 0; i < 10; ++i) {
+                metrics->time_callback(HandlerType::TcpOnWrite, &session, [] {});
+            }
+        }), "profiled callbacks run");
+        registry.profiler().disable();
+        report.expect(run([&] { metrics->time_callback(HandlerType::TcpOnWrite, &session, [] {}); }),
+                      "a callback runs after profiling stops");
+    }
+
+    const auto slow_profile = registry.profiler().snapshot(HandlerType::TcpOnRceive);
+    report.expect(slow_profile.latency.count == 1, "the slow callback is measured");
+    report.expect(slow_profile.slow_calls == 1, "the slow callback is counted as slow");
+    report.expect(slow_profile.latency.max_ns >= 40'000'000, "the latency of the slow callback is kept");
+    const auto fast_profile = registry.profiler().snapshot(HandlerType::TcpOnWrite);
+    report.expect(fast_profile.latency.count == 10, "callbacks are grouped by handler type, none after disable");
+    report.expect(fast_profile.slow_calls == 0, "fast callbacks are not slow");
+
+    const auto reports = slow.reports();
+    report.expect(reports.size() == 1, "the watchdog reports a stuck callback once while it runs");
+    if (!reports.empty()) {
+        report.expect(reports[0].handler_type == HandlerType::TcpOnRceive, "the report names the handler type");
+        report.expect(reports[0].port == handler_port, "the report names the port");
+        report.expect(reports[0].session == &session, "the report names the session");
+        report.expect(reports[0].worker < 2, "the report names the worker");
+        report.expect(reports[0].elapsed >= std::chrono::milliseconds { 20 }, "the callback was over the threshold when found");
+    }
+    return report.failures();
+}
@@ -0,0 +1,209 @@
+#ifndef LE_CHECK_REPORT_HPP
+#define LE_CHECK_REPORT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include <cxxLumengine.hpp>
+
+// Collects the failed expectations of one check
+class CheckReport final {
+    std::string m_failures;
+
+public:
+    void expect(const bool holds, const std::string_view what) {
+        if (!holds) {
+            m_failures.append(what);
+            m_failures.push_back('\n');
+        }
+    }
+
+    void expect_error(const std::error_code& ec, const CustomErrorCode expected, const std::string_view what) {
+        expect(ec == make_error_code(expected), std::string { what } + " (got " + (ec ? ec.message() : "no error") + ")");
+    }
+
+    [[nodiscard]] std::string failures() const {
+        return m_failures;
+    }
+};
+
+// Polls the condition until it holds, returns false when it did not within the timeout
+template <typename Condition>
+bool wait_until(Condition&& condition, const std::chrono::milliseconds timeout = std::chrono::seconds { 5 }) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+    }
+    return true;
+}
+
+// The results a workload callback receives, from any pool thread. Must outlive the pool.
+class CallbackRecorder final {
+    mutable std::mutex m_mutex;
+    std::vector<std::error_code> m_results;
+
+public:
+    [[nodiscard]] SwiftFunctionWrapper<void, std::error_code> callback() {
+        return SwiftFunctionWrapper<void, std::error_code> { [this](const std::error_code ec) {
+            std::lock_guard lock { m_mutex };
+            m_results.push_back(ec);
+        } };
+    }
+
+    [[nodiscard]] std::vector<std::error_code> results() const {
+        std::lock_guard lock { m_mutex };
+        return m_results;
+    }
+
+    // Returns false when fewer results arrived within the timeout
+    bool wait_for(const std::size_t count, const std::chrono::milliseconds timeout = std::chrono::seconds { 5 }) const {
+        return wait_until([this, count] { return results().size() >= count; }, timeout);
+    }
+};
+
+// Workloads around plain C++ functions, the checks have no Swift closures to hand over
+inline Workload function_workload(std::function<void()> body, CallbackRecorder& recorder) {
+    Workload workload { WorkloadTypeVariant(FunctionWorkload(std::move(body))) };
+    workload.callback = recorder.callback();
+    return workload;
+}
+
+inline Workload parallel_for_workload(const std::size_t begin, const std::size_t end, const std::size_t grain,
+                                      std::function<void(std::size_t, std::size_t)> body, CallbackRecorder& recorder) {
+    Workload workload { WorkloadTypeVariant(ParallelForWorkload {
+        begin,
+        end,
+        grain,
+        SwiftFunctionWrapper<void, std::size_t, std::size_t>(std::move(body))
+    }) };
+    workload.callback = recorder.callback();
+    return workload;
+}
+
+// A TCP config whose sessions read until the peer goes away. Checks replace the callbacks they look at.
+inline TcpConfig tcp_config() {
+    return TcpConfig {
+        .read_buffer_size = 4096,
+        .pre_allocated_session_count = 16,
+        .on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code> {
+            [](const TcpSessionPtr&, const std::error_code ec) {
+                return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+            }
+        },
+        .on_receive = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t> {
+            [](const TcpSessionPtr&, const std::error_code ec, size_t) {
+                return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+            }
+        },
+        .on_write = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t> {
+            [](const TcpSessionPtr&, const std::error_code ec, size_t) {
+                return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+            }
+        },
+        .on_disconnect = SwiftFunctionWrapper<void, TcpSessionPtr, std::error_code> { [](const TcpSessionPtr&, std::error_code) {} },
+        .on_start = SwiftFunctionWrapper<void, TcpHandlerPtr> { [](const TcpHandlerPtr&) {} },
+        .on_stop = SwiftFunctionWrapper<void, TcpHandlerPtr> { [](const TcpHandlerPtr&) {} },
+    };
+}
+
+// Starts a TCP server on the pool and waits until it listens, returns false when it does not
+inline bool start_tcp_server(ThreadPool& pool, const int port, TcpConfig config) {
+    const auto listening = std::make_shared<std::atomic<bool>>(false);
+    config.on_start = SwiftFunctionWrapper<void, TcpHandlerPtr> { [listening](const TcpHandlerPtr&) { *listening = true; } };
+    pool.run_immediately(Workload { WorkloadTypeVariant(StartServerWorkload {
+        std::make_shared<ServerConfig>(port, false, ProtocolHandlerConfigVariant { std::move(config) })
+    }) });
+    return wait_until([&listening] { return listening->load(); });
+}
+
+inline void stop_server(ThreadPool& pool, const int port) {
+    pool.run_immediately(Workload { WorkloadTypeVariant(StopServerWorkload { port }) });
+}
+
+inline asio::ip::tcp::endpoint loopback(const int port) {
+    return { asio::ip::address_v4::loopback(), static_cast<asio::ip::port_type>(port) };
+}
+
+// A blocking connection to the server on the port
+inline asio::ip::tcp::socket connect_to(asio::io_context& io_context, const int port, std::error_code& ec) {
+    asio::ip::tcp::socket socket { io_context };
+    ec = socket.connect(loopback(port), ec);
+    return socket;
+}
+
+inline bool send_all(asio::ip::tcp::socket& socket, const std::string_view bytes) {
+    std::error_code ec;
+    asio::write(socket, asio::buffer(bytes.data(), bytes.size()), ec);
+    return !ec;
+}
+
+// Waits for the socket to become readable, so a check fails instead of hanging when nothing arrives
+inline bool readable(asio::ip::tcp::socket& socket, const std::chrono::milliseconds timeout = std::chrono::seconds { 5 }) {
+    pollfd descriptor { socket.native_handle(), POLLIN, 0 };
+    return ::poll(&descriptor, 1, static_cast<int>(timeout.count())) == 1;
+}
+
+// Up to count bytes, fewer when the peer closes, fails or is too slow
+inline std::string receive(asio::ip::tcp::socket& socket, const std::size_t count) {
+    std::string bytes(count, '\0');
+    std::size_t received = 0;
+    std::error_code ec;
+    while (received < count && !ec && readable(socket)) {
+        received += socket.read_some(asio::buffer(bytes.data() + received, count - received), ec);
+    }
+    bytes.resize(received);
+    return bytes;
+}
+
+// True when the peer closed its side, false when bytes arrive or nothing happens in time
+inline bool receive_eof(asio::ip::tcp::socket& socket) {
+    if (!readable(socket)) {
+        return false;
+    }
+    char byte;
+    std::error_code ec;
+    socket.read_some(asio::buffer(&byte, 1), ec);
+    return ec == asio::error::eof || ec == asio::error::connection_reset;
+}
+
+// Hands the bytes to the assembler the way a session reads them: buffered frames are collected first and a read
+// only happens when none is complete, of as many bytes as fit. on_collect sees the assembler after every collect.
+// Returns the first error of a collect.
+template <typename OnCollect>
+std::error_code feed(FrameAssembler& assembler, std::string_view bytes, OnCollect&& on_collect) {
+    for (;;) {
+        const auto ec = assembler.collect();
+        on_collect(assembler);
+        if (ec) {
+            return ec;
+        }
+        if (!assembler.frames().empty()) {
+            continue;
+        }
+        if (bytes.empty()) {
+            return {};
+        }
+        const auto space = assembler.prepare();
+        const auto size = std::min(space.size(), bytes.size());
+        std::memcpy(space.data(), bytes.data(), size);
+        assembler.commit(size);
+        bytes.remove_prefix(size);
+    }
+}
+
+#endif //LE_CHECK_REPORT_HPP
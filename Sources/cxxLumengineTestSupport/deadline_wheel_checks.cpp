@@ -0,0 +1,99 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    using Clock = DeadlineWheel::Clock;
+
+    constexpr auto turn = DeadlineWheel::tick * 512;
+
+    struct Target {
+        // When the wheel checked the target, and whether any check came before the deadline it was scheduled for
+        std::vector<Clock::time_point> checked;
+        bool early { false };
+        // Deadlines the target moves on to, one per check, before it lets its entry go
+        std::vector<Clock::time_point> next;
+    };
+
+    Clock::time_point check(void* target, const Clock::time_point scheduled_for, const Clock::time_point now) {
+        auto& state = *static_cast<Target*>(target);
+        state.checked.push_back(now);
+        state.early = state.early || now < scheduled_for;
+        if (state.next.empty()) {
+            return Clock::time_point::max();
+        }
+        const auto next = state.next.front();
+        state.next.erase(state.next.begin());
+        return next;
+    }
+
+    // Advances in steps of a second, as a timer that is never late would
+    void run_until(DeadlineWheel& wheel, Clock::time_point& now, const Clock::time_point until) {
+        while (now < until) {
+            now = std::min(now + std::chrono::seconds { 1 }, until);
+            wheel.advance_to(now);
+        }
+    }
+
+    void check_wrap(CheckReport& report) {
+        asio::io_context io_context;
+        DeadlineWheel wheel { io_context };
+        auto now = Clock::now();
+        const auto start = now;
+        const auto soon = std::make_shared<Target>();
+        // Shares the slot of soon, one and three turns later
+        const auto next_turn = std::make_shared<Target>();
+        const auto third_turn = std::make_shared<Target>();
+        wheel.schedule(soon, &check, start + std::chrono::seconds { 1 });
+        wheel.schedule(next_turn, &check, start + turn + std::chrono::seconds { 1 });
+        wheel.schedule(third_turn, &check, start + turn * 3 + std::chrono::seconds { 1 });
+
+        run_until(wheel, now, start + std::chrono::seconds { 2 });
+        report.expect(soon->checked.size() == 1, "a deadline in the first turn fires in it");
+        report.expect(next_turn->checked.empty() && third_turn->checked.empty(),
+                      "deadlines of later turns in the same slot do not fire in the first turn");
+        run_until(wheel, now, start + turn + std::chrono::seconds { 2 });
+        report.expect(next_turn->checked.size() == 1, "a deadline one turn away fires after the wheel wraps");
+        report.expect(third_turn->checked.empty(), "a deadline three turns away waits through the wraps before it");
+        run_until(wheel, now, start + turn * 3 + std::chrono::seconds { 2 });
+        report.expect(third_turn->checked.size() == 1, "a deadline three turns away fires in its turn");
+        report.expect(soon->checked.size() == 1 && next_turn->checked.size() == 1, "a dropped entry never fires again");
+        report.expect(!soon->early && !next_turn->early && !third_turn->early, "no deadline fires early");
+        report.expect(wheel.size() == 0, "fired entries leave the wheel");
+    }
+
+    void check_stall_and_moves(CheckReport& report) {
+        asio::io_context io_context;
+        DeadlineWheel wheel { io_context };
+        const auto start = Clock::now();
+        const auto moving = std::make_shared<Target>();
+        // Moved on twice, the second time across a wrap
+        moving->next = { start + std::chrono::seconds { 5 }, start + turn + std::chrono::seconds { 10 } };
+        auto dropped = std::make_shared<Target>();
+        const auto overdue = std::make_shared<Target>();
+        wheel.schedule(moving, &check, start + std::chrono::seconds { 1 });
+        wheel.schedule(dropped, &check, start + std::chrono::seconds { 1 });
+        wheel.schedule(overdue, &check, start - std::chrono::seconds { 1 });
+        dropped.reset();
+
+        // A stall of two turns, the wheel catches up one turn per call
+        const auto late = start + turn * 2;
+        for (int i = 0; i < 3; ++i) {
+            wheel.advance_to(late);
+        }
+        report.expect(overdue->checked.size() == 1, "a deadline that is already due fires on the next tick");
+        report.expect(moving->checked.size() == 3, "a target moving its deadline on is checked at every deadline, across the wrap");
+        report.expect(!moving->early, "moved deadlines do not fire early");
+        report.expect(wheel.size() == 0, "the entry of a destroyed target is dropped");
+    }
+}
+
+std::string engine_checks::deadline_wheel() {
+    CheckReport report;
+    check_wrap(report);
+    check_stall_and_moves(report);
+    return report.failures();
+}
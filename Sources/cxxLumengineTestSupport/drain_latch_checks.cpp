@@ -0,0 +1,40 @@
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+std::string engine_checks::drain_latch() {
+    CheckReport report;
+    DrainLatch latch;
+    report.expect(latch.wait_for(std::chrono::milliseconds { 1 }), "an empty latch does not block");
+
+    constexpr std::size_t count = 8;
+    for (std::size_t i = 0; i < count; ++i) {
+        latch.add();
+    }
+    report.expect(latch.count() == count, "the latch counts outstanding work");
+    report.expect(!latch.wait_for(std::chrono::milliseconds { 10 }), "waiting times out while work is outstanding");
+
+    std::vector<std::future<void>> waiters;
+    for (int i = 0; i < 3; ++i) {
+        waiters.push_back(std::async(std::launch::async, [&latch] { latch.wait(); }));
+    }
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < count; ++i) {
+        workers.emplace_back([&latch] { latch.done(); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    bool woken = true;
+    for (auto& waiter : waiters) {
+        woken = woken && waiter.wait_for(std::chrono::seconds { 5 }) == std::future_status::ready;
+    }
+    report.expect(woken, "every waiter wakes up when the count drops to zero");
+    report.expect(latch.count() == 0, "finished work is no longer counted");
+    return report.failures();
+}
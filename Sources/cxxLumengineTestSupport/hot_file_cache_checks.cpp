@@ -0,0 +1,105 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    void write_file(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream { path, std::ios::binary | std::ios::trunc } << contents;
+    }
+
+    // Files are replaced by a rename, the way the cache wants them to be, so the inode changes
+    void replace_file(const std::filesystem::path& path, const std::string& contents) {
+        auto temporary = path;
+        temporary += ".new";
+        write_file(temporary, contents);
+        std::filesystem::rename(temporary, path);
+    }
+
+    void check_revalidation(CheckReport& report, const std::filesystem::path& directory) {
+        const auto path = (directory / "page.html").string();
+        write_file(path, "first");
+        HotFileCache cache { 1024, std::chrono::milliseconds { 50 } };
+        std::error_code ec;
+
+        const auto first = cache.get(path, ec);
+        report.expect(!ec && first.to_string() == "first", "a file is read through the cache");
+        report.expect(cache.get(path, ec).pointer() == first.pointer(), "a second get shares the mapping");
+
+        replace_file(path, "second!");
+        report.expect(cache.get(path, ec).to_string() == "first", "a changed file is served until the next check");
+        std::this_thread::sleep_for(std::chrono::milliseconds { 60 });
+        report.expect(cache.get(path, ec).to_string() == "second!", "a changed file is mapped again after the interval");
+        report.expect(first.to_string() == "first", "a view keeps its mapping after the file changed");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds { 60 });
+        const auto unchanged = cache.get(path, ec);
+        report.expect(unchanged.to_string() == "second!", "an unchanged file passes the check");
+        replace_file(path, "third");
+        cache.invalidate(path);
+        report.expect(cache.get(path, ec).to_string() == "third", "an invalidated file is mapped again right away");
+
+        const auto stats = cache.stats();
+        report.expect(stats.misses == 3, "every mapping is a miss");
+        report.expect(stats.hits == 3, "every served mapping is a hit, checked or not");
+        report.expect(stats.entries == 1 && stats.bytes == 5, "a file has one entry");
+
+        std::filesystem::remove(path);
+        std::this_thread::sleep_for(std::chrono::milliseconds { 60 });
+        report.expect(cache.get(path, ec).empty() && ec == std::errc::no_such_file_or_directory, "a removed file is an error");
+        report.expect(cache.stats().entries == 0, "a removed file leaves the cache");
+        ec = {};
+        report.expect(cache.get(directory.string(), ec).empty() && ec == std::errc::invalid_argument, "a directory is not served");
+    }
+
+    void check_eviction(CheckReport& report, const std::filesystem::path& directory) {
+        const auto a = (directory / "a").string();
+        const auto b = (directory / "b").string();
+        const auto c = (directory / "c").string();
+        const auto large = (directory / "large").string();
+        write_file(a, std::string(40, 'a'));
+        write_file(b, std::string(40, 'b'));
+        write_file(c, std::string(40, 'c'));
+        write_file(large, std::string(200, 'l'));
+        HotFileCache cache { 100, std::chrono::seconds { 10 } };
+        std::error_code ec;
+
+        const auto first = cache.get(a, ec);
+        (void) cache.get(b, ec);
+        // a is used again, so b is the least recently used once c needs the room
+        (void) cache.get(a, ec);
+        (void) cache.get(c, ec);
+        auto stats = cache.stats();
+        report.expect(stats.evictions == 1 && stats.entries == 2 && stats.bytes == 80, "the budget is kept by evicting");
+        report.expect(first.to_string() == std::string(40, 'a'), "a view outlives the eviction of others");
+
+        const auto misses = stats.misses;
+        (void) cache.get(a, ec);
+        report.expect(cache.stats().misses == misses, "the recently used file stays");
+        (void) cache.get(b, ec);
+        report.expect(cache.stats().misses == misses + 1, "the least recently used file was evicted");
+
+        report.expect(cache.get(large, ec).size() == 200 && !ec, "a file over the budget is served");
+        stats = cache.stats();
+        report.expect(stats.entries == 2 && stats.bytes <= 100, "a file over the budget is not cached");
+        cache.clear();
+        report.expect(cache.stats().entries == 0 && cache.stats().bytes == 0, "clear drops every entry");
+        for (const auto& path : { a, b, c, large }) {
+            std::filesystem::remove(path);
+        }
+    }
+}
+
+std::string engine_checks::hot_file_cache() {
+    CheckReport report;
+    const auto directory = std::filesystem::temp_directory_path() / "lumengine_hot_file_cache_check";
+    std::filesystem::create_directories(directory);
+    check_revalidation(report, directory);
+    check_eviction(report, directory);
+    std::filesystem::remove_all(directory);
+    return report.failures();
+}
@@ -0,0 +1,81 @@
+#include <string>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    TcpFraming http_framing() {
+        TcpFraming framing;
+        framing.mode = TcpFramingMode::Http;
+        framing.max_frame_size = 1024;
+        return framing;
+    }
+
+    // The error reported once the request arrives in one read
+    std::error_code parse_error(const std::string_view request) {
+        FrameAssembler assembler { http_framing(), 256 };
+        return feed(assembler, request, [](const FrameAssembler&) {});
+    }
+
+    // Feeds the bytes in reads of the given size and returns the bodies of the requests, in order
+    std::vector<std::string> bodies_of(const std::string_view bytes, const std::size_t read_size, std::error_code& ec) {
+        FrameAssembler assembler { http_framing(), 32 };
+        std::vector<std::string> bodies;
+        for (std::size_t position = 0; position < bytes.size() && !ec; position += read_size) {
+            ec = feed(assembler, bytes.substr(position, read_size), [&bodies](const FrameAssembler& collected) {
+                for (const auto& request : collected.requests()) {
+                    bodies.emplace_back(request.body.view());
+                }
+            });
+        }
+        return bodies;
+    }
+
+    void check_smuggling(CheckReport& report) {
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n"),
+                            CustomErrorCode::HttpBadRequest, "Content-Length with Transfer-Encoding is rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n0\r\n\r\n"),
+                            CustomErrorCode::HttpBadRequest, "Transfer-Encoding with Content-Length is rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\nhello!"),
+                            CustomErrorCode::HttpBadRequest, "conflicting Content-Length headers are rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n0\r\n\r\n"),
+                            CustomErrorCode::HttpBadRequest, "a final coding other than chunked is rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nContent-Length: +5\r\n\r\nhello"),
+                            CustomErrorCode::HttpBadRequest, "a signed Content-Length is rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nContent-Length: 2048\r\n\r\n"),
+                            CustomErrorCode::FrameTooLarge, "a body over the frame limit is too large");
+
+        std::error_code ec;
+        const auto bodies = bodies_of("POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello", 64, ec);
+        report.expect(!ec && bodies == std::vector<std::string> { "hello" }, "repeated equal Content-Length headers are accepted");
+    }
+
+    void check_chunked(CheckReport& report) {
+        const std::string_view bytes =
+            "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "5\r\nhello\r\n6;name=value\r\n world\r\n0\r\nTrailer: dropped\r\n\r\n"
+            "POST /next HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc";
+        for (const std::size_t read_size : { std::size_t { 1 }, std::size_t { 2 }, std::size_t { 7 }, bytes.size() }) {
+            std::error_code ec;
+            const auto bodies = bodies_of(bytes, read_size, ec);
+            const auto what = "reads of " + std::to_string(read_size) + " bytes";
+            report.expect(!ec, what + ": no error");
+            report.expect(bodies.size() == 2, what + ": both pipelined requests are parsed");
+            report.expect(!bodies.empty() && bodies[0] == "hello world", what + ": the chunks are joined");
+            report.expect(bodies.size() > 1 && bodies[1] == "abc", what + ": the request after the chunked one is intact");
+        }
+
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX\r\n0\r\n\r\n"),
+                            CustomErrorCode::HttpBadRequest, "a chunk longer than its size is rejected");
+        report.expect_error(parse_error("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"),
+                            CustomErrorCode::HttpBadRequest, "a chunk size that is not hex is rejected");
+    }
+}
+
+std::string engine_checks::http_parser() {
+    CheckReport report;
+    check_smuggling(report);
+    check_chunked(report);
+    return report.failures();
+}
@@ -0,0 +1,55 @@
+#ifndef LE_ENGINE_CHECKS_HPP
+#define LE_ENGINE_CHECKS_HPP
+
+#include <string>
+
+// Checks of the engine internals that Swift cannot reach, run by the Swift tests
+// Each check returns its failed expectations, one per line, and an empty string when all of them hold.
+namespace engine_checks {
+    // Chunks cover the range once within the grain or as a whole, idle threads steal, the callback runs once at the end
+    std::string parallel_for();
+    // Nodes run after their dependencies, cycles and missing graphs are rejected without running a node
+    std::string workload_graph();
+    // Cancelling a handle or a group, and deadlines, before and while a workload runs
+    std::string workload_handles();
+    // Sessions accepted while a TCP server stops are closed with it
+    std::string tcp_stop();
+    // Waiting for an idle pool with and without a timeout, and from a pool thread
+    std::string wait_for_completion();
+    // Waiters wake up once the outstanding work is done
+    std::string drain_latch();
+    // A UDP server left running is stopped when its thread pool is destroyed
+    std::string udp_stop();
+    // Shards of every worker add up in snapshots, handlers are kept apart from the pool
+    std::string metrics();
+    // Callback latency by handler type, and the watchdog report of a callback that blocks its worker
+    std::string callback_profiler();
+    // Probe lag of a blocked worker, handler counts with and without the probe
+    std::string loop_monitor();
+    // Events of pool and other threads between start and stop, exported as a Chrome trace, also while recording
+    std::string tracing();
+    // Pooled connections are reused, checked before they are handed out and closed once idle for too long, connects time out
+    std::string tcp_client();
+    // Splices run to the end of both directions or stop part way and hand the sockets back
+    std::string tcp_splice();
+    // Frames split across reads, batches of frames and frames over the size limit
+    std::string length_prefix_framing();
+    // Delimiters split across reads, many records per callback, records over the size limit and every SIMD level
+    std::string delimiter_framing();
+    // Ambiguous request framing is rejected, chunked bodies split across reads are joined
+    std::string http_parser();
+    // Fragments are joined across reads and around control frames, empty fragments included
+    std::string websocket();
+    // Handshakes, resumption across workers and broken setups, or the error of a build without TLS
+    std::string tls();
+    // Ranges of a path or a descriptor, invalid ranges and files that shrink during the send
+    std::string tcp_send_file();
+    // Changed files are mapped again after the revalidate interval, least recently used files are evicted
+    std::string hot_file_cache();
+    // Pooled buffers are handed out again, the sizer grows and shrinks after the reads
+    std::string read_buffer_pool();
+    // Deadlines fire in their turn of the timing wheel, across wraps and stalls
+    std::string deadline_wheel();
+}
+
+#endif //LE_ENGINE_CHECKS_HPP
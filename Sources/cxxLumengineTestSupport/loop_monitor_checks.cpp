@@ -0,0 +1,56 @@
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    // A callback that blocks the only worker makes the probe due while it runs
+    void check_lag(CheckReport& report) {
+        constexpr std::size_t count = 20;
+        CallbackRecorder completions;
+        ThreadPool pool { ThreadPoolConfig { .thread_count = 1, .loop_probe_interval = std::chrono::milliseconds { 5 } } };
+        report.expect(wait_until([&pool] { return pool.loop_snapshots().at(0).probes >= 2; }), "the probe runs every interval");
+
+        pool.run_immediately(function_workload([] { std::this_thread::sleep_for(std::chrono::milliseconds { 60 }); }, completions));
+        for (std::size_t i = 0; i < count; ++i) {
+            pool.run_immediately(function_workload([] {}, completions));
+        }
+        report.expect(completions.wait_for(count + 1), "the workloads complete");
+        report.expect(wait_until([&pool] { return pool.loop_snapshots().at(0).lag.max_ns >= 30'000'000; }),
+                      "a blocked worker shows as lag");
+
+        const auto loops = pool.loop_snapshots();
+        report.expect(loops.size() == 1, "there is one snapshot per worker");
+        const auto& loop = loops.at(0);
+        report.expect(loop.index == 0, "the snapshot names its worker");
+        report.expect(loop.handlers_run > count, "every handler is counted");
+        report.expect(loop.lag.count == loop.probes, "every probe records its lag");
+        report.expect(loop.max_queue_depth >= loop.queue_depth, "the deepest queue is kept");
+        report.expect(loop.busy_ns + loop.idle_ns > 0, "busy and idle time add up to the time since start");
+        report.expect(loop.utilisation >= 0 && loop.utilisation <= 1, "utilisation is a share");
+    }
+
+    void check_disabled(CheckReport& report) {
+        CallbackRecorder completions;
+        ThreadPool pool { ThreadPoolConfig { .thread_count = 2, .loop_probe_interval = std::chrono::nanoseconds { 0 } } };
+        pool.run_immediately(function_workload([] {}, completions));
+        pool.run_immediately(function_workload([] {}, completions));
+        report.expect(completions.wait_for(2), "the workloads complete");
+        std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+        std::uint64_t handlers = 0;
+        for (const auto& loop : pool.loop_snapshots()) {
+            report.expect(loop.probes == 0, "a zero interval disables the probe");
+            handlers += loop.handlers_run;
+        }
+        report.expect(handlers >= 2, "handlers are counted without the probe");
+    }
+}
+
+std::string engine_checks::loop_monitor() {
+    CheckReport report;
+    check_lag(report);
+    check_disabled(report);
+    return report.failures();
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int handler_port = 1;
+
+    // Workloads run round robin on every worker, each records into the shard of its own thread
+    void check_pool_shards(CheckReport& report) {
+        constexpr std::size_t count = 64;
+        CallbackRecorder completions;
+        ThreadPool pool { 4 };
+        for (std::size_t i = 0; i < count; ++i) {
+            pool.run_immediately(function_workload([] {}, completions));
+        }
+        report.expect(completions.wait_for(count), "the workloads complete");
+        report.expect(pool.wait_for_completion(std::chrono::seconds { 5 }), "the pool becomes idle");
+        const auto snapshot = pool.metrics_snapshot();
+        report.expect(snapshot.workloads_submitted == count, "every submitted workload is counted");
+        report.expect(snapshot.workloads_started == count, "the starts of all workers add up");
+        report.expect(snapshot.workloads_completed == count, "the completions of all workers add up");
+        report.expect(snapshot.workload_queue_depth == 0, "an idle pool has an empty queue");
+        report.expect(snapshot.workload_duration.count == count, "every workload duration is recorded");
+        report.expect(snapshot.workload_queue_delay.count == count, "every queue delay is recorded");
+    }
+
+    // Threads outside the pool share a shard, concurrent adds are not lost
+    void check_registry(CheckReport& report) {
+        constexpr std::uint64_t adds = 10000;
+        MetricsRegistry registry { 2 };
+        const auto handler = registry.handler(handler_port);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&registry, &handler] {
+                for (std::uint64_t n = 0; n < adds; ++n) {
+                    registry.pool().add(MetricCounter::WorkloadsSubmitted);
+                    handler->add(MetricCounter::TcpBytesIn, 2);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        report.expect(registry.handler(handler_port) == handler, "a port keeps its metrics");
+
+        for (int i = 0; i < 99; ++i) {
+            handler->record(MetricHistogram::CallbackDuration, std::chrono::milliseconds { 1 });
+        }
+        handler->record(MetricHistogram::CallbackDuration, std::chrono::milliseconds { 100 });
+
+        const auto port = registry.snapshot(handler_port);
+        report.expect(port.tcp_bytes_in == 8 * adds, "concurrent adds to a handler are not lost");
+        report.expect(port.workloads_submitted == 0, "the snapshot of a port leaves out the pool");
+        report.expect(port.callback_duration.count == 100, "every duration is counted");
+        report.expect(port.callback_duration.sum_ns == 99'000'000 + 100'000'000, "the durations add up");
+        report.expect(port.callback_duration.p50_ns < 10'000'000, "the median is near the common duration");
+        report.expect(port.callback_duration.max_ns >= 50'000'000, "the maximum is near the slowest duration");
+
+        const auto total = registry.snapshot();
+        report.expect(total.workloads_submitted == 4 * adds, "concurrent adds to the pool are not lost");
+        report.expect(total.tcp_bytes_in == port.tcp_bytes_in, "the total includes the handlers");
+        report.expect(registry.snapshot(handler_port + 1).tcp_bytes_in == 0, "a port that never listened is empty");
+    }
+}
+
+std::string engine_checks::metrics() {
+    CheckReport report;
+    check_pool_shards(report);
+    check_registry(report);
+    return report.failures();
+}
@@ -0,0 +1,124 @@
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    void check_split(CheckReport& report) {
+        constexpr std::size_t begin = 3;
+        constexpr std::size_t end = 1003;
+        constexpr std::size_t grain = 7;
+        std::vector<std::atomic<int>> hits(end);
+        std::atomic<bool> outside_chunk { false };
+        std::atomic<int> hits_at_completion { -1 };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 4 };
+            auto workload = parallel_for_workload(begin, end, grain, [&](const std::size_t chunk_begin, const std::size_t chunk_end) {
+                if (chunk_begin < begin || chunk_end > end || chunk_begin >= chunk_end || chunk_end - chunk_begin > grain) {
+                    outside_chunk = true;
+                }
+                for (auto i = chunk_begin; i < chunk_end; ++i) {
+                    ++hits[i];
+                }
+            }, completions);
+            workload.callback = SwiftFunctionWrapper<void, std::error_code> { [&hits, &hits_at_completion, record = *workload.callback](const std::error_code ec) {
+                int total = 0;
+                for (const auto& hit : hits) {
+                    total += hit;
+                }
+                hits_at_completion = total;
+                record.call(ec);
+            } };
+            pool.run_immediately(std::move(workload));
+            report.expect(completions.wait_for(1), "the parallel for completes");
+        }
+        bool once = true;
+        for (std::size_t i = 0; i < end; ++i) {
+            once = once && hits[i] == (i >= begin ? 1 : 0);
+        }
+        report.expect(once, "every index of the range is run exactly once");
+        report.expect(!outside_chunk, "chunks stay within the range and the grain");
+        report.expect(hits_at_completion == static_cast<int>(end - begin), "the callback runs after the last chunk");
+        const auto results = completions.results();
+        report.expect(results.size() == 1, "the callback runs once");
+        report.expect(!results.empty() && !results[0], "the callback reports success");
+    }
+
+    // The first chunk blocks its thread until every other index is done, which needs the other thread to steal
+    void check_steal(CheckReport& report) {
+        constexpr std::size_t count = 64;
+        std::atomic<std::size_t> done { 0 };
+        std::atomic<bool> blocked { false };
+        std::atomic<bool> stolen { false };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 2 };
+            pool.run_immediately(parallel_for_workload(0, count, 1, [&](const std::size_t chunk_begin, const std::size_t chunk_end) {
+                if (!blocked.exchange(true)) {
+                    stolen = wait_until([&] { return done == count - (chunk_end - chunk_begin); });
+                }
+                done += chunk_end - chunk_begin;
+            }, completions));
+            report.expect(completions.wait_for(1), "the parallel for with a blocked thread completes");
+        }
+        report.expect(stolen, "an idle thread steals the chunks of a blocked one");
+        report.expect(completions.results().size() == 1, "the callback of the stolen range runs once");
+    }
+
+    void check_empty(CheckReport& report) {
+        std::atomic<int> calls { 0 };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 2 };
+            pool.run_immediately(parallel_for_workload(5, 5, 0, [&](std::size_t, std::size_t) { ++calls; }, completions));
+            pool.run_immediately(parallel_for_workload(9, 2, 1, [&](std::size_t, std::size_t) { ++calls; }, completions));
+            report.expect(completions.wait_for(2), "empty ranges complete");
+            std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+        }
+        const auto results = completions.results();
+        report.expect(calls == 0, "the body never runs for an empty range");
+        report.expect(results.size() == 2, "an empty range calls back once");
+        report.expect(std::all_of(results.begin(), results.end(), [](const std::error_code& ec) { return !ec; }),
+                      "an empty range reports success");
+    }
+
+    // Grains over the range, at the end of size_t where the end of a grain sized chunk would wrap around
+    void check_large_grain(CheckReport& report) {
+        constexpr auto max = std::numeric_limits<std::size_t>::max();
+        constexpr std::size_t begin = max - 1000;
+        constexpr std::size_t end = max - 1;
+        for (const std::size_t grain : { std::size_t { 2000 }, max }) {
+            std::mutex mutex;
+            std::vector<std::pair<std::size_t, std::size_t>> chunks;
+            CallbackRecorder completions;
+            {
+                ThreadPool pool { 4 };
+                pool.run_immediately(parallel_for_workload(begin, end, grain, [&](const std::size_t chunk_begin, const std::size_t chunk_end) {
+                    std::lock_guard lock { mutex };
+                    chunks.emplace_back(chunk_begin, chunk_end);
+                }, completions));
+                report.expect(completions.wait_for(1), "a parallel for with a grain over the range completes");
+            }
+            std::lock_guard lock { mutex };
+            report.expect(chunks == std::vector<std::pair<std::size_t, std::size_t>> { { begin, end } },
+                          "a grain of " + std::to_string(grain) + " over the range runs it as one chunk");
+        }
+    }
+}
+
+std::string engine_checks::parallel_for() {
+    CheckReport report;
+    check_split(report);
+    check_steal(report);
+    check_empty(report);
+    check_large_grain(report);
+    return report.failures();
+}
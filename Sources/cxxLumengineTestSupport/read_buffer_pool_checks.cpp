@@ -0,0 +1,74 @@
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    void check_pool(CheckReport& report) {
+        report.expect(ReadBufferPool::class_size(1) == ReadBufferPool::min_class_size, "small sizes use the smallest class");
+        report.expect(ReadBufferPool::class_size(3000) == 4096, "sizes round up to a power of two");
+
+        // Checked on a thread of its own, so its free lists start empty
+        std::thread { [&report] {
+            const char* first;
+            {
+                const auto buffer = ReadBufferPool::acquire(3000);
+                report.expect(buffer.size() == 4096, "a buffer has the size of its class");
+                first = buffer.pointer();
+            }
+            {
+                const auto buffer = ReadBufferPool::acquire(4096);
+                report.expect(buffer.pointer() == first, "a released buffer is handed out again");
+                const auto other = ReadBufferPool::acquire(4096);
+                report.expect(other.pointer() != first, "a buffer in use is not handed out twice");
+                const auto smaller = ReadBufferPool::acquire(1024);
+                report.expect(smaller.size() == 1024 && smaller.pointer() != first, "classes keep their own buffers");
+            }
+            const auto large = ReadBufferPool::acquire(ReadBufferPool::max_class_size + 1);
+            report.expect(large.size() == ReadBufferPool::max_class_size + 1, "a buffer over the largest class has the size asked for");
+        } }.join();
+    }
+
+    void check_sizer(CheckReport& report) {
+        ReadBufferSizer sizer { TcpReadBufferSizing { .adaptive = true, .min_size = 1024, .max_size = 8192 }, 3000 };
+        report.expect(sizer.size() == 4096, "the initial size is rounded up to its class");
+
+        sizer.record(4096);
+        report.expect(sizer.size() == 4096, "one full read does not grow");
+        sizer.record(4096);
+        report.expect(sizer.size() == 8192, "two full reads in a row double the size");
+        sizer.record(8192);
+        sizer.record(8192);
+        report.expect(sizer.size() == 8192, "the size stops at the maximum");
+
+        for (int i = 0; i < 15; ++i) {
+            sizer.record(100);
+        }
+        report.expect(sizer.size() == 8192, "fewer than sixteen sparse reads do not shrink");
+        sizer.record(100);
+        report.expect(sizer.size() == 4096, "sixteen sparse reads in a row halve the size");
+
+        for (int i = 0; i < 15; ++i) {
+            sizer.record(100);
+        }
+        sizer.record(2048);
+        sizer.record(100);
+        report.expect(sizer.size() == 4096, "a read in between restarts the count");
+
+        for (int i = 0; i < 64; ++i) {
+            sizer.record(0);
+        }
+        report.expect(sizer.size() == 1024, "the size stops at the minimum");
+
+        const ReadBufferSizer clamped { TcpReadBufferSizing { .adaptive = true, .min_size = 1024, .max_size = 8192 }, 64 * 1024 };
+        report.expect(clamped.size() == 8192, "the initial size is kept within the bounds");
+    }
+}
+
+std::string engine_checks::read_buffer_pool() {
+    CheckReport report;
+    check_pool(report);
+    check_sizer(report);
+    return report.failures();
+}
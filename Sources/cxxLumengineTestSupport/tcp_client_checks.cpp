@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int server_port = 39101;
+    constexpr int unanswered_port = 39107;
+
+    // Sessions in the order on_connect saw them. Only weak references, sessions must not outlive their pool.
+    template<typename Session>
+    class SessionRecorder final {
+        mutable std::mutex m_mutex;
+        std::vector<std::weak_ptr<Session>> m_sessions;
+
+    public:
+        void add(const std::shared_ptr<Session>& session) {
+            std::lock_guard lock { m_mutex };
+            m_sessions.push_back(session);
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            std::lock_guard lock { m_mutex };
+            return m_sessions.size();
+        }
+
+        [[nodiscard]] std::shared_ptr<Session> at(const std::size_t index) const {
+            std::lock_guard lock { m_mutex };
+            return index < m_sessions.size() ? m_sessions[index].lock() : nullptr;
+        }
+
+        // Whether on_connect saw the same session both times, closed sessions included
+        [[nodiscard]] bool same(const std::size_t first, const std::size_t second) const {
+            std::lock_guard lock { m_mutex };
+            const auto& a = m_sessions.at(first);
+            const auto& b = m_sessions.at(second);
+            return !a.owner_before(b) && !b.owner_before(a);
+        }
+
+        bool wait_for(const std::size_t count) const {
+            return wait_until([this, count] { return size() >= count; });
+        }
+    };
+
+    // Every connection the client hands out is released straight back to its pool
+    TcpClientConfigPtr releasing_config(SessionRecorder<TcpClientSession>& connects, const std::chrono::nanoseconds idle_timeout) {
+        return std::make_shared<TcpClientConfig>(TcpClientConfig {
+            .read_buffer_size = 1024,
+            .idle_timeout = idle_timeout,
+            .on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code> {
+                [&connects](const TcpClientSessionPtr& session, const std::error_code ec) {
+                    connects.add(session);
+                    return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReleaseCommand {} };
+                }
+            },
+            .on_receive = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> {
+                [](const TcpClientSessionPtr&, std::error_code, size_t) { return TCPCommandVariant { TCPCloseCommand {} }; }
+            },
+            .on_write = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> {
+                [](const TcpClientSessionPtr&, std::error_code, size_t) { return TCPCommandVariant { TCPCloseCommand {} }; }
+            },
+            .on_disconnect = SwiftFunctionWrapper<void, TcpClientSessionPtr, std::error_code> {
+                [](const TcpClientSessionPtr&, std::error_code) {}
+            },
+        });
+    }
+
+    bool idle_after(const TcpClientPtr& client, const std::size_t open, const std::size_t idle) {
+        return wait_until([&client, open, idle] {
+            const auto info = client->pool_info(loopback(server_port));
+            return info.open == open && info.idle == idle;
+        });
+    }
+
+    // The listener never accepts and its backlog fills up with the first connects, later ones get no answer
+    void check_connect_timeout(CheckReport& report, ThreadPool& pool) {
+        constexpr std::size_t connects = 8;
+        asio::io_context io_context;
+        asio::ip::tcp::acceptor listener { io_context };
+        listener.open(asio::ip::tcp::v4());
+        listener.set_option(asio::ip::tcp::acceptor::reuse_address { true });
+        listener.bind(loopback(unanswered_port));
+        listener.listen(0);
+
+        CallbackRecorder results;
+        const auto client = pool.create_tcp_client(std::make_shared<TcpClientConfig>(TcpClientConfig {
+            .max_connections_per_endpoint = connects,
+            .connect_timeout = std::chrono::milliseconds { 200 },
+            .on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code> {
+                [record = results.callback()](const TcpClientSessionPtr&, const std::error_code ec) {
+                    record.call(ec);
+                    return TCPCommandVariant { TCPCloseCommand {} };
+                }
+            },
+            .on_receive = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> {
+                [](const TcpClientSessionPtr&, std::error_code, size_t) { return TCPCommandVariant { TCPCloseCommand {} }; }
+            },
+            .on_write = SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t> {
+                [](const TcpClientSessionPtr&, std::error_code, size_t) { return TCPCommandVariant { TCPCloseCommand {} }; }
+            },
+            .on_disconnect = SwiftFunctionWrapper<void, TcpClientSessionPtr, std::error_code> {
+                [](const TcpClientSessionPtr&, std::error_code) {}
+            },
+        }));
+        for (std::size_t i = 0; i < connects; ++i) {
+            client->connect(loopback(unanswered_port));
+        }
+        report.expect(results.wait_for(connects), "every connect is reported, also when it gets no answer");
+        const auto timed_out = results.results();
+        report.expect(std::any_of(timed_out.begin(), timed_out.end(), [](const std::error_code& ec) {
+            return ec == make_error_code(CustomErrorCode::ConnectTimeout);
+        }), "a connect without an answer reports ConnectTimeout");
+        report.expect(wait_until([&client] { return client->pool_info(loopback(unanswered_port)).open == 0; }),
+                      "a connect that timed out does not hold a connection of the limit");
+        client->stop();
+    }
+}
+
+std::string engine_checks::tcp_client() {
+    CheckReport report;
+    SessionRecorder<TcpSession> accepted;
+    SessionRecorder<TcpClientSession> connects;
+    SessionRecorder<TcpClientSession> expiring;
+    ThreadPool pool { 2 };
+    auto config = tcp_config();
+    config.on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code> {
+        [&accepted](const TcpSessionPtr& session, const std::error_code ec) {
+            accepted.add(session);
+            return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+        }
+    };
+    report.expect(start_tcp_server(pool, server_port, std::move(config)), "the server starts");
+
+    const auto client = pool.create_tcp_client(releasing_config(connects, std::chrono::seconds { 30 }));
+    report.expect(client->connect(loopback(server_port)) && connects.wait_for(1), "a new connection is handed out");
+    report.expect(idle_after(client, 1, 1), "a released connection is kept idle");
+    report.expect(client->connect(loopback(server_port)) && connects.wait_for(2), "a pooled connection is handed out");
+    report.expect(idle_after(client, 1, 1), "the reused connection is released again");
+    report.expect(connects.size() == 2 && connects.same(0, 1), "an idle connection is reused");
+    report.expect(accepted.size() == 1, "a reused connection does not connect again");
+
+    // The server closes the idle connection, the client notices before handing it out
+    accepted.at(0)->close();
+    report.expect(wait_until([&pool] { return pool.metrics_snapshot(server_port).tcp_sessions_closed == 1; }), "the server closes");
+    report.expect(client->connect(loopback(server_port)) && connects.wait_for(3), "a connect after the server closed is served");
+    report.expect(connects.size() == 3 && !connects.same(0, 2), "a connection the server closed is not reused");
+    report.expect(accepted.wait_for(2), "a closed idle connection is replaced by a new one");
+    report.expect(idle_after(client, 1, 1), "the closed connection is no longer counted");
+    client->stop();
+    report.expect(idle_after(client, 0, 0), "stopping the client closes its idle connections");
+    report.expect(!client->connect(loopback(server_port)), "a stopped client refuses connects");
+
+    const auto short_lived = pool.create_tcp_client(releasing_config(expiring, std::chrono::milliseconds { 150 }));
+    report.expect(short_lived->connect(loopback(server_port)) && expiring.wait_for(1), "a connection is handed out");
+    report.expect(idle_after(short_lived, 0, 0), "an idle connection is closed after its idle timeout");
+
+    stop_server(pool, server_port);
+    check_connect_timeout(report, pool);
+    return report.failures();
+}
@@ -0,0 +1,166 @@
+#include <string>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    // Feeds the bytes in reads of the given size and returns the frames of every collect, up to the first error
+    std::vector<std::vector<std::string>> collects_of(const TcpFraming& framing, const std::size_t buffer_size,
+                                                      const std::string_view bytes, const std::size_t read_size,
+                                                      std::error_code& ec) {
+        FrameAssembler assembler { framing, buffer_size };
+        std::vector<std::vector<std::string>> collects;
+        for (std::size_t position = 0; position < bytes.size() && !ec; position += read_size) {
+            ec = feed(assembler, bytes.substr(position, read_size), [&collects](const FrameAssembler& collected) {
+                if (collected.frames().empty()) {
+                    return;
+                }
+                auto& frames = collects.emplace_back();
+                for (const auto& frame : collected.frames()) {
+                    frames.emplace_back(frame.data, frame.size);
+                }
+            });
+        }
+        return collects;
+    }
+
+    std::vector<std::string> joined(const std::vector<std::vector<std::string>>& collects) {
+        std::vector<std::string> frames;
+        for (const auto& collect : collects) {
+            frames.insert(frames.end(), collect.begin(), collect.end());
+        }
+        return frames;
+    }
+
+    std::string length_prefixed(const std::vector<std::string>& payloads, const uint header_size, const bool big_endian) {
+        std::string bytes;
+        for (const auto& payload : payloads) {
+            for (uint i = 0; i < header_size; ++i) {
+                const auto shift = 8 * (big_endian ? header_size - 1 - i : i);
+                bytes.push_back(static_cast<char>(shift < 64 ? payload.size() >> shift : 0));
+            }
+            bytes += payload;
+        }
+        return bytes;
+    }
+
+    void check_length_prefix(CheckReport& report) {
+        const std::vector<std::string> payloads { "a", "", std::string(300, 'b'), "frame" };
+        for (const uint header_size : { 2u, 4u, 8u }) {
+            for (const bool big_endian : { true, false }) {
+                TcpFraming framing;
+                framing.mode = TcpFramingMode::LengthPrefix;
+                framing.header_size = header_size;
+                framing.big_endian = big_endian;
+                const auto bytes = length_prefixed(payloads, header_size, big_endian);
+                for (const std::size_t read_size : { std::size_t { 1 }, std::size_t { 5 }, bytes.size() }) {
+                    std::error_code ec;
+                    const auto frames = joined(collects_of(framing, 16, bytes, read_size, ec));
+                    report.expect(!ec && frames == payloads,
+                                  "header of " + std::to_string(header_size) + (big_endian ? " big" : " little") +
+                                      " endian bytes in reads of " + std::to_string(read_size) + ": frames split across reads are joined");
+                }
+            }
+        }
+    }
+
+    void check_batches(CheckReport& report) {
+        TcpFraming framing;
+        framing.mode = TcpFramingMode::LengthPrefix;
+        framing.max_frames_per_callback = 2;
+        const std::vector<std::string> payloads { "1", "2", "3", "4", "5" };
+        const auto bytes = length_prefixed(payloads, 4, true);
+        std::error_code ec;
+        const auto collects = collects_of(framing, 1024, bytes, bytes.size(), ec);
+        report.expect(!ec && collects.size() == 3 && collects[0].size() == 2 && collects[2].size() == 1 &&
+                          joined(collects) == payloads,
+                      "a read of five frames is handed out two frames at a time");
+    }
+
+    void check_too_large(CheckReport& report) {
+        TcpFraming framing;
+        framing.mode = TcpFramingMode::LengthPrefix;
+        framing.max_frame_size = 100;
+        std::error_code ec;
+        auto frames = joined(collects_of(framing, 16, length_prefixed({ std::string(100, 'x') }, 4, true), 3, ec));
+        report.expect(!ec && frames.size() == 1 && frames[0].size() == 100, "a frame of the maximum size is handed out");
+        frames = joined(collects_of(framing, 16, length_prefixed({ "ok", std::string(101, 'x') }, 4, true), 64, ec));
+        report.expect_error(ec, CustomErrorCode::FrameTooLarge, "a header announcing a larger frame is too large");
+        report.expect(frames == std::vector<std::string> { "ok" }, "the frames before a frame that is too large are handed out");
+    }
+
+    TcpFraming delimiter_framing(std::string delimiter, const std::size_t max_frame_size = 1024) {
+        TcpFraming framing;
+        framing.mode = TcpFramingMode::Delimiter;
+        framing.delimiter = std::move(delimiter);
+        framing.max_frame_size = max_frame_size;
+        return framing;
+    }
+
+    void check_split_delimiters(CheckReport& report) {
+        // Records longer than a SIMD block, with lone delimiter bytes inside, so the vector and scalar paths both run
+        std::vector<std::string> records;
+        for (std::size_t i = 0; i < 12; ++i) {
+            records.push_back(std::string(i * 7, 'a') + std::string(i % 3, '\n') + "\rz" + std::to_string(i));
+        }
+        records.emplace_back();
+        std::string bytes;
+        for (const auto& record : records) {
+            bytes += record + "\r\n";
+        }
+        for (const std::size_t read_size : { std::size_t { 1 }, std::size_t { 2 }, std::size_t { 5 }, std::size_t { 33 }, bytes.size() }) {
+            std::error_code ec;
+            const auto frames = joined(collects_of(delimiter_framing("\r\n"), 16, bytes, read_size, ec));
+            report.expect(!ec && frames == records,
+                          "reads of " + std::to_string(read_size) + " bytes: records split across reads, delimiters included, are found");
+        }
+
+        std::error_code ec;
+        const auto collects = collects_of(delimiter_framing(""), 1024, "one\ntwo\nthree\npartial", 64, ec);
+        report.expect(!ec && collects.size() == 1 && collects[0] == std::vector<std::string> { "one", "two", "three" },
+                      "the records of one read reach one callback, an empty delimiter means a line feed");
+    }
+
+    void check_delimiter_too_large(CheckReport& report) {
+        std::error_code ec;
+        auto frames = joined(collects_of(delimiter_framing("\r\n", 8), 16, "12345678\r\nnext\r\n", 3, ec));
+        report.expect(!ec && frames == std::vector<std::string> { "12345678", "next" }, "a record of the maximum size is handed out");
+        frames = joined(collects_of(delimiter_framing("\r\n", 8), 16, "ok\r\n123456789\r\n", 3, ec));
+        report.expect_error(ec, CustomErrorCode::FrameTooLarge, "a longer record is too large");
+        report.expect(frames == std::vector<std::string> { "ok" }, "the records before one that is too large are handed out");
+        collects_of(delimiter_framing("\n", 8), 16, std::string(64, 'x'), 4, ec);
+        report.expect_error(ec, CustomErrorCode::FrameTooLarge, "bytes without a delimiter are too large once over the limit");
+    }
+
+    // Every level gives the same results, levels the CPU lacks included
+    void check_simd_levels(CheckReport& report) {
+        const std::string bytes = std::string(100, 'a') + "\n" + std::string(30, 'b');
+        for (const auto level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon }) {
+            const auto name = "level " + std::to_string(static_cast<int>(level));
+            report.expect(supported_simd_level(level) <= simd_level(), name + " is clamped to the level of the CPU");
+            const auto found = find_byte(bytes.data(), bytes.data() + bytes.size(), '\n', level);
+            report.expect(found == bytes.data() + 100, name + " finds the needle");
+            std::string masked = bytes;
+            xor_mask(masked.data(), masked.data(), masked.size(), 0x12345678, level);
+            xor_mask(masked.data(), masked.data(), masked.size(), 0x12345678);
+            report.expect(masked == bytes, name + " masks like the default level");
+        }
+    }
+}
+
+std::string engine_checks::delimiter_framing() {
+    CheckReport report;
+    check_split_delimiters(report);
+    check_delimiter_too_large(report);
+    check_simd_levels(report);
+    return report.failures();
+}
+
+std::string engine_checks::length_prefix_framing() {
+    CheckReport report;
+    check_length_prefix(report);
+    check_batches(report);
+    check_too_large(report);
+    return report.failures();
+}
@@ -0,0 +1,57 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int server_port = 39106;
+    constexpr int rounds = 20;
+    constexpr std::size_t peers_per_round = 64;
+
+    // Connects until the server refuses or enough peers are connected. The peers stay open, only the server closes.
+    void connect_peers(asio::io_context& io_context, std::vector<asio::ip::tcp::socket>& peers) {
+        for (std::size_t i = 0; i < peers_per_round; ++i) {
+            std::error_code ec;
+            auto socket = connect_to(io_context, server_port, ec);
+            if (ec) {
+                return;
+            }
+            peers.push_back(std::move(socket));
+        }
+    }
+}
+
+std::string engine_checks::tcp_stop() {
+    CheckReport report;
+    asio::io_context io_context;
+    std::vector<asio::ip::tcp::socket> peers;
+    ThreadPool pool { 2 };
+    const auto opened = [&pool] { return pool.metrics_snapshot(server_port).tcp_sessions_opened; };
+    const auto closed = [&pool] { return pool.metrics_snapshot(server_port).tcp_sessions_closed; };
+
+    // Stops while peers connect, so accepts complete around the stop
+    for (int round = 0; round < rounds; ++round) {
+        const auto stopped = std::make_shared<std::atomic<bool>>(false);
+        auto config = tcp_config();
+        config.on_stop = SwiftFunctionWrapper<void, TcpHandlerPtr> { [stopped](const TcpHandlerPtr&) { *stopped = true; } };
+        if (!start_tcp_server(pool, server_port, std::move(config))) {
+            report.expect(false, "the server starts again on its port");
+            break;
+        }
+        const auto before = opened();
+        std::thread connecting { [&io_context, &peers] { connect_peers(io_context, peers); } };
+        report.expect(wait_until([&opened, before] { return opened() > before; }), "peers connect");
+        stop_server(pool, server_port);
+        connecting.join();
+        // The next round binds the port again, which needs the acceptor of this one closed
+        report.expect(wait_until([&stopped] { return stopped->load(); }), "the server stops");
+    }
+    report.expect(wait_until([&opened, &closed] { return opened() == closed(); }),
+                  "every session accepted before the server stopped is closed, also when it connects after the stop");
+    return report.failures();
+}
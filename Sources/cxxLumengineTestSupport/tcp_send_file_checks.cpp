@@ -0,0 +1,127 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int server_port = 39103;
+    // Spans more than one FileSource chunk
+    constexpr std::size_t file_size = 300 * 1024;
+    // Larger than what loopback buffers take before the send has to wait for the reader
+    constexpr std::uint64_t sparse_size = 64 * 1024 * 1024;
+
+    // Each connection sends the next command, on_write reports how it ended and closes the session
+    struct FileSends {
+        std::mutex mutex;
+        std::vector<TCPSendFileCommand> commands;
+        std::size_t next { 0 };
+        std::vector<std::pair<std::error_code, std::size_t>> results;
+
+        [[nodiscard]] std::vector<std::pair<std::error_code, std::size_t>> ends() {
+            std::lock_guard lock { mutex };
+            return results;
+        }
+    };
+
+    TcpConfig send_file_config(FileSends& sends) {
+        auto config = tcp_config();
+        config.on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code> {
+            [&sends](const TcpSessionPtr&, const std::error_code ec) {
+                std::lock_guard lock { sends.mutex };
+                if (ec || sends.next == sends.commands.size()) {
+                    return TCPCommandVariant { TCPCloseCommand {} };
+                }
+                return TCPCommandVariant { sends.commands[sends.next++] };
+            }
+        };
+        config.on_write = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t> {
+            [&sends](const TcpSessionPtr&, const std::error_code ec, const size_t bytes) {
+                std::lock_guard lock { sends.mutex };
+                sends.results.emplace_back(ec, bytes);
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+        };
+        return config;
+    }
+
+    // Everything the server sends until it closes
+    std::string receive_all(asio::ip::tcp::socket& socket) {
+        std::string bytes;
+        char chunk[64 * 1024];
+        std::error_code ec;
+        while (!ec && readable(socket)) {
+            bytes.append(chunk, socket.read_some(asio::buffer(chunk), ec));
+        }
+        return bytes;
+    }
+
+    std::string download(asio::io_context& io_context, std::error_code& ec) {
+        auto socket = connect_to(io_context, server_port, ec);
+        return ec ? std::string {} : receive_all(socket);
+    }
+}
+
+std::string engine_checks::tcp_send_file() {
+    CheckReport report;
+    const auto directory = std::filesystem::temp_directory_path();
+    const auto path = (directory / "lumengine_send_file_check.bin").string();
+    const auto sparse_path = (directory / "lumengine_send_file_check_sparse.bin").string();
+    std::string contents(file_size, '\0');
+    for (std::size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<char>('a' + i % 23);
+    }
+    std::ofstream { path, std::ios::binary } << contents;
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    const auto sparse_fd = ::open(sparse_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    report.expect(fd >= 0 && sparse_fd >= 0 && ::ftruncate(sparse_fd, sparse_size) == 0, "the files are created");
+
+    FileSends sends;
+    sends.commands = {
+        TCPSendFileCommand { .path = path, .offset = 1000, .length = 280000 },
+        TCPSendFileCommand { .fd = fd, .offset = file_size - 5000 },
+        TCPSendFileCommand { .path = path, .offset = file_size - 10, .length = 11 },
+        TCPSendFileCommand { .fd = sparse_fd },
+    };
+    asio::io_context io_context;
+    ThreadPool pool { 2 };
+    report.expect(start_tcp_server(pool, server_port, send_file_config(sends)), "the server starts");
+
+    std::error_code ec;
+    report.expect(download(io_context, ec) == contents.substr(1000, 280000), "a range of a path is sent");
+    report.expect(download(io_context, ec) == contents.substr(file_size - 5000), "a length of 0 sends the rest of a descriptor");
+    report.expect(download(io_context, ec).empty(), "a range past the end of the file sends nothing");
+
+    // The file shrinks while the send waits for the reader
+    auto socket = connect_to(io_context, server_port, ec);
+    std::this_thread::sleep_for(std::chrono::milliseconds { 200 });
+    report.expect(::ftruncate(sparse_fd, 0) == 0, "the file is truncated");
+    const auto truncated = receive_all(socket);
+
+    report.expect(wait_until([&sends] { return sends.ends().size() == 4; }), "every send reports its end");
+    const auto ends = sends.ends();
+    if (ends.size() == 4) {
+        report.expect(!ends[0].first && ends[0].second == 280000, "on_write gets the bytes of the range");
+        report.expect(!ends[1].first && ends[1].second == 5000, "on_write gets the bytes of the rest of the file");
+        report.expect(ends[2].first == std::errc::invalid_argument && ends[2].second == 0, "an invalid range is an error");
+        report.expect(ends[3].first == asio::error::eof, "a file that shrank ends the send with eof");
+        report.expect(ends[3].second == truncated.size() && truncated.size() < sparse_size, "the bytes sent before the file shrank are reported");
+    }
+    report.expect(pool.metrics_snapshot(server_port).tcp_file_bytes_out == 285000 + truncated.size(), "the file bytes are counted");
+
+    stop_server(pool, server_port);
+    ::close(fd);
+    ::close(sparse_fd);
+    std::filesystem::remove(path);
+    std::filesystem::remove(sparse_path);
+    return report.failures();
+}
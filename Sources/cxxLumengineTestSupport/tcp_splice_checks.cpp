@@ -0,0 +1,120 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr int server_port = 39102;
+
+    // The first connection of a pair is held, the second one splices it. One worker runs both.
+    struct SplicePairs {
+        std::mutex mutex;
+        TcpSessionPtr held;
+        TcpSessionPtr splicing;
+        std::vector<std::pair<std::error_code, std::size_t>> ends;
+
+        [[nodiscard]] std::vector<std::pair<std::error_code, std::size_t>> results() {
+            std::lock_guard lock { mutex };
+            return ends;
+        }
+    };
+
+    TcpConfig splice_config(SplicePairs& pairs) {
+        auto config = tcp_config();
+        config.on_connect = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code> {
+            [&pairs](const TcpSessionPtr& session, const std::error_code ec) {
+                if (ec) {
+                    return TCPCommandVariant { TCPCloseCommand {} };
+                }
+                std::lock_guard lock { pairs.mutex };
+                if (!pairs.held) {
+                    pairs.held = session;
+                    return TCPCommandVariant { TCPHoldCommand {} };
+                }
+                pairs.splicing = session;
+                return TCPCommandVariant { splice_with(std::exchange(pairs.held, nullptr)) };
+            }
+        };
+        // A stopped splice hands the socket back to the session, which writes to it
+        config.on_receive = SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t> {
+            [&pairs](const TcpSessionPtr&, const std::error_code ec, const size_t bytes) {
+                std::lock_guard lock { pairs.mutex };
+                pairs.ends.emplace_back(ec, bytes);
+                if (ec == asio::error::operation_aborted) {
+                    return TCPCommandVariant { TCPWriteCommand { Buffer { std::string { "after" } } } };
+                }
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+        };
+        return config;
+    }
+
+    // Connects the held side first, so the second connection is the one that splices
+    bool connect_pair(asio::io_context& io_context, SplicePairs& pairs, asio::ip::tcp::socket& held, asio::ip::tcp::socket& splicing) {
+        std::error_code ec;
+        held = connect_to(io_context, server_port, ec);
+        if (ec || !wait_until([&pairs] { std::lock_guard lock { pairs.mutex }; return pairs.held != nullptr; })) {
+            return false;
+        }
+        splicing = connect_to(io_context, server_port, ec);
+        return !ec && wait_until([&pairs] { std::lock_guard lock { pairs.mutex }; return pairs.held == nullptr; });
+    }
+}
+
+std::string engine_checks::tcp_splice() {
+    CheckReport report;
+    SplicePairs pairs;
+    asio::io_context io_context;
+    ThreadPool pool { 1 };
+    report.expect(start_tcp_server(pool, server_port, splice_config(pairs)), "the server starts");
+
+    // Both directions until both peers are done sending
+    {
+        asio::ip::tcp::socket held { io_context };
+        asio::ip::tcp::socket splicing { io_context };
+        report.expect(connect_pair(io_context, pairs, held, splicing), "the pair connects");
+        report.expect(send_all(splicing, "ping") && receive(held, 4) == "ping", "bytes of the splicing side reach the held one");
+        report.expect(send_all(held, "pong!") && receive(splicing, 5) == "pong!", "bytes of the held side reach the splicing one");
+        splicing.shutdown(asio::ip::tcp::socket::shutdown_send);
+        report.expect(receive_eof(held), "end of file is passed on");
+        held.shutdown(asio::ip::tcp::socket::shutdown_send);
+        report.expect(wait_until([&pairs] { return pairs.results().size() == 1; }), "the end of the splice is reported");
+        const auto ends = pairs.results();
+        report.expect(!ends.empty() && ends[0].first == asio::error::eof, "a splice that ran to the end reports eof");
+        report.expect(!ends.empty() && ends[0].second == 4, "the end reports the bytes sent to the peer");
+        report.expect(receive_eof(splicing), "the session closes after its splice");
+        report.expect(wait_until([&pool] { return pool.metrics_snapshot(server_port).tcp_spliced_bytes == 9; }),
+                      "the bytes of both directions are counted");
+    }
+
+    // Stopped part way, each session carries on by itself
+    {
+        asio::ip::tcp::socket held { io_context };
+        asio::ip::tcp::socket splicing { io_context };
+        report.expect(connect_pair(io_context, pairs, held, splicing), "the second pair connects");
+        report.expect(send_all(splicing, "ab") && receive(held, 2) == "ab", "the second splice runs");
+        TcpSessionPtr spliced;
+        {
+            std::lock_guard lock { pairs.mutex };
+            spliced = pairs.splicing;
+        }
+        spliced->stop_splice();
+        report.expect(wait_until([&pairs] { return pairs.results().size() == 2; }), "the stop is reported");
+        const auto ends = pairs.results();
+        report.expect(ends.size() == 2 && ends[1].first == asio::error::operation_aborted, "a stopped splice reports operation_aborted");
+        report.expect(receive(splicing, 5) == "after", "the splicing session gets its socket back");
+        report.expect(!readable(held, std::chrono::milliseconds { 50 }), "the held session stays open and quiet");
+    }
+
+    stop_server(pool, server_port);
+    // Sessions must not outlive their pool
+    std::lock_guard lock { pairs.mutex };
+    pairs.held.reset();
+    pairs.splicing.reset();
+    return report.failures();
+}
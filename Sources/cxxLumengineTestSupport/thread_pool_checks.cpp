@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    constexpr WorkloadGroup shed_group = 7;
+    constexpr WorkloadGroup kept_group = 8;
+
+    void check_handle_cancel(CheckReport& report) {
+        std::atomic<int> runs { 0 };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 2 };
+            const auto handle = pool.run_after(function_workload([&] { ++runs; }, completions), std::chrono::seconds { 10 });
+            report.expect(!handle.finished(), "a delayed workload is pending");
+            report.expect(handle.cancel(), "a pending workload can be cancelled");
+            report.expect(completions.wait_for(1), "a cancelled workload calls back right away");
+            report.expect(wait_until([&handle] { return handle.finished(); }), "a cancelled workload is finished");
+        }
+        const auto results = completions.results();
+        report.expect(runs == 0, "a cancelled workload does not run");
+        report.expect(results.size() == 1, "a cancelled workload calls back once");
+        report.expect(!results.empty() && results[0] == make_error_code(CustomErrorCode::Cancelled),
+                      "a cancelled workload reports Cancelled");
+    }
+
+    void check_group_cancel(CheckReport& report) {
+        std::atomic<int> runs { 0 };
+        CallbackRecorder shed;
+        CallbackRecorder kept;
+        {
+            ThreadPool pool { 2 };
+            pool.run_after(function_workload([&] { ++runs; }, shed).in_group(shed_group), std::chrono::seconds { 10 });
+            pool.run_after(function_workload([&] { ++runs; }, shed).in_group(shed_group), std::chrono::seconds { 10 });
+            const auto other = pool.run_after(function_workload([&] { ++runs; }, kept).in_group(kept_group), std::chrono::seconds { 10 });
+            pool.cancel_group(shed_group);
+            report.expect(shed.wait_for(2), "every workload of a cancelled group calls back");
+            std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+            report.expect(kept.results().empty(), "workloads of other groups are not cancelled");
+            other.cancel();
+            kept.wait_for(1);
+        }
+        report.expect(runs == 0, "workloads of a cancelled group do not run");
+        for (const auto& result : shed.results()) {
+            report.expect_error(result, CustomErrorCode::Cancelled, "a workload of a cancelled group reports Cancelled");
+        }
+    }
+
+    // Cancelled from its first chunk, the rest of the range is skipped. Other chunks wait for the cancel, so the
+    // other thread cannot finish the range while the first chunk waits for its handle.
+    void check_running_cancel(CheckReport& report) {
+        constexpr std::size_t count = 1000;
+        std::atomic<std::size_t> chunks { 0 };
+        std::atomic<bool> cancelled { false };
+        std::promise<WorkloadHandle> handle;
+        auto shared_handle = handle.get_future().share();
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 2 };
+            handle.set_value(pool.run_immediately(parallel_for_workload(0, count, 1, [&chunks, &cancelled, shared_handle](std::size_t, std::size_t) {
+                if (chunks++ == 0) {
+                    shared_handle.get().cancel();
+                    cancelled = true;
+                } else {
+                    wait_until([&cancelled] { return cancelled.load(); });
+                }
+            }, completions)));
+            report.expect(completions.wait_for(1), "a cancelled parallel for completes");
+        }
+        report.expect(chunks < count, "a running parallel for stops before its next chunk");
+        const auto results = completions.results();
+        report.expect(results.size() == 1 && results[0] == make_error_code(CustomErrorCode::Cancelled),
+                      "a parallel for cancelled while it runs reports Cancelled once");
+    }
+
+    void check_deadline(CheckReport& report) {
+        constexpr std::size_t count = 1000;
+        std::atomic<int> runs { 0 };
+        std::atomic<std::size_t> chunks { 0 };
+        CallbackRecorder late;
+        CallbackRecorder loop;
+        {
+            ThreadPool pool { 2 };
+            pool.run_immediately(function_workload([&] { ++runs; }, late)
+                .with_deadline(std::chrono::steady_clock::now() - std::chrono::milliseconds { 1 }));
+            pool.run_after(function_workload([&] { ++runs; }, late).with_deadline_after(std::chrono::milliseconds { 5 }),
+                           std::chrono::milliseconds { 50 });
+            pool.run_immediately(parallel_for_workload(0, count, 1, [&chunks](std::size_t, std::size_t) {
+                ++chunks;
+                std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+            }, loop).with_deadline_after(std::chrono::milliseconds { 30 }));
+            report.expect(late.wait_for(2) && loop.wait_for(1), "workloads past their deadline complete");
+            report.expect(pool.wait_for_completion(std::chrono::seconds { 5 }), "the pool becomes idle");
+            const auto snapshot = pool.metrics_snapshot();
+            report.expect(snapshot.workloads_started == 1, "a workload that expired before it ran is not counted as started");
+            report.expect(snapshot.workloads_completed == 3, "an expired workload is counted as completed");
+        }
+        report.expect(runs == 0, "a workload that is due after its deadline does not run");
+        for (const auto& result : late.results()) {
+            report.expect_error(result, CustomErrorCode::DeadlineExpired, "a workload due after its deadline reports DeadlineExpired");
+        }
+        report.expect(chunks > 0 && chunks < count, "a parallel for stops at its deadline part way through");
+        const auto results = loop.results();
+        report.expect(results.size() == 1 && results[0] == make_error_code(CustomErrorCode::DeadlineExpired),
+                      "a parallel for stopped by its deadline reports DeadlineExpired once");
+    }
+}
+
+std::string engine_checks::workload_handles() {
+    CheckReport report;
+    check_handle_cancel(report);
+    check_group_cancel(report);
+    check_running_cancel(report);
+    check_deadline(report);
+    return report.failures();
+}
+
+std::string engine_checks::wait_for_completion() {
+    CheckReport report;
+    std::atomic<bool> release { false };
+    CallbackRecorder completions;
+    {
+        ThreadPool pool { 2 };
+        pool.run_immediately(function_workload([&release] {
+            wait_until([&release] { return release.load(); });
+        }, completions));
+        report.expect(pool.has_active_tasks(), "a running workload keeps the pool active");
+        report.expect(!pool.wait_for_completion(std::chrono::milliseconds { 20 }), "waiting times out while a workload runs");
+
+        std::atomic<bool> from_pool_thread { true };
+        pool.run_immediately(function_workload([&pool, &from_pool_thread] {
+            from_pool_thread = pool.wait_for_completion();
+        }, completions));
+        report.expect(wait_until([&from_pool_thread] { return !from_pool_thread; }),
+                      "waiting on a pool thread returns false instead of blocking");
+
+        auto waiter = std::async(std::launch::async, [&pool] { return pool.wait_for_completion(); });
+        report.expect(waiter.wait_for(std::chrono::milliseconds { 20 }) == std::future_status::timeout,
+                      "a waiter blocks while a workload runs");
+        release = true;
+        report.expect(waiter.wait_for(std::chrono::seconds { 5 }) == std::future_status::ready && waiter.get(),
+                      "a waiter wakes up once the last workload completes");
+        report.expect(!pool.has_active_tasks(), "an idle pool has no active tasks");
+        report.expect(pool.wait_for_completion(std::chrono::milliseconds { 1 }), "waiting on an idle pool returns right away");
+    }
+    return report.failures();
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    // Objects that only this check records, other checks may trace at the same time
+    const void* marker(const std::uintptr_t i) {
+        return reinterpret_cast<const void*>(std::uintptr_t { 0x7e570000 } + i);
+    }
+
+    bool traced(const std::string& json, const std::uintptr_t i) {
+        char object[64];
+        std::snprintf(object, sizeof(object), "\"object\":\"%p\"", marker(i));
+        return json.find(object) != std::string::npos;
+    }
+
+    void check_export(CheckReport& report) {
+        CallbackRecorder completions;
+        ThreadPool pool { 2 };
+        trace(TraceEvent::Accept, marker(0));
+        pool.start_tracing(1024);
+        pool.run_immediately(function_workload([] {
+            trace(TraceEvent::Accept, marker(1), 1);
+            trace(TraceEvent::CallbackEnter, marker(2), static_cast<std::uint64_t>(HandlerType::TcpOnRceive));
+            trace(TraceEvent::CallbackExit, marker(2), static_cast<std::uint64_t>(HandlerType::TcpOnRceive));
+        }, completions));
+        report.expect(completions.wait_for(1), "the traced workload completes");
+        trace(TraceEvent::Connect, marker(3));
+        pool.stop_tracing();
+        trace(TraceEvent::Accept, marker(4));
+
+        const auto json = Tracer::instance().chrome_trace_json();
+        report.expect(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") && json.ends_with("]}\n"),
+                      "the export is a Chrome trace");
+        report.expect(!traced(json, 0), "events before the start are not recorded");
+        report.expect(traced(json, 1), "events of pool threads are exported");
+        report.expect(traced(json, 3), "events of other threads are exported");
+        report.expect(!traced(json, 4), "events after the stop are not recorded");
+        report.expect(json.find("\"name\":\"tcp on_receive\",\"cat\":\"callback\",\"ph\":\"B\"") != std::string::npos &&
+                      json.find("\"name\":\"tcp on_receive\",\"cat\":\"callback\",\"ph\":\"E\"") != std::string::npos,
+                      "callbacks are exported as duration events named after their handler type");
+        report.expect(json.find("\"args\":{\"name\":\"worker ") != std::string::npos, "pool threads are named after their worker");
+        report.expect(json.find("\"args\":{\"name\":\"other threads\"") != std::string::npos,
+                      "threads without a ring of their own share one");
+
+        const auto path = (std::filesystem::temp_directory_path() / "lumengine_trace_check.json").string();
+        report.expect(pool.write_trace(path) && std::filesystem::file_size(path) > 0, "the trace is written to a file");
+        std::filesystem::remove(path);
+        report.expect(!pool.write_trace("/nonexistent/directory/trace.json"), "an unwritable path is reported");
+    }
+
+    // A full ring keeps the newest events
+    void check_wrap(CheckReport& report) {
+        constexpr std::uintptr_t first = 100;
+        constexpr std::uintptr_t count = 20;
+        Tracer::instance().start(8);
+        std::thread { [] {
+            Tracer::instance().attach_current_thread("wrap check");
+            for (auto i = first; i < first + count; ++i) {
+                trace(TraceEvent::Accept, marker(i));
+            }
+        } }.join();
+        Tracer::instance().stop();
+
+        const auto json = Tracer::instance().chrome_trace_json();
+        bool newest = true;
+        bool oldest = false;
+        for (auto i = first; i < first + count - 8; ++i) {
+            oldest = oldest || traced(json, i);
+        }
+        for (auto i = first + count - 8; i < first + count; ++i) {
+            newest = newest && traced(json, i);
+        }
+        report.expect(newest, "the newest events of a full ring are kept");
+        report.expect(!oldest, "the oldest events of a full ring are overwritten");
+    }
+
+    // Every exported event of a marker between first and first + count, and whether its value matches the marker
+    bool consistent(const std::string& json, const std::uintptr_t first, const std::uintptr_t count, std::size_t& events) {
+        static constexpr std::string_view object_key = "\"object\":\"";
+        static constexpr std::string_view value_key = "\"value\":";
+        for (auto position = json.find(object_key); position != std::string::npos; position = json.find(object_key, position + 1)) {
+            const auto object = std::strtoull(json.c_str() + position + object_key.size(), nullptr, 16);
+            const auto value = std::strtoull(json.c_str() + json.find(value_key, position) + value_key.size(), nullptr, 10);
+            const auto i = object - reinterpret_cast<std::uintptr_t>(marker(0));
+            if (i >= first && i < first + count) {
+                ++events;
+                if (value != i) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Exports and restarts while a thread records, every exported event is whole
+    void check_concurrent(CheckReport& report) {
+        constexpr std::uintptr_t first = 200;
+        constexpr std::uintptr_t count = 50;
+        std::atomic<bool> done { false };
+        std::atomic<std::size_t> recorded { 0 };
+        Tracer::instance().start(256);
+        std::thread recording { [&done, &recorded] {
+            Tracer::instance().attach_current_thread("concurrent check");
+            for (std::uintptr_t i = 0; !done; i = (i + 1) % count) {
+                trace(TraceEvent::Accept, marker(first + i), first + i);
+                ++recorded;
+            }
+        } };
+        bool whole = true;
+        std::size_t events = 0;
+        for (int i = 0; i < 50; ++i) {
+            // With a single CPU the exports could otherwise all run before the thread records anything
+            const auto before = recorded.load();
+            wait_until([&recorded, before] { return recorded > before; });
+            whole = consistent(Tracer::instance().chrome_trace_json(), first, count, events) && whole;
+            if (i % 10 == 0) {
+                Tracer::instance().start(256);
+            }
+        }
+        done = true;
+        recording.join();
+        Tracer::instance().stop();
+        report.expect(events > 0, "events recorded during an export are exported");
+        report.expect(whole, "an event written during an export is left out instead of torn");
+    }
+}
+
+std::string engine_checks::tracing() {
+    CheckReport report;
+    check_export(report);
+    check_wrap(report);
+    check_concurrent(report);
+    return report.failures();
+}
@@ -0,0 +1,33 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+std::string engine_checks::udp_stop() {
+    CheckReport report;
+    std::atomic<int> starts { 0 };
+    std::atomic<int> stops { 0 };
+    {
+        LeScheduler scheduler { ThreadPoolConfig { 2 } };
+        // Port 0 binds an ephemeral port, the server is never stopped explicitly
+        scheduler.run_immediately(Workload { WorkloadTypeVariant(StartServerWorkload {
+            std::make_shared<ServerConfig>(0, false, ProtocolHandlerConfigVariant { UdpConfig {
+                1024,
+                SwiftFunctionWrapper<UDPCommandVariant, UdpHandlerPtr, std::error_code, size_t, asio::ip::udp::endpoint> {
+                    [](const UdpHandlerPtr&, std::error_code, size_t, const asio::ip::udp::endpoint&) { return UDPCommandVariant { UDPReadCommand {} }; }
+                },
+                SwiftFunctionWrapper<UDPCommandVariant, UdpHandlerPtr, std::error_code, size_t> {
+                    [](const UdpHandlerPtr&, std::error_code, size_t) { return UDPCommandVariant { UDPReadCommand {} }; }
+                },
+                SwiftFunctionWrapper<void, UdpHandlerPtr> { [&starts](const UdpHandlerPtr&) { ++starts; } },
+                SwiftFunctionWrapper<void, UdpHandlerPtr> { [&stops](const UdpHandlerPtr&) { ++stops; } },
+            } })
+        }) });
+        report.expect(wait_until([&starts] { return starts > 0; }) && starts == 1, "the server starts");
+    }
+    report.expect(stops == 1, "a server still running when its pool is destroyed is stopped once, after the threads are joined");
+    return report.failures();
+}
@@ -0,0 +1,111 @@
+#include <string>
+#include <vector>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    TcpFraming websocket_framing() {
+        TcpFraming framing;
+        framing.mode = TcpFramingMode::WebSocket;
+        framing.max_frame_size = 64;
+        return framing;
+    }
+
+    // A masked frame, as clients send them
+    std::string frame(const WebSocketOpcode opcode, const std::string_view payload, const bool fin = true) {
+        const auto buffer = websocket_frame(opcode, payload.data(), payload.size(), true, fin);
+        return { buffer.pointer(), buffer.size() };
+    }
+
+    struct Received {
+        std::vector<WebSocketMessage> messages;
+        std::vector<std::string> payloads;
+        std::string replies;
+        std::error_code ec;
+    };
+
+    // Feeds the frames in reads of the given size, up to the first error
+    Received receive(const std::string_view bytes, const std::size_t read_size) {
+        FrameAssembler assembler { websocket_framing(), 16 };
+        Received received;
+        for (std::size_t position = 0; position < bytes.size() && !received.ec; position += read_size) {
+            received.ec = feed(assembler, bytes.substr(position, read_size), [&received](FrameAssembler& collected) {
+                for (const auto& message : collected.messages()) {
+                    received.messages.push_back(message);
+                    received.payloads.emplace_back(message.data, message.size);
+                }
+                received.replies += collected.take_replies();
+            });
+        }
+        return received;
+    }
+
+    void check_fragments(CheckReport& report) {
+        const auto bytes = frame(WebSocketOpcode::Text, "Hel", false) + frame(WebSocketOpcode::Continuation, "lo", false) +
+                           frame(WebSocketOpcode::Ping, "p") + frame(WebSocketOpcode::Continuation, " there") +
+                           frame(WebSocketOpcode::Binary, "next");
+        for (const std::size_t read_size : { std::size_t { 1 }, std::size_t { 3 }, bytes.size() }) {
+            const auto received = receive(bytes, read_size);
+            const auto what = "reads of " + std::to_string(read_size) + " bytes";
+            report.expect(!received.ec, what + ": no error");
+            report.expect(received.payloads == std::vector<std::string> { "Hello there", "next" },
+                          what + ": the fragments are joined around the ping");
+            report.expect(received.messages.size() == 2 && received.messages[0].opcode == WebSocketOpcode::Text &&
+                              received.messages[1].opcode == WebSocketOpcode::Binary,
+                          what + ": a joined message keeps the opcode of its first fragment");
+            report.expect(received.replies.size() == 3 && received.replies[0] == static_cast<char>(0x8A) &&
+                              received.replies[2] == 'p',
+                          what + ": the interleaved ping is answered");
+        }
+    }
+
+    void check_empty_fragments(CheckReport& report) {
+        auto received = receive(frame(WebSocketOpcode::Binary, "", false) + frame(WebSocketOpcode::Continuation, "", false) +
+                                    frame(WebSocketOpcode::Continuation, "abc"),
+                                1);
+        report.expect(!received.ec && received.payloads == std::vector<std::string> { "abc" } &&
+                          received.messages[0].opcode == WebSocketOpcode::Binary,
+                      "empty fragments before the payload join to it");
+
+        received = receive(frame(WebSocketOpcode::Text, "", false) + frame(WebSocketOpcode::Continuation, ""), 1);
+        report.expect(!received.ec && received.payloads == std::vector<std::string> { "" } &&
+                          received.messages[0].opcode == WebSocketOpcode::Text,
+                      "a message of empty fragments is an empty text message");
+
+        received = receive(frame(WebSocketOpcode::Text, "") + frame(WebSocketOpcode::Text, "x"), 2);
+        report.expect(!received.ec && received.payloads == std::vector<std::string> { "", "x" },
+                      "an empty single frame message is handed out");
+    }
+
+    void check_violations(CheckReport& report) {
+        report.expect_error(receive(frame(WebSocketOpcode::Continuation, "abc"), 64).ec,
+                            CustomErrorCode::WebSocketProtocolError, "a continuation without a message is rejected");
+        report.expect_error(receive(frame(WebSocketOpcode::Text, "a", false) + frame(WebSocketOpcode::Text, "b"), 64).ec,
+                            CustomErrorCode::WebSocketProtocolError, "a new message inside a fragmented one is rejected");
+        const auto unmasked = websocket_frame(WebSocketOpcode::Text, "abc", 3);
+        report.expect_error(receive({ unmasked.pointer(), unmasked.size() }, 64).ec,
+                            CustomErrorCode::WebSocketProtocolError, "an unmasked client frame is rejected");
+
+        const std::string half(40, 'a');
+        const auto received = receive(frame(WebSocketOpcode::Text, half, false) + frame(WebSocketOpcode::Continuation, half), 7);
+        report.expect_error(received.ec, CustomErrorCode::FrameTooLarge, "fragments over the message limit are too large");
+        report.expect(received.replies.size() == 4 && received.replies.substr(2) == "\x03\xF1",
+                      "a message over the limit is closed with 1009");
+
+        const char reason[] { 0x03, static_cast<char>(0xE8), 'b', 'y', 'e' };
+        const auto closed = receive(frame(WebSocketOpcode::Close, { reason, sizeof(reason) }), 64);
+        report.expect_error(closed.ec, CustomErrorCode::WebSocketClosed, "a close ends the session");
+        report.expect(closed.messages.size() == 1 && closed.messages[0].close_code == websocket::normal_closure &&
+                          closed.payloads[0] == "bye",
+                      "a close carries its code and reason");
+    }
+}
+
+std::string engine_checks::websocket() {
+    CheckReport report;
+    check_fragments(report);
+    check_empty_fragments(report);
+    check_violations(report);
+    return report.failures();
+}
@@ -0,0 +1,87 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "check_report.hpp"
+#include "engine_checks.hpp"
+
+namespace {
+    Workload graph_workload(WorkloadGraphPtr graph, CallbackRecorder& recorder) {
+        Workload workload { WorkloadTypeVariant(GraphWorkload { std::move(graph) }) };
+        workload.callback = recorder.callback();
+        return workload;
+    }
+
+    // A diamond with a parallel for in one arm: first before both arms, both arms before last
+    void check_order(CheckReport& report) {
+        std::atomic<int> sequence { 0 };
+        std::atomic<int> first { -1 };
+        std::atomic<int> arm { -1 };
+        std::atomic<int> loop_done { -1 };
+        std::atomic<int> last { -1 };
+        std::atomic<int> indices { 0 };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 4 };
+            const auto graph = std::make_shared<WorkloadGraph>();
+            const auto a = graph->add_function(FunctionWorkload { [&] { first = sequence++; } });
+            const auto b = graph->add_function(FunctionWorkload { [&] { arm = sequence++; } });
+            const auto c = graph->add_parallel_for(0, 100, 10, SwiftFunctionWrapper<void, std::size_t, std::size_t> {
+                [&](const std::size_t begin, const std::size_t end) {
+                    if ((indices += static_cast<int>(end - begin)) == 100) {
+                        loop_done = sequence++;
+                    }
+                }
+            });
+            const auto d = graph->add_function(FunctionWorkload { [&] { last = sequence++; } });
+            report.expect(graph->add_dependency(a, b) && graph->add_dependency(a, c) &&
+                          graph->add_dependency(b, d) && graph->add_dependency(c, d), "dependencies between nodes are added");
+            report.expect(!graph->add_dependency(a, a), "a node cannot depend on itself");
+            report.expect(!graph->add_dependency(a, 9), "a dependency on a missing node is refused");
+            report.expect(graph->is_acyclic(), "a diamond is acyclic");
+            pool.run_immediately(graph_workload(graph, completions));
+            report.expect(completions.wait_for(1), "the graph completes");
+        }
+        report.expect(first == 0, "the root runs first");
+        report.expect(arm > first && loop_done > first, "both arms run after the root");
+        report.expect(indices == 100, "the parallel for node covers its range");
+        report.expect(last == 3, "the join runs after both arms");
+        const auto results = completions.results();
+        report.expect(results.size() == 1 && !results[0], "the graph calls back once with success");
+    }
+
+    void check_invalid(CheckReport& report) {
+        std::atomic<int> runs { 0 };
+        CallbackRecorder completions;
+        {
+            ThreadPool pool { 2 };
+            const auto cycle = std::make_shared<WorkloadGraph>();
+            const auto a = cycle->add_function(FunctionWorkload { [&] { ++runs; } });
+            const auto b = cycle->add_function(FunctionWorkload { [&] { ++runs; } });
+            const auto c = cycle->add_function(FunctionWorkload { [&] { ++runs; } });
+            cycle->add_dependency(a, b);
+            cycle->add_dependency(b, c);
+            cycle->add_dependency(c, b);
+            report.expect(!cycle->is_acyclic(), "a cycle is detected");
+            pool.run_immediately(graph_workload(cycle, completions));
+            pool.run_immediately(graph_workload(nullptr, completions));
+            report.expect(completions.wait_for(2), "invalid graphs complete");
+            std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+        }
+        const auto results = completions.results();
+        report.expect(runs == 0, "no node of a cyclic graph runs");
+        report.expect(results.size() == 2, "an invalid graph calls back once");
+        for (const auto& result : results) {
+            report.expect_error(result, CustomErrorCode::InvalidGraph, "an invalid graph reports InvalidGraph");
+        }
+    }
+}
+
+std::string engine_checks::workload_graph() {
+    CheckReport report;
+    check_order(report);
+    check_invalid(report);
+    return report.failures();
+}
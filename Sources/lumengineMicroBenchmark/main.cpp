@@ -0,0 +1,616 @@
+// Microbenchmarks of the building blocks on the hot path: ThreadPool submission and timers, SparseVector,
+// Buffer, the SIMD byte kernels, the HTTP request stage and SwiftFunctionWrapper.
+// Every benchmark is calibrated so one batch runs for at least --min-batch-ms, then warmed up and repeated.
+// The median and the median absolute deviation of the repetitions are reported, they are far less sensitive to
+// a single noisy repetition than mean and standard deviation. Passing the JSON of an earlier run as --baseline
+// flags every benchmark whose median got slower by more than --threshold and by more than its own noise.
+//
+// Usage: lumengineMicroBenchmark [--filter text] [--repetitions 15] [--warmup 3] [--min-batch-ms 10] [--cpu N]
+//                                [--pool-threads 2] [--baseline previous.json] [--threshold 0.05]
+//                                [--label name] [--output micro_benchmark.json | -]
+
+#include <cxxLumengine.hpp>
+#include <benchmark_support.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <random>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Keeps the compiler from optimising away a value that is otherwise unused
+    template<typename T>
+    void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // A benchmark body runs ops operations and returns the measured value of the whole batch, normally the
+    // elapsed time. Bodies that measure something else (e.g. timer lateness) run a fixed number of operations.
+    struct MicroBenchmark {
+        std::string name;
+        std::string unit { "ns/op" };
+        std::function<std::chrono::nanoseconds(std::size_t ops, HdrHistogram& distribution)> body;
+        std::size_t fixed_ops { 0 };
+        bool has_distribution { false };
+    };
+
+    struct MicroBenchmarkResult {
+        std::string name;
+        std::string unit;
+        std::size_t ops_per_repetition { 0 };
+        std::vector<double> samples;
+        HdrHistogram distribution { 1, 60'000'000'000, 3 };
+        bool has_distribution { false };
+    };
+
+    struct Settings {
+        std::size_t repetitions;
+        std::size_t warmup;
+        std::chrono::nanoseconds min_batch;
+    };
+
+    double median(std::vector<double> values) {
+        if (values.empty()) {
+            return 0;
+        }
+        std::ranges::sort(values);
+        const auto middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    }
+
+    double median_absolute_deviation(const std::vector<double>& values) {
+        const auto center = median(values);
+        std::vector<double> deviations;
+        deviations.reserve(values.size());
+        for (const auto value : values) {
+            deviations.push_back(std::abs(value - center));
+        }
+        return median(deviations);
+    }
+
+    std::size_t calibrate(const MicroBenchmark& benchmark, const Settings& settings) {
+        if (benchmark.fixed_ops) {
+            return benchmark.fixed_ops;
+        }
+        HdrHistogram ignored;
+        std::size_t ops = 1;
+        while (ops < (std::size_t { 1 } << 30)) {
+            const auto start = Clock::now();
+            benchmark.body(ops, ignored);
+            if (Clock::now() - start >= settings.min_batch) {
+                break;
+            }
+            ops *= 2;
+        }
+        return ops;
+    }
+
+    MicroBenchmarkResult run(const MicroBenchmark& benchmark, const Settings& settings) {
+        MicroBenchmarkResult result;
+        result.name = benchmark.name;
+        result.unit = benchmark.unit;
+        result.has_distribution = benchmark.has_distribution;
+        result.ops_per_repetition = calibrate(benchmark, settings);
+
+        HdrHistogram ignored;
+        for (std::size_t i = 0; i < settings.warmup; ++i) {
+            benchmark.body(result.ops_per_repetition, ignored);
+        }
+        for (std::size_t i = 0; i < settings.repetitions; ++i) {
+            const auto measured = benchmark.body(result.ops_per_repetition, result.distribution);
+            result.samples.push_back(static_cast<double>(measured.count()) / static_cast<double>(result.ops_per_repetition));
+        }
+        return result;
+    }
+
+    // Baseline medians are looked up in the JSON this program writes, which keeps name and median together
+    std::map<std::string, double> read_baseline(const std::string& path) {
+        std::map<std::string, double> medians;
+        std::ifstream file { path };
+        if (!file) {
+            std::fprintf(stderr, "[Error] Failed to open baseline %s\n", path.c_str());
+            return medians;
+        }
+        const std::string text { std::istreambuf_iterator<char> { file }, std::istreambuf_iterator<char> {} };
+        const std::string name_key { "\"name\":\"" };
+        const std::string median_key { "\"median\":" };
+        for (auto position = text.find(name_key); position != std::string::npos; position = text.find(name_key, position)) {
+            position += name_key.size();
+            const auto name_end = text.find('"', position);
+            const auto median_position = text.find(median_key, name_end);
+            const auto next_name = text.find(name_key, name_end);
+            if (name_end == std::string::npos || median_position == std::string::npos || median_position > next_name) {
+                continue;
+            }
+            medians[text.substr(position, name_end - position)] = std::strtod(text.c_str() + median_position + median_key.size(), nullptr);
+        }
+        return medians;
+    }
+
+    // ThreadPool
+
+    std::atomic<std::uint64_t> workloads_run { 0 };
+    std::atomic<std::int64_t> last_run_at { 0 };
+
+    std::int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void count_workload(void*) {
+        workloads_run.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void stamp_workload(void*) {
+        last_run_at.store(now_ns(), std::memory_order_release);
+    }
+
+    // Lateness of timers that were all due at the same moment, one slot per firing
+    std::vector<std::int64_t> timer_fired_at;
+    std::atomic<std::size_t> timers_fired { 0 };
+
+    void record_timer(void*) {
+        const auto slot = timers_fired.fetch_add(1, std::memory_order_relaxed);
+        if (slot < timer_fired_at.size()) {
+            timer_fired_at[slot] = now_ns();
+        }
+    }
+
+    void add_thread_pool_benchmarks(std::vector<MicroBenchmark>& benchmarks, ThreadPool& pool) {
+        benchmarks.push_back({ "thread_pool.run_immediately.throughput", "ns/op",
+            [&pool](const std::size_t ops, HdrHistogram&) {
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    pool.run_immediately(Workload::create_function(reinterpret_cast<void*>(&count_workload)));
+                }
+                pool.wait_for_completion();
+                return Clock::now() - start;
+            } });
+
+        // Submission until the workload starts running, one workload in flight
+        benchmarks.push_back({ "thread_pool.run_immediately.latency", "ns/op",
+            [&pool](const std::size_t ops, HdrHistogram& distribution) {
+                std::chrono::nanoseconds total { 0 };
+                for (std::size_t i = 0; i < ops; ++i) {
+                    last_run_at.store(0, std::memory_order_relaxed);
+                    const auto submitted = now_ns();
+                    pool.run_immediately(Workload::create_function(reinterpret_cast<void*>(&stamp_workload)));
+                    std::int64_t ran_at;
+                    while ((ran_at = last_run_at.load(std::memory_order_acquire)) == 0) {
+                        std::this_thread::yield();
+                    }
+                    distribution.record(ran_at - submitted);
+                    total += std::chrono::nanoseconds { ran_at - submitted };
+                }
+                pool.wait_for_completion();
+                return total;
+            }, 0, true });
+
+        // Cost of arming a timer, the timers are cancelled before they fire
+        benchmarks.push_back({ "thread_pool.run_after.insert", "ns/op",
+            [&pool](const std::size_t ops, HdrHistogram&) {
+                std::vector<WorkloadHandle> handles;
+                handles.reserve(ops);
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    handles.push_back(pool.run_after(
+                        Workload::create_function(reinterpret_cast<void*>(&count_workload)),
+                        std::chrono::seconds { 60 }
+                    ));
+                }
+                const auto elapsed = Clock::now() - start;
+                for (auto& handle : handles) {
+                    handle.cancel();
+                }
+                pool.wait_for_completion();
+                return elapsed;
+            } });
+
+        // A batch of timers due at the same moment: time from the deadline until the last one has fired
+        benchmarks.push_back({ "thread_pool.run_at.fire", "ns/op",
+            [&pool](const std::size_t ops, HdrHistogram&) {
+                timer_fired_at.assign(ops, 0);
+                timers_fired = 0;
+                const auto due = Clock::now() + std::chrono::milliseconds { 5 } + ops * std::chrono::microseconds { 5 };
+                for (std::size_t i = 0; i < ops; ++i) {
+                    pool.run_at(Workload::create_function(reinterpret_cast<void*>(&record_timer)), due);
+                }
+                pool.wait_for_completion();
+                const auto last = *std::ranges::max_element(timer_fired_at);
+                return std::chrono::nanoseconds { last } - std::chrono::duration_cast<std::chrono::nanoseconds>(due.time_since_epoch());
+            }, 1000 });
+
+        // How late a single timer fires after its delay has passed
+        benchmarks.push_back({ "thread_pool.run_after.lateness", "ns late",
+            [&pool](const std::size_t ops, HdrHistogram& distribution) {
+                std::chrono::nanoseconds total { 0 };
+                for (std::size_t i = 0; i < ops; ++i) {
+                    last_run_at.store(0, std::memory_order_relaxed);
+                    const auto due = now_ns() + 1'000'000;
+                    pool.run_after(Workload::create_function(reinterpret_cast<void*>(&stamp_workload)), std::chrono::milliseconds { 1 });
+                    pool.wait_for_completion();
+                    const auto late = std::max<std::int64_t>(0, last_run_at.load(std::memory_order_acquire) - due);
+                    distribution.record(late);
+                    total += std::chrono::nanoseconds { late };
+                }
+                return total;
+            }, 100, true });
+    }
+
+    // SparseVector, used with shared pointers the way the session and workload registries use it
+
+    void add_sparse_vector_benchmarks(std::vector<MicroBenchmark>& benchmarks) {
+        for (const std::size_t capacity : { 128, 4096 }) {
+            // Half full, each op adds one element and removes a random live one by value
+            benchmarks.push_back({ "sparse_vector.churn." + std::to_string(capacity), "ns/op",
+                [capacity](const std::size_t ops, HdrHistogram&) {
+                    SparseVector<std::shared_ptr<int>> vector { capacity };
+                    std::vector<std::shared_ptr<int>> live;
+                    for (std::size_t i = 0; i < capacity / 2; ++i) {
+                        live.push_back(vector.add(std::make_shared<int>(static_cast<int>(i))));
+                    }
+                    std::vector<std::shared_ptr<int>> fresh;
+                    fresh.reserve(ops);
+                    for (std::size_t i = 0; i < ops; ++i) {
+                        fresh.push_back(std::make_shared<int>(static_cast<int>(i)));
+                    }
+                    std::minstd_rand random { 42 };
+
+                    const auto start = Clock::now();
+                    for (std::size_t i = 0; i < ops; ++i) {
+                        live.push_back(vector.add(fresh[i]));
+                        const auto victim = random() % live.size();
+                        vector.remove(live[victim]);
+                        live[victim] = std::move(live.back());
+                        live.pop_back();
+                    }
+                    return Clock::now() - start;
+                } });
+
+            // Every other slot is empty, the per element cost includes skipping the holes
+            benchmarks.push_back({ "sparse_vector.iterate." + std::to_string(capacity), "ns/element",
+                [capacity](const std::size_t ops, HdrHistogram&) {
+                    SparseVector<std::shared_ptr<int>> vector { capacity };
+                    for (std::size_t i = 0; i < capacity; ++i) {
+                        vector.add(std::make_shared<int>(static_cast<int>(i)));
+                    }
+                    for (std::size_t i = 0; i < capacity; i += 2) {
+                        vector.remove(i);
+                    }
+                    const auto start = Clock::now();
+                    for (std::size_t i = 0; i < ops; ) {
+                        for (const auto& element : vector) {
+                            do_not_optimize(*element);
+                            if (++i == ops) {
+                                break;
+                            }
+                        }
+                    }
+                    return Clock::now() - start;
+                } });
+        }
+    }
+
+    // Buffer
+
+    void add_buffer_benchmarks(std::vector<MicroBenchmark>& benchmarks) {
+        for (const std::size_t size : { 64, 4096, 65536 }) {
+            benchmarks.push_back({ "buffer.allocate." + std::to_string(size), "ns/op",
+                [size](const std::size_t ops, HdrHistogram&) {
+                    const auto start = Clock::now();
+                    for (std::size_t i = 0; i < ops; ++i) {
+                        Buffer buffer { size };
+                        do_not_optimize(buffer.pointer());
+                    }
+                    return Clock::now() - start;
+                } });
+        }
+
+        // The reply path of the handlers: allocate and copy the payload in
+        benchmarks.push_back({ "buffer.allocate_and_write.1024", "ns/op",
+            [](const std::size_t ops, HdrHistogram&) {
+                const std::vector<char> payload(1024, 'x');
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    Buffer buffer { payload.size() };
+                    buffer.write(payload.data(), payload.size());
+                    do_not_optimize(buffer.pointer());
+                }
+                return Clock::now() - start;
+            } });
+
+        benchmarks.push_back({ "buffer.from_string.1024", "ns/op",
+            [](const std::size_t ops, HdrHistogram&) {
+                std::vector<std::string> strings(ops, std::string(1024, 'x'));
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    Buffer buffer { std::move(strings[i]) };
+                    do_not_optimize(buffer.pointer());
+                }
+                return Clock::now() - start;
+            } });
+    }
+
+    // SIMD byte search and masking, every kernel the CPU supports against the scalar one
+
+    void add_simd_scan_benchmarks(std::vector<MicroBenchmark>& benchmarks) {
+        std::vector<std::pair<std::string, SimdLevel>> levels { { "scalar", SimdLevel::Scalar } };
+#if defined(LE_SIMD_X86)
+        levels.emplace_back("sse2", SimdLevel::Sse2);
+        if (simd_level() == SimdLevel::Avx2) {
+            levels.emplace_back("avx2", SimdLevel::Avx2);
+        }
+#elif defined(LE_SIMD_NEON)
+        levels.emplace_back("neon", SimdLevel::Neon);
+#endif
+        // A short line and a read buffer holding a single line
+        for (const std::size_t size : { 64, 4096 }) {
+            for (const auto& [name, level] : levels) {
+                benchmarks.push_back({ "simd_scan.find_byte." + name + "." + std::to_string(size), "ns/op",
+                    [size, level](const std::size_t ops, HdrHistogram&) {
+                        std::string line(size - 1, 'x');
+                        line.push_back('\n');
+                        const auto start = Clock::now();
+                        for (std::size_t i = 0; i < ops; ++i) {
+                            const auto* data = line.data();
+                            do_not_optimize(data);
+                            do_not_optimize(find_byte(data, data + size, '\n', level));
+                        }
+                        return Clock::now() - start;
+                    } });
+            }
+        }
+        // Unmasking a WebSocket payload in place
+        for (const auto& [name, level] : levels) {
+            benchmarks.push_back({ "simd_scan.xor_mask." + name + ".4096", "ns/op",
+                [level](const std::size_t ops, HdrHistogram&) {
+                    std::string payload(4096, 'x');
+                    const auto start = Clock::now();
+                    for (std::size_t i = 0; i < ops; ++i) {
+                        xor_mask(payload.data(), payload.data(), payload.size(), 0x5A3C96E1, level);
+                        do_not_optimize(payload.data());
+                    }
+                    return Clock::now() - start;
+                } });
+        }
+    }
+
+    // HTTP request stage, against parsing the raw bytes of on_receive the way a handler does it in Swift:
+    // lines and headers copied into strings and a dictionary keyed by the lower case name
+
+    struct NaiveHttpRequest {
+        std::string method;
+        std::string target;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    std::size_t parse_naively(const std::string& bytes, std::vector<NaiveHttpRequest>& requests) {
+        std::size_t position = 0;
+        while (true) {
+            const auto head_end = bytes.find("\r\n\r\n", position);
+            if (head_end == std::string::npos) {
+                return position;
+            }
+            NaiveHttpRequest request;
+            std::vector<std::string> lines;
+            for (auto line = position; line < head_end;) {
+                const auto end = bytes.find("\r\n", line);
+                lines.push_back(bytes.substr(line, end - line));
+                line = end + 2;
+            }
+            const auto space = lines[0].find(' ');
+            request.method = lines[0].substr(0, space);
+            request.target = lines[0].substr(space + 1, lines[0].rfind(' ') - space - 1);
+            for (std::size_t i = 1; i < lines.size(); ++i) {
+                const auto colon = lines[i].find(':');
+                auto name = lines[i].substr(0, colon);
+                std::ranges::transform(name, name.begin(), [](const unsigned char c) { return std::tolower(c); });
+                auto value = lines[i].substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                request.headers[name] = value;
+            }
+            std::size_t length = 0;
+            if (const auto it = request.headers.find("content-length"); it != request.headers.end()) {
+                length = std::stoul(it->second);
+            }
+            if (bytes.size() - head_end - 4 < length) {
+                return position;
+            }
+            request.body = bytes.substr(head_end + 4, length);
+            position = head_end + 4 + length;
+            requests.push_back(std::move(request));
+        }
+    }
+
+    void add_http_benchmarks(std::vector<MicroBenchmark>& benchmarks) {
+        // A pipelined batch of browser like requests, reported per request
+        constexpr std::size_t batch = 16;
+        std::string pipelined;
+        for (std::size_t i = 0; i < batch; ++i) {
+            pipelined += "GET /api/items/" + std::to_string(i) + "?page=2&sort=name HTTP/1.1\r\n"
+                "Host: example.com\r\n"
+                "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+                "Accept: application/json, text/plain, */*\r\n"
+                "Accept-Language: en-GB,en;q=0.5\r\n"
+                "Accept-Encoding: gzip, deflate, br\r\n"
+                "Connection: keep-alive\r\n"
+                "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+                "\r\n";
+        }
+
+        benchmarks.push_back({ "http.parse.stage", "ns/op",
+            [pipelined](const std::size_t ops, HdrHistogram&) {
+                FrameAssembler assembler { TcpFraming { TcpFramingMode::Http }, 16 * 1024 };
+                std::size_t parsed = 0;
+                const auto start = Clock::now();
+                while (parsed < ops) {
+                    const auto space = assembler.prepare();
+                    std::memcpy(space.data(), pipelined.data(), pipelined.size());
+                    assembler.commit(pipelined.size());
+                    do_not_optimize(assembler.collect());
+                    do_not_optimize(assembler.requests().back().header("cookie"));
+                    parsed += assembler.requests().size();
+                }
+                return (Clock::now() - start) * ops / parsed;
+            } });
+
+        benchmarks.push_back({ "http.parse.naive", "ns/op",
+            [pipelined](const std::size_t ops, HdrHistogram&) {
+                std::vector<NaiveHttpRequest> requests;
+                std::size_t parsed = 0;
+                const auto start = Clock::now();
+                while (parsed < ops) {
+                    const std::string received { pipelined };
+                    requests.clear();
+                    do_not_optimize(parse_naively(received, requests));
+                    do_not_optimize(requests.back().headers["cookie"]);
+                    parsed += requests.size();
+                }
+                return (Clock::now() - start) * ops / parsed;
+            } });
+    }
+
+    // SwiftFunctionWrapper, against calling the same function pointer directly
+
+    std::uint64_t calls { 0 };
+
+    void void_closure(void*) {
+        ++calls;
+    }
+
+    TCPCommandVariant receive_closure(void* arguments) {
+        const auto& [session, ec, bytes] = *static_cast<std::tuple<TcpSessionPtr, std::error_code, size_t>*>(arguments);
+        calls += bytes;
+        return TCPCommandVariant { TCPReadCommand {} };
+    }
+
+    void add_swift_function_wrapper_benchmarks(std::vector<MicroBenchmark>& benchmarks) {
+        benchmarks.push_back({ "swift_function_wrapper.direct_call.void", "ns/op",
+            [](const std::size_t ops, HdrHistogram&) {
+                auto function = &void_closure;
+                do_not_optimize(function);
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    function(nullptr);
+                }
+                do_not_optimize(calls);
+                return Clock::now() - start;
+            } });
+
+        benchmarks.push_back({ "swift_function_wrapper.call.void", "ns/op",
+            [](const std::size_t ops, HdrHistogram&) {
+                const SwiftFunctionWrapper<void, void> wrapper { reinterpret_cast<void*>(&void_closure) };
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    wrapper.call();
+                }
+                do_not_optimize(calls);
+                return Clock::now() - start;
+            } });
+
+        // The shape of the TCP receive callback: a shared pointer, an error code and a size in, a command out
+        benchmarks.push_back({ "swift_function_wrapper.call.tcp_on_receive", "ns/op",
+            [](const std::size_t ops, HdrHistogram&) {
+                const SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t> wrapper {
+                    reinterpret_cast<void*>(&receive_closure)
+                };
+                const TcpSessionPtr session {};
+                const auto start = Clock::now();
+                for (std::size_t i = 0; i < ops; ++i) {
+                    const auto command = wrapper.call(session, std::error_code {}, i);
+                    do_not_optimize(command);
+                }
+                return Clock::now() - start;
+            } });
+    }
+}
+
+int main(int argc, char** argv) {
+    const BenchmarkArguments arguments { argc, argv };
+    const Settings settings {
+        arguments.size("repetitions", 15),
+        arguments.size("warmup", 3),
+        std::chrono::milliseconds { arguments.size("min-batch-ms", 10) },
+    };
+    const auto filter = arguments.string("filter", "");
+    const auto threshold = arguments.number("threshold", 0.05);
+
+    // A pinned benchmark thread does not migrate between repetitions, which removes most of the run to run noise
+    if (arguments.has("cpu")) {
+        if (const auto ec = pin_current_thread({ static_cast<int>(arguments.size("cpu", 0)) })) {
+            std::fprintf(stderr, "[Error] Failed to pin the benchmark thread: %s\n", ec.message().c_str());
+        }
+    }
+
+    ThreadPool pool { arguments.size("pool-threads", 2) };
+    std::vector<MicroBenchmark> benchmarks;
+    add_thread_pool_benchmarks(benchmarks, pool);
+    add_sparse_vector_benchmarks(benchmarks);
+    add_buffer_benchmarks(benchmarks);
+    add_simd_scan_benchmarks(benchmarks);
+    add_http_benchmarks(benchmarks);
+    add_swift_function_wrapper_benchmarks(benchmarks);
+
+    const auto baseline = arguments.has("baseline") ? read_baseline(arguments.string("baseline", "")) : std::map<std::string, double> {};
+    bool regressed = false;
+
+    JsonWriter json;
+    json.begin_object();
+    write_environment(json, "micro", arguments.string("label", ""));
+    json.key("settings").begin_object()
+        .field("repetitions", settings.repetitions)
+        .field("warmup", settings.warmup)
+        .field("min_batch_ms", std::chrono::duration<double, std::milli>(settings.min_batch).count())
+        .field("pool_threads", pool.thread_count())
+        .end_object();
+    json.key("results").begin_array();
+    for (const auto& benchmark : benchmarks) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        const auto result = run(benchmark, settings);
+        const auto center = median(result.samples);
+        const auto mad = median_absolute_deviation(result.samples);
+
+        json.begin_object()
+            .field("name", result.name)
+            .field("unit", result.unit)
+            .field("median", center)
+            .field("mad", mad)
+            .field("relative_mad", center > 0 ? mad / center : 0.0)
+            .field("min", *std::ranges::min_element(result.samples))
+            .field("max", *std::ranges::max_element(result.samples))
+            .field("ops_per_repetition", result.ops_per_repetition);
+        if (result.has_distribution) {
+            write_latency(json, "distribution", result.distribution);
+        }
+
+        std::string verdict;
+        if (const auto it = baseline.find(result.name); it != baseline.end() && it->second > 0) {
+            const auto change = (center - it->second) / it->second;
+            // Slower by more than the threshold and by more than three times the noise of this run
+            const auto regression = change > threshold && center - it->second > 3 * mad;
+            regressed |= regression;
+            json.field("baseline_median", it->second)
+                .field("change", change)
+                .field("regression", regression);
+            char formatted[64];
+            std::snprintf(formatted, sizeof(formatted), "  %+.1f%%%s", change * 100, regression ? "  REGRESSION" : "");
+            verdict = formatted;
+        }
+        json.end_object();
+
+        std::fprintf(stderr, "%-48s %12.1f %-10s ± %.1f%s\n",
+            result.name.c_str(), center, result.unit.c_str(), mad, verdict.c_str());
+    }
+    json.end_array().end_object();
+
+    if (!write_json_output(arguments.string("output", "micro_benchmark.json"), json)) {
+        return 1;
+    }
+    return regressed ? 2 : 0;
+}
@@ -0,0 +1,370 @@
+// TCP proxy throughput benchmark
+// A load generator streams bytes into a proxy, the proxy forwards them to a sink server that only reads.
+// For every accepted connection the proxy opens an upstream connection with a TcpClient. In copy mode the bytes
+// take the regular path: a read into the session buffer, a copy into a write command on the upstream session and
+// the write. In splice mode the upstream session splices the two sockets, so the bytes stay in the kernel.
+// Throughput is what the sink received during the measurement window. Proxy CPU is the thread CPU time of the
+// proxy workers, the load generator and the sink run on their own threads. Results are written as JSON.
+//
+// Usage: lumengineProxyBenchmark [--modes copy,splice] [--pool-threads 1,2] [--connections 1,16]
+//                                [--chunk 65536] [--client-threads 2] [--sink-threads 2]
+//                                [--warmup 1] [--duration 3] [--port 19300]
+//                                [--label name] [--output tcp_proxy_benchmark.json | -]
+
+#include <cxxLumengine.hpp>
+#include <benchmark_support.hpp>
+
+#include <latch>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct ProxyConfig;
+    using ProxySession = BasicTcpSession<ProxyConfig>;
+    using ProxySessionPtr = std::shared_ptr<ProxySession>;
+
+    // The upstream callbacks are plain functions like Swift closures, so the mode of the run is global
+    bool splice_mode { false };
+
+    // Downstream side: every accepted connection asks the client for an upstream and waits for it
+    struct ProxyConfig {
+        using HandlerPtr = std::shared_ptr<BasicTcpHandler<ProxyConfig>>;
+
+        uint read_buffer_size { 64 * 1024 };
+        uint pre_allocated_session_count { 1024 };
+        TcpClientPtr client;
+        asio::ip::tcp::endpoint upstream;
+
+        TCPCommandVariant on_connect(const ProxySessionPtr& session, const std::error_code& ec) const {
+            if (ec || !client->connect(upstream, session)) {
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+            return TCPCommandVariant { TCPHoldCommand {} };
+        }
+
+        // Copy mode only, the upstream resumes the read once the previous chunk was written
+        TCPCommandVariant on_receive(const ProxySessionPtr& session, const std::error_code& ec, const size_t bytes) const {
+            const auto upstream_session = std::static_pointer_cast<TcpClientSession>(session->context());
+            if (ec || bytes == 0 || !upstream_session) {
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+            Buffer chunk { bytes };
+            chunk.write(session->read_buffer().pointer(), bytes);
+            upstream_session->resume(TCPCommandVariant { TCPWriteCommand { std::move(chunk) } });
+            return TCPCommandVariant { TCPHoldCommand {} };
+        }
+
+        TCPCommandVariant on_write(const ProxySessionPtr&, const std::error_code&, size_t) const {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+
+        void on_disconnect(const ProxySessionPtr& session, const std::error_code&) const {
+            if (const auto upstream_session = std::static_pointer_cast<TcpClientSession>(session->context())) {
+                session->set_context(nullptr);
+                upstream_session->close();
+            }
+        }
+
+        void on_start(const HandlerPtr&) const {}
+        void on_stop(const HandlerPtr&) const {}
+    };
+
+    // Upstream side, called through SwiftFunctionWrapper. The context of the session is its downstream.
+    TCPCommandVariant upstream_on_connect(void* arguments) {
+        const auto& [session, ec] = *static_cast<std::tuple<TcpClientSessionPtr, std::error_code>*>(arguments);
+        const auto downstream = std::static_pointer_cast<ProxySession>(session->context());
+        if (ec) {
+            downstream->close();
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+        if (splice_mode) {
+            return TCPCommandVariant { splice_with(downstream) };
+        }
+        downstream->set_context(session);
+        downstream->resume(TCPCommandVariant { TCPReadCommand {} });
+        return TCPCommandVariant { TCPHoldCommand {} };
+    }
+
+    // Copy mode never reads upstream, in splice mode this is the end of the splice
+    TCPCommandVariant upstream_on_receive(void*) {
+        return TCPCommandVariant { TCPCloseCommand {} };
+    }
+
+    TCPCommandVariant upstream_on_write(void* arguments) {
+        const auto& [session, ec, bytes] = *static_cast<std::tuple<TcpClientSessionPtr, std::error_code, size_t>*>(arguments);
+        const auto downstream = std::static_pointer_cast<ProxySession>(session->context());
+        if (ec || !downstream) {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+        downstream->resume(TCPCommandVariant { TCPReadCommand {} });
+        return TCPCommandVariant { TCPHoldCommand {} };
+    }
+
+    void upstream_on_disconnect(void* arguments) {
+        const auto& [session, ec] = *static_cast<std::tuple<TcpClientSessionPtr, std::error_code>*>(arguments);
+        if (const auto downstream = std::static_pointer_cast<ProxySession>(session->context())) {
+            session->set_context(nullptr);
+            downstream->close();
+        }
+    }
+
+    // Reads and drops everything
+    struct SinkConfig {
+        using SessionPtr = std::shared_ptr<BasicTcpSession<SinkConfig>>;
+        using HandlerPtr = std::shared_ptr<BasicTcpHandler<SinkConfig>>;
+
+        uint read_buffer_size { 64 * 1024 };
+        uint pre_allocated_session_count { 1024 };
+
+        TCPCommandVariant on_connect(const SessionPtr&, const std::error_code& ec) const {
+            return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+        }
+
+        TCPCommandVariant on_receive(const SessionPtr&, const std::error_code& ec, const size_t bytes) const {
+            return ec || bytes == 0 ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+        }
+
+        TCPCommandVariant on_write(const SessionPtr&, const std::error_code&, size_t) const {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+
+        void on_disconnect(const SessionPtr&, const std::error_code&) const {}
+        void on_start(const HandlerPtr&) const {}
+        void on_stop(const HandlerPtr&) const {}
+    };
+
+    // Streams chunks over its connections until it is stopped
+    class ClientThread final {
+        asio::io_context m_io_context { 1 };
+        std::vector<std::unique_ptr<asio::ip::tcp::socket>> m_sockets;
+        std::vector<char> m_chunk;
+        std::uint64_t m_errors { 0 };
+        bool m_running { true };
+        std::thread m_thread;
+
+        void send(asio::ip::tcp::socket& socket) {
+            if (!m_running) {
+                std::error_code ec;
+                ec = socket.close(ec);
+                return;
+            }
+            async_write(socket, asio::buffer(m_chunk), [this, &socket](const std::error_code ec, size_t) {
+                if (ec) {
+                    ++m_errors;
+                    return;
+                }
+                send(socket);
+            });
+        }
+
+    public:
+        explicit ClientThread(const std::size_t chunk_size): m_chunk(chunk_size, 'x') {}
+
+        std::error_code connect(const asio::ip::tcp::endpoint& endpoint, const std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i) {
+                auto socket = std::make_unique<asio::ip::tcp::socket>(m_io_context);
+                std::error_code ec;
+                ec = socket->connect(endpoint, ec);
+                if (ec) {
+                    return ec;
+                }
+                m_sockets.push_back(std::move(socket));
+            }
+            return {};
+        }
+
+        void start() {
+            for (const auto& socket : m_sockets) {
+                send(*socket);
+            }
+            m_thread = std::thread { [this] { m_io_context.run(); } };
+        }
+
+        void stop() {
+            post(m_io_context, [this] { m_running = false; });
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+
+        [[nodiscard]] std::uint64_t errors() const { return m_errors; }
+    };
+
+    std::chrono::nanoseconds workers_busy_time(const LeScheduler& scheduler) {
+        std::chrono::nanoseconds busy { 0 };
+        for (const auto& worker : scheduler.loop_snapshots()) {
+            busy += std::chrono::nanoseconds { worker.busy_ns };
+        }
+        return busy;
+    }
+
+    // Paired sessions refer to each other through their contexts until both are disconnected, so the
+    // pool must not go away while their closes are still queued
+    bool wait_for_sessions_to_close(const LeScheduler& scheduler, const std::chrono::nanoseconds timeout) {
+        const auto deadline = Clock::now() + timeout;
+        while (scheduler.metrics_snapshot().tcp_active_sessions > 0) {
+            if (Clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+        }
+        return true;
+    }
+
+    struct RunConfig {
+        bool splice;
+        std::size_t pool_threads;
+        std::size_t connections;
+        std::size_t chunk_size;
+        std::size_t client_threads;
+        std::size_t sink_threads;
+        int port;
+        std::chrono::duration<double> warmup;
+        std::chrono::duration<double> duration;
+    };
+
+    bool run_once(const RunConfig& config, JsonWriter& json) {
+        std::fprintf(stderr, "mode=%s pool_threads=%zu connections=%zu chunk=%zu ... ",
+            config.splice ? "splice" : "copy", config.pool_threads, config.connections, config.chunk_size);
+        splice_mode = config.splice;
+
+        const auto loopback = asio::ip::make_address("127.0.0.1");
+        const auto sink_port = config.port;
+        const auto proxy_port = config.port + 1;
+
+        LeScheduler sink { ThreadPoolConfig { config.sink_threads } };
+        auto sink_config = std::make_shared<SinkConfig>();
+        sink_config->read_buffer_size = static_cast<uint>(std::max<std::size_t>(config.chunk_size, 16 * 1024));
+        if (const auto ec = start_server_and_wait(sink, std::make_shared<ServerConfig>(sink_port, false,
+                ProtocolHandlerConfigVariant(NativeHandlerConfig::tcp<SinkConfig>(std::move(sink_config)))))) {
+            std::fprintf(stderr, "sink did not start: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        // Probed often, so the busy time of the workers is close to the measurement window
+        ThreadPoolConfig pool_config { config.pool_threads };
+        pool_config.loop_probe_interval = std::chrono::milliseconds { 10 };
+        LeScheduler proxy { pool_config };
+        const auto client_config = std::make_shared<TcpClientConfig>(TcpClientConfig {
+            static_cast<uint>(std::max<std::size_t>(config.chunk_size, 16 * 1024)),
+            static_cast<uint>(config.connections * 2),
+            16,
+            std::chrono::seconds { 30 },
+            SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code>(reinterpret_cast<void*>(&upstream_on_connect)),
+            SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t>(reinterpret_cast<void*>(&upstream_on_receive)),
+            SwiftFunctionWrapper<TCPCommandVariant, TcpClientSessionPtr, std::error_code, size_t>(reinterpret_cast<void*>(&upstream_on_write)),
+            SwiftFunctionWrapper<void, TcpClientSessionPtr, std::error_code>(reinterpret_cast<void*>(&upstream_on_disconnect)),
+        });
+        const auto client = proxy.create_tcp_client(client_config);
+        auto proxy_config = std::make_shared<ProxyConfig>();
+        proxy_config->read_buffer_size = static_cast<uint>(std::max<std::size_t>(config.chunk_size, 16 * 1024));
+        proxy_config->client = client;
+        proxy_config->upstream = { loopback, static_cast<asio::ip::port_type>(sink_port) };
+        if (const auto ec = start_server_and_wait(proxy, std::make_shared<ServerConfig>(proxy_port, false,
+                ProtocolHandlerConfigVariant(NativeHandlerConfig::tcp<ProxyConfig>(std::move(proxy_config)))))) {
+            std::fprintf(stderr, "proxy did not start: %s\n", ec.message().c_str());
+            stop_server_and_wait(sink, sink_port);
+            return false;
+        }
+
+        std::vector<std::unique_ptr<ClientThread>> clients;
+        const auto client_threads = std::max<std::size_t>(1, std::min(config.client_threads, config.connections));
+        const asio::ip::tcp::endpoint endpoint { loopback, static_cast<asio::ip::port_type>(proxy_port) };
+        for (std::size_t i = 0; i < client_threads; ++i) {
+            auto load = std::make_unique<ClientThread>(config.chunk_size);
+            const auto share = config.connections / client_threads + (i < config.connections % client_threads ? 1 : 0);
+            if (const auto ec = load->connect(endpoint, share)) {
+                std::fprintf(stderr, "connect failed: %s\n", ec.message().c_str());
+                client->stop();
+                stop_server_and_wait(proxy, proxy_port);
+                stop_server_and_wait(sink, sink_port);
+                return false;
+            }
+            clients.push_back(std::move(load));
+        }
+        for (const auto& load : clients) {
+            load->start();
+        }
+
+        std::this_thread::sleep_for(config.warmup);
+        const auto bytes_start = sink.metrics_snapshot(sink_port).tcp_bytes_in;
+        const auto busy_start = workers_busy_time(proxy);
+        const auto wall_start = Clock::now();
+        std::this_thread::sleep_for(config.duration);
+        const auto bytes = sink.metrics_snapshot(sink_port).tcp_bytes_in - bytes_start;
+        const auto proxy_cpu = workers_busy_time(proxy) - busy_start;
+        const auto wall_time = std::chrono::duration<double>(Clock::now() - wall_start).count();
+
+        std::uint64_t errors = 0;
+        for (const auto& load : clients) {
+            load->stop();
+            errors += load->errors();
+        }
+        client->stop();
+        if (!wait_for_sessions_to_close(proxy, std::chrono::seconds { 5 })) {
+            std::fprintf(stderr, "proxy sessions did not close ... ");
+        }
+        stop_server_and_wait(proxy, proxy_port);
+        stop_server_and_wait(sink, sink_port);
+
+        const auto mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+        const auto cpu_s = static_cast<double>(proxy_cpu.count()) / 1e9;
+        json.begin_object()
+            .field("mode", config.splice ? "splice" : "copy")
+            .field("pool_threads", config.pool_threads)
+            .field("connections", config.connections)
+            .field("chunk_bytes", config.chunk_size)
+            .field("client_threads", client_threads)
+            .field("duration_s", wall_time)
+            .field("bytes", bytes)
+            .field("errors", errors)
+            .field("throughput_mib_per_second", mib / wall_time)
+            .field("proxy_cpu_cores", cpu_s / wall_time)
+            .field("proxy_cpu_ms_per_gib", mib > 0 ? cpu_s * 1000.0 * 1024.0 / mib : 0.0)
+            .end_object();
+
+        std::fprintf(stderr, "%.0f MiB/s, proxy %.2f cores\n", mib / wall_time, cpu_s / wall_time);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    const BenchmarkArguments arguments { argc, argv };
+    const auto modes = arguments.strings("modes", { "copy", "splice" });
+    const auto pool_threads = arguments.sizes("pool-threads", { 1, 2 });
+    const auto connections = arguments.sizes("connections", { 1, 16 });
+    const auto chunk_size = arguments.size("chunk", 64 * 1024);
+    const auto client_threads = arguments.size("client-threads", 2);
+    const auto sink_threads = arguments.size("sink-threads", 2);
+    const auto base_port = static_cast<int>(arguments.size("port", 19300));
+    const std::chrono::duration<double> warmup { arguments.number("warmup", 1) };
+    const std::chrono::duration<double> duration { arguments.number("duration", 3) };
+
+    JsonWriter json;
+    json.begin_object();
+    write_environment(json, "tcp_proxy", arguments.string("label", ""));
+    json.key("runs").begin_array();
+    bool succeeded = true;
+    int run = 0;
+    for (const auto& mode : modes) {
+        if (mode != "copy" && mode != "splice") {
+            std::fprintf(stderr, "[Error] Unknown mode %s\n", mode.c_str());
+            return 1;
+        }
+        for (const auto threads : pool_threads) {
+            for (const auto connection_count : connections) {
+                // Every run uses its own pair of ports, so sockets of the previous run in TIME_WAIT do not interfere
+                succeeded &= run_once({
+                    mode == "splice", threads, connection_count, chunk_size, client_threads, sink_threads,
+                    base_port + 2 * run++, warmup, duration
+                }, json);
+            }
+        }
+    }
+    json.end_array().end_object();
+
+    if (!write_json_output(arguments.string("output", "tcp_proxy_benchmark.json"), json)) {
+        return 1;
+    }
+    return succeeded ? 0 : 1;
+}
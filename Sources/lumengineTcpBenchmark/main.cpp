@@ -0,0 +1,392 @@
+// TCP echo benchmark
+// Starts a TcpHandler on loopback through the scheduler, exactly like the Swift layer does, and drives it with
+// closed loop connections: every connection sends one payload, waits for the full echo and sends the next.
+// Each combination of handler kind, pool size, connection count and payload size is one run. The swift handler
+// goes through SwiftFunctionWrapper like the Swift layer, the native one is a C++ config with the same echo logic,
+// so the difference between the two is the cost of the interop. Results are written as JSON.
+//
+// Usage: lumengineTcpBenchmark [--handlers swift,native]
+//                              [--pool-threads 1,2,4] [--connections 1,16,64] [--payload 64,1024,16384]
+//                              [--client-threads N] [--warmup 1] [--duration 3] [--port 19100] [--v6]
+//                              [--label name] [--output tcp_echo_benchmark.json | -]
+
+#include <cxxLumengine.hpp>
+#include <benchmark_support.hpp>
+
+#include <latch>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Server callbacks, called through SwiftFunctionWrapper with the same argument tuples a Swift closure gets
+    TCPCommandVariant echo_on_connect(void*) {
+        return TCPCommandVariant { TCPReadCommand {} };
+    }
+
+    TCPCommandVariant echo_on_receive(void* arguments) {
+        const auto& [session, ec, bytes] = *static_cast<std::tuple<TcpSessionPtr, std::error_code, size_t>*>(arguments);
+        if (ec || bytes == 0) {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+        Buffer reply { bytes };
+        reply.write(session->read_buffer().pointer(), bytes);
+        return TCPCommandVariant { TCPWriteCommand { std::move(reply) } };
+    }
+
+    TCPCommandVariant echo_on_write(void* arguments) {
+        const auto& [session, ec, bytes] = *static_cast<std::tuple<TcpSessionPtr, std::error_code, size_t>*>(arguments);
+        if (ec) {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+        return TCPCommandVariant { TCPReadCommand {} };
+    }
+
+    void ignore_event(void*) {}
+
+    // The same echo server without Swift interop, the callbacks are inlined into the session
+    struct NativeEchoConfig {
+        using SessionPtr = std::shared_ptr<BasicTcpSession<NativeEchoConfig>>;
+        using HandlerPtr = std::shared_ptr<BasicTcpHandler<NativeEchoConfig>>;
+
+        uint read_buffer_size { 16 * 1024 };
+        uint pre_allocated_session_count { 1024 };
+
+        TCPCommandVariant on_connect(const SessionPtr&, const std::error_code&) const {
+            return TCPCommandVariant { TCPReadCommand {} };
+        }
+
+        TCPCommandVariant on_receive(const SessionPtr& session, const std::error_code& ec, const size_t bytes) const {
+            if (ec || bytes == 0) {
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+            Buffer reply { bytes };
+            reply.write(session->read_buffer().pointer(), bytes);
+            return TCPCommandVariant { TCPWriteCommand { std::move(reply) } };
+        }
+
+        TCPCommandVariant on_write(const SessionPtr&, const std::error_code& ec, size_t) const {
+            if (ec) {
+                return TCPCommandVariant { TCPCloseCommand {} };
+            }
+            return TCPCommandVariant { TCPReadCommand {} };
+        }
+
+        void on_disconnect(const SessionPtr&, const std::error_code&) const {}
+        void on_start(const HandlerPtr&) const {}
+        void on_stop(const HandlerPtr&) const {}
+    };
+
+    ServerConfigPtr native_echo_server_config(const int port, const bool v6, const std::size_t read_buffer_size) {
+        auto config = std::make_shared<NativeEchoConfig>();
+        config->read_buffer_size = static_cast<uint>(read_buffer_size);
+        return std::make_shared<ServerConfig>(port, v6, ProtocolHandlerConfigVariant(
+            NativeHandlerConfig::tcp<NativeEchoConfig>(std::move(config))
+        ));
+    }
+
+    ServerConfigPtr echo_server_config(const int port, const bool v6, const std::size_t read_buffer_size) {
+        return std::make_shared<ServerConfig>(port, v6, ProtocolHandlerConfigVariant(TcpConfig {
+            static_cast<uint>(read_buffer_size),
+            1024,
+            SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code>(reinterpret_cast<void*>(&echo_on_connect)),
+            SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t>(reinterpret_cast<void*>(&echo_on_receive)),
+            SwiftFunctionWrapper<TCPCommandVariant, TcpSessionPtr, std::error_code, size_t>(reinterpret_cast<void*>(&echo_on_write)),
+            SwiftFunctionWrapper<void, TcpSessionPtr, std::error_code>(reinterpret_cast<void*>(&ignore_event)),
+            SwiftFunctionWrapper<void, TcpHandlerPtr>(reinterpret_cast<void*>(&ignore_event)),
+            SwiftFunctionWrapper<void, TcpHandlerPtr>(reinterpret_cast<void*>(&ignore_event)),
+        }));
+    }
+
+    class ClientThread;
+
+    // One closed loop connection of the load generator
+    class ClientConnection final {
+        ClientThread& m_owner;
+        asio::ip::tcp::socket m_socket;
+        std::vector<char> m_payload;
+        std::vector<char> m_reply;
+        Clock::time_point m_sent;
+
+        void send();
+        void receive();
+
+    public:
+        ClientConnection(ClientThread& owner, asio::io_context& io_context, const std::size_t payload_size);
+
+        std::error_code connect(const asio::ip::tcp::endpoint& endpoint) {
+            std::error_code ec;
+            ec = m_socket.connect(endpoint, ec);
+            if (!ec) {
+                ec = m_socket.set_option(asio::ip::tcp::no_delay { true }, ec);
+            }
+            return ec;
+        }
+
+        void start() {
+            send();
+        }
+    };
+
+    // Runs a share of the connections on its own io_context
+    // Statistics are only touched by the client thread. The measurement window is opened and closed by handlers
+    // posted to that thread, so requests and thread CPU time are counted over the same window.
+    class ClientThread final {
+        asio::io_context m_io_context { 1 };
+        std::vector<std::unique_ptr<ClientConnection>> m_connections;
+        HdrHistogram m_latency { 1, 60'000'000'000, 3 };
+        std::uint64_t m_requests { 0 };
+        std::uint64_t m_errors { 0 };
+        bool m_measuring { false };
+        bool m_running { true };
+        std::chrono::nanoseconds m_cpu_start { 0 };
+        std::chrono::nanoseconds m_cpu_time { 0 };
+        std::thread m_thread;
+
+    public:
+        std::error_code connect(const asio::ip::tcp::endpoint& endpoint, const std::size_t count, const std::size_t payload_size) {
+            for (std::size_t i = 0; i < count; ++i) {
+                auto connection = std::make_unique<ClientConnection>(*this, m_io_context, payload_size);
+                if (const auto ec = connection->connect(endpoint)) {
+                    return ec;
+                }
+                m_connections.push_back(std::move(connection));
+            }
+            return {};
+        }
+
+        void start() {
+            for (const auto& connection : m_connections) {
+                connection->start();
+            }
+            m_thread = std::thread { [this] { m_io_context.run(); } };
+        }
+
+        void begin_measurement(std::latch& done) {
+            post(m_io_context, [this, &done] {
+                m_cpu_start = thread_cpu_time();
+                m_measuring = true;
+                done.count_down();
+            });
+        }
+
+        void end_measurement(std::latch& done) {
+            post(m_io_context, [this, &done] {
+                m_measuring = false;
+                m_cpu_time = thread_cpu_time() - m_cpu_start;
+                done.count_down();
+            });
+        }
+
+        // Connections finish their current request and close, the thread exits once all of them are gone
+        void stop() {
+            post(m_io_context, [this] { m_running = false; });
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+
+        void completed(const Clock::time_point sent) {
+            if (m_measuring) {
+                m_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent).count());
+                ++m_requests;
+            }
+        }
+
+        void failed() {
+            ++m_errors;
+        }
+
+        [[nodiscard]] bool running() const { return m_running; }
+        [[nodiscard]] const HdrHistogram& latency() const { return m_latency; }
+        [[nodiscard]] std::uint64_t requests() const { return m_requests; }
+        [[nodiscard]] std::uint64_t errors() const { return m_errors; }
+        [[nodiscard]] std::chrono::nanoseconds cpu_time() const { return m_cpu_time; }
+    };
+
+    ClientConnection::ClientConnection(ClientThread& owner, asio::io_context& io_context, const std::size_t payload_size):
+        m_owner { owner },
+        m_socket { io_context },
+        m_payload(payload_size, 'x'),
+        m_reply(payload_size) {}
+
+    void ClientConnection::send() {
+        if (!m_owner.running()) {
+            std::error_code ec;
+            ec = m_socket.close(ec);
+            return;
+        }
+        m_sent = Clock::now();
+        async_write(m_socket, asio::buffer(m_payload), [this](const std::error_code ec, size_t) {
+            if (ec) {
+                m_owner.failed();
+                return;
+            }
+            receive();
+        });
+    }
+
+    void ClientConnection::receive() {
+        async_read(m_socket, asio::buffer(m_reply), [this](const std::error_code ec, size_t) {
+            if (ec) {
+                m_owner.failed();
+                return;
+            }
+            m_owner.completed(m_sent);
+            send();
+        });
+    }
+
+    struct RunConfig {
+        bool native;
+        std::size_t pool_threads;
+        std::size_t connections;
+        std::size_t payload_size;
+        std::size_t client_threads;
+        int port;
+        bool v6;
+        std::chrono::duration<double> warmup;
+        std::chrono::duration<double> duration;
+    };
+
+    bool run_once(const RunConfig& config, JsonWriter& json) {
+        std::fprintf(stderr, "handler=%s pool_threads=%zu connections=%zu payload=%zu ... ",
+            config.native ? "native" : "swift", config.pool_threads, config.connections, config.payload_size);
+
+        LeScheduler scheduler { ThreadPoolConfig { config.pool_threads } };
+        const auto read_buffer_size = std::max<std::size_t>(config.payload_size, 16 * 1024);
+        const auto server_config = config.native
+            ? native_echo_server_config(config.port, config.v6, read_buffer_size)
+            : echo_server_config(config.port, config.v6, read_buffer_size);
+        if (const auto ec = start_server_and_wait(scheduler, server_config)) {
+            std::fprintf(stderr, "server did not start: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        const asio::ip::tcp::endpoint endpoint {
+            asio::ip::make_address(config.v6 ? "::1" : "127.0.0.1"),
+            static_cast<asio::ip::port_type>(config.port)
+        };
+        std::vector<std::unique_ptr<ClientThread>> clients;
+        const auto client_threads = std::max<std::size_t>(1, std::min(config.client_threads, config.connections));
+        for (std::size_t i = 0; i < client_threads; ++i) {
+            auto client = std::make_unique<ClientThread>();
+            const auto share = config.connections / client_threads + (i < config.connections % client_threads ? 1 : 0);
+            if (const auto ec = client->connect(endpoint, share, config.payload_size)) {
+                std::fprintf(stderr, "connect failed: %s\n", ec.message().c_str());
+                stop_server_and_wait(scheduler, config.port);
+                return false;
+            }
+            clients.push_back(std::move(client));
+        }
+        for (const auto& client : clients) {
+            client->start();
+        }
+
+        std::this_thread::sleep_for(config.warmup);
+        std::latch began { static_cast<std::ptrdiff_t>(clients.size()) };
+        for (const auto& client : clients) {
+            client->begin_measurement(began);
+        }
+        began.wait();
+        const auto wall_start = Clock::now();
+        const auto cpu_start = process_cpu_time();
+
+        std::this_thread::sleep_for(config.duration);
+        std::latch ended { static_cast<std::ptrdiff_t>(clients.size()) };
+        for (const auto& client : clients) {
+            client->end_measurement(ended);
+        }
+        ended.wait();
+        const auto wall_time = std::chrono::duration<double>(Clock::now() - wall_start).count();
+        const auto process_cpu = process_cpu_time() - cpu_start;
+
+        for (const auto& client : clients) {
+            client->stop();
+        }
+        stop_server_and_wait(scheduler, config.port);
+
+        HdrHistogram latency { 1, 60'000'000'000, 3 };
+        std::uint64_t requests = 0;
+        std::uint64_t errors = 0;
+        std::chrono::nanoseconds client_cpu { 0 };
+        for (const auto& client : clients) {
+            latency.merge(client->latency());
+            requests += client->requests();
+            errors += client->errors();
+            client_cpu += client->cpu_time();
+        }
+        // Everything that is not the load generator is the engine, the main thread only sleeps
+        const auto server_cpu = std::max(std::chrono::nanoseconds { 0 }, process_cpu - client_cpu);
+        const auto per_request_us = [requests](const std::chrono::nanoseconds cpu) {
+            return requests ? static_cast<double>(cpu.count()) / 1000.0 / static_cast<double>(requests) : 0.0;
+        };
+        const auto requests_per_second = static_cast<double>(requests) / wall_time;
+
+        json.begin_object()
+            .field("handler", config.native ? "native" : "swift")
+            .field("pool_threads", config.pool_threads)
+            .field("connections", config.connections)
+            .field("payload_bytes", config.payload_size)
+            .field("client_threads", client_threads)
+            .field("duration_s", wall_time)
+            .field("requests", requests)
+            .field("errors", errors)
+            .field("requests_per_second", requests_per_second)
+            .field("throughput_mib_per_second", requests_per_second * static_cast<double>(config.payload_size) * 2 / (1024.0 * 1024.0))
+            .field("server_cpu_us_per_request", per_request_us(server_cpu))
+            .field("client_cpu_us_per_request", per_request_us(client_cpu))
+            .field("server_cpu_cores", static_cast<double>(server_cpu.count()) / 1e9 / wall_time);
+        write_latency(json, "latency", latency);
+        json.end_object();
+
+        std::fprintf(stderr, "%.0f req/s, p50 %.1f us, p99 %.1f us, p99.9 %.1f us\n",
+            requests_per_second,
+            static_cast<double>(latency.value_at_percentile(50)) / 1000.0,
+            static_cast<double>(latency.value_at_percentile(99)) / 1000.0,
+            static_cast<double>(latency.value_at_percentile(99.9)) / 1000.0);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    const BenchmarkArguments arguments { argc, argv };
+    const auto handlers = arguments.strings("handlers", { "swift", "native" });
+    const auto pool_threads = arguments.sizes("pool-threads", { 1, 2, 4 });
+    const auto connections = arguments.sizes("connections", { 1, 16, 64 });
+    const auto payloads = arguments.sizes("payload", { 64, 1024, 16 * 1024 });
+    const auto hardware_threads = std::max<std::size_t>(2, std::thread::hardware_concurrency());
+    const auto client_threads = arguments.size("client-threads", hardware_threads / 2);
+    const auto base_port = static_cast<int>(arguments.size("port", 19100));
+    const auto v6 = arguments.has("v6");
+    const std::chrono::duration<double> warmup { arguments.number("warmup", 1) };
+    const std::chrono::duration<double> duration { arguments.number("duration", 3) };
+
+    JsonWriter json;
+    json.begin_object();
+    write_environment(json, "tcp_echo", arguments.string("label", ""));
+    json.key("runs").begin_array();
+    bool succeeded = true;
+    int run = 0;
+    for (const auto& handler : handlers) {
+        if (handler != "swift" && handler != "native") {
+            std::fprintf(stderr, "[Error] Unknown handler %s\n", handler.c_str());
+            return 1;
+        }
+        for (const auto threads : pool_threads) {
+            for (const auto connection_count : connections) {
+                for (const auto payload : payloads) {
+                    // Every run listens on its own port, so sockets of the previous run in TIME_WAIT do not interfere
+                    succeeded &= run_once({
+                        handler == "native", threads, connection_count, payload, client_threads, base_port + run++, v6, warmup, duration
+                    }, json);
+                }
+            }
+        }
+    }
+    json.end_array().end_object();
+
+    if (!write_json_output(arguments.string("output", "tcp_echo_benchmark.json"), json)) {
+        return 1;
+    }
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+// TLS handshake benchmark
+// A client thread opens connections to a TLS server over loopback one after another and times the handshake of
+// each. Full handshakes never offer a session. Resumed handshakes offer the session of the previous connection,
+// as a stateless ticket or, with tickets disabled on the server, by session id (a stateful ticket in TLS 1.3)
+// from the server session cache. The server writes a short greeting after the handshake, so the client also
+// receives the TLS 1.3 tickets before it saves the session. Every run starts a fresh server with a self-signed
+// P-256 certificate. Client latency and the server side handshake histogram are written as JSON.
+// Needs a build with the TLS trait: swift run -c release --traits TLS lumengineTlsBenchmark
+//
+// Usage: lumengineTlsBenchmark [--versions 1.2,1.3] [--modes full,ticket,session-id] [--pool-threads 1]
+//                              [--handshakes 2000] [--warmup 100] [--port 19400]
+//                              [--label name] [--output tls_handshake_benchmark.json | -]
+
+#include <cxxLumengine.hpp>
+#include <benchmark_support.hpp>
+
+#if defined(LE_ENABLE_TLS)
+
+#include <cstdio>
+#include <filesystem>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Greets every client once the handshake is done and closes when the client does
+    struct GreetingConfig {
+        using SessionPtr = std::shared_ptr<BasicTcpSession<GreetingConfig>>;
+        using HandlerPtr = std::shared_ptr<BasicTcpHandler<GreetingConfig>>;
+
+        uint read_buffer_size { 4 * 1024 };
+        uint pre_allocated_session_count { 1024 };
+        TcpTls tls {};
+
+        TCPCommandVariant on_connect(const SessionPtr&, const std::error_code& ec) const {
+            return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPWriteCommand { Buffer { std::string { "hello\n" } } } };
+        }
+
+        TCPCommandVariant on_receive(const SessionPtr&, const std::error_code&, size_t) const {
+            return TCPCommandVariant { TCPCloseCommand {} };
+        }
+
+        TCPCommandVariant on_write(const SessionPtr&, const std::error_code& ec, size_t) const {
+            return ec ? TCPCommandVariant { TCPCloseCommand {} } : TCPCommandVariant { TCPReadCommand {} };
+        }
+
+        void on_disconnect(const SessionPtr&, const std::error_code&) const {}
+        void on_start(const HandlerPtr&) const {}
+        void on_stop(const HandlerPtr&) const {}
+    };
+
+    struct Certificate {
+        std::filesystem::path chain_file;
+        std::filesystem::path key_file;
+
+        ~Certificate() {
+            std::error_code ec;
+            std::filesystem::remove(chain_file, ec);
+            std::filesystem::remove(key_file, ec);
+        }
+    };
+
+    bool write_pem(const std::filesystem::path& path, const auto& write) {
+        auto* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        const auto written = write(file) == 1;
+        std::fclose(file);
+        return written;
+    }
+
+    // Self-signed, valid for a day
+    bool generate_certificate(Certificate& certificate) {
+        const auto directory = std::filesystem::temp_directory_path();
+        const auto prefix = "lumengine_tls_benchmark_" + std::to_string(::getpid());
+        certificate.chain_file = directory / (prefix + "_chain.pem");
+        certificate.key_file = directory / (prefix + "_key.pem");
+
+        const std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key { EVP_EC_gen("P-256"), &EVP_PKEY_free };
+        const std::unique_ptr<X509, decltype(&X509_free)> x509 { X509_new(), &X509_free };
+        if (!key || !x509) {
+            return false;
+        }
+        X509_set_version(x509.get(), 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(x509.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(x509.get()), 0);
+        X509_gmtime_adj(X509_getm_notAfter(x509.get()), 24 * 60 * 60);
+        X509_set_pubkey(x509.get(), key.get());
+        auto* name = X509_get_subject_name(x509.get());
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(x509.get(), name);
+        if (X509_sign(x509.get(), key.get(), EVP_sha256()) == 0) {
+            return false;
+        }
+        return write_pem(certificate.chain_file, [&](FILE* file) { return PEM_write_X509(file, x509.get()); }) &&
+               write_pem(certificate.key_file, [&](FILE* file) {
+                   return PEM_write_PrivateKey(file, key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+               });
+    }
+
+    struct RunConfig {
+        // TLS1_2_VERSION or TLS1_3_VERSION
+        int version;
+        std::string mode;
+        std::size_t pool_threads;
+        std::size_t handshakes;
+        std::size_t warmup;
+        int port;
+    };
+
+    struct Sample {
+        bool succeeded { false };
+        bool resumed { false };
+        std::chrono::nanoseconds handshake { 0 };
+    };
+
+    // One connection: handshake, greeting, close. The session is replaced by the one of this connection.
+    Sample connect_once(asio::io_context& io_context, asio::ssl::context& context, const asio::ip::tcp::endpoint& endpoint,
+                        SSL_SESSION*& session, const bool resume) {
+        Sample sample;
+        asio::ip::tcp::socket socket { io_context };
+        std::error_code ec;
+        ec = socket.connect(endpoint, ec);
+        if (ec) {
+            return sample;
+        }
+        ec = socket.set_option(asio::ip::tcp::no_delay { true }, ec);
+        asio::ssl::stream<asio::ip::tcp::socket&> stream { socket, context };
+        if (resume && session) {
+            SSL_set_session(stream.native_handle(), session);
+        }
+        const auto started = Clock::now();
+        ec = stream.handshake(asio::ssl::stream_base::client, ec);
+        sample.handshake = Clock::now() - started;
+        if (ec) {
+            return sample;
+        }
+        sample.resumed = SSL_session_reused(stream.native_handle()) == 1;
+        std::array<char, 64> greeting {};
+        if (stream.read_some(asio::buffer(greeting), ec) == 0 || ec) {
+            return sample;
+        }
+        if (auto* latest = SSL_get1_session(stream.native_handle())) {
+            if (session) {
+                SSL_SESSION_free(session);
+            }
+            session = latest;
+        }
+        sample.succeeded = true;
+        // A session of a connection without close_notify is not resumable, the server closes in return
+        ec = stream.shutdown(ec);
+        ec = socket.close(ec);
+        return sample;
+    }
+
+    bool run_once(const RunConfig& config, const Certificate& certificate, JsonWriter& json) {
+        const auto version_name = config.version == TLS1_3_VERSION ? "1.3" : "1.2";
+        std::fprintf(stderr, "version=%s mode=%s pool_threads=%zu ... ", version_name, config.mode.c_str(), config.pool_threads);
+
+        LeScheduler server { ThreadPoolConfig { config.pool_threads } };
+        auto server_config = std::make_shared<GreetingConfig>();
+        server_config->tls.enabled = true;
+        server_config->tls.certificate_chain_file = certificate.chain_file.string();
+        server_config->tls.private_key_file = certificate.key_file.string();
+        server_config->tls.tickets = config.mode != "session-id";
+        if (const auto ec = start_server_and_wait(server, std::make_shared<ServerConfig>(config.port, false,
+                ProtocolHandlerConfigVariant(NativeHandlerConfig::tcp<GreetingConfig>(std::move(server_config)))))) {
+            std::fprintf(stderr, "server did not start: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        asio::io_context io_context { 1 };
+        asio::ssl::context context { asio::ssl::context::tls_client };
+        SSL_CTX_set_min_proto_version(context.native_handle(), config.version);
+        SSL_CTX_set_max_proto_version(context.native_handle(), config.version);
+        // Sessions are handed over by the benchmark itself
+        SSL_CTX_set_session_cache_mode(context.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        const asio::ip::tcp::endpoint endpoint { asio::ip::make_address("127.0.0.1"), static_cast<asio::ip::port_type>(config.port) };
+        const auto resume = config.mode != "full";
+
+        SSL_SESSION* session { nullptr };
+        for (std::size_t i = 0; i < config.warmup; ++i) {
+            std::ignore = connect_once(io_context, context, endpoint, session, resume);
+        }
+        const auto before = server.metrics_snapshot(config.port);
+        HdrHistogram latency { 1, 60'000'000'000, 3 };
+        std::uint64_t errors = 0;
+        std::uint64_t resumed = 0;
+        const auto wall_start = Clock::now();
+        for (std::size_t i = 0; i < config.handshakes; ++i) {
+            const auto sample = connect_once(io_context, context, endpoint, session, resume);
+            if (!sample.succeeded) {
+                ++errors;
+                continue;
+            }
+            resumed += sample.resumed ? 1 : 0;
+            latency.record(sample.handshake.count());
+        }
+        const auto wall_time = std::chrono::duration<double>(Clock::now() - wall_start).count();
+        if (session) {
+            SSL_SESSION_free(session);
+        }
+        // Let the server finish the last sessions, so its counters are complete
+        std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+        const auto after = server.metrics_snapshot(config.port);
+        stop_server_and_wait(server, config.port);
+
+        const auto& server_handshakes = after.tls_handshake_duration;
+        json.begin_object()
+            .field("version", version_name)
+            .field("mode", config.mode)
+            .field("pool_threads", config.pool_threads)
+            .field("handshakes", config.handshakes)
+            .field("errors", errors)
+            .field("resumed", resumed)
+            .field("server_resumed", after.tls_resumed_handshakes - before.tls_resumed_handshakes)
+            .field("server_handshake_errors", after.tls_handshake_errors - before.tls_handshake_errors)
+            .field("duration_s", wall_time)
+            .field("handshakes_per_second", static_cast<double>(config.handshakes - errors) / wall_time);
+        write_latency(json, "client_handshake", latency);
+        // Includes the warmup handshakes
+        json.key("server_handshake").begin_object()
+            .field("count", server_handshakes.count)
+            .field("mean_us", server_handshakes.mean_ns() / 1000.0)
+            .field("p50_us", static_cast<double>(server_handshakes.p50_ns) / 1000.0)
+            .field("p99_us", static_cast<double>(server_handshakes.p99_ns) / 1000.0)
+            .field("max_us", static_cast<double>(server_handshakes.max_ns) / 1000.0)
+            .end_object();
+        json.end_object();
+
+        std::fprintf(stderr, "%.0f handshakes/s, p50 %.1f us, p99 %.1f us, %llu resumed, %llu errors\n",
+            static_cast<double>(config.handshakes - errors) / wall_time,
+            static_cast<double>(latency.value_at_percentile(50)) / 1000.0,
+            static_cast<double>(latency.value_at_percentile(99)) / 1000.0,
+            static_cast<unsigned long long>(resumed), static_cast<unsigned long long>(errors));
+        return errors == 0 && (config.mode == "full" ? resumed == 0 : resumed == config.handshakes);
+    }
+}
+
+int main(int argc, char** argv) {
+    const BenchmarkArguments arguments { argc, argv };
+    const auto versions = arguments.strings("versions", { "1.2", "1.3" });
+    const auto modes = arguments.strings("modes", { "full", "ticket", "session-id" });
+    const auto pool_threads = arguments.sizes("pool-threads", { 1 });
+    const auto handshakes = arguments.size("handshakes", 2000);
+    const auto warmup = arguments.size("warmup", 100);
+    const auto base_port = static_cast<int>(arguments.size("port", 19400));
+
+    Certificate certificate;
+    if (!generate_certificate(certificate)) {
+        std::fprintf(stderr, "[Error] Could not create the certificate\n");
+        return 1;
+    }
+
+    JsonWriter json;
+    json.begin_object();
+    write_environment(json, "tls_handshake", arguments.string("label", ""));
+    json.key("runs").begin_array();
+    bool succeeded = true;
+    int run = 0;
+    for (const auto& version : versions) {
+        if (version != "1.2" && version != "1.3") {
+            std::fprintf(stderr, "[Error] Unknown TLS version %s\n", version.c_str());
+            return 1;
+        }
+        for (const auto& mode : modes) {
+            if (mode != "full" && mode != "ticket" && mode != "session-id") {
+                std::fprintf(stderr, "[Error] Unknown mode %s\n", mode.c_str());
+                return 1;
+            }
+            for (const auto threads : pool_threads) {
+                // Every run uses its own port, so sockets of the previous run in TIME_WAIT do not interfere
+                succeeded &= run_once({
+                    version == "1.3" ? TLS1_3_VERSION : TLS1_2_VERSION, mode, threads, handshakes, warmup, base_port + run++
+                }, certificate, json);
+            }
+        }
+    }
+    json.end_array().end_object();
+
+    if (!write_json_output(arguments.string("output", "tls_handshake_benchmark.json"), json)) {
+        return 1;
+    }
+    return succeeded ? 0 : 1;
+}
+
+#else
+
+int main() {
+    std::fprintf(stderr, "[Error] Built without TLS, enable the TLS trait: swift run -c release --traits TLS lumengineTlsBenchmark\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,427 @@
+// UDP packet rate benchmark
+// Two measurements per mode (IPv4 and IPv6 loopback, the modes UdpHandler supports):
+// - blast: sender threads push datagrams at the handler as fast as they can, or at a fixed rate per sender.
+//   Packets received by the handler are compared with packets sent, and the kernel UDP error counters tell
+//   whether the rest was dropped in the receive buffer.
+// - echo: clients send one datagram at a time and wait for the handler to echo it, the round trip is recorded.
+// Results are written as JSON.
+//
+// Usage: lumengineUdpBenchmark [--modes v4,v6] [--payload 64,512,1400] [--senders 1,2,4] [--rate 0]
+//                              [--echo-clients 1] [--pool-threads 1] [--duration 2] [--port 19300]
+//                              [--label name] [--output udp_benchmark.json | -]
+
+#include <cxxLumengine.hpp>
+#include <benchmark_support.hpp>
+
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<std::uint64_t> received_packets { 0 };
+    std::atomic<std::uint64_t> received_bytes { 0 };
+
+    // Server callbacks, called through SwiftFunctionWrapper with the same argument tuples a Swift closure gets
+    using ReceiveArguments = std::tuple<UdpHandlerPtr, std::error_code, size_t, asio::ip::udp::endpoint>;
+
+    UDPCommandVariant sink_on_receive(void* arguments) {
+        const auto& [handler, ec, bytes, endpoint] = *static_cast<ReceiveArguments*>(arguments);
+        if (!ec) {
+            received_packets.fetch_add(1, std::memory_order_relaxed);
+            received_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+        return UDPCommandVariant { UDPReadCommand {} };
+    }
+
+    UDPCommandVariant echo_on_receive(void* arguments) {
+        const auto& [handler, ec, bytes, endpoint] = *static_cast<ReceiveArguments*>(arguments);
+        if (ec) {
+            return UDPCommandVariant { UDPReadCommand {} };
+        }
+        Buffer reply { bytes };
+        reply.write(handler->read_buffer().pointer(), bytes);
+        return UDPCommandVariant { UDPWriteCommand { std::move(reply), endpoint } };
+    }
+
+    UDPCommandVariant read_on_write(void*) {
+        return UDPCommandVariant { UDPReadCommand {} };
+    }
+
+    void ignore_event(void*) {}
+
+    ServerConfigPtr udp_server_config(const int port, const bool v6, const bool echo) {
+        return std::make_shared<ServerConfig>(port, v6, ProtocolHandlerConfigVariant(UdpConfig {
+            64 * 1024,
+            SwiftFunctionWrapper<UDPCommandVariant, UdpHandlerPtr, std::error_code, size_t, asio::ip::udp::endpoint>(
+                reinterpret_cast<void*>(echo ? &echo_on_receive : &sink_on_receive)
+            ),
+            SwiftFunctionWrapper<UDPCommandVariant, UdpHandlerPtr, std::error_code, size_t>(reinterpret_cast<void*>(&read_on_write)),
+            SwiftFunctionWrapper<void, UdpHandlerPtr>(reinterpret_cast<void*>(&ignore_event)),
+            SwiftFunctionWrapper<void, UdpHandlerPtr>(reinterpret_cast<void*>(&ignore_event)),
+        }));
+    }
+
+    // Kernel UDP counters. They are system wide, so other traffic on the machine shows up as well.
+    struct UdpKernelCounters {
+        std::uint64_t in_datagrams { 0 };
+        std::uint64_t in_errors { 0 };
+        std::uint64_t receive_buffer_errors { 0 };
+    };
+
+    // Reads /proc/net/snmp (Udp: header and value lines) or /proc/net/snmp6 (one "name value" per line)
+    std::optional<UdpKernelCounters> read_udp_counters(const bool v6) {
+        std::ifstream file { v6 ? "/proc/net/snmp6" : "/proc/net/snmp" };
+        if (!file) {
+            return std::nullopt;
+        }
+        std::map<std::string, std::uint64_t> values;
+        if (v6) {
+            std::string name;
+            std::uint64_t value;
+            while (file >> name >> value) {
+                values[name] = value;
+            }
+        } else {
+            std::string header;
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.starts_with("Udp: ")) {
+                    continue;
+                }
+                if (header.empty()) {
+                    header = line;
+                    continue;
+                }
+                std::stringstream names { header.substr(5) };
+                std::stringstream numbers { line.substr(5) };
+                std::string name;
+                std::uint64_t value;
+                while (names >> name && numbers >> value) {
+                    values["Udp" + name] = value;
+                }
+                break;
+            }
+        }
+        const auto prefix = v6 ? std::string { "Udp6" } : std::string { "Udp" };
+        if (!values.contains(prefix + "InDatagrams")) {
+            return std::nullopt;
+        }
+        return UdpKernelCounters {
+            values[prefix + "InDatagrams"],
+            values[prefix + "InErrors"],
+            values[prefix + "RcvbufErrors"],
+        };
+    }
+
+    // IPv6 can be disabled on the host, a mode that cannot bind is reported as skipped
+    bool loopback_available(const bool v6) {
+        asio::io_context io_context;
+        asio::ip::udp::socket socket { io_context };
+        std::error_code ec;
+        ec = socket.open(v6 ? asio::ip::udp::v6() : asio::ip::udp::v4(), ec);
+        if (!ec) {
+            ec = socket.bind({ asio::ip::make_address(v6 ? "::1" : "127.0.0.1"), 0 }, ec);
+        }
+        return !ec;
+    }
+
+    asio::ip::udp::endpoint loopback(const bool v6, const int port) {
+        return { asio::ip::make_address(v6 ? "::1" : "127.0.0.1"), static_cast<asio::ip::port_type>(port) };
+    }
+
+    struct SenderResult {
+        std::uint64_t sent { 0 };
+        std::uint64_t errors { 0 };
+        std::chrono::nanoseconds cpu_time { 0 };
+    };
+
+    // Sends until the deadline, paced when a rate in packets per second is given
+    void blast(const asio::ip::udp::endpoint endpoint, const std::size_t payload_size, const double rate,
+               const Clock::time_point deadline, SenderResult& result) {
+        asio::io_context io_context;
+        asio::ip::udp::socket socket { io_context };
+        std::error_code ec;
+        ec = socket.open(endpoint.protocol(), ec);
+        if (!ec) {
+            ec = socket.connect(endpoint, ec);
+        }
+        if (ec) {
+            ++result.errors;
+            return;
+        }
+        const std::vector<char> payload(payload_size, 'x');
+        const auto cpu_start = thread_cpu_time();
+        const auto interval = rate > 0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))
+            : Clock::duration::zero();
+        auto next = Clock::now();
+        while (true) {
+            const auto now = Clock::now();
+            if (now >= deadline) {
+                break;
+            }
+            if (rate > 0) {
+                if (now < next) {
+                    std::this_thread::sleep_until(std::min(next, deadline));
+                    continue;
+                }
+                next += interval;
+            }
+            socket.send(asio::buffer(payload), 0, ec);
+            ec ? ++result.errors : ++result.sent;
+        }
+        result.cpu_time = thread_cpu_time() - cpu_start;
+    }
+
+    struct EchoResult {
+        HdrHistogram latency { 1, 60'000'000'000, 3 };
+        std::uint64_t sent { 0 };
+        std::uint64_t lost { 0 };
+    };
+
+    // One datagram in flight. The sequence number in the payload discards late replies of timed out requests.
+    void echo_client(const asio::ip::udp::endpoint endpoint, const std::size_t payload_size,
+                     const Clock::time_point deadline, EchoResult& result) {
+        asio::io_context io_context;
+        asio::ip::udp::socket socket { io_context };
+        std::error_code ec;
+        ec = socket.open(endpoint.protocol(), ec);
+        if (!ec) {
+            ec = socket.connect(endpoint, ec);
+        }
+        if (ec) {
+            return;
+        }
+        timeval timeout { 0, 100'000 };
+        setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::vector<char> payload(std::max(payload_size, sizeof(std::uint64_t)), 'x');
+        std::vector<char> reply(payload.size());
+        for (std::uint64_t sequence = 0; Clock::now() < deadline; ++sequence) {
+            std::memcpy(payload.data(), &sequence, sizeof(sequence));
+            const auto sent = Clock::now();
+            socket.send(asio::buffer(payload), 0, ec);
+            if (ec) {
+                ++result.lost;
+                continue;
+            }
+            ++result.sent;
+            while (true) {
+                const auto bytes = socket.receive(asio::buffer(reply), 0, ec);
+                if (ec) {
+                    ++result.lost;
+                    break;
+                }
+                std::uint64_t echoed;
+                std::memcpy(&echoed, reply.data(), sizeof(echoed));
+                if (bytes == payload.size() && echoed == sequence) {
+                    result.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent).count());
+                    break;
+                }
+            }
+        }
+    }
+
+    struct RunConfig {
+        std::string mode;
+        bool v6;
+        std::size_t pool_threads;
+        std::size_t payload_size;
+        int port;
+        std::chrono::duration<double> duration;
+    };
+
+    bool run_blast(const RunConfig& config, const std::size_t senders, const double rate, JsonWriter& json) {
+        std::fprintf(stderr, "blast mode=%s senders=%zu payload=%zu rate=%.0f ... ",
+            config.mode.c_str(), senders, config.payload_size, rate);
+
+        LeScheduler scheduler { ThreadPoolConfig { config.pool_threads } };
+        if (const auto ec = start_server_and_wait(scheduler, udp_server_config(config.port, config.v6, false))) {
+            std::fprintf(stderr, "server did not start: %s\n", ec.message().c_str());
+            return false;
+        }
+        received_packets = 0;
+        received_bytes = 0;
+
+        const auto kernel_before = read_udp_counters(config.v6);
+        const auto cpu_start = process_cpu_time();
+        const auto wall_start = Clock::now();
+        const auto deadline = wall_start + std::chrono::duration_cast<Clock::duration>(config.duration);
+        std::vector<SenderResult> results(senders);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < senders; ++i) {
+            threads.emplace_back(blast, loopback(config.v6, config.port), config.payload_size, rate, deadline, std::ref(results[i]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto wall_time = std::chrono::duration<double>(Clock::now() - wall_start).count();
+
+        // Datagrams still queued in the socket are received, not dropped
+        auto previous = received_packets.load();
+        for (int i = 0; i < 50; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+            const auto current = received_packets.load();
+            if (current == previous) {
+                break;
+            }
+            previous = current;
+        }
+        const auto process_cpu = process_cpu_time() - cpu_start;
+        const auto kernel_after = read_udp_counters(config.v6);
+        stop_server_and_wait(scheduler, config.port);
+
+        std::uint64_t sent = 0;
+        std::uint64_t send_errors = 0;
+        std::chrono::nanoseconds sender_cpu { 0 };
+        for (const auto& result : results) {
+            sent += result.sent;
+            send_errors += result.errors;
+            sender_cpu += result.cpu_time;
+        }
+        const auto received = received_packets.load();
+        const auto lost = sent > received ? sent - received : 0;
+        const auto server_cpu = std::max(std::chrono::nanoseconds { 0 }, process_cpu - sender_cpu);
+
+        json.begin_object()
+            .field("test", "blast")
+            .field("mode", config.mode)
+            .field("pool_threads", config.pool_threads)
+            .field("payload_bytes", config.payload_size)
+            .field("senders", senders)
+            .field("target_rate_per_sender", rate)
+            .field("duration_s", wall_time)
+            .field("sent", sent)
+            .field("send_errors", send_errors)
+            .field("received", received)
+            .field("lost", lost)
+            .field("loss_ratio", sent ? static_cast<double>(lost) / static_cast<double>(sent) : 0.0)
+            .field("sent_per_second", static_cast<double>(sent) / wall_time)
+            .field("received_per_second", static_cast<double>(received) / wall_time)
+            .field("received_mib_per_second", static_cast<double>(received_bytes.load()) / wall_time / (1024.0 * 1024.0))
+            .field("server_cpu_us_per_packet", received ? static_cast<double>(server_cpu.count()) / 1000.0 / static_cast<double>(received) : 0.0);
+        if (kernel_before && kernel_after) {
+            json.key("kernel").begin_object()
+                .field("in_datagrams", kernel_after->in_datagrams - kernel_before->in_datagrams)
+                .field("in_errors", kernel_after->in_errors - kernel_before->in_errors)
+                .field("receive_buffer_errors", kernel_after->receive_buffer_errors - kernel_before->receive_buffer_errors)
+                .end_object();
+        }
+        json.end_object();
+
+        std::fprintf(stderr, "sent %.0f/s, received %.0f/s, loss %.2f%%\n",
+            static_cast<double>(sent) / wall_time,
+            static_cast<double>(received) / wall_time,
+            sent ? 100.0 * static_cast<double>(lost) / static_cast<double>(sent) : 0.0);
+        return true;
+    }
+
+    bool run_echo(const RunConfig& config, const std::size_t clients, JsonWriter& json) {
+        std::fprintf(stderr, "echo mode=%s clients=%zu payload=%zu ... ", config.mode.c_str(), clients, config.payload_size);
+
+        LeScheduler scheduler { ThreadPoolConfig { config.pool_threads } };
+        if (const auto ec = start_server_and_wait(scheduler, udp_server_config(config.port, config.v6, true))) {
+            std::fprintf(stderr, "server did not start: %s\n", ec.message().c_str());
+            return false;
+        }
+
+        const auto wall_start = Clock::now();
+        const auto deadline = wall_start + std::chrono::duration_cast<Clock::duration>(config.duration);
+        std::vector<EchoResult> results(clients);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < clients; ++i) {
+            threads.emplace_back(echo_client, loopback(config.v6, config.port), config.payload_size, deadline, std::ref(results[i]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto wall_time = std::chrono::duration<double>(Clock::now() - wall_start).count();
+        stop_server_and_wait(scheduler, config.port);
+
+        HdrHistogram latency { 1, 60'000'000'000, 3 };
+        std::uint64_t sent = 0;
+        std::uint64_t lost = 0;
+        for (const auto& result : results) {
+            latency.merge(result.latency);
+            sent += result.sent;
+            lost += result.lost;
+        }
+
+        json.begin_object()
+            .field("test", "echo")
+            .field("mode", config.mode)
+            .field("pool_threads", config.pool_threads)
+            .field("payload_bytes", config.payload_size)
+            .field("clients", clients)
+            .field("duration_s", wall_time)
+            .field("sent", sent)
+            .field("lost", lost)
+            .field("round_trips_per_second", static_cast<double>(latency.count()) / wall_time);
+        write_latency(json, "round_trip", latency);
+        json.end_object();
+
+        std::fprintf(stderr, "%.0f round trips/s, p50 %.1f us, p99 %.1f us, p99.9 %.1f us\n",
+            static_cast<double>(latency.count()) / wall_time,
+            static_cast<double>(latency.value_at_percentile(50)) / 1000.0,
+            static_cast<double>(latency.value_at_percentile(99)) / 1000.0,
+            static_cast<double>(latency.value_at_percentile(99.9)) / 1000.0);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    const BenchmarkArguments arguments { argc, argv };
+    const auto modes = arguments.strings("modes", { "v4", "v6" });
+    const auto payloads = arguments.sizes("payload", { 64, 512, 1400 });
+    const auto senders = arguments.sizes("senders", { 1, 2, 4 });
+    const auto rate = arguments.number("rate", 0);
+    const auto echo_clients = arguments.size("echo-clients", 1);
+    const auto pool_threads = arguments.size("pool-threads", 1);
+    const auto base_port = static_cast<int>(arguments.size("port", 19300));
+    const std::chrono::duration<double> duration { arguments.number("duration", 2) };
+
+    JsonWriter json;
+    json.begin_object();
+    write_environment(json, "udp", arguments.string("label", ""));
+    json.key("skipped_modes").begin_array();
+    std::vector<std::string> available_modes;
+    for (const auto& mode : modes) {
+        if (mode != "v4" && mode != "v6") {
+            std::fprintf(stderr, "[Error] Unknown mode %s, expected v4 or v6\n", mode.c_str());
+            return 1;
+        }
+        if (loopback_available(mode == "v6")) {
+            available_modes.push_back(mode);
+        } else {
+            std::fprintf(stderr, "mode %s is not available on this host, skipped\n", mode.c_str());
+            json.value(mode);
+        }
+    }
+    json.end_array();
+
+    json.key("runs").begin_array();
+    bool succeeded = true;
+    int port = base_port;
+    for (const auto& mode : available_modes) {
+        for (const auto payload : payloads) {
+            const RunConfig config { mode, mode == "v6", pool_threads, payload, port, duration };
+            for (const auto sender_count : senders) {
+                auto run = config;
+                run.port = port++;
+                succeeded &= run_blast(run, sender_count, rate, json);
+            }
+            auto run = config;
+            run.port = port++;
+            succeeded &= run_echo(run, echo_clients, json);
+        }
+    }
+    json.end_array().end_object();
+
+    if (!write_json_output(arguments.string("output", "udp_benchmark.json"), json)) {
+        return 1;
+    }
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+import CxxStdlib
+import Testing
+import cxxLumengineTestSupport
+
+// Every check returns its failed expectations, one per line
+@Test func parallelFor() {
+    let failures = String(engine_checks.parallel_for())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func workloadGraph() {
+    let failures = String(engine_checks.workload_graph())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func workloadHandles() {
+    let failures = String(engine_checks.workload_handles())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tcpStop() {
+    let failures = String(engine_checks.tcp_stop())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func waitForCompletion() {
+    let failures = String(engine_checks.wait_for_completion())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func drainLatch() {
+    let failures = String(engine_checks.drain_latch())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func udpStopOnPoolDestruction() {
+    let failures = String(engine_checks.udp_stop())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func metrics() {
+    let failures = String(engine_checks.metrics())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func callbackProfiler() {
+    let failures = String(engine_checks.callback_profiler())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func loopMonitor() {
+    let failures = String(engine_checks.loop_monitor())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tracing() {
+    let failures = String(engine_checks.tracing())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tcpClient() {
+    let failures = String(engine_checks.tcp_client())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tcpSplice() {
+    let failures = String(engine_checks.tcp_splice())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func lengthPrefixFraming() {
+    let failures = String(engine_checks.length_prefix_framing())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func delimiterFraming() {
+    let failures = String(engine_checks.delimiter_framing())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func httpParser() {
+    let failures = String(engine_checks.http_parser())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func webSocketParser() {
+    let failures = String(engine_checks.websocket())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tls() {
+    let failures = String(engine_checks.tls())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func tcpSendFile() {
+    let failures = String(engine_checks.tcp_send_file())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func hotFileCache() {
+    let failures = String(engine_checks.hot_file_cache())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func readBufferPool() {
+    let failures = String(engine_checks.read_buffer_pool())
+    #expect(failures.isEmpty, "\(failures)")
+}
+
+@Test func deadlineWheel() {
+    let failures = String(engine_checks.deadline_wheel())
+    #expect(failures.isEmpty, "\(failures)")
+}